@@ -0,0 +1,114 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+namespace epee
+{
+namespace metrics
+{
+  //! Each metric is split into this many slots, updated by different threads
+  //! and summed when read, so hot metrics don't bounce a single cache line
+  constexpr size_t NUM_SHARDS = 16;
+
+  inline size_t get_shard() noexcept
+  {
+    static std::atomic<size_t> next_shard{0};
+    static thread_local const size_t shard = next_shard++ % NUM_SHARDS;
+    return shard;
+  }
+
+  class counter
+  {
+  public:
+    counter() noexcept;
+
+    void inc(uint64_t n = 1) noexcept { shards[get_shard()].value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const noexcept;
+
+  private:
+    struct shard { std::atomic<uint64_t> value; char padding[64 - sizeof(std::atomic<uint64_t>)]; };
+    shard shards[NUM_SHARDS];
+  };
+
+  //! Counts values in power of two buckets: bucket b holds (2^(b-1), 2^b]
+  class histogram
+  {
+  public:
+    static constexpr size_t NUM_BUCKETS = 65;
+
+    histogram() noexcept;
+
+    void observe(uint64_t value) noexcept;
+    void get(uint64_t (&buckets)[NUM_BUCKETS], uint64_t &count, uint64_t &sum) const noexcept;
+
+  private:
+    struct shard { std::atomic<uint64_t> buckets[NUM_BUCKETS]; std::atomic<uint64_t> sum; };
+    shard shards[NUM_SHARDS];
+  };
+
+  //! Adds a duration in nanoseconds to a histogram (if any) when going out of scope
+  class scoped_timer
+  {
+  public:
+    scoped_timer(histogram *h) noexcept;
+    ~scoped_timer();
+
+  private:
+    histogram *h;
+    uint64_t start;
+  };
+
+  //! Metrics are always recorded, but the ones which need building their labels
+  //! on each update are only recorded when enabled (ie, when someone scrapes them)
+  void set_enabled(bool enabled);
+  bool is_enabled() noexcept;
+
+  //! Returns the metric with this name and labels, creating it if needed.
+  //! The returned reference stays valid for the lifetime of the process.
+  //! labels are of the form: key="value",key2="value2" (see label below).
+  //! Histogram values are multiplied by scale when exposed (eg, 1e-9 to expose
+  //! nanoseconds as seconds).
+  counter &get_counter(const std::string &name, const std::string &help, const std::string &labels = std::string());
+  histogram &get_histogram(const std::string &name, const std::string &help, double scale, const std::string &labels = std::string());
+
+  //! Returns key="value", with value escaped
+  std::string label(const char *key, const std::string &value);
+
+  //! All metrics in the Prometheus text exposition format
+  std::string get_exposition();
+
+  //! RPC request duration for this endpoint or method, NULL if metrics are disabled
+  histogram *get_rpc_request_histogram(const char *method);
+  void on_p2p_traffic(const char *command, bool sent, size_t bytes);
+}
+}
@@ -132,6 +132,7 @@ void mlog_set_categories(const char *categories);
 std::string mlog_get_categories();
 void mlog_set_log_level(int level);
 void mlog_set_log(const char *log);
+void mlog_set_async_file_logging(bool async);
 
 namespace epee
 {
@@ -30,6 +30,7 @@
 #include "jsonrpc_structs.h"
 #include "storages/portable_storage.h"
 #include "storages/portable_storage_template_helper.h"
+#include "metrics.h"
 
 #undef DINASTYCOIN_DEFAULT_LOG_CATEGORY
 #define DINASTYCOIN_DEFAULT_LOG_CATEGORY "net.http"
@@ -65,12 +66,15 @@
 
 #define MAP_URI2(pattern, callback)  else if(std::string::npos != query_info.m_URI.find(pattern)) return callback(query_info, response_info, &m_conn_context);
 
+#define MAP_URI_EXACT2(pattern, callback)  else if(query_info.m_URI == pattern) return callback(query_info, response_info, &m_conn_context);
+
 #define MAP_URI_AUTO_XML2(s_pattern, callback_f, command_type) //TODO: don't think i ever again will use xml - ambiguous and "overtagged" format
 
 #define MAP_URI_AUTO_JON2_IF(s_pattern, callback_f, command_type, cond) \
     else if((query_info.m_URI == s_pattern) && (cond)) \
     { \
       handled = true; \
+      epee::metrics::scoped_timer rpc_timer(epee::metrics::get_rpc_request_histogram(s_pattern)); \
       uint64_t ticks = misc_utils::get_tick_count(); \
       boost::value_initialized<command_type::request> req; \
       bool parse_res = epee::serialization::load_t_from_json(static_cast<command_type::request&>(req), query_info.m_body); \
@@ -101,6 +105,7 @@
     else if(query_info.m_URI == s_pattern) \
     { \
       handled = true; \
+      epee::metrics::scoped_timer rpc_timer(epee::metrics::get_rpc_request_histogram(s_pattern)); \
       uint64_t ticks = misc_utils::get_tick_count(); \
       boost::value_initialized<command_type::request> req; \
       bool parse_res = epee::serialization::load_t_from_binary(static_cast<command_type::request&>(req), epee::strspan<uint8_t>(query_info.m_body)); \
@@ -130,12 +135,18 @@
 #define END_URI_MAP2() return handled;}
 
 
-#define BEGIN_JSON_RPC_MAP(uri)    else if(query_info.m_URI == uri) \
+#define BEGIN_JSON_RPC_MAP(uri) BEGIN_JSON_RPC_MAP_PARSED(uri, nullptr)
+
+// parsed_storage is the request body if the caller already parsed it, or nullptr
+#define BEGIN_JSON_RPC_MAP_PARSED(uri, parsed_storage)    else if(query_info.m_URI == uri) \
     { \
     uint64_t ticks = epee::misc_utils::get_tick_count(); \
     response_info.m_mime_tipe = "application/json"; \
-    epee::serialization::portable_storage ps; \
-    if(!ps.load_from_json(query_info.m_body)) \
+    epee::serialization::portable_storage ps_; \
+    epee::serialization::portable_storage *parsed_ps = parsed_storage; \
+    if(!parsed_ps && ps_.load_from_json(query_info.m_body)) \
+      parsed_ps = &ps_; \
+    if(!parsed_ps) \
     { \
        boost::value_initialized<epee::json_rpc::error_response> rsp; \
        static_cast<epee::json_rpc::error_response&>(rsp).jsonrpc = "2.0"; \
@@ -144,6 +155,7 @@
        epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
        return true; \
     } \
+    epee::serialization::portable_storage &ps = *parsed_ps; \
     epee::serialization::storage_entry id_; \
     id_ = epee::serialization::storage_entry(std::string()); \
     ps.get_value("id", id_, nullptr); \
@@ -192,6 +204,7 @@
 #define MAP_JON_RPC_WE_IF(method_name, callback_f, command_type, cond) \
     else if((callback_name == method_name) && (cond)) \
 { \
+  epee::metrics::scoped_timer rpc_timer(epee::metrics::get_rpc_request_histogram(method_name)); \
   PREPARE_OBJECTS_FROM_JSON(command_type) \
   epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp); \
   fail_resp.jsonrpc = "2.0"; \
@@ -214,6 +227,7 @@
 #define MAP_JON_RPC_WERI(method_name, callback_f, command_type) \
     else if(callback_name == method_name) \
 { \
+  epee::metrics::scoped_timer rpc_timer(epee::metrics::get_rpc_request_histogram(method_name)); \
   PREPARE_OBJECTS_FROM_JSON(command_type) \
   epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp); \
   fail_resp.jsonrpc = "2.0"; \
@@ -234,6 +248,7 @@
 #define MAP_JON_RPC(method_name, callback_f, command_type) \
     else if(callback_name == method_name) \
 { \
+  epee::metrics::scoped_timer rpc_timer(epee::metrics::get_rpc_request_histogram(method_name)); \
   PREPARE_OBJECTS_FROM_JSON(command_type) \
   MINFO(m_conn_context << "calling RPC method " << method_name); \
   bool res = false; \
@@ -124,6 +124,49 @@ private:
      return i == 0;
   }
 
+  //stores v in slot i of the circular queue, maintains median in O(lg nItems)
+  void replace(int i, Item v)
+  {
+    int p = pos[i];
+    Item old = data[i];
+    data[i] = v;
+    if (p > 0)         //new item is in minHeap
+    {
+      if (minCt < (N - 1) / 2)
+      {
+        ++minCt;
+      }
+      else if (v > old)
+      {
+        minSortDown(p);
+        return;
+      }
+      if (minSortUp(p) && mmCmpExch(0, -1))
+        maxSortDown(-1);
+    }
+    else if (p < 0)   //new item is in maxheap
+    {
+      if (maxCt < N / 2)
+      {
+        ++maxCt;
+      }
+      else if (v < old)
+      {
+        maxSortDown(p);
+        return;
+      }
+      if (maxSortUp(p) && minCt && mmCmpExch(1, 0))
+        minSortDown(1);
+    }
+    else //new item is at median
+    {
+      if (maxCt && maxSortUp(-1))
+        maxSortDown(-1);
+      if (minCt && minSortUp(1))
+        minSortDown(1);
+    }
+  }
+
 protected:
   rolling_median_t &operator=(const rolling_median_t&) = delete;
   rolling_median_t(const rolling_median_t&) = delete;
@@ -176,49 +219,26 @@ public:
     return sz;
   }
 
+  int capacity() const
+  {
+    return N;
+  }
+
   //Inserts item, maintains median in O(lg nItems)
   void insert(Item v)
   {
-    int p = pos[idx];
-    Item old = data[idx];
-    data[idx] = v;
+    const int i = idx;
     idx = (idx + 1) % N;
     sz = std::min<int>(sz + 1, N);
-    if (p > 0)         //new item is in minHeap
-    {
-      if (minCt < (N - 1) / 2)
-      {
-        ++minCt;
-      }
-      else if (v > old)
-      {
-        minSortDown(p);
-        return;
-      }
-      if (minSortUp(p) && mmCmpExch(0, -1))
-        maxSortDown(-1);
-    }
-    else if (p < 0)   //new item is in maxheap
-    {
-      if (maxCt < N / 2)
-      {
-        ++maxCt;
-      }
-      else if (v < old)
-      {
-        maxSortDown(p);
-        return;
-      }
-      if (maxSortUp(p) && minCt && mmCmpExch(1, 0))
-        minSortDown(1);
-    }
-    else //new item is at median
-    {
-      if (maxCt && maxSortUp(-1))
-        maxSortDown(-1);
-      if (minCt && minSortUp(1))
-        minSortDown(1);
-    }
+    replace(i, v);
+  }
+
+  //Undoes the last insert into a full window, given the item that insert
+  //evicted, maintains median in O(lg nItems)
+  void rollback(Item evicted)
+  {
+    idx = (idx + N - 1) % N;
+    replace(idx, evicted);
   }
 
   //returns median item (or average of 2 when item count is even)
@@ -32,6 +32,7 @@
 #include <functional>
 #include "span.h"
 #include "net/levin_base.h"
+#include "metrics.h"
 
 #undef DINASTYCOIN_DEFAULT_LOG_CATEGORY
 #define DINASTYCOIN_DEFAULT_LOG_CATEGORY "net"
@@ -43,6 +44,7 @@ namespace
   {
     MCINFO("net.p2p.traffic", context << bytes << " bytes " << (sent ? "sent" : "received") << (error ? "/corrupt" : "")
         << " for category " << category << " initiated by " << (initiator ? "us" : "peer"));
+    epee::metrics::on_p2p_traffic(category, sent, bytes);
   }
   template<typename context_t>
   void on_levin_traffic(const context_t &context, bool initiator, bool sent, bool error, size_t bytes, int command)
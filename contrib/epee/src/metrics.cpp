@@ -0,0 +1,299 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <stdio.h>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include "misc_log_ex.h"
+#include "misc_os_dependent.h"
+#include "metrics.h"
+
+namespace
+{
+  struct family
+  {
+    std::string help;
+    bool is_histogram;
+    double scale;
+    std::map<std::string, std::unique_ptr<epee::metrics::counter>> counters;
+    std::map<std::string, std::unique_ptr<epee::metrics::histogram>> histograms;
+  };
+
+  std::atomic<bool> enabled{false};
+
+  boost::mutex &registry_mutex()
+  {
+    static boost::mutex mutex;
+    return mutex;
+  }
+
+  std::map<std::string, family> &registry()
+  {
+    static std::map<std::string, family> families;
+    return families;
+  }
+
+  // creating a metric needs the registry lock, so each thread remembers the
+  // ones it already looked up, and updating them takes no lock at all
+  template<typename T>
+  T &lookup(const std::string &name, const std::string &help, bool is_histogram, double scale, const std::string &labels,
+      std::map<std::string, std::unique_ptr<T>> family::*metrics)
+  {
+    static thread_local std::unordered_map<std::string, T*> cache;
+    std::string key;
+    key.reserve(name.size() + 1 + labels.size());
+    key.append(name).push_back('{');
+    key.append(labels);
+    const auto i = cache.find(key);
+    if (i != cache.end())
+      return *i->second;
+
+    boost::lock_guard<boost::mutex> lock(registry_mutex());
+    auto f = registry().find(name);
+    if (f == registry().end())
+    {
+      f = registry().emplace(name, family()).first;
+      f->second.help = help;
+      f->second.is_histogram = is_histogram;
+      f->second.scale = scale;
+    }
+    CHECK_AND_ASSERT_THROW_MES(f->second.is_histogram == is_histogram, "Metric " << name << " already exists with another type");
+    std::unique_ptr<T> &metric = (f->second.*metrics)[labels];
+    if (!metric)
+      metric.reset(new T());
+    cache.emplace(std::move(key), metric.get());
+    return *metric;
+  }
+
+  size_t get_bucket(uint64_t value) noexcept
+  {
+    if (value <= 1)
+      return 0;
+#if defined(__GNUC__)
+    return 64 - __builtin_clzll(value - 1);
+#else
+    size_t bucket = 0;
+    for (--value; value; value >>= 1)
+      ++bucket;
+    return bucket;
+#endif
+  }
+
+  void add_value(std::string &s, double value)
+  {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g", value);
+    s.append(buf);
+  }
+
+  void add_value(std::string &s, uint64_t value)
+  {
+    s.append(std::to_string(value));
+  }
+
+  void add_sample(std::string &s, const std::string &name, const char *suffix, const std::string &labels, const std::string &extra_label)
+  {
+    s.append(name).append(suffix);
+    if (!labels.empty() || !extra_label.empty())
+    {
+      s.push_back('{');
+      s.append(labels);
+      if (!labels.empty() && !extra_label.empty())
+        s.push_back(',');
+      s.append(extra_label);
+      s.push_back('}');
+    }
+    s.push_back(' ');
+  }
+}
+
+namespace epee
+{
+namespace metrics
+{
+  counter::counter() noexcept
+  {
+    for (shard &s: shards)
+      s.value = 0;
+  }
+
+  uint64_t counter::value() const noexcept
+  {
+    uint64_t total = 0;
+    for (const shard &s: shards)
+      total += s.value.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  histogram::histogram() noexcept
+  {
+    for (shard &s: shards)
+    {
+      for (std::atomic<uint64_t> &b: s.buckets)
+        b = 0;
+      s.sum = 0;
+    }
+  }
+
+  void histogram::observe(uint64_t value) noexcept
+  {
+    shard &s = shards[get_shard()];
+    s.buckets[get_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    s.sum.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  void histogram::get(uint64_t (&buckets)[NUM_BUCKETS], uint64_t &count, uint64_t &sum) const noexcept
+  {
+    count = 0;
+    sum = 0;
+    for (size_t b = 0; b < NUM_BUCKETS; ++b)
+      buckets[b] = 0;
+    for (const shard &s: shards)
+    {
+      for (size_t b = 0; b < NUM_BUCKETS; ++b)
+        buckets[b] += s.buckets[b].load(std::memory_order_relaxed);
+      sum += s.sum.load(std::memory_order_relaxed);
+    }
+    for (size_t b = 0; b < NUM_BUCKETS; ++b)
+      count += buckets[b];
+  }
+
+  scoped_timer::scoped_timer(histogram *h) noexcept: h(h), start(h ? misc_utils::get_ns_count() : 0)
+  {
+  }
+
+  scoped_timer::~scoped_timer()
+  {
+    if (h)
+      h->observe(misc_utils::get_ns_count() - start);
+  }
+
+  void set_enabled(bool e)
+  {
+    enabled = e;
+  }
+
+  bool is_enabled() noexcept
+  {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  counter &get_counter(const std::string &name, const std::string &help, const std::string &labels)
+  {
+    return lookup(name, help, false, 1.0, labels, &family::counters);
+  }
+
+  histogram &get_histogram(const std::string &name, const std::string &help, double scale, const std::string &labels)
+  {
+    return lookup(name, help, true, scale, labels, &family::histograms);
+  }
+
+  std::string label(const char *key, const std::string &value)
+  {
+    std::string s = key;
+    s.append("=\"");
+    for (const char c: value)
+    {
+      switch (c)
+      {
+        case '\\': s.append("\\\\"); break;
+        case '"': s.append("\\\""); break;
+        case '\n': s.append("\\n"); break;
+        default: s.push_back(c); break;
+      }
+    }
+    s.push_back('"');
+    return s;
+  }
+
+  std::string get_exposition()
+  {
+    std::string s;
+    uint64_t buckets[histogram::NUM_BUCKETS], count, sum;
+    boost::lock_guard<boost::mutex> lock(registry_mutex());
+    for (const auto &f: registry())
+    {
+      const std::string &name = f.first;
+      s.append("# HELP ").append(name).append(" ").append(f.second.help).append("\n");
+      s.append("# TYPE ").append(name).append(f.second.is_histogram ? " histogram\n" : " counter\n");
+      for (const auto &c: f.second.counters)
+      {
+        add_sample(s, name, "", c.first, std::string());
+        add_value(s, c.second->value());
+        s.push_back('\n');
+      }
+      for (const auto &h: f.second.histograms)
+      {
+        h.second->get(buckets, count, sum);
+        // empty buckets are skipped, the cumulative counts are the same without them
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < histogram::NUM_BUCKETS - 1; ++b)
+        {
+          if (!buckets[b])
+            continue;
+          cumulative += buckets[b];
+          std::string le = "le=\"";
+          add_value(le, (double)(((uint64_t)1) << b) * f.second.scale);
+          le.push_back('"');
+          add_sample(s, name, "_bucket", h.first, le);
+          add_value(s, cumulative);
+          s.push_back('\n');
+        }
+        add_sample(s, name, "_bucket", h.first, "le=\"+Inf\"");
+        add_value(s, count);
+        s.push_back('\n');
+        add_sample(s, name, "_sum", h.first, std::string());
+        add_value(s, sum * f.second.scale);
+        s.push_back('\n');
+        add_sample(s, name, "_count", h.first, std::string());
+        add_value(s, count);
+        s.push_back('\n');
+      }
+    }
+    return s;
+  }
+
+  histogram *get_rpc_request_histogram(const char *method)
+  {
+    if (!is_enabled())
+      return NULL;
+    return &get_histogram("dinastycoin_rpc_request_seconds", "RPC request durations", 1e-9, label("method", method));
+  }
+
+  void on_p2p_traffic(const char *command, bool sent, size_t bytes)
+  {
+    if (!is_enabled())
+      return;
+    get_counter("dinastycoin_p2p_bytes_total", "P2P traffic by levin command",
+        label("command", command) + (sent ? ",direction=\"sent\"" : ",direction=\"received\"")).inc(bytes);
+  }
+}
+}
@@ -163,6 +163,8 @@ void mlog_configure(const std::string &filename_base, bool console, const std::s
   el::Loggers::addFlag(el::LoggingFlag::DisableApplicationAbortOnFatalLog);
   el::Loggers::addFlag(el::LoggingFlag::ColoredTerminalOutput);
   el::Loggers::addFlag(el::LoggingFlag::StrictLogFileSizeCheck);
+  // this runs while the log file is being written, possibly on the async
+  // writer's thread, so it must not log: failures are ignored
   el::Helpers::installPreRollOutCallback([filename_base, max_log_files](const char *name, size_t){
     std::string rname = generate_log_filename(filename_base.c_str());
     int ret = rename(name, rname.c_str());
@@ -191,16 +193,10 @@ void mlog_configure(const std::string &filename_base, bool console, const std::s
           boost::system::error_code ec;
           std::time_t ta = boost::filesystem::last_write_time(boost::filesystem::path(a), ec);
           if (ec)
-          {
-            MERROR("Failed to get timestamp from " << a << ": " << ec);
             ta = std::time(nullptr);
-          }
           std::time_t tb = boost::filesystem::last_write_time(boost::filesystem::path(b), ec);
           if (ec)
-          {
-            MERROR("Failed to get timestamp from " << b << ": " << ec);
             tb = std::time(nullptr);
-          }
           static_assert(std::is_integral<time_t>(), "bad time_t");
           return ta < tb;
         });
@@ -210,14 +206,9 @@ void mlog_configure(const std::string &filename_base, bool console, const std::s
           {
             boost::system::error_code ec;
             boost::filesystem::remove(found_files[i], ec);
-            if (ec)
-            {
-              MERROR("Failed to remove " << found_files[i] << ": " << ec);
-            }
           }
-          catch (const std::exception &e)
+          catch (const std::exception &)
           {
-            MERROR("Failed to remove " << found_files[i] << ": " << e.what());
           }
         }
       }
@@ -317,6 +308,14 @@ void mlog_set_log(const char *log)
   }
 }
 
+// log lines are queued and written to the log file by a background thread,
+// which flushes once per batch rather than once per line
+void mlog_set_async_file_logging(bool async)
+{
+  el::Helpers::setAsyncFileLogging(async);
+  MLOG_LOG("Asynchronous log file writes " << (async ? "enabled" : "disabled"));
+}
+
 namespace epee
 {
 
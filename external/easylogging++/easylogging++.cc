@@ -18,6 +18,8 @@
 #include "easylogging++.h"
 
 #include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
 
 #if defined(AUTO_INITIALIZE_EASYLOGGINGPP)
 INITIALIZE_EASYLOGGINGPP
@@ -690,6 +692,180 @@ void LogBuilder::setColor(Color color, bool bright) {
     el::base::utils::setConsoleColor(color, bright);
 }
 
+// el::base
+namespace base {
+
+#if ELPP_THREADING_ENABLED && ELPP_USE_STD_THREADING
+/// @brief Writes log lines to their files from a background thread.
+///
+/// Lines are written in batches, and the files are flushed once per batch.
+/// Logging threads only queue their lines. The file I/O is serialized by the
+/// writer's own mutex rather than the storage lock, so logging threads do not
+/// wait for it. The writer takes no logger or storage lock, so the pre-roll
+/// callback, which it runs, must not log.
+class AsyncFileWriter : base::NoCopy {
+ public:
+  AsyncFileWriter(void) : m_enabled(false), m_running(false), m_stopping(false), m_queued(0), m_written(0) {}
+  ~AsyncFileWriter(void) {
+    stop();
+  }
+
+  inline bool enabled(void) const {
+    return m_enabled.load(std::memory_order_acquire);
+  }
+
+  void start(void) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_running)
+      return;
+    m_running = true;
+    m_stopping = false;
+    m_thread = std::thread([this](void) { run(); });
+    m_enabled = true;
+  }
+
+  void stop(void) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      if (!m_running || m_stopping)
+        return;
+      m_stopping = true;
+    }
+    m_cv.notify_one();
+    m_writtenCv.notify_all();
+    m_thread.join();
+    // lines are pushed with the storage lock held, so once it is taken here
+    // no more can be queued, and the last ones are written before logging
+    // threads go back to writing their own lines
+    base::threading::ScopedLock scopedLock(ELPP->lock());
+    std::unique_lock<std::recursive_mutex> writeLock(m_writeMutex);
+    flush();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_enabled = false;
+    m_running = false;
+    m_stopping = false;
+  }
+
+  /// @brief Queues a line for its logger's file. Called with the storage lock held.
+  /// @return false if the writer is not running, and the line should be written now
+  bool push(Logger* logger, Level level, base::type::string_t&& line) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_running)
+      return false;
+    if (m_queue.empty())
+      m_cv.notify_one();
+    m_queue.push_back(Entry{logger, level, std::move(line)});
+    const uint64_t position = ++m_queued;
+    // fatal lines are on disk before the process aborts, and a logging storm
+    // can't grow the queue without bounds. Both wait for the writer thread
+    // rather than writing here, under the locks the caller holds
+    if (m_stopping || std::this_thread::get_id() == m_thread.get_id())
+      return true;
+    if (level == Level::Fatal)
+      m_writtenCv.wait(lock, [this, position](void) { return m_written >= position || m_stopping; });
+    else if (m_queue.size() >= kMaxQueuedLines)
+      m_writtenCv.wait(lock, [this](void) { return m_queue.size() < kMaxQueuedLines || m_stopping; });
+    return true;
+  }
+
+  /// @brief Writes the queued lines now. Batches are taken and written under the
+  /// write mutex, so they reach the files in order
+  void flush(void) {
+    std::unique_lock<std::recursive_mutex> writeLock(m_writeMutex);
+    std::vector<Entry> batch;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      batch.swap(m_queue);
+    }
+    m_writtenCv.notify_all();
+    write(batch);
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_written += batch.size();
+    }
+    m_writtenCv.notify_all();
+  }
+
+  /// @brief Writes the queued lines, and holds off any more writes until the
+  /// returned lock is released, for changes to the loggers' files
+  std::unique_lock<std::recursive_mutex> pause(void) {
+    std::unique_lock<std::recursive_mutex> writeLock(m_writeMutex);
+    flush();
+    return writeLock;
+  }
+
+ private:
+  struct Entry {
+    Logger* logger;
+    Level level;
+    base::type::string_t line;
+  };
+  static const std::size_t kMaxQueuedLines = 65536;
+
+  void run(void) {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this](void) { return !m_queue.empty() || m_stopping; });
+        if (m_stopping)
+          return;
+      }
+      flush();
+    }
+  }
+
+  void write(std::vector<Entry>& batch) {
+    std::vector<base::type::fstream_t*> streams;
+    for (Entry& e : batch) {
+      base::TypedConfigurations* tc = e.logger->typedConfigurations();
+      if (ELPP->hasFlag(LoggingFlag::StrictLogFileSizeCheck)) {
+        tc->validateFileRolling(e.level, ELPP->preRollOutCallback());
+      }
+      base::type::fstream_t* fs = tc->fileStream(e.level);
+      if (fs == nullptr)
+        continue;
+      fs->write(e.line.c_str(), e.line.size());
+      if (fs->fail()) {
+        ELPP_INTERNAL_ERROR("Unable to write log to file [" << tc->filename(e.level) << "].\n", true);
+      }
+      if (std::find(streams.begin(), streams.end(), fs) == streams.end())
+        streams.push_back(fs);
+    }
+    for (base::type::fstream_t* fs : streams)
+      fs->flush();
+  }
+
+  std::atomic<bool> m_enabled;
+  bool m_running;
+  bool m_stopping;
+  std::mutex m_mutex;
+  std::recursive_mutex m_writeMutex;
+  std::condition_variable m_cv;
+  std::condition_variable m_writtenCv;
+  std::vector<Entry> m_queue;
+  uint64_t m_queued;
+  uint64_t m_written;
+  std::thread m_thread;
+};
+#else
+class AsyncFileWriter : base::NoCopy {
+ public:
+  inline bool enabled(void) const { return false; }
+  void start(void) {}
+  void stop(void) {}
+  bool push(Logger*, Level, base::type::string_t&&) { return false; }
+  void flush(void) {}
+  int pause(void) { return 0; }
+};
+#endif  // ELPP_THREADING_ENABLED && ELPP_USE_STD_THREADING
+
+static AsyncFileWriter& asyncFileWriter(void) {
+  static AsyncFileWriter writer;
+  return writer;
+}
+
+}  // namespace base
+
 // Logger
 
 Logger::Logger(const std::string& id, base::LogStreamsReferenceMap* logStreamsReference) :
@@ -747,6 +923,8 @@ void Logger::configure(const Configurations& configurations) {
     }
   }
   base::threading::ScopedLock scopedLock(lock());
+  // the async file writer uses the typed configurations without the logger lock
+  auto asyncWriterLock = base::asyncFileWriter().pause();
   if (m_configurations != configurations) {
     m_configurations.setFromBase(const_cast<Configurations*>(&configurations));
   }
@@ -773,6 +951,7 @@ bool Logger::isValidId(const std::string& id) {
 void Logger::flush(void) {
   ELPP_INTERNAL_INFO(3, "Flushing logger [" << m_id << "] all levels");
   base::threading::ScopedLock scopedLock(lock());
+  auto asyncWriterLock = base::asyncFileWriter().pause();
   base::type::EnumType lIndex = LevelHelper::kMinValid;
   LevelHelper::forEachLevel(&lIndex, [&](void) -> bool {
     flush(LevelHelper::castFromInt(lIndex), nullptr);
@@ -2035,7 +2214,7 @@ void RegisteredLoggers::unsafeFlushAll(void) {
 
 // VRegistry
 
-VRegistry::VRegistry(base::type::VerboseLevel level, base::type::EnumType* pFlags) : m_level(level), m_pFlags(pFlags), m_lowest_priority(INT_MAX) {
+VRegistry::VRegistry(base::type::VerboseLevel level, base::type::EnumType* pFlags) : m_level(level), m_pFlags(pFlags), m_categories_generation(1), m_lowest_priority(INT_MAX) {
 }
 
 /// @brief Sets verbose level. Accepted range is 0-9
@@ -2136,6 +2315,7 @@ void VRegistry::setCategories(const char* categories, bool clear) {
   auto insert = [&](std::stringstream& ss, Level level) {
     m_categories.push_back(std::make_pair(ss.str(), level));
     m_cached_allowed_categories.clear();
+    ++m_categories_generation;
     int pri = priority(level);
     if (pri > m_lowest_priority)
       m_lowest_priority = pri;
@@ -2145,6 +2325,7 @@ void VRegistry::setCategories(const char* categories, bool clear) {
     m_lowest_priority = 0;
     m_categories.clear();
     m_cached_allowed_categories.clear();
+    ++m_categories_generation;
     m_categoriesString.clear();
   }
   if (!categories)
@@ -2203,24 +2384,43 @@ bool VRegistry::allowed(Level level, const std::string &category) {
   const int pri = priority(level);
   if (pri > m_lowest_priority)
     return false;
-  base::threading::ScopedLock scopedLock(lock());
-  const std::map<std::string, int>::const_iterator it = m_cached_allowed_categories.find(category);
-  if (it != m_cached_allowed_categories.end())
-    return pri <= it->second;
-  if (m_categories.empty()) {
-    return false;
-  } else {
-    std::vector<std::pair<std::string, Level>>::const_reverse_iterator it = m_categories.rbegin();
-    for (; it != m_categories.rend(); ++it) {
-      if (base::utils::Str::wildCardMatch(category.c_str(), it->first.c_str())) {
-        const int p = priority(it->second);
-        m_cached_allowed_categories.insert(std::make_pair(category, p));
-        return pri <= p;
+
+  // each thread keeps its own copy of the category cache, dropped whenever the
+  // categories change, so checking a category usually takes no lock
+  static thread_local const VRegistry *t_registry = nullptr;
+  static thread_local unsigned int t_generation = 0;
+  static thread_local std::unordered_map<std::string, int> t_allowed_categories;
+  const unsigned int generation = m_categories_generation.load(std::memory_order_acquire);
+  if (t_registry != this || t_generation != generation) {
+    t_allowed_categories.clear();
+    t_registry = this;
+    t_generation = generation;
+  }
+  const std::unordered_map<std::string, int>::const_iterator t_it = t_allowed_categories.find(category);
+  if (t_it != t_allowed_categories.end())
+    return pri <= t_it->second;
+
+  int p = -1;
+  {
+    base::threading::ScopedLock scopedLock(lock());
+    const std::map<std::string, int>::const_iterator it = m_cached_allowed_categories.find(category);
+    if (it != m_cached_allowed_categories.end()) {
+      p = it->second;
+    } else {
+      std::vector<std::pair<std::string, Level>>::const_reverse_iterator it = m_categories.rbegin();
+      for (; it != m_categories.rend(); ++it) {
+        if (base::utils::Str::wildCardMatch(category.c_str(), it->first.c_str())) {
+          p = priority(it->second);
+          break;
+        }
       }
+      m_cached_allowed_categories.insert(std::make_pair(category, p));
     }
-    m_cached_allowed_categories.insert(std::make_pair(category, -1));
-    return false;
+    if (m_categories_generation.load(std::memory_order_relaxed) != generation)
+      return pri <= p;
   }
+  t_allowed_categories.insert(std::make_pair(category, p));
+  return pri <= p;
 }
 
 bool VRegistry::allowed(base::type::VerboseLevel vlevel, const char* file) {
@@ -2571,7 +2771,8 @@ void sanitize(std::string &s)
 
 void DefaultLogDispatchCallback::dispatch(base::type::string_t&& rawLinePrefix, base::type::string_t&& rawLinePayload, base::type::string_t&& logLine) {
   if (m_data->dispatchAction() == base::DispatchAction::NormalLog || m_data->dispatchAction() == base::DispatchAction::FileOnlyLog) {
-    if (m_data->logMessage()->logger()->m_typedConfigurations->toFile(m_data->logMessage()->level())) {
+    if (m_data->logMessage()->logger()->m_typedConfigurations->toFile(m_data->logMessage()->level())
+        && !asyncFileWriter().push(m_data->logMessage()->logger(), m_data->logMessage()->level(), std::move(logLine))) {
       base::type::fstream_t* fs = m_data->logMessage()->logger()->m_typedConfigurations->fileStream(
                                     m_data->logMessage()->level());
       if (fs != nullptr) {
@@ -2850,7 +3051,8 @@ void LogDispatcher::dispatch(void) {
   base::threading::ScopedLock scopedLock(ELPP->lock());
 #endif
   base::TypedConfigurations* tc = m_logMessage->logger()->m_typedConfigurations;
-  if (ELPP->hasFlag(LoggingFlag::StrictLogFileSizeCheck)) {
+  // the async file writer checks for rolling when it writes the lines
+  if (ELPP->hasFlag(LoggingFlag::StrictLogFileSizeCheck) && !asyncFileWriter().enabled()) {
     tc->validateFileRolling(m_logMessage->level(), ELPP->preRollOutCallback());
   }
   LogDispatchCallback* callback = nullptr;
@@ -3273,6 +3475,7 @@ static void logCrashReason(int sig, bool stackTraceIfAvailable, Level level, con
 }
 
 static inline void crashAbort(int sig) {
+  base::asyncFileWriter().flush();
   base::utils::abort(sig, std::string());
 }
 
@@ -3325,6 +3528,7 @@ void Helpers::crashAbort(int sig, const char* sourceFile, unsigned int long line
     else
       ss << " (line number not specified)";
   }
+  base::asyncFileWriter().flush();
   base::utils::abort(sig, ss.str());
 }
 
@@ -3334,6 +3538,17 @@ void Helpers::logCrashReason(int sig, bool stackTraceIfAvailable, Level level, c
 
 #endif // defined(ELPP_FEATURE_ALL) || defined(ELPP_FEATURE_CRASH_LOG)
 
+void Helpers::setAsyncFileLogging(bool enabled) {
+  if (enabled)
+    base::asyncFileWriter().start();
+  else
+    base::asyncFileWriter().stop();
+}
+
+void Helpers::flushAsyncFileLogging(void) {
+  base::asyncFileWriter().flush();
+}
+
 // Loggers
 
 Logger* Loggers::getLogger(const std::string& identity, bool registerIfNotAvailable) {
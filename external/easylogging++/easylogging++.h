@@ -507,6 +507,7 @@ class PErrorWriter;
 class LogDispatcher;
 class DefaultLogBuilder;
 class DefaultLogDispatchCallback;
+class AsyncFileWriter;
 #if ELPP_ASYNC_LOGGING
 class AsyncLogDispatchCallback;
 class AsyncDispatchWorker;
@@ -1986,6 +1987,7 @@ class TypedConfigurations : public base::threading::ThreadSafe {
   friend class el::base::Writer;
   friend class el::base::DefaultLogDispatchCallback;
   friend class el::base::LogDispatcher;
+  friend class el::base::AsyncFileWriter;
 
   template <typename Conf_T>
   inline Conf_T getConfigByVal(Level level, const std::unordered_map<Level, Conf_T>* confMap, const char* confName) {
@@ -2468,6 +2470,7 @@ class VRegistry : base::NoCopy, public base::threading::ThreadSafe {
     base::threading::ScopedLock scopedLock(lock());
     m_categories.clear();
     m_cached_allowed_categories.clear();
+    ++m_categories_generation;
     m_lowest_priority = INT_MAX;
   }
 
@@ -2511,6 +2514,7 @@ class VRegistry : base::NoCopy, public base::threading::ThreadSafe {
   std::unordered_map<std::string, base::type::VerboseLevel> m_modules;
   std::vector<std::pair<std::string, Level>> m_categories;
   std::map<std::string, int> m_cached_allowed_categories;
+  std::atomic<unsigned int> m_categories_generation;
   std::string m_categoriesString;
   std::string m_filenameCommonPrefix;
   std::atomic<int> m_lowest_priority;
@@ -3758,6 +3762,11 @@ class Helpers : base::StaticClass {
   static inline void setThreadName(const std::string& name) {
     ELPP->setThreadName(name);
   }
+  /// @brief Writes log files from a background thread, flushing once per batch of lines,
+  /// instead of writing and flushing each line from the logging thread. Requires std::thread
+  static void setAsyncFileLogging(bool enabled);
+  /// @brief Writes the lines queued by async file logging now
+  static void flushAsyncFileLogging(void);
   static inline std::string getThreadName() {
     return ELPP->getThreadName(base::threading::getCurrentThreadId());
   }
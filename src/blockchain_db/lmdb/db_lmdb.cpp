@@ -44,9 +44,11 @@
 #include "file_io_utils.h"
 #include "common/util.h"
 #include "common/pruning.h"
+#include "common/trace.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "crypto/crypto.h"
 #include "profile_tools.h"
+#include "metrics.h"
 #include "ringct/rctOps.h"
 
 #undef DINASTYCOIN_DEFAULT_LOG_CATEGORY
@@ -425,6 +427,9 @@ void mdb_txn_safe::commit(std::string message)
     message = "Failed to commit a transaction to the db";
   }
 
+  TRACE_SPAN(lmdb_txn_commit);
+  static epee::metrics::histogram &commit_histogram = epee::metrics::get_histogram("dinastycoin_lmdb_txn_commit_seconds", "LMDB transaction commit durations", 1e-9);
+  epee::metrics::scoped_timer commit_timer(&commit_histogram);
   if (auto result = mdb_txn_commit(m_txn))
   {
     m_txn = nullptr;
@@ -31,6 +31,7 @@
 #include "common/unordered_containers_boost_serialization.h"
 #include "common/command_line.h"
 #include "common/varint.h"
+#include "common/threadpool.h"
 #include "serialization/crypto.h"
 #include "cryptonote_basic/cryptonote_boost_serialization.h"
 #include "cryptonote_core/tx_pool.h"
@@ -50,6 +51,8 @@ using namespace cryptonote;
 static const char zerokey[8] = {0};
 static const MDB_val zerokval = { sizeof(zerokey), (void *)zerokey };
 
+static const size_t TXES_PER_PARSE_TASK = 256;
+
 static uint64_t records_per_sync = 200;
 static uint64_t db_flags = 0;
 static MDB_dbi dbi_relative_rings;
@@ -68,6 +71,7 @@ struct output_data
   output_data(): amount(0), offset(0) {}
   output_data(uint64_t a, uint64_t i): amount(a), offset(i) {}
   bool operator==(const output_data &other) const { return other.amount == amount && other.offset == offset; }
+  bool operator<(const output_data &other) const { return amount < other.amount || (amount == other.amount && offset < other.offset); }
 };
 
 //
@@ -369,37 +373,66 @@ static bool for_all_transactions(const std::string &filename, uint64_t &start_id
 
   bool fret = true;
 
+  // Transactions are read in batches and parsed on the threadpool, then handed
+  // to f in index order, so the (stateful) analysis sees the same sequence
+  tools::threadpool &tpool = tools::threadpool::getInstance();
+  const size_t n_threads = std::max<size_t>(tpool.get_max_concurrency(), 1);
+  const size_t batch_size = n_threads * TXES_PER_PARSE_TASK;
+  std::vector<std::pair<uint64_t, blobdata>> blobs;
+  std::vector<cryptonote::transaction_prefix> txes;
+  std::unique_ptr<bool[]> parsed(new bool[batch_size]);
+  blobs.reserve(batch_size);
+
   k.mv_size = sizeof(uint64_t);
   k.mv_data = &start_idx;
   MDB_cursor_op op = MDB_SET;
-  while (1)
+  bool done = false;
+  while (fret && !done)
   {
-    int ret = mdb_cursor_get(cur, &k, &v, op);
-    op = MDB_NEXT;
-    if (ret == MDB_NOTFOUND)
+    blobs.clear();
+    while (blobs.size() < batch_size)
+    {
+      int ret = mdb_cursor_get(cur, &k, &v, op);
+      op = MDB_NEXT;
+      if (ret == MDB_NOTFOUND)
+      {
+        done = true;
+        break;
+      }
+      if (ret)
+        throw std::runtime_error("Failed to enumerate transactions: " + std::string(mdb_strerror(ret)));
+
+      if (k.mv_size != sizeof(uint64_t))
+        throw std::runtime_error("Bad key size");
+      const uint64_t idx = *(uint64_t*)k.mv_data;
+      if (idx < start_idx)
+        continue;
+      blobs.emplace_back(idx, blobdata(reinterpret_cast<const char*>(v.mv_data), v.mv_size));
+    }
+    if (blobs.empty())
       break;
-    if (ret)
-      throw std::runtime_error("Failed to enumerate transactions: " + std::string(mdb_strerror(ret)));
 
-    if (k.mv_size != sizeof(uint64_t))
-      throw std::runtime_error("Bad key size");
-    const uint64_t idx = *(uint64_t*)k.mv_data;
-    if (idx < start_idx)
-      continue;
+    txes.clear();
+    txes.resize(blobs.size());
+    tools::threadpool::waiter waiter(tpool);
+    for (size_t begin = 0; begin < blobs.size(); begin += TXES_PER_PARSE_TASK)
+    {
+      const size_t end = std::min(begin + TXES_PER_PARSE_TASK, blobs.size());
+      tpool.submit(&waiter, [&blobs, &txes, &parsed, begin, end](){
+        for (size_t i = begin; i < end; ++i)
+          parsed[i] = parse_and_validate_tx_prefix_from_blob(blobs[i].second, txes[i]);
+      }, true);
+    }
+    CHECK_AND_ASSERT_MES(waiter.wait(), false, "Failed to parse transactions");
 
-    cryptonote::transaction_prefix tx;
-    blobdata bd;
-    bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
-    std::stringstream ss;
-    ss << bd;
-    binary_archive<false> ba(ss);
-    bool r = do_serialize(ba, tx);
-    CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
-
-    start_idx = *(uint64_t*)k.mv_data;
-    if (!f(tx)) {
-      fret = false;
-      break;
+    for (size_t i = 0; i < blobs.size(); ++i)
+    {
+      CHECK_AND_ASSERT_MES(parsed[i], false, "Failed to parse transaction from blob");
+      start_idx = blobs[i].first;
+      if (!f(txes[i])) {
+        fret = false;
+        break;
+      }
     }
   }
 
@@ -1494,14 +1527,11 @@ int main(int argc, char* argv[])
           {
             MDEBUG("Rings are different");
             std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
+            // absolute offsets are sorted, so the intersection is linear
             const std::vector<uint64_t> r0 = cryptonote::relative_output_offsets_to_absolute(relative_ring);
             const std::vector<uint64_t> r1 = cryptonote::relative_output_offsets_to_absolute(txin.key_offsets);
             std::vector<uint64_t> common;
-            for (uint64_t out: r0)
-            {
-              if (std::find(r1.begin(), r1.end(), out) != r1.end())
-                common.push_back(out);
-            }
+            std::set_intersection(r0.begin(), r0.end(), r1.begin(), r1.end(), std::back_inserter(common));
             if (common.empty())
             {
               MERROR("Rings for the same key image are disjoint");
@@ -1523,10 +1553,7 @@ int main(int argc, char* argv[])
             {
               MDEBUG("The intersection has more than one element, it's still ok");
               std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
-              for (const auto &out: r0)
-                if (std::find(common.begin(), common.end(), out) != common.end())
-                  new_ring.push_back(out);
-              new_ring = cryptonote::absolute_output_offsets_to_relative(new_ring);
+              new_ring = cryptonote::absolute_output_offsets_to_relative(common);
             }
           }
         }
@@ -1618,6 +1645,8 @@ int main(int argc, char* argv[])
     std::vector<std::pair<uint64_t, uint64_t>> blackballs;
     std::vector<output_data> scan_spent = std::move(work_spent);
     work_spent.clear();
+    std::sort(scan_spent.begin(), scan_spent.end());
+    scan_spent.erase(std::unique(scan_spent.begin(), scan_spent.end()), scan_spent.end());
     for (const output_data &od: scan_spent)
     {
       std::vector<crypto::key_image> key_images = get_key_images(txn, od);
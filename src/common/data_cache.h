@@ -0,0 +1,80 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <deque>
+#include <unordered_set>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+namespace tools
+{
+  // a thread safe set of the MAX_SIZE most recently added values
+  template<typename T, size_t MAX_SIZE>
+  class data_cache
+  {
+  public:
+    void add(const T &value)
+    {
+      boost::lock_guard<boost::mutex> lock(m_lock);
+      if (!m_set.insert(value).second)
+        return;
+      m_order.push_back(value);
+      while (m_order.size() > MAX_SIZE)
+      {
+        m_set.erase(m_order.front());
+        m_order.pop_front();
+      }
+    }
+
+    bool has(const T &value) const
+    {
+      boost::lock_guard<boost::mutex> lock(m_lock);
+      return m_set.find(value) != m_set.end();
+    }
+
+    void clear()
+    {
+      boost::lock_guard<boost::mutex> lock(m_lock);
+      m_set.clear();
+      m_order.clear();
+    }
+
+    size_t size() const
+    {
+      boost::lock_guard<boost::mutex> lock(m_lock);
+      return m_set.size();
+    }
+
+  private:
+    mutable boost::mutex m_lock;
+    std::unordered_set<T> m_set;
+    std::deque<T> m_order;
+  };
+}
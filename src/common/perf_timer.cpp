@@ -28,6 +28,7 @@
 
 #include <vector>
 #include "misc_os_dependent.h"
+#include "metrics.h"
 #include "perf_timer.h"
 
 #undef DINASTYCOIN_DEFAULT_LOG_CATEGORY
@@ -155,6 +156,11 @@ LoggingPerformanceTimer::~LoggingPerformanceTimer()
     size_t size = 0; for (const auto *tmp: *performance_timers) if (!tmp->paused || tmp==this) ++size;
     PERF_LOG_ALWAYS(level, cat.c_str(), "PERF " << s << std::string(size * 2, ' ') << "  " << name);
   }
+  if (epee::metrics::is_enabled())
+  {
+    epee::metrics::get_histogram("dinastycoin_perf_timer_seconds", "PERF_TIMER scope durations", 1e-9,
+        epee::metrics::label("category", cat) + "," + epee::metrics::label("name", name)).observe(ticks_to_ns(ticks));
+  }
   if (performance_timers->empty())
   {
     delete performance_timers;
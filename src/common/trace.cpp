@@ -0,0 +1,249 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include "misc_log_ex.h"
+#include "trace.h"
+
+#undef DINASTYCOIN_DEFAULT_LOG_CATEGORY
+#define DINASTYCOIN_DEFAULT_LOG_CATEGORY "perf"
+
+namespace
+{
+  struct trace_event
+  {
+    const char *name;
+    const char *category;
+    uint64_t start;
+    uint64_t end;
+  };
+
+  struct trace_buffer
+  {
+    boost::mutex lock;
+    uint32_t tid;
+    bool alive;
+    size_t next;
+    std::vector<trace_event> events;
+  };
+
+  std::atomic<bool> tracing{false};
+  std::atomic<uint64_t> trace_epoch{0};
+
+  boost::mutex &buffers_lock()
+  {
+    static boost::mutex lock;
+    return lock;
+  }
+
+  std::vector<std::shared_ptr<trace_buffer>> &buffers()
+  {
+    static std::vector<std::shared_ptr<trace_buffer>> b;
+    return b;
+  }
+
+  // a thread's buffer outlives it, so its spans can still be dumped, and is
+  // reused by the next thread to start tracing
+  struct thread_buffer
+  {
+    std::shared_ptr<trace_buffer> buffer;
+
+    trace_buffer &get()
+    {
+      if (!buffer)
+      {
+        static uint32_t next_tid = 0;
+        boost::lock_guard<boost::mutex> lock(buffers_lock());
+        for (const auto &b: buffers())
+        {
+          boost::lock_guard<boost::mutex> buffer_lock(b->lock);
+          if (!b->alive)
+          {
+            b->alive = true;
+            b->tid = ++next_tid;
+            b->next = 0;
+            b->events.clear();
+            buffer = b;
+            break;
+          }
+        }
+        if (!buffer)
+        {
+          buffer = std::make_shared<trace_buffer>();
+          buffer->alive = true;
+          buffer->tid = ++next_tid;
+          buffer->next = 0;
+          buffers().push_back(buffer);
+        }
+      }
+      return *buffer;
+    }
+
+    ~thread_buffer()
+    {
+      if (buffer)
+      {
+        boost::lock_guard<boost::mutex> lock(buffer->lock);
+        buffer->alive = false;
+      }
+    }
+  };
+
+  uint64_t relative_ns(uint64_t ticks, uint64_t epoch)
+  {
+    return ticks > epoch ? tools::ticks_to_ns(ticks - epoch) : 0;
+  }
+
+  void add_json_string(std::string &s, const char *str)
+  {
+    s.push_back('"');
+    for (; *str; ++str)
+    {
+      if ((unsigned char)*str < 0x20)
+      {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)(unsigned char)*str);
+        s.append(buf);
+        continue;
+      }
+      if (*str == '"' || *str == '\\')
+        s.push_back('\\');
+      s.push_back(*str);
+    }
+    s.push_back('"');
+  }
+
+  template<typename F>
+  void for_each_span(F f)
+  {
+    boost::lock_guard<boost::mutex> lock(buffers_lock());
+    for (const auto &b: buffers())
+    {
+      boost::lock_guard<boost::mutex> buffer_lock(b->lock);
+      for (const trace_event &e: b->events)
+        f(b->tid, e);
+    }
+  }
+}
+
+namespace tools
+{
+
+bool is_tracing()
+{
+  return tracing.load(std::memory_order_relaxed);
+}
+
+void set_tracing(bool enabled)
+{
+  if (enabled && !trace_epoch)
+    trace_epoch = get_tick_count();
+  tracing = enabled;
+  MINFO("Tracing " << (enabled ? "enabled" : "disabled"));
+}
+
+void add_trace_span(const char *name, const char *category, uint64_t start_ticks, uint64_t end_ticks)
+{
+  static thread_local thread_buffer tb;
+  trace_buffer &buffer = tb.get();
+  boost::lock_guard<boost::mutex> lock(buffer.lock);
+  const trace_event e{name, category, start_ticks, end_ticks};
+  if (buffer.events.size() < TRACE_BUFFER_SPANS)
+  {
+    buffer.events.push_back(e);
+  }
+  else
+  {
+    buffer.events[buffer.next] = e;
+    buffer.next = (buffer.next + 1) % TRACE_BUFFER_SPANS;
+  }
+}
+
+void clear_trace()
+{
+  boost::lock_guard<boost::mutex> lock(buffers_lock());
+  for (const auto &b: buffers())
+  {
+    boost::lock_guard<boost::mutex> buffer_lock(b->lock);
+    b->events.clear();
+    b->next = 0;
+  }
+}
+
+std::string get_chrome_trace()
+{
+  const uint64_t epoch = trace_epoch;
+  std::string s = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  char buf[128];
+  for_each_span([&](uint32_t tid, const trace_event &e) {
+    if (!first)
+      s.push_back(',');
+    first = false;
+    s.append("{\"ph\":\"X\",\"name\":");
+    add_json_string(s, e.name);
+    s.append(",\"cat\":");
+    add_json_string(s, e.category);
+    const uint64_t start_ns = relative_ns(e.start, epoch), end_ns = relative_ns(e.end, epoch);
+    snprintf(buf, sizeof(buf), ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+        tid, start_ns / 1000.0, (end_ns - std::min(start_ns, end_ns)) / 1000.0);
+    s.append(buf);
+  });
+  s.append("]}");
+  return s;
+}
+
+std::vector<trace_span_summary> get_trace_summary()
+{
+  const uint64_t epoch = trace_epoch;
+  std::map<std::string, trace_span_summary> by_name;
+  for_each_span([&](uint32_t tid, const trace_event &e) {
+    trace_span_summary &summary = by_name[e.name];
+    const uint64_t start_ns = relative_ns(e.start, epoch), end_ns = relative_ns(e.end, epoch);
+    const uint64_t ns = end_ns - std::min(start_ns, end_ns);
+    summary.count++;
+    summary.total_ns += ns;
+    summary.max_ns = std::max(summary.max_ns, ns);
+  });
+  std::vector<trace_span_summary> summaries;
+  summaries.reserve(by_name.size());
+  for (auto &e: by_name)
+  {
+    e.second.name = e.first;
+    summaries.push_back(std::move(e.second));
+  }
+  std::sort(summaries.begin(), summaries.end(), [](const trace_span_summary &a, const trace_span_summary &b) { return a.total_ns > b.total_ns; });
+  return summaries;
+}
+
+}
@@ -0,0 +1,82 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "perf_timer.h"
+
+namespace tools
+{
+
+// Spans are recorded only while tracing is switched on at runtime, and the
+// TRACE_SPAN macro compiles to nothing when built with DISABLE_TRACING
+bool is_tracing();
+void set_tracing(bool enabled);
+
+// Each thread records its spans in its own ring buffer, which keeps the most
+// recent TRACE_BUFFER_SPANS of them
+#define TRACE_BUFFER_SPANS 16384
+
+void add_trace_span(const char *name, const char *category, uint64_t start_ticks, uint64_t end_ticks);
+void clear_trace();
+
+struct trace_span_summary
+{
+  std::string name;
+  uint64_t count;
+  uint64_t total_ns;
+  uint64_t max_ns;
+};
+
+// all recorded spans, as Chrome trace event JSON (chrome://tracing, Perfetto)
+std::string get_chrome_trace();
+// count, total and max duration of the recorded spans, by name, longest total first
+std::vector<trace_span_summary> get_trace_summary();
+
+class trace_span
+{
+public:
+  trace_span(const char *name, const char *category): name(name), category(category), start(is_tracing() ? get_tick_count() : 0) {}
+  ~trace_span() { if (start) add_trace_span(name, category, start, get_tick_count()); }
+
+private:
+  const char *name;
+  const char *category;
+  uint64_t start;
+};
+
+#ifdef DISABLE_TRACING
+#define TRACE_SPAN(name) do {} while(0)
+#else
+#define TRACE_SPAN(name) tools::trace_span trace_span_##name(#name, DINASTYCOIN_DEFAULT_LOG_CATEGORY)
+#endif
+
+}
@@ -200,23 +200,15 @@ namespace cryptonote {
       return check_hash_128(hash, difficulty);
   }
 
-  difficulty_type next_difficulty(std::vector<uint64_t> timestamps, std::vector<difficulty_type> cumulative_difficulties, size_t target_seconds) {
-    //cutoff DIFFICULTY_LAG
-    if(timestamps.size() > DIFFICULTY_WINDOW)
-    {
-      timestamps.resize(DIFFICULTY_WINDOW);
-      cumulative_difficulties.resize(DIFFICULTY_WINDOW);
-    }
-
-
-    size_t length = timestamps.size();
-    assert(length == cumulative_difficulties.size());
+  // sorted_timestamps and cumulative_difficulty(i) cover the oldest
+  // min(length, DIFFICULTY_WINDOW) blocks, in sorted and chronological order
+  template<typename T, typename C>
+  static difficulty_type next_difficulty_sorted(const T &sorted_timestamps, const C &cumulative_difficulty, size_t length, size_t target_seconds) {
     if (length <= 1) {
       return 1;
     }
     static_assert(DIFFICULTY_WINDOW >= 2, "Window is too small");
     assert(length <= DIFFICULTY_WINDOW);
-    sort(timestamps.begin(), timestamps.end());
     size_t cut_begin, cut_end;
     static_assert(2 * DIFFICULTY_CUT <= DIFFICULTY_WINDOW - 2, "Cut length is too large");
     if (length <= DIFFICULTY_WINDOW - 2 * DIFFICULTY_CUT) {
@@ -227,40 +219,48 @@ namespace cryptonote {
       cut_end = cut_begin + (DIFFICULTY_WINDOW - 2 * DIFFICULTY_CUT);
     }
     assert(/*cut_begin >= 0 &&*/ cut_begin + 2 <= cut_end && cut_end <= length);
-    uint64_t time_span = timestamps[cut_end - 1] - timestamps[cut_begin];
+    uint64_t time_span = sorted_timestamps[cut_end - 1] - sorted_timestamps[cut_begin];
     if (time_span == 0) {
       time_span = 1;
     }
-    difficulty_type total_work = cumulative_difficulties[cut_end - 1] - cumulative_difficulties[cut_begin];
+    difficulty_type total_work = cumulative_difficulty(cut_end - 1) - cumulative_difficulty(cut_begin);
     assert(total_work > 0);
     boost::multiprecision::uint256_t res =  (boost::multiprecision::uint256_t(total_work) * target_seconds + time_span - 1) / time_span;
     if(res > max128bit)
       return 0; // to behave like previous implementation, may be better return max128bit?
     return res.convert_to<difficulty_type>();
   }
-//added code for hardfork 13
-  difficulty_type next_difficulty_13(std::vector<uint64_t> timestamps, std::vector<difficulty_type> cumulative_difficulties, size_t target_seconds) {
-    //  std::cout  << "timestamps size = " << timestamps.size() 
-    //             << "cumulative_difficulties size = " << cumulative_difficulties.size()
-    //             << std::endl;
 
+  difficulty_type next_difficulty(std::vector<uint64_t> timestamps, std::vector<difficulty_type> cumulative_difficulties, size_t target_seconds) {
+    //cutoff DIFFICULTY_LAG
+    if(timestamps.size() > DIFFICULTY_WINDOW)
+    {
+      timestamps.resize(DIFFICULTY_WINDOW);
+      cumulative_difficulties.resize(DIFFICULTY_WINDOW);
+    }
+
+    assert(timestamps.size() == cumulative_difficulties.size());
+    sort(timestamps.begin(), timestamps.end());
+    return next_difficulty_sorted(timestamps, [&](size_t i) -> const difficulty_type& { return cumulative_difficulties[i]; }, timestamps.size(), target_seconds);
+  }
+//added code for hardfork 13
+  // timestamps(i) and cumulative_difficulties(i) cover a window of the given
+  // size, in chronological order
+  template<typename TS, typename CD>
+  static difficulty_type next_difficulty_13_lwma(const TS &timestamps, const CD &cumulative_difficulties, size_t size, size_t target_seconds) {
     const int64_t T = static_cast<int64_t>(target_seconds);
     size_t N = DIFFICULTY_WINDOW_V13;
     int64_t FTL = static_cast<int64_t>(CRYPTONOTE_BLOCK_FUTURE_TIME_LIMIT);
 
     // Return a difficulty of 1 for first 3 blocks if it's the start of the chain.
-    if (timestamps.size() < 4) {
+    if (size < 4) {
       return 1;
     }
     // Otherwise, use a smaller N if the start of the chain is less than N+1.
-    else if ( timestamps.size() < N+1 ) {
-      N = timestamps.size() - 1;
-    }
-    // Otherwise make sure timestamps and cumulative_difficulties are correct size.
-    else {
-      timestamps.resize(N+1);
-      cumulative_difficulties.resize(N+1);
+    else if ( size < N+1 ) {
+      N = size - 1;
     }
+    // Otherwise only the first N+1 entries are used
     // To get an average solvetime to within +/- ~0.1%, use an adjustment factor.
     // adjust=0.998 for N = 60
     const double adjust = 0.998;
@@ -273,9 +273,9 @@ namespace cryptonote {
 
     // Loop through N most recent blocks. N is most recently solved block.
     for (size_t i = 1; i <= N; i++) {
-      solveTime = static_cast<int64_t>(timestamps[i]) - static_cast<int64_t>(timestamps[i - 1]);
+      solveTime = static_cast<int64_t>(timestamps(i)) - static_cast<int64_t>(timestamps(i - 1));
       solveTime = std::min<int64_t>((T * 10), std::max<int64_t>(solveTime, -FTL));
-      difficulty = (cumulative_difficulties[i] - cumulative_difficulties[i - 1]).convert_to<uint64_t>();
+      difficulty = difficulty_type(cumulative_difficulties(i) - cumulative_difficulties(i - 1)).convert_to<uint64_t>();
       LWMA += (int64_t)(solveTime * i) / k;
       sum_inverse_D += 1 / static_cast<double>(difficulty);
       
@@ -313,7 +313,70 @@ namespace cryptonote {
 
     return next_difficulty;
   }
+
+  difficulty_type next_difficulty_13(std::vector<uint64_t> timestamps, std::vector<difficulty_type> cumulative_difficulties, size_t target_seconds) {
+    return next_difficulty_13_lwma([&](size_t i) { return timestamps[i]; }, [&](size_t i) -> const difficulty_type& { return cumulative_difficulties[i]; },
+        timestamps.size(), target_seconds);
+  }
 //end
+
+  void difficulty_window::clear(size_t capacity) {
+    m_capacity = capacity;
+    m_blocks.clear();
+    m_sorted_timestamps.clear();
+  }
+
+  void difficulty_window::sorted_insert(uint64_t timestamp) {
+    m_sorted_timestamps.insert(std::upper_bound(m_sorted_timestamps.begin(), m_sorted_timestamps.end(), timestamp), timestamp);
+  }
+
+  void difficulty_window::sorted_erase(uint64_t timestamp) {
+    auto it = std::lower_bound(m_sorted_timestamps.begin(), m_sorted_timestamps.end(), timestamp);
+    assert(it != m_sorted_timestamps.end() && *it == timestamp);
+    m_sorted_timestamps.erase(it);
+  }
+
+  void difficulty_window::push_back(uint64_t timestamp, const difficulty_type &cumulative_difficulty) {
+    if (m_blocks.size() < DIFFICULTY_WINDOW)
+      sorted_insert(timestamp);
+    m_blocks.emplace_back(timestamp, cumulative_difficulty);
+    if (m_capacity && m_blocks.size() > m_capacity)
+      pop_front();
+  }
+
+  void difficulty_window::pop_back() {
+    assert(!m_blocks.empty());
+    if (m_blocks.size() <= DIFFICULTY_WINDOW)
+      sorted_erase(m_blocks.back().first);
+    m_blocks.pop_back();
+  }
+
+  void difficulty_window::push_front(uint64_t timestamp, const difficulty_type &cumulative_difficulty) {
+    if (m_blocks.size() >= DIFFICULTY_WINDOW)
+      sorted_erase(m_blocks[DIFFICULTY_WINDOW - 1].first);
+    sorted_insert(timestamp);
+    m_blocks.emplace_front(timestamp, cumulative_difficulty);
+    if (m_capacity && m_blocks.size() > m_capacity)
+      pop_back();
+  }
+
+  void difficulty_window::pop_front() {
+    assert(!m_blocks.empty());
+    sorted_erase(m_blocks.front().first);
+    m_blocks.pop_front();
+    if (m_blocks.size() >= DIFFICULTY_WINDOW)
+      sorted_insert(m_blocks[DIFFICULTY_WINDOW - 1].first);
+  }
+
+  difficulty_type difficulty_window::next_difficulty(size_t target_seconds) const {
+    return next_difficulty_sorted(m_sorted_timestamps, [this](size_t i) -> const difficulty_type& { return m_blocks[i].second; },
+        m_sorted_timestamps.size(), target_seconds);
+  }
+
+  difficulty_type difficulty_window::next_difficulty_13(size_t target_seconds) const {
+    return next_difficulty_13_lwma([this](size_t i) { return m_blocks[i].first; }, [this](size_t i) -> const difficulty_type& { return m_blocks[i].second; },
+        m_blocks.size(), target_seconds);
+  }
   std::string hex(difficulty_type v)
   {
     static const char chars[] = "0123456789abcdef";
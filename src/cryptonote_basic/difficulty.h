@@ -31,6 +31,7 @@
 #pragma once
 
 #include <cstdint>
+#include <deque>
 #include <vector>
 #include <string>
 #include <boost/multiprecision/cpp_int.hpp>
@@ -61,5 +62,46 @@ namespace cryptonote
     //added for hardfork 13
     difficulty_type next_difficulty_13(std::vector<std::uint64_t> timestamps, std::vector<difficulty_type> cumulative_difficulties, size_t target_seconds);
     //end
+
+    /**
+     * @brief a sliding window of block timestamps and cumulative difficulties
+     *
+     * The oldest DIFFICULTY_WINDOW timestamps are kept sorted as blocks are
+     * added or removed at either end, so the next difficulty is computed
+     * without copying and sorting the window for every block. The result is
+     * the same as next_difficulty/next_difficulty_13 on the equivalent vectors.
+     *
+     * Windows are plain values: an alternative chain can copy the main chain's
+     * window, pop the blocks above the split point and push its own.
+     */
+    class difficulty_window
+    {
+    public:
+      explicit difficulty_window(size_t capacity = 0): m_capacity(capacity) {}
+
+      size_t capacity() const { return m_capacity; }
+      size_t size() const { return m_blocks.size(); }
+      bool empty() const { return m_blocks.empty(); }
+      void clear(size_t capacity);
+
+      //! adds the newest block, dropping the oldest one if over capacity
+      void push_back(uint64_t timestamp, const difficulty_type &cumulative_difficulty);
+      void pop_back();
+      //! adds an older block, dropping the newest one if over capacity
+      void push_front(uint64_t timestamp, const difficulty_type &cumulative_difficulty);
+      void pop_front();
+
+      difficulty_type next_difficulty(size_t target_seconds) const;
+      difficulty_type next_difficulty_13(size_t target_seconds) const;
+
+    private:
+      void sorted_insert(uint64_t timestamp);
+      void sorted_erase(uint64_t timestamp);
+
+      size_t m_capacity;
+      std::deque<std::pair<uint64_t, difficulty_type>> m_blocks;
+      std::vector<uint64_t> m_sorted_timestamps;
+    };
+
     std::string hex(difficulty_type v);
 }
@@ -45,6 +45,7 @@
 #include "hardforks/hardforks.h"
 #include "misc_language.h"
 #include "profile_tools.h"
+#include "metrics.h"
 #include "file_io_utils.h"
 #include "int-util.h"
 #include "common/threadpool.h"
@@ -54,6 +55,7 @@
 #include "cryptonote_core.h"
 #include "ringct/rctSigs.h"
 #include "common/perf_timer.h"
+#include "common/trace.h"
 #include "common/notify.h"
 #include "common/varint.h"
 #include "common/pruning.h"
@@ -85,6 +87,14 @@ DISABLE_VS_WARNINGS(4267)
 // used to overestimate the block reward when estimating a per kB to use
 #define BLOCK_REWARD_OVERESTIMATE (10 * 1000000000000)
 
+// alternative blocks this close to the tip get their txes verified ahead of a reorg
+#define ALT_CHAIN_SPECULATIVE_VERIFY_DEPTH 10
+
+#define VERIFIED_POW_CACHE_SIZE 256
+
+// deepest reorg the long term weight median is rolled back over, rather than reloaded
+#define LONG_TERM_BLOCK_WEIGHT_CACHE_MAX_ROLLBACK 2048
+
 //------------------------------------------------------------------
 Blockchain::Blockchain(tx_memory_pool& tx_pool) :
   m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_reset_timestamps_and_difficulties_height(true), m_current_block_cumul_weight_limit(0), m_current_block_cumul_weight_median(0),
@@ -92,7 +102,9 @@ Blockchain::Blockchain(tx_memory_pool& tx_pool) :
   m_long_term_block_weights_window(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
   m_long_term_effective_median_block_weight(0),
   m_long_term_block_weights_cache_tip_hash(crypto::null_hash),
+  m_long_term_block_weights_cache_tip_height(0),
   m_long_term_block_weights_cache_rolling_median(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
+  m_num_mature_rct_outputs_top_hash(crypto::null_hash), m_num_mature_rct_outputs(0),
   m_difficulty_for_next_block_top_hash(crypto::null_hash),
   m_difficulty_for_next_block(1),
   m_btc_valid(false),
@@ -439,6 +451,7 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
   {
     m_long_term_block_weights_window = test_options->long_term_block_weight_window;
     m_long_term_block_weights_cache_rolling_median = epee::misc_utils::rolling_median_t<uint64_t>(m_long_term_block_weights_window);
+    m_long_term_block_weights_cache_hashes.clear();
   }
 
   bool difficulty_ok;
@@ -856,8 +869,6 @@ start:
   }
 
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  std::vector<uint64_t> timestamps;
-  std::vector<difficulty_type> difficulties;
   uint64_t height;
   auto new_top_hash = get_tail_id(height); // get it again now that we have the lock
   ++height;
@@ -870,86 +881,38 @@ start:
   //    then when the next block difficulty is queried, push the latest height data and
   //    pop the oldest one from the list. This only requires 1x read per height instead
   //    of doing 735 (get_difficulty_blocks_count()).
-  bool check = false;
   if (m_reset_timestamps_and_difficulties_height)
     m_timestamps_and_difficulties_height = 0;
-  if (m_timestamps_and_difficulties_height != 0 && ((height - m_timestamps_and_difficulties_height) == 1) && m_timestamps.size() >= get_difficulty_blocks_count())
+  const uint64_t blocks_count = get_difficulty_blocks_count();
+  if (m_timestamps_and_difficulties_height != 0 && ((height - m_timestamps_and_difficulties_height) == 1) && m_difficulty_window.capacity() == blocks_count)
   {
     uint64_t index = height - 1;
-    m_timestamps.push_back(m_db->get_block_timestamp(index));
-    m_difficulties.push_back(m_db->get_block_cumulative_difficulty(index));
-
-    while (m_timestamps.size() > get_difficulty_blocks_count())
-      m_timestamps.erase(m_timestamps.begin());
-    while (m_difficulties.size() > get_difficulty_blocks_count())
-      m_difficulties.erase(m_difficulties.begin());
-
+    m_difficulty_window.push_back(m_db->get_block_timestamp(index), m_db->get_block_cumulative_difficulty(index));
     m_timestamps_and_difficulties_height = height;
-    timestamps = m_timestamps;
-    difficulties = m_difficulties;
-    check = true;
   }
-  //else
-  std::vector<uint64_t> timestamps_from_cache = timestamps;
-  std::vector<difficulty_type> difficulties_from_cache = difficulties;
-
+  else if (m_timestamps_and_difficulties_height != height || m_difficulty_window.capacity() != blocks_count)
   {
-    uint64_t offset = height - std::min <uint64_t> (height, static_cast<uint64_t>(get_difficulty_blocks_count()));
+    uint64_t offset = height - std::min <uint64_t> (height, blocks_count);
     if (offset == 0)
       ++offset;
 
-    timestamps.clear();
-    difficulties.clear();
-    if (height > offset)
-    {
-      timestamps.reserve(height - offset);
-      difficulties.reserve(height - offset);
-    }
+    m_difficulty_window.clear(blocks_count);
     ss << "Looking up " << (height - offset) << " from " << offset << std::endl;
     for (; offset < height; offset++)
-    {
-      timestamps.push_back(m_db->get_block_timestamp(offset));
-      difficulties.push_back(m_db->get_block_cumulative_difficulty(offset));
-    }
-
-    if (check) if (timestamps != timestamps_from_cache || difficulties !=difficulties_from_cache)
-    {
-      ss << "Inconsistency XXX:" << std::endl;
-      ss << "top hash: "<<top_hash << std::endl;
-      ss << "timestamps: " << timestamps_from_cache.size() << " from cache, but " << timestamps.size() << " without" << std::endl;
-      ss << "difficulties: " << difficulties_from_cache.size() << " from cache, but " << difficulties.size() << " without" << std::endl;
-      ss << "timestamps_from_cache:" << std::endl; for (const auto &v :timestamps_from_cache) ss << "  " << v << std::endl;
-      ss << "timestamps:" << std::endl; for (const auto &v :timestamps) ss << "  " << v << std::endl;
-      ss << "difficulties_from_cache:" << std::endl; for (const auto &v :difficulties_from_cache) ss << "  " << v << std::endl;
-      ss << "difficulties:" << std::endl; for (const auto &v :difficulties) ss << "  " << v << std::endl;
-
-      uint64_t dbh = m_db->height();
-      uint64_t sh = dbh < 10000 ? 0 : dbh - 10000;
-      ss << "History from -10k at :" << dbh << ", from " << sh << std::endl;
-      for (uint64_t h = sh; h < dbh; ++h)
-      {
-        uint64_t ts = m_db->get_block_timestamp(h);
-        difficulty_type d = m_db->get_block_cumulative_difficulty(h);
-        ss << "  " << h << " " << ts << " " << d << std::endl;
-      }
-      print = true;
-    }
+      m_difficulty_window.push_back(m_db->get_block_timestamp(offset), m_db->get_block_cumulative_difficulty(offset));
     m_timestamps_and_difficulties_height = height;
-    m_timestamps = timestamps;
-    m_difficulties = difficulties;
   }
 
   size_t target = get_difficulty_target();
-  // difficulty_type diff = next_difficulty(timestamps, difficulties, target);
 //added code for hardfork 13
   difficulty_type diff;
   if(get_current_hard_fork_version() < HF_VERSION_NEW_DIFFICULTY_APPLY )
   {
-    diff = next_difficulty(timestamps, difficulties, target);
+    diff = m_difficulty_window.next_difficulty(target);
   }
   else
   {
-    diff = next_difficulty_13(timestamps, difficulties, target);
+    diff = m_difficulty_window.next_difficulty_13(target);
   }
   //end
   CRITICAL_REGION_LOCAL1(m_difficulty_lock);
@@ -1274,72 +1237,80 @@ difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const std:
   }
 
   LOG_PRINT_L3("Blockchain::" << __func__);
-  std::vector<uint64_t> timestamps;
-  std::vector<difficulty_type> cumulative_difficulties;
+  const size_t blocks_count = get_difficulty_blocks_count();
+  difficulty_window window(blocks_count);
 
   // if the alt chain isn't long enough to calculate the difficulty target
   // based on its blocks alone, need to get more blocks from the main chain
-  if(alt_chain.size()< get_difficulty_blocks_count())
+  if(alt_chain.size()< blocks_count)
   {
     CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
     // Figure out start and stop offsets for main chain blocks
     size_t main_chain_stop_offset = alt_chain.size() ? alt_chain.front().height : bei.height;
-    size_t main_chain_count = get_difficulty_blocks_count() - std::min(static_cast<size_t>(get_difficulty_blocks_count()), alt_chain.size());
+    size_t main_chain_count = blocks_count - std::min(blocks_count, alt_chain.size());
     main_chain_count = std::min(main_chain_count, main_chain_stop_offset);
     size_t main_chain_start_offset = main_chain_stop_offset - main_chain_count;
 
     if(!main_chain_start_offset)
       ++main_chain_start_offset; //skip genesis block
 
-    // get difficulties and timestamps from relevant main chain blocks
-    for(; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset)
+    // if the main chain's window is current and overlaps the split point, fork
+    // it rather than reading the whole window from the DB again
+    const uint64_t main_height = m_timestamps_and_difficulties_height;
+    if (!m_reset_timestamps_and_difficulties_height && main_height == m_db->height() && m_difficulty_window.capacity() == blocks_count
+        && main_chain_stop_offset <= main_height && main_height - main_chain_stop_offset < m_difficulty_window.size())
+    {
+      window = m_difficulty_window;
+      for (uint64_t h = main_height; h > main_chain_stop_offset; --h)
+        window.pop_back();
+      size_t first = main_chain_stop_offset - window.size();
+      while (first < main_chain_start_offset)
+      {
+        window.pop_front();
+        ++first;
+      }
+      while (first > main_chain_start_offset)
+      {
+        --first;
+        window.push_front(m_db->get_block_timestamp(first), m_db->get_block_cumulative_difficulty(first));
+      }
+    }
+    else
     {
-      timestamps.push_back(m_db->get_block_timestamp(main_chain_start_offset));
-      cumulative_difficulties.push_back(m_db->get_block_cumulative_difficulty(main_chain_start_offset));
+      // get difficulties and timestamps from relevant main chain blocks
+      for(; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset)
+        window.push_back(m_db->get_block_timestamp(main_chain_start_offset), m_db->get_block_cumulative_difficulty(main_chain_start_offset));
     }
 
     // make sure we haven't accidentally grabbed too many blocks...maybe don't need this check?
-    CHECK_AND_ASSERT_MES((alt_chain.size() + timestamps.size()) <= get_difficulty_blocks_count(), false, "Internal error, alt_chain.size()[" << alt_chain.size() << "] + vtimestampsec.size()[" << timestamps.size() << "] NOT <= DIFFICULTY_WINDOW[]" << get_difficulty_blocks_count());
+    CHECK_AND_ASSERT_MES((alt_chain.size() + window.size()) <= blocks_count, false, "Internal error, alt_chain.size()[" << alt_chain.size() << "] + window.size()[" << window.size() << "] NOT <= DIFFICULTY_WINDOW[]" << blocks_count);
 
     for (const auto &bei : alt_chain)
-    {
-      timestamps.push_back(bei.bl.timestamp);
-      cumulative_difficulties.push_back(bei.cumulative_difficulty);
-    }
+      window.push_back(bei.bl.timestamp, bei.cumulative_difficulty);
   }
   // if the alt chain is long enough for the difficulty calc, grab difficulties
-  // and timestamps from it alone
+  // and timestamps from its most recent blocks alone
   else
   {
-    timestamps.resize(static_cast<size_t>(get_difficulty_blocks_count()));
-    cumulative_difficulties.resize(static_cast<size_t>(get_difficulty_blocks_count()));
-    size_t count = 0;
-    size_t max_i = timestamps.size()-1;
-    // get difficulties and timestamps from most recent blocks in alt chain
-    for (const auto &bei: boost::adaptors::reverse(alt_chain))
-    {
-      timestamps[max_i - count] = bei.bl.timestamp;
-      cumulative_difficulties[max_i - count] = bei.cumulative_difficulty;
-      count++;
-      if(count >= get_difficulty_blocks_count())
-        break;
-    }
+    auto it = alt_chain.end();
+    std::advance(it, -static_cast<std::ptrdiff_t>(blocks_count));
+    for (; it != alt_chain.end(); ++it)
+      window.push_back(it->bl.timestamp, it->cumulative_difficulty);
   }
 
   // FIXME: This will fail if fork activation heights are subject to voting
   size_t target = get_ideal_hard_fork_version(bei.height) < 2 ? DIFFICULTY_TARGET_V1 : DIFFICULTY_TARGET_V2;
 
   // calculate the difficulty target for the block and return it
-  // return next_difficulty(timestamps, cumulative_difficulties, target);
   //added code for harfork 13
   if(get_ideal_hard_fork_version(bei.height) < HF_VERSION_NEW_DIFFICULTY_APPLY)
   {
-    return next_difficulty(timestamps, cumulative_difficulties, target);
+    return window.next_difficulty(target);
   }
   else
   {
-    return next_difficulty_13(timestamps, cumulative_difficulties, target);
+    return window.next_difficulty_13(target);
   }
   //end
 }
@@ -1486,29 +1457,93 @@ uint64_t Blockchain::get_long_term_block_weight_median(uint64_t start_height, si
     return m_long_term_block_weights_cache_rolling_median.median();
   }
 
-  // in the vast majority of uncached cases, most is still cached,
-  // as we just move the window one block up:
-  if (tip_height > 0 && count == (size_t)m_long_term_block_weights_cache_rolling_median.size() && tip_height < blockchain_height)
+  // in the vast majority of uncached cases, most is still cached, as we
+  // just move the window one block up, or a reorg replaced a few blocks
+  if (tip_hash != crypto::null_hash && count == (size_t)m_long_term_block_weights_cache_rolling_median.capacity()
+      && move_long_term_block_weights_cache(tip_height, tip_hash))
   {
-    crypto::hash old_tip_hash = m_db->get_block_hash_from_height(tip_height - 1);
-    if (old_tip_hash == m_long_term_block_weights_cache_tip_hash)
-    {
-      MTRACE("requesting " << count << " from " << start_height << ", incremental");
-      m_long_term_block_weights_cache_tip_hash = tip_hash;
-      m_long_term_block_weights_cache_rolling_median.insert(m_db->get_block_long_term_weight(tip_height));
-      return m_long_term_block_weights_cache_rolling_median.median();
-    }
+    MTRACE("requesting " << count << " from " << start_height << ", incremental");
+    return m_long_term_block_weights_cache_rolling_median.median();
   }
 
   MTRACE("requesting " << count << " from " << start_height << ", uncached");
   std::vector<uint64_t> weights = m_db->get_long_term_block_weights(start_height, count);
   m_long_term_block_weights_cache_tip_hash = tip_hash;
   m_long_term_block_weights_cache_rolling_median.clear();
+  m_long_term_block_weights_cache_hashes.clear();
   for (uint64_t w: weights)
     m_long_term_block_weights_cache_rolling_median.insert(w);
+  if (tip_hash != crypto::null_hash)
+    add_long_term_block_weights_cache_tip(tip_height, tip_hash);
   return m_long_term_block_weights_cache_rolling_median.median();
 }
 //------------------------------------------------------------------
+bool Blockchain::move_long_term_block_weights_cache(uint64_t tip_height, const crypto::hash &tip_hash) const
+{
+  auto &median = m_long_term_block_weights_cache_rolling_median;
+  auto &hashes = m_long_term_block_weights_cache_hashes;
+  const uint64_t window = median.capacity();
+  if (hashes.empty() || median.size() != median.capacity())
+    return false;
+
+  // find the most recent cached block still on the main chain, at or below the new tip
+  const uint64_t cache_height = m_long_term_block_weights_cache_tip_height;
+  size_t n_rollback = 0;
+  while (n_rollback < hashes.size())
+  {
+    const uint64_t h = cache_height - n_rollback;
+    if (h <= tip_height && m_db->get_block_hash_from_height(h) == hashes[hashes.size() - 1 - n_rollback])
+      break;
+    ++n_rollback;
+  }
+  if (n_rollback == hashes.size())
+    return false;
+  const uint64_t common_height = cache_height - n_rollback;
+  const uint64_t n_forward = tip_height - common_height;
+  if (n_rollback > window || n_forward > window || common_height + 1 < window)
+    return false;
+
+  // each rolled back block had evicted the weight of the block one window below it
+  std::vector<uint64_t> evicted, added;
+  if (n_rollback > 0)
+  {
+    evicted = m_db->get_long_term_block_weights(common_height + 1 - window, n_rollback);
+    if (evicted.size() != n_rollback)
+      return false;
+  }
+  if (n_forward > 0)
+  {
+    added = m_db->get_long_term_block_weights(common_height + 1, n_forward);
+    if (added.size() != n_forward)
+      return false;
+  }
+
+  for (size_t i = evicted.size(); i-- > 0; )
+    median.rollback(evicted[i]);
+  hashes.erase(hashes.end() - n_rollback, hashes.end());
+  m_long_term_block_weights_cache_tip_height = common_height;
+  m_long_term_block_weights_cache_tip_hash = hashes.back();
+
+  for (size_t i = 0; i < added.size(); ++i)
+  {
+    const uint64_t h = common_height + 1 + i;
+    median.insert(added[i]);
+    add_long_term_block_weights_cache_tip(h, h == tip_height ? tip_hash : m_db->get_block_hash_from_height(h));
+  }
+  if (n_rollback > 0)
+    MDEBUG("Rolled back " << n_rollback << " and added " << n_forward << " blocks to the long term weight median, to height " << tip_height);
+  return true;
+}
+//------------------------------------------------------------------
+void Blockchain::add_long_term_block_weights_cache_tip(uint64_t height, const crypto::hash &hash) const
+{
+  m_long_term_block_weights_cache_tip_height = height;
+  m_long_term_block_weights_cache_tip_hash = hash;
+  m_long_term_block_weights_cache_hashes.push_back(hash);
+  while (m_long_term_block_weights_cache_hashes.size() > LONG_TERM_BLOCK_WEIGHT_CACHE_MAX_ROLLBACK)
+    m_long_term_block_weights_cache_hashes.pop_front();
+}
+//------------------------------------------------------------------
 uint64_t Blockchain::get_current_cumulative_block_weight_limit() const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -1917,8 +1952,6 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  m_timestamps_and_difficulties_height = 0;
-  m_reset_timestamps_and_difficulties_height = true;
   uint64_t block_height = get_block_height(b);
   if(0 == block_height)
   {
@@ -1990,7 +2023,11 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
     CHECK_AND_ASSERT_MES(current_diff, false, "!!!!!!! DIFFICULTY OVERHEAD !!!!!!!");
     crypto::hash proof_of_work;
     memset(proof_of_work.data, 0xff, sizeof(proof_of_work.data));
-    if (b.major_version >= RX_BLOCK_VERSION)
+    if (get_verified_pow(id, proof_of_work))
+    {
+      // verified earlier, eg while this block was on the main chain
+    }
+    else if (b.major_version >= RX_BLOCK_VERSION)
     {
       crypto::hash seedhash = null_hash;
       uint64_t seedheight = rx_seedheight(bei.height);
@@ -2021,6 +2058,7 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
       bvc.m_bad_pow = true;
       return false;
     }
+    add_verified_pow(id, proof_of_work);
 
     if(!prevalidate_miner_transaction(b, bei.height, hf_version))
     {
@@ -2122,6 +2160,22 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
     else
     {
       MGINFO_BLUE("----- BLOCK ADDED AS ALTERNATIVE ON HEIGHT " << bei.height << std::endl << "id:\t" << id << std::endl << "PoW:\t" << proof_of_work << std::endl << "difficulty:\t" << current_diff);
+
+      // a chain this close to the tip may well become the main chain soon,
+      // so get its signature checks out of the way while we're idle
+      if (bei.height + ALT_CHAIN_SPECULATIVE_VERIFY_DEPTH >= m_db->height() && !b.tx_hashes.empty())
+      {
+        std::vector<blobdata> txs;
+        txs.reserve(b.tx_hashes.size());
+        for (const crypto::hash &txid: b.tx_hashes)
+        {
+          cryptonote::blobdata blob;
+          if (m_tx_pool.get_transaction(txid, blob, relay_category::all))
+            txs.push_back(std::move(blob));
+        }
+        if (!txs.empty())
+          m_async_service.post([this, id, txs](){ speculatively_verify_alt_block_txs(id, txs); });
+      }
       return true;
     }
   }
@@ -2268,6 +2322,36 @@ size_t Blockchain::get_alternative_blocks_count() const
 // This function adds the output specified by <amount, i> to the result_outs container
 // unlocked and other such checks should be done by here.
 uint64_t Blockchain::get_num_mature_outputs(uint64_t amount) const
+{
+  if (amount == 0)
+  {
+    // rct outputs are counted per block, so this is a single lookup, once per top block
+    uint64_t top_height;
+    const crypto::hash top_hash = m_db->top_block_hash(&top_height);
+    {
+      boost::lock_guard<boost::mutex> lock(m_num_mature_rct_outputs_lock);
+      if (top_hash == m_num_mature_rct_outputs_top_hash)
+        return m_num_mature_rct_outputs;
+    }
+    const uint64_t blockchain_height = top_height + 1;
+    uint64_t num_outs = 0;
+    if (blockchain_height >= CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE)
+    {
+      const std::vector<uint64_t> cumulative = m_db->get_block_cumulative_rct_outputs({blockchain_height - CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE});
+      if (cumulative.size() == 1)
+        num_outs = cumulative[0];
+      else
+        return get_num_mature_outputs_by_walking(amount);
+    }
+    boost::lock_guard<boost::mutex> lock(m_num_mature_rct_outputs_lock);
+    m_num_mature_rct_outputs_top_hash = top_hash;
+    m_num_mature_rct_outputs = num_outs;
+    return num_outs;
+  }
+  return get_num_mature_outputs_by_walking(amount);
+}
+
+uint64_t Blockchain::get_num_mature_outputs_by_walking(uint64_t amount) const
 {
   uint64_t num_outs = m_db->get_num_outputs(amount);
   // ensure we don't include outputs that aren't yet eligible to be used
@@ -3259,6 +3343,120 @@ bool Blockchain::expand_transaction_2(transaction &tx, const crypto::hash &tx_pr
   return true;
 }
 //------------------------------------------------------------------
+bool Blockchain::get_verified_pow(const crypto::hash &id, crypto::hash &proof_of_work) const
+{
+  const auto it = m_verified_pow.find(id);
+  if (it == m_verified_pow.end())
+    return false;
+  proof_of_work = it->second;
+  return true;
+}
+//------------------------------------------------------------------
+void Blockchain::add_verified_pow(const crypto::hash &id, const crypto::hash &proof_of_work)
+{
+  if (!m_verified_pow.emplace(id, proof_of_work).second)
+    return;
+  m_verified_pow_order.push_back(id);
+  while (m_verified_pow_order.size() > VERIFIED_POW_CACHE_SIZE)
+  {
+    m_verified_pow.erase(m_verified_pow_order.front());
+    m_verified_pow_order.pop_front();
+  }
+}
+//------------------------------------------------------------------
+void Blockchain::speculatively_verify_alt_block_txs(const crypto::hash &id, const std::vector<blobdata> &txs) const
+{
+  PERF_TIMER(speculatively_verify_alt_block_txs);
+  std::atomic<size_t> n_verified(0);
+
+  // this does not take the blockchain lock: the DB handles concurrent readers,
+  // and a ring read while the main chain changes under us only yields a key
+  // which check_tx_inputs will never look up
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter(tpool);
+  for (const blobdata &blob: txs)
+  {
+    tpool.submit(&waiter, [this, &blob, &n_verified](){
+      if (m_cancel)
+        return;
+      transaction tx;
+      if (!parse_and_validate_tx_from_blob(blob, tx))
+        return;
+      if (preverify_tx_ring(tx))
+        ++n_verified;
+    }, true);
+  }
+  waiter.wait();
+  MDEBUG("Speculatively verified " << n_verified << "/" << txs.size() << " txes from alternative block " << id);
+}
+//------------------------------------------------------------------
+size_t Blockchain::preverify_tx_rings(const std::vector<transaction*> &txs) const
+{
+  PERF_TIMER(preverify_tx_rings);
+  if (txs.empty())
+    return 0;
+  if (txs.size() == 1)
+    return preverify_tx_ring(*txs[0]) ? 1 : 0;
+
+  std::atomic<size_t> n_verified(0);
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter(tpool);
+  for (transaction *tx: txs)
+  {
+    tpool.submit(&waiter, [this, tx, &n_verified](){
+      if (preverify_tx_ring(*tx))
+        ++n_verified;
+    }, true);
+  }
+  waiter.wait();
+  return n_verified;
+}
+//------------------------------------------------------------------
+bool Blockchain::preverify_tx_ring(transaction &tx) const
+{
+  TRACE_SPAN(preverify_tx_ring);
+  if (tx.version < 2 || tx.pruned)
+    return false;
+  const rct::rctSig &rv = tx.rct_signatures;
+  if (rv.type != rct::RCTTypeSimple && rv.type != rct::RCTTypeBulletproof && rv.type != rct::RCTTypeBulletproof2 && rv.type != rct::RCTTypeCLSAG)
+    return false;
+
+  std::vector<std::vector<rct::ctkey>> pubkeys(tx.vin.size());
+  try
+  {
+    for (size_t n = 0; n < tx.vin.size(); ++n)
+    {
+      if (tx.vin[n].type() != typeid(txin_to_key))
+        return false;
+      const txin_to_key &in_to_key = boost::get<txin_to_key>(tx.vin[n]);
+      if (in_to_key.amount != 0 || in_to_key.key_offsets.empty())
+        return false;
+      const std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
+      const std::vector<uint64_t> amounts(absolute_offsets.size(), 0);
+      std::vector<output_data_t> outputs;
+      m_db->get_output_key(epee::to_span(amounts), absolute_offsets, outputs, false);
+      pubkeys[n].reserve(outputs.size());
+      for (const output_data_t &od: outputs)
+        pubkeys[n].push_back(rct::ctkey({rct::pk2rct(od.pubkey), od.commitment}));
+    }
+  }
+  catch (const std::exception &)
+  {
+    // some ring members are not on the main chain (yet)
+    return false;
+  }
+
+  const crypto::hash ring_key = get_tx_ring_verification_key(get_transaction_hash(tx), pubkeys);
+  if (m_tx_verification_cache.has_ring(ring_key))
+    return true;
+  if (!expand_transaction_2(tx, get_transaction_prefix_hash(tx), pubkeys))
+    return false;
+  if (!rct::verRctNonSemanticsSimple(tx.rct_signatures))
+    return false;
+  m_tx_verification_cache.add_ring(ring_key);
+  return true;
+}
+//------------------------------------------------------------------
 // This function validates transaction inputs and their keys.
 // FIXME: consider moving functionality specific to one input into
 //        check_tx_input() rather than here, and use this function simply
@@ -3586,10 +3784,15 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
         }
       }
 
-      if (!rct::verRctNonSemanticsSimple(rv))
+      const crypto::hash ring_key = get_tx_ring_verification_key(get_transaction_hash(tx), pubkeys);
+      if (!m_tx_verification_cache.has_ring(ring_key))
       {
-        MERROR_VER("Failed to check ringct signatures!");
-        return false;
+        if (!rct::verRctNonSemanticsSimple(rv))
+        {
+          MERROR_VER("Failed to check ringct signatures!");
+          return false;
+        }
+        m_tx_verification_cache.add_ring(ring_key);
       }
       break;
     }
@@ -4054,6 +4257,9 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
 
   TIME_MEASURE_START(block_processing_time);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  TRACE_SPAN(handle_block_to_main_chain);
+  static epee::metrics::histogram &block_verification_histogram = epee::metrics::get_histogram("dinastycoin_block_verification_seconds", "Time to verify and add a block to the main chain", 1e-9);
+  epee::metrics::scoped_timer block_verification_timer(&block_verification_histogram);
   TIME_MEASURE_START(t1);
 
   static bool seen_future_version = false;
@@ -4161,6 +4367,8 @@ leave:
       precomputed = true;
       proof_of_work = it->second;
     }
+    else if (get_verified_pow(id, proof_of_work))
+      precomputed = true;
     else
       proof_of_work = get_block_longhash(this, bl, blockchain_height, 0);
 
@@ -4172,6 +4380,7 @@ leave:
       bvc.m_bad_pow = true;
       goto leave;
     }
+    add_verified_pow(id, proof_of_work);
   }
 
   // If we're at a checkpoint, ensure that our hardcoded checkpoint hash
@@ -4528,8 +4737,8 @@ bool Blockchain::update_next_cumulative_weight_limit(uint64_t *long_term_effecti
     }
     else
     {
-      m_long_term_block_weights_cache_tip_hash = m_db->get_block_hash_from_height(db_height - 1);
       m_long_term_block_weights_cache_rolling_median.insert(long_term_block_weight);
+      add_long_term_block_weights_cache_tip(db_height - 1, m_db->get_block_hash_from_height(db_height - 1));
       long_term_median = m_long_term_block_weights_cache_rolling_median.median();
     }
     m_long_term_effective_median_block_weight = std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, long_term_median);
@@ -4682,6 +4891,7 @@ void Blockchain::set_enforce_dns_checkpoints(bool enforce_checkpoints)
 //------------------------------------------------------------------
 void Blockchain::block_longhash_worker(uint64_t height, const epee::span<const block> &blocks, std::unordered_map<crypto::hash, crypto::hash> &map) const
 {
+  TRACE_SPAN(block_longhash_worker);
   TIME_MEASURE_START(t);
   slow_hash_allocate_state();
 
@@ -4701,6 +4911,7 @@ void Blockchain::block_longhash_worker(uint64_t height, const epee::span<const b
 //------------------------------------------------------------------
 bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
 {
+  TRACE_SPAN(cleanup_handle_incoming_blocks);
   bool success = false;
 
   MTRACE("Blockchain::" << __func__);
@@ -4779,6 +4990,7 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
 //------------------------------------------------------------------
 void Blockchain::output_scan_worker(const uint64_t amount, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs) const
 {
+  TRACE_SPAN(output_scan_worker);
   try
   {
     m_db->get_output_key(epee::span<const uint64_t>(&amount, 1), offsets, outputs, true);
@@ -4934,6 +5146,7 @@ bool Blockchain::has_block_weights(uint64_t height, uint64_t nblocks) const
 //    keys.
 bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete_entry> &blocks_entry, std::vector<block> &blocks)
 {
+  TRACE_SPAN(prepare_handle_incoming_blocks);
   MTRACE("Blockchain::" << __func__);
   TIME_MEASURE_START(prepare);
   bool stop_batch;
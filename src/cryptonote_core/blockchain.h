@@ -42,6 +42,7 @@
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <atomic>
+#include <deque>
 #include <functional>
 #include <unordered_map>
 #include <unordered_set>
@@ -56,6 +57,7 @@
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "cryptonote_basic/difficulty.h"
 #include "cryptonote_tx_utils.h"
+#include "tx_verification_utils.h"
 #include "cryptonote_basic/verification_context.h"
 #include "crypto/hash.h"
 #include "checkpoints/checkpoints.h"
@@ -606,6 +608,22 @@ namespace cryptonote
      */
     bool check_tx_inputs(transaction& tx, uint64_t& pmax_used_block_height, crypto::hash& max_used_block_id, tx_verification_context &tvc, bool kept_by_block = false) const;
 
+    /**
+     * @brief verifies the ring signatures of a batch of transactions in parallel
+     *
+     * Takes no lock: ring members are resolved against the chain as it is,
+     * and the results only land in the tx verification cache, where the
+     * serial check_tx_inputs later finds them if it resolves the same ring
+     * members. Transactions which cannot be checked this way (missing ring
+     * members, unsupported types) or fail are left for check_tx_inputs to
+     * check and report.
+     *
+     * @param txs the transactions, which get their rct signatures expanded
+     *
+     * @return the number of transactions verified
+     */
+    size_t preverify_tx_rings(const std::vector<transaction*> &txs) const;
+
     /**
      * @brief get fee quantization mask
      *
@@ -986,6 +1004,16 @@ namespace cryptonote
       return *m_db;
     }
 
+    /**
+     * @brief get the cache of tx checks already passed
+     *
+     * @return a reference to the cache, which is thread safe
+     */
+    tx_verification_cache& get_tx_verification_cache() const
+    {
+      return m_tx_verification_cache;
+    }
+
     /**
      * @brief get a number of outputs of a specific amount
      *
@@ -1115,6 +1143,14 @@ namespace cryptonote
     std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>> m_scan_table;
     std::unordered_map<crypto::hash, crypto::hash> m_blocks_longhash_table;
 
+    // recently verified PoW hashes (by block id), so reorgs and their
+    // rollbacks do not redo the work
+    std::unordered_map<crypto::hash, crypto::hash> m_verified_pow;
+    std::deque<crypto::hash> m_verified_pow_order;
+
+    // expensive tx checks already passed, shared with the pool
+    mutable tx_verification_cache m_tx_verification_cache;
+
     // Keccak hashes for each block and for fast pow checking
     std::vector<std::pair<crypto::hash, crypto::hash>> m_blocks_hash_of_hashes;
     std::vector<std::pair<crypto::hash, uint64_t>> m_blocks_hash_check;
@@ -1131,15 +1167,21 @@ namespace cryptonote
     uint64_t m_fake_scan_time;
     uint64_t m_sync_counter;
     uint64_t m_bytes_to_sync;
-    std::vector<uint64_t> m_timestamps;
-    std::vector<difficulty_type> m_difficulties;
+    difficulty_window m_difficulty_window;
     uint64_t m_timestamps_and_difficulties_height;
     bool m_reset_timestamps_and_difficulties_height;
     uint64_t m_long_term_block_weights_window;
     uint64_t m_long_term_effective_median_block_weight;
     mutable crypto::hash m_long_term_block_weights_cache_tip_hash;
+    mutable uint64_t m_long_term_block_weights_cache_tip_height;
+    mutable std::deque<crypto::hash> m_long_term_block_weights_cache_hashes;
     mutable epee::misc_utils::rolling_median_t<uint64_t> m_long_term_block_weights_cache_rolling_median;
 
+    // number of mature rct outputs, for the given top block
+    mutable boost::mutex m_num_mature_rct_outputs_lock;
+    mutable crypto::hash m_num_mature_rct_outputs_top_hash;
+    mutable uint64_t m_num_mature_rct_outputs;
+
     epee::critical_section m_difficulty_lock;
     crypto::hash m_difficulty_for_next_block_top_hash;
     difficulty_type m_difficulty_for_next_block;
@@ -1415,6 +1457,34 @@ namespace cryptonote
      */
     uint64_t get_long_term_block_weight_median(uint64_t start_height, size_t count) const;
 
+    /**
+     * @brief moves the cached long term weight median to a new tip
+     *
+     * Rolls back the cached blocks which are no longer on the main chain
+     * (or are above the new tip), then adds the main chain blocks up to the
+     * new tip, in O(n log window) for n blocks rolled back or added.
+     *
+     * @param tip_height the height of the new tip
+     * @param tip_hash the hash of the new tip
+     *
+     * @return false if the cache can't be moved, and needs reloading
+     */
+    bool move_long_term_block_weights_cache(uint64_t tip_height, const crypto::hash &tip_hash) const;
+
+    /**
+     * @brief get number of outputs of an amount past the minimum spendable age, from the outputs themselves
+     *
+     * @param amount the output amount
+     *
+     * @return the number of mature outputs
+     */
+    uint64_t get_num_mature_outputs_by_walking(uint64_t amount) const;
+
+    /**
+     * @brief records a block added to the cached long term weight median
+     */
+    void add_long_term_block_weights_cache_tip(uint64_t height, const crypto::hash &hash) const;
+
     /**
      * @brief checks if a transaction is unlocked (its outputs spendable)
      *
@@ -1552,6 +1622,46 @@ namespace cryptonote
      */
     bool expand_transaction_2(transaction &tx, const crypto::hash &tx_prefix_hash, const std::vector<std::vector<rct::ctkey>> &pubkeys) const;
 
+    /**
+     * @brief looks up a block's PoW hash if it was verified recently
+     *
+     * @param id the block's hash
+     * @param proof_of_work return-by-reference the PoW hash, if found
+     *
+     * @return true if found, false otherwise
+     */
+    bool get_verified_pow(const crypto::hash &id, crypto::hash &proof_of_work) const;
+
+    /**
+     * @brief remembers a block's verified PoW hash
+     *
+     * The PoW hash depends only on the block and its ancestry, so it stays
+     * valid whether the block ends up on the main chain or an alternative one.
+     */
+    void add_verified_pow(const crypto::hash &id, const crypto::hash &proof_of_work);
+
+    /**
+     * @brief verifies the ringct signatures of an alternative block's transactions ahead of time
+     *
+     * Runs on the async service. Ring members are resolved against the current
+     * main chain, and results are only reused if a later check_tx_inputs
+     * resolves the exact same ring members, so a chain switch skips the
+     * signature checks for any tx whose ring lies below the split point.
+     *
+     * @param id the alternative block's hash, for logging
+     * @param txs the alternative block's transaction blobs
+     */
+    void speculatively_verify_alt_block_txs(const crypto::hash &id, const std::vector<blobdata> &txs) const;
+
+    /**
+     * @brief verifies a transaction's ring signatures into the tx verification cache
+     *
+     * @param tx the transaction, which gets its rct signatures expanded
+     *
+     * @return true if the signatures are known good, false if they could not be checked or failed
+     */
+    bool preverify_tx_ring(transaction &tx) const;
+
     /**
      * @brief invalidates any cached block template
      */
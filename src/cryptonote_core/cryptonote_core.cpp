@@ -39,6 +39,7 @@ using namespace epee;
 #include "common/util.h"
 #include "common/updates.h"
 #include "common/download.h"
+#include "common/trace.h"
 #include "common/threadpool.h"
 #include "common/command_line.h"
 #include "cryptonote_basic/events.h"
@@ -47,6 +48,7 @@ using namespace epee;
 #include "cryptonote_config.h"
 #include "misc_language.h"
 #include "file_io_utils.h"
+#include "metrics.h"
 #include <csignal>
 #include "checkpoints/checkpoints.h"
 #include "ringct/rctTypes.h"
@@ -674,7 +676,7 @@ namespace cryptonote
     r = m_blockchain_storage.init(db.release(), m_nettype, m_offline, regtest ? &regtest_test_options : test_options, fixed_difficulty, get_checkpoints);
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize blockchain storage");
 
-    r = m_mempool.init(max_txpool_weight, m_nettype == FAKECHAIN);
+    r = m_mempool.init(max_txpool_weight, m_nettype == FAKECHAIN, (folder / CRYPTONOTE_POOLDATA_FILENAME).string());
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize memory pool");
 
     // now that we have a valid m_blockchain_storage, we can clean out any
@@ -886,7 +888,9 @@ namespace cryptonote
       return true;
     }
 
+    tx_verification_cache &verification_cache = m_blockchain_storage.get_tx_verification_cache();
     std::vector<const rct::rctSig*> rvv;
+    std::vector<bool> verified(tx_info.size(), false);
     for (size_t n = 0; n < tx_info.size(); ++n)
     {
       if (!check_tx_semantic(*tx_info[n].tx, keeped_by_block))
@@ -899,6 +903,10 @@ namespace cryptonote
 
       if (tx_info[n].tx->version < 2)
         continue;
+      // already seen in the pool, another block, or before a reorg
+      if (verification_cache.has_semantics(tx_info[n].tx_hash))
+        continue;
+      verified[n] = true;
       const rct::rctSig &rv = tx_info[n].tx->rct_signatures;
       switch (rv.type) {
         case rct::RCTTypeNull:
@@ -958,6 +966,8 @@ namespace cryptonote
       {
         if (!tx_info[n].result)
           continue;
+        if (!verified[n])
+          continue;
         if (tx_info[n].tx->rct_signatures.type != rct::RCTTypeBulletproof && tx_info[n].tx->rct_signatures.type != rct::RCTTypeBulletproof2 && tx_info[n].tx->rct_signatures.type != rct::RCTTypeCLSAG)
           continue;
         if (assumed_bad || !rct::verRctSemanticsSimple(tx_info[n].tx->rct_signatures))
@@ -969,12 +979,17 @@ namespace cryptonote
       }
     }
 
+    for (size_t n = 0; n < tx_info.size(); ++n)
+      if (verified[n] && tx_info[n].result)
+        verification_cache.add_semantics(tx_info[n].tx_hash);
+
     return ret;
   }
   //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_txs(const epee::span<const tx_blob_entry> tx_blobs, epee::span<tx_verification_context> tvc, relay_method tx_relay, bool relayed)
   {
     TRY_ENTRY();
+    TRACE_SPAN(handle_incoming_txs);
 
     if (tx_blobs.size() != tvc.size())
     {
@@ -1049,6 +1064,37 @@ namespace cryptonote
     if (!tx_info.empty())
       handle_incoming_tx_accumulated_batch(tx_info, tx_relay == relay_method::block);
 
+    for (size_t i = 0; i < tx_blobs.size(); i++) {
+      if (!results[i].res || already_have[i])
+        continue;
+      results[i].blob_size = tx_blobs[i].blob.size();
+      results[i].weight = results[i].tx.pruned ? get_pruned_transaction_weight(results[i].tx) : get_transaction_weight(results[i].tx, results[i].blob_size);
+    }
+
+    // the ring signatures are the bulk of the work adding to the pool, which
+    // checks txes one at a time under the pool and blockchain locks, so check
+    // them all in parallel first: add_tx then finds them in the tx verification
+    // cache. Txes add_tx would reject on its cheap checks (fee, weight, spent
+    // key images) are skipped, so spam does not get the expensive check. Block
+    // txes are skipped too, as their rings are often in the same span of blocks,
+    // not in the chain yet, and get checked when the block is added
+    if (tx_relay != relay_method::block)
+    {
+      static epee::metrics::counter &preverified_counter = epee::metrics::get_counter("dinastycoin_txpool_preverified_txes_total", "Incoming transactions whose ring signatures were checked ahead of adding them to the pool");
+      const uint8_t version = m_blockchain_storage.get_current_hard_fork_version();
+      std::vector<transaction*> ring_txs;
+      ring_txs.reserve(tx_info.size());
+      for (size_t i = 0; i < tx_blobs.size(); i++)
+        if (results[i].res && !already_have[i] && m_mempool.precheck_tx(results[i].tx, results[i].hash, results[i].weight, version))
+          ring_txs.push_back(&results[i].tx);
+      if (!ring_txs.empty())
+      {
+        preverified_counter.inc(ring_txs.size());
+        const size_t n_verified = m_blockchain_storage.preverify_tx_rings(ring_txs);
+        MDEBUG("Preverified ring signatures of " << n_verified << "/" << ring_txs.size() << " incoming txes");
+      }
+    }
+
     bool valid_events = false;
     bool ok = true;
     it = tx_blobs.begin();
@@ -1063,8 +1109,6 @@ namespace cryptonote
       if (already_have[i])
         continue;
 
-      results[i].blob_size = it->blob.size();
-      results[i].weight = results[i].tx.pruned ? get_pruned_transaction_weight(results[i].tx) : get_transaction_weight(results[i].tx, it->blob.size());
       ok &= add_new_tx(results[i].tx, results[i].hash, tx_blobs[i].blob, results[i].weight, tvc[i], tx_relay, relayed);
 
       if(tvc[i].m_verifivation_failed)
@@ -1665,6 +1709,12 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::get_pool_transaction_hashes_since(uint64_t token, bool &full, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed, uint64_t &new_token, bool include_sensitive_data) const
+  {
+    m_mempool.get_transaction_hashes_since(token, full, added, removed, new_token, include_sensitive_data);
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_pool_transaction_stats(struct txpool_stats& stats, bool include_sensitive_data) const
   {
     m_mempool.get_transaction_stats(stats, include_sensitive_data);
@@ -503,6 +503,14 @@ namespace cryptonote
       */
      bool get_pool_transaction_hashes(std::vector<crypto::hash>& txs, bool include_sensitive_txes = false) const;
 
+     /**
+      * @copydoc tx_memory_pool::get_transaction_hashes_since
+      * @param include_sensitive_txes include private transactions
+      *
+      * @note see tx_memory_pool::get_transaction_hashes_since
+      */
+     bool get_pool_transaction_hashes_since(uint64_t token, bool &full, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed, uint64_t &new_token, bool include_sensitive_txes = false) const;
+
      /**
       * @copydoc tx_memory_pool::get_transactions
       * @param include_sensitive_txes include private transactions
@@ -43,8 +43,10 @@
 #include "common/boost_serialization_helper.h"
 #include "int-util.h"
 #include "misc_language.h"
+#include "profile_tools.h"
 #include "warnings.h"
 #include "common/perf_timer.h"
+#include "metrics.h"
 #include "crypto/hash.h"
 #include "crypto/duration.h"
 
@@ -89,6 +91,7 @@ namespace cryptonote
     //      will work correctly.
     time_t const MIN_RELAY_TIME = (60 * 5); // only start re-relaying transactions after that many seconds
     time_t const MAX_RELAY_TIME = (60 * 60 * 4); // at most that many seconds between resends
+    size_t const MAX_POOL_EVENTS = 65536; // pool sync clients further behind than this get the full pool
     float const ACCEPT_THRESHOLD = 1.0f;
 
     //! Max DB check interval for relayable txes
@@ -128,7 +131,7 @@ namespace cryptonote
   }
   //---------------------------------------------------------------------------------
   //---------------------------------------------------------------------------------
-  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_cookie(0), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_mine_stem_txes(false), m_next_check(std::time(nullptr))
+  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_cookie(0), m_next_pool_event_id(crypto::rand<uint64_t>() >> 1), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_mine_stem_txes(false), m_next_check(std::time(nullptr))
   {
     // class code expects unsigned values throughout
     if (m_next_check < time_t(0))
@@ -142,6 +145,8 @@ namespace cryptonote
     // this should already be called with that lock, but let's make it explicit for clarity
     CRITICAL_REGION_LOCAL(m_transactions_lock);
 
+    static epee::metrics::histogram &add_tx_histogram = epee::metrics::get_histogram("dinastycoin_txpool_add_tx_seconds", "Time to verify and add a transaction to the pool", 1e-9);
+    epee::metrics::scoped_timer add_tx_timer(&add_tx_histogram);
     PERF_TIMER(add_tx);
     if (tx.version == 0)
     {
@@ -281,7 +286,7 @@ namespace cryptonote
             return false;
 
           m_blockchain.add_txpool_tx(id, blob, meta);
-          m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)(tx_weight ? tx_weight : 1), receive_time), id);
+          add_tx_to_sorted_container(id, fee, tx_weight, receive_time);
           lock.commit();
         }
         catch (const std::exception &e)
@@ -352,7 +357,7 @@ namespace cryptonote
 
           m_blockchain.remove_txpool_tx(id);
           m_blockchain.add_txpool_tx(id, blob, meta);
-          m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)(tx_weight ? tx_weight : 1), receive_time), id);
+          add_tx_to_sorted_container(id, fee, tx_weight, receive_time);
         }
         lock.commit();
       }
@@ -372,6 +377,7 @@ namespace cryptonote
     m_txpool_weight += tx_weight;
 
     ++m_cookie;
+    add_pool_event(id, true, meta.get_relay_method());
 
     MINFO("Transaction added to pool: txid " << id << " weight: " << tx_weight << " fee/byte: " << (fee / (double)(tx_weight ? tx_weight : 1)));
 
@@ -380,6 +386,26 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::precheck_tx(const transaction &tx, const crypto::hash &id, size_t tx_weight, uint8_t version) const
+  {
+    // v1 txes have their fee in the inputs, and are not preverified anyway
+    if (tx.version < 2)
+      return true;
+
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    if (m_timed_out_transactions.find(id) != m_timed_out_transactions.end())
+      return false;
+    if (!m_blockchain.check_fee(tx_weight, tx.rct_signatures.txnFee))
+      return false;
+    if (tx_weight > get_transaction_weight_limit(version))
+      return false;
+    if (have_tx_keyimges_as_spent(tx, id))
+      return false;
+    if (m_blockchain.have_tx_keyimges_as_spent(tx))
+      return false;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::add_tx(transaction &tx, tx_verification_context& tvc, relay_method tx_relay, bool relayed, uint8_t version)
   {
     crypto::hash h = null_hash;
@@ -445,8 +471,9 @@ namespace cryptonote
         m_blockchain.remove_txpool_tx(txid);
         m_txpool_weight -= meta.weight;
         remove_transaction_keyimages(tx, txid);
+        add_pool_event(txid, false, meta.get_relay_method());
         MINFO("Pruned tx " << txid << " from txpool: weight: " << meta.weight << ", fee/byte: " << it->first.first);
-        m_txs_by_fee_and_receive_time.erase(it--);
+        remove_tx_from_sorted_container(it--);
         changed = true;
       }
       catch (const std::exception &e)
@@ -565,6 +592,7 @@ namespace cryptonote
       m_blockchain.remove_txpool_tx(id);
       m_txpool_weight -= tx_weight;
       remove_transaction_keyimages(tx, id);
+      add_pool_event(id, false, meta.get_relay_method());
       lock.commit();
     }
     catch (const std::exception &e)
@@ -574,7 +602,7 @@ namespace cryptonote
     }
 
     if (sorted_it != m_txs_by_fee_and_receive_time.end())
-      m_txs_by_fee_and_receive_time.erase(sorted_it);
+      remove_tx_from_sorted_container(sorted_it);
     ++m_cookie;
     return true;
   }
@@ -672,11 +700,28 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   sorted_tx_container::iterator tx_memory_pool::find_tx_in_sorted_container(const crypto::hash& id) const
   {
-    return std::find_if( m_txs_by_fee_and_receive_time.begin(), m_txs_by_fee_and_receive_time.end()
-                       , [&](const sorted_tx_container::value_type& a){
-                         return a.second == id;
-                       }
-    );
+    const auto i = m_txs_by_fee_and_receive_time_index.find(id);
+    if (i == m_txs_by_fee_and_receive_time_index.end())
+      return m_txs_by_fee_and_receive_time.end();
+    return i->second;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::add_tx_to_sorted_container(const crypto::hash& id, uint64_t fee, size_t weight, std::time_t receive_time)
+  {
+    const auto i = m_txs_by_fee_and_receive_time_index.find(id);
+    if (i != m_txs_by_fee_and_receive_time_index.end())
+    {
+      m_txs_by_fee_and_receive_time.erase(i->second);
+      m_txs_by_fee_and_receive_time_index.erase(i);
+    }
+    const auto sorted_it = m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)(weight ? weight : 1), receive_time), id).first;
+    m_txs_by_fee_and_receive_time_index.emplace(id, sorted_it);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::remove_tx_from_sorted_container(sorted_tx_container::iterator it)
+  {
+    m_txs_by_fee_and_receive_time_index.erase(it->second);
+    m_txs_by_fee_and_receive_time.erase(it);
   }
   //---------------------------------------------------------------------------------
   //TODO: investigate whether boolean return is appropriate
@@ -684,7 +729,7 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    std::list<std::pair<crypto::hash, uint64_t>> remove;
+    std::list<std::tuple<crypto::hash, uint64_t, relay_method>> remove;
     m_blockchain.for_all_txpool_txes([this, &remove](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*) {
       uint64_t tx_age = time(nullptr) - meta.receive_time;
 
@@ -699,10 +744,10 @@ namespace cryptonote
         }
         else
         {
-          m_txs_by_fee_and_receive_time.erase(sorted_it);
+          remove_tx_from_sorted_container(sorted_it);
         }
         m_timed_out_transactions.insert(txid);
-        remove.push_back(std::make_pair(txid, meta.weight));
+        remove.push_back(std::make_tuple(txid, meta.weight, meta.get_relay_method()));
       }
       return true;
     }, false, relay_category::all);
@@ -710,9 +755,9 @@ namespace cryptonote
     if (!remove.empty())
     {
       LockedTXN lock(m_blockchain.get_db());
-      for (const std::pair<crypto::hash, uint64_t> &entry: remove)
+      for (const std::tuple<crypto::hash, uint64_t, relay_method> &entry: remove)
       {
-        const crypto::hash &txid = entry.first;
+        const crypto::hash &txid = std::get<0>(entry);
         try
         {
           cryptonote::blobdata bd = m_blockchain.get_txpool_tx_blob(txid, relay_category::all);
@@ -726,8 +771,9 @@ namespace cryptonote
           {
             // remove first, so we only remove key images if the tx removal succeeds
             m_blockchain.remove_txpool_tx(txid);
-            m_txpool_weight -= entry.second;
+            m_txpool_weight -= std::get<1>(entry);
             remove_transaction_keyimages(tx, txid);
+            add_pool_event(txid, false, std::get<2>(entry));
           }
         }
         catch (const std::exception &e)
@@ -838,6 +884,7 @@ namespace cryptonote
         if (m_blockchain.get_txpool_tx_meta(hash, meta))
         {
           // txes can be received as "stem" or "fluff" in either order
+          const bool was_public = meta.matches(relay_category::broadcasted);
           meta.upgrade_relay_method(method);
           meta.relayed = true;
 
@@ -850,6 +897,9 @@ namespace cryptonote
             meta.last_relayed_time = std::chrono::system_clock::to_time_t(now);
 
           m_blockchain.update_txpool_tx(hash, meta);
+          // a stem tx becomes public once fluffed, re-relays change nothing
+          if (!was_public && meta.matches(relay_category::broadcasted))
+            add_pool_event(hash, true, meta.get_relay_method());
         }
       }
       catch (const std::exception &e)
@@ -901,6 +951,46 @@ namespace cryptonote
     }, false, category);
   }
   //------------------------------------------------------------------
+  void tx_memory_pool::get_transaction_hashes_since(uint64_t token, bool &full, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed, uint64_t &new_token, bool include_sensitive) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+    added.clear();
+    removed.clear();
+    new_token = m_next_pool_event_id;
+    const uint64_t oldest = m_pool_events.empty() ? m_next_pool_event_id : m_pool_events.front().id;
+    full = token < oldest || token > m_next_pool_event_id;
+    if (full)
+    {
+      get_transaction_hashes(added, include_sensitive);
+      return;
+    }
+
+    // events are in id order, so the last one seen for a tx is its state now
+    std::unordered_map<crypto::hash, const pool_event*> changes;
+    for (auto i = m_pool_events.begin() + (token - oldest); i != m_pool_events.end(); ++i)
+      changes[i->txid] = &*i;
+    const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
+    for (const auto &e: changes)
+    {
+      // a tx which was never public is not disclosed when it leaves the pool either
+      if (!e.second->added)
+      {
+        if (matches_category(e.second->method, category))
+          removed.push_back(e.first);
+      }
+      else if (m_blockchain.txpool_tx_matches_category(e.first, category))
+        added.push_back(e.first);
+    }
+  }
+  //------------------------------------------------------------------
+  void tx_memory_pool::add_pool_event(const crypto::hash &txid, bool added, relay_method method)
+  {
+    m_pool_events.push_back({m_next_pool_event_id++, txid, added, method});
+    while (m_pool_events.size() > MAX_POOL_EVENTS)
+      m_pool_events.pop_front();
+  }
+  //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_backlog(std::vector<tx_backlog_entry>& backlog, bool include_sensitive) const
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
@@ -1571,18 +1661,18 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
     size_t tx_weight_limit = get_transaction_weight_limit(version);
-    std::unordered_set<crypto::hash> remove;
+    std::unordered_map<crypto::hash, relay_method> remove;
 
     m_txpool_weight = 0;
     m_blockchain.for_all_txpool_txes([this, &remove, tx_weight_limit](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*) {
       m_txpool_weight += meta.weight;
       if (meta.weight > tx_weight_limit) {
         LOG_PRINT_L1("Transaction " << txid << " is too big (" << meta.weight << " bytes), removing it from pool");
-        remove.insert(txid);
+        remove.emplace(txid, meta.get_relay_method());
       }
       else if (m_blockchain.have_tx(txid)) {
         LOG_PRINT_L1("Transaction " << txid << " is in the blockchain, removing it from pool");
-        remove.insert(txid);
+        remove.emplace(txid, meta.get_relay_method());
       }
       return true;
     }, false, relay_category::all);
@@ -1591,8 +1681,9 @@ namespace cryptonote
     if (!remove.empty())
     {
       LockedTXN lock(m_blockchain.get_db());
-      for (const crypto::hash &txid: remove)
+      for (const auto &entry: remove)
       {
+        const crypto::hash &txid = entry.first;
         try
         {
           cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid, relay_category::all);
@@ -1606,6 +1697,7 @@ namespace cryptonote
           m_blockchain.remove_txpool_tx(txid);
           m_txpool_weight -= get_transaction_weight(tx, txblob.size());
           remove_transaction_keyimages(tx, txid);
+          add_pool_event(txid, false, entry.second);
           auto sorted_it = find_tx_in_sorted_container(txid);
           if (sorted_it == m_txs_by_fee_and_receive_time.end())
           {
@@ -1613,7 +1705,7 @@ namespace cryptonote
           }
           else
           {
-            m_txs_by_fee_and_receive_time.erase(sorted_it);
+            remove_tx_from_sorted_container(sorted_it);
           }
           ++n_removed;
         }
@@ -1630,17 +1722,26 @@ namespace cryptonote
     return n_removed;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::init(size_t max_txpool_weight, bool mine_stem_txes)
+  bool tx_memory_pool::init(size_t max_txpool_weight, bool mine_stem_txes, const std::string &snapshot_filename)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
 
     m_txpool_max_weight = max_txpool_weight ? max_txpool_weight : DEFAULT_TXPOOL_MAX_WEIGHT;
     m_txs_by_fee_and_receive_time.clear();
+    m_txs_by_fee_and_receive_time_index.clear();
     m_spent_key_images.clear();
     m_txpool_weight = 0;
+    m_pool_events.clear();
+    m_snapshot_filename = snapshot_filename;
     std::vector<crypto::hash> remove;
 
+    m_mine_stem_txes = mine_stem_txes;
+    m_cookie = 0;
+
+    if (load_snapshot())
+      return true;
+
     // first add the not kept by block, then the kept by block,
     // to avoid rejection due to key image collision
     for (int pass = 0; pass < 2; ++pass)
@@ -1661,7 +1762,7 @@ namespace cryptonote
           MFATAL("Failed to insert key images from txpool tx");
           return false;
         }
-        m_txs_by_fee_and_receive_time.emplace(std::pair<double, time_t>(meta.fee / (double)meta.weight, meta.receive_time), txid);
+        add_tx_to_sorted_container(txid, meta.fee, meta.weight, meta.receive_time);
         m_txpool_weight += meta.weight;
         return true;
       }, true, relay_category::all);
@@ -1686,16 +1787,94 @@ namespace cryptonote
       lock.commit();
     }
 
-    m_mine_stem_txes = mine_stem_txes;
-    m_cookie = 0;
-
     // Ignore deserialization error
     return true;
   }
+  //---------------------------------------------------------------------------------
+  crypto::hash tx_memory_pool::get_txids_hash(uint64_t &n_txes, bool rebuild_sorted_container)
+  {
+    std::string txids;
+    txids.reserve(m_blockchain.get_txpool_tx_count(true) * sizeof(crypto::hash));
+    m_blockchain.for_all_txpool_txes([this, &txids, rebuild_sorted_container](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*) {
+      txids.append(reinterpret_cast<const char*>(&txid), sizeof(txid));
+      if (rebuild_sorted_container)
+      {
+        add_tx_to_sorted_container(txid, meta.fee, meta.weight, meta.receive_time);
+        m_txpool_weight += meta.weight;
+      }
+      return true;
+    }, false, relay_category::all);
+    n_txes = txids.size() / sizeof(crypto::hash);
+    return crypto::cn_fast_hash(txids.data(), txids.size());
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::load_snapshot()
+  {
+    if (m_snapshot_filename.empty())
+      return false;
+    boost::system::error_code ec;
+    if (!boost::filesystem::exists(m_snapshot_filename, ec))
+      return false;
 
+    TIME_MEASURE_START(t);
+    pool_snapshot snapshot;
+    const bool loaded = tools::unserialize_obj_from_file(snapshot, m_snapshot_filename);
+    // a snapshot is only good for the pool it was saved from, so it's
+    // removed now in case the pool changes and we crash before saving
+    boost::filesystem::remove(m_snapshot_filename, ec);
+    if (!loaded)
+    {
+      MWARNING("Failed to load txpool snapshot from " << m_snapshot_filename << ", rebuilding");
+      return false;
+    }
+
+    uint64_t n_txes;
+    const crypto::hash txids_hash = get_txids_hash(n_txes, true);
+    if (n_txes != snapshot.n_txes || txids_hash != snapshot.txids_hash)
+    {
+      MINFO("Txpool snapshot does not match the txpool (" << snapshot.n_txes << " txes, " << n_txes << " in the database), rebuilding");
+      m_txs_by_fee_and_receive_time.clear();
+      m_txs_by_fee_and_receive_time_index.clear();
+      m_txpool_weight = 0;
+      return false;
+    }
+
+    m_spent_key_images = std::move(snapshot.spent_key_images);
+    TIME_MEASURE_FINISH(t);
+    MINFO("Loaded txpool snapshot with " << n_txes << " txes in " << t << " ms");
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::store_snapshot()
+  {
+    pool_snapshot snapshot;
+    snapshot.txids_hash = get_txids_hash(snapshot.n_txes, false);
+    snapshot.spent_key_images = m_spent_key_images;
+    if (!tools::serialize_obj_to_file(snapshot, m_snapshot_filename))
+    {
+      MWARNING("Failed to save txpool snapshot to " << m_snapshot_filename);
+      return false;
+    }
+    MINFO("Saved txpool snapshot with " << snapshot.n_txes << " txes to " << m_snapshot_filename);
+    return true;
+  }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::deinit()
   {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+
+    if (!m_snapshot_filename.empty())
+    {
+      try
+      {
+        store_snapshot();
+      }
+      catch (const std::exception &e)
+      {
+        MWARNING("Failed to save txpool snapshot: " << e.what());
+      }
+    }
     return true;
   }
 }
@@ -32,6 +32,7 @@
 #include "include_base_utils.h"
 
 #include <atomic>
+#include <deque>
 #include <set>
 #include <tuple>
 #include <unordered_map>
@@ -72,8 +73,8 @@ namespace cryptonote
       else if (a.first.first < b.first.first) return false;
       else if (a.first.second < b.first.second) return true;
       else if (a.first.second > b.first.second) return false;
-      else if (a.second != b.second) return true;
-      else return false;
+      // ties are ordered by hash, so the ordering stays strict weak
+      else return memcmp(a.second.data, b.second.data, sizeof(a.second.data)) < 0;
     }
   };
 
@@ -132,6 +133,23 @@ namespace cryptonote
      */
     bool add_tx(transaction &tx, tx_verification_context& tvc, relay_method tx_relay, bool relayed, uint8_t version);
 
+    /**
+     * @brief runs the cheap checks add_tx would reject a relayed transaction on
+     *
+     * These are the fee, the weight limit and key images already spent in the
+     * pool or the chain. They let the expensive ring signature checks be
+     * skipped for transactions add_tx would reject anyway. add_tx still runs
+     * all its checks and reports the failure.
+     *
+     * @param tx the transaction to check
+     * @param id the transaction's hash
+     * @param tx_weight the transaction's weight
+     * @param version the current hard fork version
+     *
+     * @return false if add_tx would reject the transaction, true otherwise
+     */
+    bool precheck_tx(const transaction &tx, const crypto::hash &id, size_t tx_weight, uint8_t version) const;
+
     /**
      * @brief takes a transaction with the given hash from the pool
      *
@@ -205,21 +223,24 @@ namespace cryptonote
     /**
      * @brief loads pool state (if any) from disk, and initializes pool
      *
+     * The in memory indices are loaded from the snapshot if it matches the
+     * txes in the database, and rebuilt from the txes otherwise.
+     *
      * @param max_txpool_weight the max weight in bytes
      * @param mine_stem_txes whether to mine txes in stem relay mode
+     * @param snapshot_filename where deinit saves the in memory indices, empty for nowhere
      *
      * @return true
      */
-    bool init(size_t max_txpool_weight = 0, bool mine_stem_txes = false);
+    bool init(size_t max_txpool_weight = 0, bool mine_stem_txes = false, const std::string &snapshot_filename = std::string());
 
     /**
      * @brief attempts to save the transaction pool state to disk
      *
-     * Currently fails (returns false) if the data directory from init()
-     * does not exist and cannot be created, but returns true even if
-     * saving to disk is unsuccessful.
+     * Saves a snapshot of the in memory indices to the file given to init(),
+     * if any. Returns true even if saving to disk is unsuccessful.
      *
-     * @return true in most cases (see above)
+     * @return true
      */
     bool deinit();
 
@@ -256,6 +277,21 @@ namespace cryptonote
      */
     void get_transaction_hashes(std::vector<crypto::hash>& txs, bool include_sensitive = false) const;
 
+    /**
+     * @brief get the changes to the pool since a token from a previous call
+     *
+     * If the token is too old to be answered from the event log (or comes
+     * from another run), the full list of hashes is returned in added
+     *
+     * @param token the token returned by a previous call, 0 if none
+     * @param full return-by-reference true if added is the whole pool
+     * @param added return-by-reference txes added (or made public) since token
+     * @param removed return-by-reference txes removed since token
+     * @param new_token return-by-reference the token to pass next time
+     * @param include_sensitive return stempool, anonymity-pool, and unrelayed txes
+     */
+    void get_transaction_hashes_since(uint64_t token, bool &full, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed, uint64_t &new_token, bool include_sensitive = false) const;
+
     /**
      * @brief get (weight, fee, receive time) for all transaction in the pool
      *
@@ -408,6 +444,7 @@ namespace cryptonote
 
 #define CURRENT_MEMPOOL_ARCHIVE_VER    11
 #define CURRENT_MEMPOOL_TX_DETAILS_ARCHIVE_VER    13
+#define CURRENT_MEMPOOL_SNAPSHOT_ARCHIVE_VER    1
 
     /**
      * @brief information about a single transaction
@@ -450,6 +487,16 @@ namespace cryptonote
       bool double_spend_seen; //!< true iff another tx was seen double spending this one
     };
 
+    /**
+     * @brief the in memory pool state which is expensive to rebuild, as saved on shutdown
+     */
+    struct pool_snapshot
+    {
+      uint64_t n_txes;  //!< the number of txes in the pool database
+      crypto::hash txids_hash;  //!< the hash of their txids, see get_txids_hash
+      std::unordered_map<crypto::key_image, std::unordered_set<crypto::hash>> spent_key_images;  //!< the key image index
+    };
+
     /**
      * @brief get infornation about a single transaction
      */
@@ -590,12 +637,37 @@ private:
     //! interval on which to check for stale/"stuck" transactions
     epee::math_helper::once_a_time_seconds<30> m_remove_stuck_tx_interval;
 
-    //TODO: look into doing this better
     //!< container for transactions organized by fee per size and receive time
     sorted_tx_container m_txs_by_fee_and_receive_time;
+    //!< positions of transactions in m_txs_by_fee_and_receive_time, by hash
+    std::unordered_map<crypto::hash, sorted_tx_container::iterator> m_txs_by_fee_and_receive_time_index;
+
+    std::string m_snapshot_filename; //!< where to save the snapshot, if anywhere
 
     std::atomic<uint64_t> m_cookie; //!< incremented at each change
 
+    //! an addition to or removal from the pool, for incremental pool sync
+    struct pool_event
+    {
+      uint64_t id;
+      crypto::hash txid;
+      bool added;
+      relay_method method; //!< how the tx was relayed at the time of the event
+    };
+
+    //! bounded log of the most recent pool events, oldest first
+    std::deque<pool_event> m_pool_events;
+    uint64_t m_next_pool_event_id; //!< randomly seeded, so tokens from a previous run don't match
+
+    /**
+     * @brief record a pool event, with m_transactions_lock held
+     *
+     * @param txid the transaction added or removed
+     * @param added true if added, false if removed
+     * @param method the relay method of the transaction
+     */
+    void add_pool_event(const crypto::hash &txid, bool added, relay_method method);
+
     /**
      * @brief get an iterator to a transaction in the sorted container
      *
@@ -605,6 +677,52 @@ private:
      */
     sorted_tx_container::iterator find_tx_in_sorted_container(const crypto::hash& id) const;
 
+    /**
+     * @brief adds a transaction to the sorted container, replacing any previous entry for it
+     *
+     * @param id the hash of the transaction
+     * @param fee the transaction's fee
+     * @param weight the transaction's weight
+     * @param receive_time when the transaction was received
+     */
+    void add_tx_to_sorted_container(const crypto::hash& id, uint64_t fee, size_t weight, std::time_t receive_time);
+
+    /**
+     * @brief removes a transaction from the sorted container
+     *
+     * @param it an iterator to the transaction in the sorted container
+     */
+    void remove_tx_from_sorted_container(sorted_tx_container::iterator it);
+
+    /**
+     * @brief hashes the list of txids in the pool database
+     *
+     * A tx's key images are fixed by its hash, so this identifies the key
+     * image index a snapshot holds. While hashing, the fee sorted container
+     * and pool weight, which are cheap to derive from the tx metadata, are
+     * rebuilt if asked.
+     *
+     * @param n_txes return-by-reference the number of txes
+     * @param rebuild_sorted_container whether to rebuild the fee sorted container and weight
+     *
+     * @return the hash
+     */
+    crypto::hash get_txids_hash(uint64_t &n_txes, bool rebuild_sorted_container);
+
+    /**
+     * @brief loads the in memory indices from the snapshot, if it matches the pool database
+     *
+     * @return true if loaded, false if the indices need rebuilding
+     */
+    bool load_snapshot();
+
+    /**
+     * @brief saves the in memory indices to the snapshot file
+     *
+     * @return true if saved
+     */
+    bool store_snapshot();
+
     //! cache/call Blockchain::check_tx_inputs results
     bool check_tx_inputs(const std::function<cryptonote::transaction&(void)> &get_tx, const crypto::hash &txid, uint64_t &max_used_block_height, crypto::hash &max_used_block_id, tx_verification_context &tvc, bool kept_by_block = false) const;
 
@@ -656,10 +774,19 @@ namespace boost
         return;
       ar & td.weight;
     }
+
+    template<class archive_t>
+    void serialize(archive_t & ar, cryptonote::tx_memory_pool::pool_snapshot& snapshot, const unsigned int version)
+    {
+      ar & snapshot.n_txes;
+      ar & snapshot.txids_hash;
+      ar & snapshot.spent_key_images;
+    }
   }
 }
 BOOST_CLASS_VERSION(cryptonote::tx_memory_pool, CURRENT_MEMPOOL_ARCHIVE_VER)
 BOOST_CLASS_VERSION(cryptonote::tx_memory_pool::tx_details, CURRENT_MEMPOOL_TX_DETAILS_ARCHIVE_VER)
+BOOST_CLASS_VERSION(cryptonote::tx_memory_pool::pool_snapshot, CURRENT_MEMPOOL_SNAPSHOT_ARCHIVE_VER)
 
 
 
@@ -27,6 +27,7 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdint.h>
+#include <algorithm>
 #include <vector>
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
@@ -39,22 +40,52 @@
 namespace cryptonote
 {
 
+// offsets must be sorted and unique
+static bool tx_sanity_check_sorted(const std::vector<uint64_t> &offsets, size_t n_indices, uint64_t rct_outs_available)
+{
+  if (n_indices <= 10)
+  {
+    MDEBUG("n_indices is only " << n_indices << ", not checking");
+    return true;
+  }
+
+  if (rct_outs_available < 10000)
+    return true;
+
+  if (offsets.size() < n_indices * 8 / 10)
+  {
+    MERROR("amount of unique indices is too low (amount of rct indices is " << offsets.size() << ", out of total " << n_indices << "indices.");
+    return false;
+  }
+
+  const size_t n = offsets.size();
+  const uint64_t median = n == 0 ? 0 : n % 2 ? offsets[n / 2] : epee::misc_utils::get_mid<uint64_t>(offsets[n / 2 - 1], offsets[n / 2]);
+  if (median < rct_outs_available * 6 / 10)
+  {
+    MERROR("median offset index is too low (median is " << median << " out of total " << rct_outs_available << "offsets). Transactions should contain a higher fraction of recent outputs.");
+    return false;
+  }
+
+  return true;
+}
+
 bool tx_sanity_check(const cryptonote::blobdata &tx_blob, uint64_t rct_outs_available)
 {
-  cryptonote::transaction tx;
+  // the ring members are all in the prefix, no need to parse the signatures
+  cryptonote::transaction_prefix tx;
 
-  if (!cryptonote::parse_and_validate_tx_from_blob(tx_blob, tx))
+  if (!cryptonote::parse_and_validate_tx_prefix_from_blob(tx_blob, tx))
   {
     MERROR("Failed to parse transaction");
     return false;
   }
 
-  if (cryptonote::is_coinbase(tx))
+  if (tx.vin.size() == 1 && tx.vin[0].type() == typeid(cryptonote::txin_gen))
   {
     MERROR("Transaction is coinbase");
     return false;
   }
-  std::set<uint64_t> rct_indices;
+  std::vector<uint64_t> offsets;
   size_t n_indices = 0;
 
   for (const auto &txin : tx.vin)
@@ -64,41 +95,21 @@ bool tx_sanity_check(const cryptonote::blobdata &tx_blob, uint64_t rct_outs_avai
     const cryptonote::txin_to_key &in_to_key = boost::get<cryptonote::txin_to_key>(txin);
     if (in_to_key.amount != 0)
       continue;
-    const std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(in_to_key.key_offsets);
-    for (uint64_t offset: absolute)
-      rct_indices.insert(offset);
+    uint64_t offset = 0;
+    for (uint64_t relative: in_to_key.key_offsets)
+      offsets.push_back(offset += relative);
     n_indices += in_to_key.key_offsets.size();
   }
+  std::sort(offsets.begin(), offsets.end());
+  offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
 
-  return tx_sanity_check(rct_indices, n_indices, rct_outs_available);
+  return tx_sanity_check_sorted(offsets, n_indices, rct_outs_available);
 }
 
 bool tx_sanity_check(const std::set<uint64_t> &rct_indices, size_t n_indices, uint64_t rct_outs_available)
 {
-  if (n_indices <= 10)
-  {
-    MDEBUG("n_indices is only " << n_indices << ", not checking");
-    return true;
-  }
-
-  if (rct_outs_available < 10000)
-    return true;
-
-  if (rct_indices.size() < n_indices * 8 / 10)
-  {
-    MERROR("amount of unique indices is too low (amount of rct indices is " << rct_indices.size() << ", out of total " << n_indices << "indices.");
-    return false;
-  }
-
   std::vector<uint64_t> offsets(rct_indices.begin(), rct_indices.end());
-  uint64_t median = epee::misc_utils::median(offsets);
-  if (median < rct_outs_available * 6 / 10)
-  {
-    MERROR("median offset index is too low (median is " << median << " out of total " << rct_outs_available << "offsets). Transactions should contain a higher fraction of recent outputs.");
-    return false;
-  }
-
-  return true;
+  return tx_sanity_check_sorted(offsets, n_indices, rct_outs_available);
 }
 
 }
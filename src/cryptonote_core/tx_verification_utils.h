@@ -0,0 +1,75 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "common/data_cache.h"
+#include "crypto/hash.h"
+#include "ringct/rctTypes.h"
+
+#define TX_VERIFICATION_CACHE_SEMANTICS_SIZE 16384
+#define TX_VERIFICATION_CACHE_RINGS_SIZE 16384
+
+namespace cryptonote
+{
+  /**
+   * @brief key under which a tx's ring signature check is cached
+   *
+   * Covers the ring members the signatures were checked against, so the
+   * same tx referencing different outputs (eg, after a reorg) is a miss.
+   */
+  crypto::hash get_tx_ring_verification_key(const crypto::hash &txid, const rct::ctkeyM &pubkeys);
+
+  /**
+   * @brief results of the expensive parts of tx verification
+   *
+   * Shared by the pool, block, alternative chain and reorg paths, so a tx
+   * only has its proofs and signatures checked once however it reaches us.
+   * Only checks which depend on nothing but the tx (its hash commits to all
+   * of it) and, for signatures, the ring members are cached. Rules which
+   * depend on the height or hard fork version are always checked anew.
+   * Only successes are cached.
+   */
+  class tx_verification_cache
+  {
+  public:
+    //! rct semantics (range proofs, balance), by txid
+    bool has_semantics(const crypto::hash &txid) const { return m_semantics.has(txid); }
+    void add_semantics(const crypto::hash &txid) { m_semantics.add(txid); }
+
+    //! ring signatures, by get_tx_ring_verification_key
+    bool has_ring(const crypto::hash &key) const { return m_rings.has(key); }
+    void add_ring(const crypto::hash &key) { m_rings.add(key); }
+
+    void clear() { m_semantics.clear(); m_rings.clear(); }
+
+  private:
+    tools::data_cache<crypto::hash, TX_VERIFICATION_CACHE_SEMANTICS_SIZE> m_semantics;
+    tools::data_cache<crypto::hash, TX_VERIFICATION_CACHE_RINGS_SIZE> m_rings;
+  };
+}
@@ -82,6 +82,11 @@ namespace daemon_args
   , ""
   , ""
   };
+  const command_line::arg_descriptor<bool> arg_log_async = {
+    "log-async"
+  , "Write the log file from a background thread, so logging at high levels does not slow down the node"
+  , false
+  };
   const command_line::arg_descriptor<std::vector<std::string>> arg_command = {
     "daemon_command"
   , "Hidden"
@@ -207,6 +207,35 @@ bool t_command_parser_executor::set_log_level(const std::vector<std::string>& ar
   }
 }
 
+bool t_command_parser_executor::set_trace(const std::vector<std::string>& args)
+{
+  if (args.size() != 1 || (args[0] != "on" && args[0] != "off"))
+  {
+    std::cout << "use: set_trace <on|off>" << std::endl;
+    return true;
+  }
+
+  return m_executor.set_trace(args[0] == "on");
+}
+
+bool t_command_parser_executor::print_trace(const std::vector<std::string>& args)
+{
+  if (!args.empty()) return false;
+
+  return m_executor.print_trace();
+}
+
+bool t_command_parser_executor::save_trace(const std::vector<std::string>& args)
+{
+  if (args.size() != 1)
+  {
+    std::cout << "use: save_trace <filename>" << std::endl;
+    return true;
+  }
+
+  return m_executor.save_trace(args[0]);
+}
+
 bool t_command_parser_executor::print_height(const std::vector<std::string>& args) 
 {
   if (!args.empty()) return false;
@@ -81,6 +81,12 @@ public:
 
   bool set_log_categories(const std::vector<std::string>& args);
 
+  bool set_trace(const std::vector<std::string>& args);
+
+  bool print_trace(const std::vector<std::string>& args);
+
+  bool save_trace(const std::vector<std::string>& args);
+
   bool print_height(const std::vector<std::string>& args);
 
   bool print_block(const std::vector<std::string>& args);
@@ -165,6 +165,23 @@ t_command_server::t_command_server(
     , "set_log <level>|<{+,-,}categories>"
     , "Change the current log level/categories where <level> is a number 0-4."
     );
+  m_command_lookup.set_handler(
+      "set_trace"
+    , std::bind(&t_command_parser_executor::set_trace, &m_parser, p::_1)
+    , "set_trace <on|off>"
+    , "Start (discarding previous spans) or stop recording spans of block and transaction processing."
+    );
+  m_command_lookup.set_handler(
+      "print_trace"
+    , std::bind(&t_command_parser_executor::print_trace, &m_parser, p::_1)
+    , "Print the count, total and maximum duration of the recorded spans."
+    );
+  m_command_lookup.set_handler(
+      "save_trace"
+    , std::bind(&t_command_parser_executor::save_trace, &m_parser, p::_1)
+    , "save_trace <filename>"
+    , "Save the recorded spans as a Chrome trace (for chrome://tracing or Perfetto)."
+    );
   m_command_lookup.set_handler(
       "diff"
     , std::bind(&t_command_parser_executor::show_difficulty, &m_parser, p::_1)
@@ -151,6 +151,7 @@ int main(int argc, char const * argv[])
       command_line::add_arg(core_settings, daemon_args::arg_log_level);
       command_line::add_arg(core_settings, daemon_args::arg_max_log_file_size);
       command_line::add_arg(core_settings, daemon_args::arg_max_log_files);
+      command_line::add_arg(core_settings, daemon_args::arg_log_async);
       command_line::add_arg(core_settings, daemon_args::arg_max_concurrency);
       command_line::add_arg(core_settings, daemon_args::arg_proxy);
       command_line::add_arg(core_settings, daemon_args::arg_proxy_allow_dns_leaks);
@@ -275,6 +276,8 @@ int main(int argc, char const * argv[])
     if (!log_file_path.has_parent_path())
       log_file_path = bf::absolute(log_file_path, relative_path_base);
     mlog_configure(log_file_path.string(), true, command_line::get_arg(vm, daemon_args::arg_max_log_file_size), command_line::get_arg(vm, daemon_args::arg_max_log_files));
+    if (command_line::get_arg(vm, daemon_args::arg_log_async))
+      mlog_set_async_file_logging(true);
 
     // Set log level
     if (!command_line::is_arg_defaulted(vm, daemon_args::arg_log_level))
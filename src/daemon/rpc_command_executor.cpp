@@ -29,6 +29,7 @@
 // Parts of this file are originally copyright (c) 2015-2019 The Monero Project
 
 #include "string_tools.h"
+#include "file_io_utils.h"
 #include "common/password.h"
 #include "common/scoped_message_writer.h"
 #include "common/pruning.h"
@@ -850,6 +851,108 @@ bool t_rpc_command_executor::set_log_level(int8_t level) {
   return true;
 }
 
+bool t_rpc_command_executor::set_trace(bool enable) {
+  cryptonote::COMMAND_RPC_SET_TRACE::request req;
+  cryptonote::COMMAND_RPC_SET_TRACE::response res;
+  req.enable = enable;
+  req.clear = enable;
+
+  std::string fail_message = "Unsuccessful";
+
+  if (m_is_rpc)
+  {
+    if (!m_rpc_client->rpc_request(req, res, "/set_trace", fail_message.c_str()))
+    {
+      return true;
+    }
+  }
+  else
+  {
+    if (!m_rpc_server->on_set_trace(req, res) || res.status != CORE_RPC_STATUS_OK)
+    {
+      tools::fail_msg_writer() << make_error(fail_message, res.status);
+      return true;
+    }
+  }
+
+  tools::success_msg_writer() << "Tracing is now " << (enable ? "on" : "off");
+
+  return true;
+}
+
+bool t_rpc_command_executor::print_trace() {
+  cryptonote::COMMAND_RPC_GET_TRACE::request req;
+  cryptonote::COMMAND_RPC_GET_TRACE::response res;
+  req.chrome_trace = false;
+
+  std::string fail_message = "Unsuccessful";
+
+  if (m_is_rpc)
+  {
+    if (!m_rpc_client->rpc_request(req, res, "/get_trace", fail_message.c_str()))
+    {
+      return true;
+    }
+  }
+  else
+  {
+    if (!m_rpc_server->on_get_trace(req, res) || res.status != CORE_RPC_STATUS_OK)
+    {
+      tools::fail_msg_writer() << make_error(fail_message, res.status);
+      return true;
+    }
+  }
+
+  tools::msg_writer() << "Tracing is " << (res.enabled ? "on" : "off") << ", " << res.spans.size() << " span names recorded";
+  if (res.spans.empty())
+    return true;
+  tools::msg_writer() << boost::format("%-40s %10s %14s %14s") % "Span" % "Count" % "Total (ms)" % "Max (ms)";
+  for (const auto &span: res.spans)
+  {
+    tools::msg_writer() << boost::format("%-40s %10u %14.3f %14.3f")
+      % span.name
+      % span.count
+      % (span.total_ns / 1e6)
+      % (span.max_ns / 1e6);
+  }
+
+  return true;
+}
+
+bool t_rpc_command_executor::save_trace(const std::string &filename) {
+  cryptonote::COMMAND_RPC_GET_TRACE::request req;
+  cryptonote::COMMAND_RPC_GET_TRACE::response res;
+  req.chrome_trace = true;
+
+  std::string fail_message = "Unsuccessful";
+
+  if (m_is_rpc)
+  {
+    if (!m_rpc_client->rpc_request(req, res, "/get_trace", fail_message.c_str()))
+    {
+      return true;
+    }
+  }
+  else
+  {
+    if (!m_rpc_server->on_get_trace(req, res) || res.status != CORE_RPC_STATUS_OK)
+    {
+      tools::fail_msg_writer() << make_error(fail_message, res.status);
+      return true;
+    }
+  }
+
+  if (!epee::file_io_utils::save_string_to_file(filename, res.chrome_trace))
+  {
+    tools::fail_msg_writer() << "Failed to save trace to " << filename;
+    return true;
+  }
+
+  tools::success_msg_writer() << "Trace saved to " << filename;
+
+  return true;
+}
+
 bool t_rpc_command_executor::set_log_categories(const std::string &categories) {
   cryptonote::COMMAND_RPC_SET_LOG_CATEGORIES::request req;
   cryptonote::COMMAND_RPC_SET_LOG_CATEGORIES::response res;
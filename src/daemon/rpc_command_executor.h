@@ -91,6 +91,12 @@ public:
 
   bool set_log_categories(const std::string &categories);
 
+  bool set_trace(bool enable);
+
+  bool print_trace();
+
+  bool save_trace(const std::string &filename);
+
   bool print_height();
 
   bool print_block_by_hash(crypto::hash block_hash, bool include_hex);
@@ -366,7 +366,43 @@ struct straus_cached_data
 #endif
 #endif
 
+// multiexps without a caller provided cache fill a temporary one; these
+// are kept per thread and reused while small enough, so verifying many
+// proofs does not allocate and page in a fresh buffer for each multiexp.
+// The limits cover straus up to its size limit in bulletproofs, and the
+// points past the generator cache for pippenger, keeping about 2 MB per
+// thread at most; larger multiexps allocate per call
+#define STRAUS_SCRATCH_MAX_POINTS 256
+#define PIPPENGER_SCRATCH_MAX_POINTS 4096
+
+static void straus_fill_cache(const std::shared_ptr<straus_cached_data> &cache, const std::vector<MultiexpData> &data, size_t N);
+
 std::shared_ptr<straus_cached_data> straus_init_cache(const std::vector<MultiexpData> &data, size_t N)
+{
+  std::shared_ptr<straus_cached_data> cache(new straus_cached_data());
+  straus_fill_cache(cache, data, N);
+  return cache;
+}
+
+static std::shared_ptr<straus_cached_data> straus_scratch_cache(const std::vector<MultiexpData> &data)
+{
+  static thread_local std::shared_ptr<straus_cached_data> scratch;
+  if (data.size() > STRAUS_SCRATCH_MAX_POINTS)
+    return straus_init_cache(data);
+  if (!scratch)
+    scratch.reset(new straus_cached_data());
+  // start over, keeping the allocation
+#ifdef RAW_MEMORY_BLOCK
+  scratch->size = 0;
+#else
+  for (auto &e: scratch->multiples)
+    e.clear();
+#endif
+  straus_fill_cache(scratch, data, 0);
+  return scratch;
+}
+
+static void straus_fill_cache(const std::shared_ptr<straus_cached_data> &cache, const std::vector<MultiexpData> &data, size_t N)
 {
   MULTIEXP_PERF(PERF_TIMER_START_UNIT(multiples, 1000000));
   if (N == 0)
@@ -375,7 +411,6 @@ std::shared_ptr<straus_cached_data> straus_init_cache(const std::vector<Multiexp
   ge_cached cached;
   ge_p1p1 p1;
   ge_p3 p3;
-  std::shared_ptr<straus_cached_data> cache(new straus_cached_data());
 
 #ifdef RAW_MEMORY_BLOCK
   const size_t offset = cache->size;
@@ -427,8 +462,6 @@ std::shared_ptr<straus_cached_data> straus_init_cache(const std::vector<Multiexp
 #endif
 #endif
   MULTIEXP_PERF(PERF_TIMER_STOP(multiples));
-
-  return cache;
 }
 
 size_t straus_get_cache_size(const std::shared_ptr<straus_cached_data> &cache)
@@ -451,7 +484,7 @@ rct::key straus(const std::vector<MultiexpData> &data, const std::shared_ptr<str
 
   MULTIEXP_PERF(PERF_TIMER_START_UNIT(setup, 1000000));
   static constexpr unsigned int mask = (1<<STRAUS_C)-1;
-  std::shared_ptr<straus_cached_data> local_cache = cache == NULL ? straus_init_cache(data) : cache;
+  std::shared_ptr<straus_cached_data> local_cache = cache == NULL ? straus_scratch_cache(data) : cache;
   ge_cached cached;
   ge_p1p1 p1;
   ge_p3 p3;
@@ -465,10 +498,13 @@ rct::key straus(const std::vector<MultiexpData> &data, const std::shared_ptr<str
 #endif
 
   MULTIEXP_PERF(PERF_TIMER_START_UNIT(digits, 1000000));
+  static thread_local std::vector<uint8_t> scratch_digits;
+  std::vector<uint8_t> large_digits;
+  std::vector<uint8_t> &digits = data.size() > STRAUS_SCRATCH_MAX_POINTS ? large_digits : scratch_digits;
 #if STRAUS_C==4
-  std::unique_ptr<uint8_t[]> digits{new uint8_t[64 * data.size()]};
+  digits.resize(64 * data.size());
 #else
-  std::unique_ptr<uint8_t[]> digits{new uint8_t[256 * data.size()]};
+  digits.resize(256 * data.size());
 #endif
   for (size_t j = 0; j < data.size(); ++j)
   {
@@ -580,15 +616,13 @@ struct pippenger_cached_data
   ~pippenger_cached_data() { aligned_free(cached); }
 };
 
-std::shared_ptr<pippenger_cached_data> pippenger_init_cache(const std::vector<MultiexpData> &data, size_t start_offset, size_t N)
+static void pippenger_fill_cache(const std::shared_ptr<pippenger_cached_data> &cache, const std::vector<MultiexpData> &data, size_t start_offset, size_t N)
 {
   MULTIEXP_PERF(PERF_TIMER_START_UNIT(pippenger_init_cache, 1000000));
   CHECK_AND_ASSERT_THROW_MES(start_offset <= data.size(), "Bad cache base data");
   if (N == 0)
     N = data.size() - start_offset;
   CHECK_AND_ASSERT_THROW_MES(N <= data.size() - start_offset, "Bad cache base data");
-  ge_cached cached;
-  std::shared_ptr<pippenger_cached_data> cache(new pippenger_cached_data());
 
   cache->size = N;
   cache->cached = (ge_cached*)aligned_realloc(cache->cached, N * sizeof(ge_cached), 4096);
@@ -597,9 +631,27 @@ std::shared_ptr<pippenger_cached_data> pippenger_init_cache(const std::vector<Mu
     ge_p3_to_cached(&cache->cached[i], &data[i+start_offset].point);
 
   MULTIEXP_PERF(PERF_TIMER_STOP(pippenger_init_cache));
+}
+
+std::shared_ptr<pippenger_cached_data> pippenger_init_cache(const std::vector<MultiexpData> &data, size_t start_offset, size_t N)
+{
+  std::shared_ptr<pippenger_cached_data> cache(new pippenger_cached_data());
+  pippenger_fill_cache(cache, data, start_offset, N);
   return cache;
 }
 
+// there are two slots, as a multiexp may need one for the points past its caller's cache
+static std::shared_ptr<pippenger_cached_data> pippenger_scratch_cache(const std::vector<MultiexpData> &data, size_t start_offset, unsigned slot)
+{
+  static thread_local std::shared_ptr<pippenger_cached_data> scratch[2];
+  if (data.size() - start_offset > PIPPENGER_SCRATCH_MAX_POINTS)
+    return pippenger_init_cache(data, start_offset);
+  if (!scratch[slot])
+    scratch[slot].reset(new pippenger_cached_data());
+  pippenger_fill_cache(scratch[slot], data, start_offset, 0);
+  return scratch[slot];
+}
+
 size_t pippenger_get_cache_size(const std::shared_ptr<pippenger_cached_data> &cache)
 {
   return cache->size * sizeof(*cache->cached);
@@ -616,10 +668,11 @@ rct::key pippenger(const std::vector<MultiexpData> &data, const std::shared_ptr<
 
   ge_p3 result = ge_p3_identity;
   bool result_init = false;
-  std::unique_ptr<ge_p3[]> buckets{new ge_p3[1<<c]};
+  static thread_local std::unique_ptr<ge_p3[]> buckets{new ge_p3[1<<9]};
   bool buckets_init[1<<9];
-  std::shared_ptr<pippenger_cached_data> local_cache = cache == NULL ? pippenger_init_cache(data) : cache;
-  std::shared_ptr<pippenger_cached_data> local_cache_2 = data.size() > cache_size ? pippenger_init_cache(data, cache_size) : NULL;
+  // without a cache, all points are past it, in local_cache_2
+  std::shared_ptr<pippenger_cached_data> local_cache = cache != NULL ? cache : cache_size > 0 ? pippenger_scratch_cache(data, 0, 0) : NULL;
+  std::shared_ptr<pippenger_cached_data> local_cache_2 = data.size() > cache_size ? pippenger_scratch_cache(data, cache_size, 1) : NULL;
 
   rct::key maxscalar = rct::zero();
   for (size_t i = 0; i < data.size(); ++i)
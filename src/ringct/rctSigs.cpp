@@ -46,6 +46,8 @@ using namespace std;
 
 #define CHECK_AND_ASSERT_MES_L1(expr, ret, message) {if(!(expr)) {MCERROR("verify", message); return ret;}}
 
+#define CLSAG_RING_POINTS_CACHE_SIZE 1024
+
 namespace
 {
     rct::Bulletproof make_dummy_bulletproof(const std::vector<uint64_t> &outamounts, rct::keyV &C, rct::keyV &masks)
@@ -827,7 +829,66 @@ namespace rct {
         catch (...) { return false; }
     }
 
-    bool verRctCLSAGSimple(const key &message, const clsag &sig, const ctkeyV & pubs, const key & C_offset) {
+    //Decompressed ring members for CLSAG verification, one array per point
+    //  P[i] = pubs[i].dest, C[i] = pubs[i].mask, Hp[i] = hash_to_p3(pubs[i].dest)
+    //decompress_clsag_ring fills them from a per thread cache of recently seen
+    //  ring members, so outputs shared by several rings are only decompressed once
+    //Internal, as the verification trusts the points to match pubs
+    namespace
+    {
+    struct clsag_ring_points
+    {
+      std::vector<ge_p3> P;
+      std::vector<ge_p3> C;
+      std::vector<ge_p3> Hp;
+    };
+
+    bool decompress_clsag_ring(const ctkeyV &pubs, clsag_ring_points &points) {
+        // Direct mapped on the ring member keys: a colliding member just evicts
+        // the previous one, so an entry is only ever reused for the same keys
+        struct ring_member_points
+        {
+            bool valid;
+            ctkey pubs;
+            ge_p3 P;
+            ge_p3 C;
+            ge_p3 Hp;
+        };
+        static thread_local std::vector<ring_member_points> cache;
+        if (cache.empty())
+        {
+            cache.resize(CLSAG_RING_POINTS_CACHE_SIZE);
+            for (ring_member_points &e: cache)
+                e.valid = false;
+        }
+
+        const size_t n = pubs.size();
+        points.P.resize(n);
+        points.C.resize(n);
+        points.Hp.resize(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            uint64_t dest_bits, mask_bits;
+            memcpy(&dest_bits, pubs[i].dest.bytes, sizeof(dest_bits));
+            memcpy(&mask_bits, pubs[i].mask.bytes, sizeof(mask_bits));
+            ring_member_points &e = cache[(dest_bits ^ mask_bits) % CLSAG_RING_POINTS_CACHE_SIZE];
+            if (!e.valid || !(e.pubs.dest == pubs[i].dest) || !(e.pubs.mask == pubs[i].mask))
+            {
+                e.valid = false;
+                CHECK_AND_ASSERT_MES(ge_frombytes_vartime(&e.P, pubs[i].dest.bytes) == 0, false, "point conv failed");
+                CHECK_AND_ASSERT_MES(ge_frombytes_vartime(&e.C, pubs[i].mask.bytes) == 0, false, "point conv failed");
+                hash_to_p3(e.Hp, pubs[i].dest);
+                e.pubs = pubs[i];
+                e.valid = true;
+            }
+            points.P[i] = e.P;
+            points.C[i] = e.C;
+            points.Hp[i] = e.Hp;
+        }
+        return true;
+    }
+
+    bool verRctCLSAGSimple(const key &message, const clsag &sig, const ctkeyV & pubs, const key & C_offset, const clsag_ring_points &points) {
         try
         {
             PERF_TIMER(verRctCLSAGSimple);
@@ -836,6 +897,7 @@ namespace rct {
             // Check data
             CHECK_AND_ASSERT_MES(n >= 1, false, "Empty pubs");
             CHECK_AND_ASSERT_MES(n == sig.s.size(), false, "Signature scalar vector is the wrong size!");
+            CHECK_AND_ASSERT_MES(n == points.P.size() && n == points.C.size() && n == points.Hp.size(), false, "Ring points are the wrong size!");
             for (size_t i = 0; i < n; ++i)
                 CHECK_AND_ASSERT_MES(sc_check(sig.s[i].bytes) == 0, false, "Bad signature scalar!");
             CHECK_AND_ASSERT_MES(sc_check(sig.c1.bytes) == 0, false, "Bad signature commitment!");
@@ -901,7 +963,6 @@ namespace rct {
             geDsmp C_precomp;
             geDsmp H_precomp;
             size_t i = 0;
-            ge_p3 hash8_p3;
             geDsmp hash_precomp;
             ge_p3 temp_p3;
             ge_p1p1 temp_p1;
@@ -912,10 +973,9 @@ namespace rct {
                 sc_mul(c_c.bytes,mu_C.bytes,c.bytes);
 
                 // Precompute points for L/R
-                precomp(P_precomp.k,pubs[i].dest);
+                ge_dsm_precomp(P_precomp.k,&points.P[i]);
 
-                CHECK_AND_ASSERT_MES(ge_frombytes_vartime(&temp_p3, pubs[i].mask.bytes) == 0, false, "point conv failed");
-                ge_sub(&temp_p1,&temp_p3,&C_offset_cached);
+                ge_sub(&temp_p1,&points.C[i],&C_offset_cached);
                 ge_p1p1_to_p3(&temp_p3,&temp_p1);
                 ge_dsm_precomp(C_precomp.k,&temp_p3);
 
@@ -923,8 +983,7 @@ namespace rct {
                 addKeys_aGbBcC(L,sig.s[i],c_p,P_precomp.k,c_c,C_precomp.k);
 
                 // Compute R
-                hash_to_p3(hash8_p3,pubs[i].dest);
-                ge_dsm_precomp(hash_precomp.k, &hash8_p3);
+                ge_dsm_precomp(hash_precomp.k, &points.Hp[i]);
                 addKeys_aAbBcC(R,sig.s[i],hash_precomp.k,c_p,I_precomp.k,c_c,D_precomp.k);
 
                 c_to_hash[2*n+3] = L;
@@ -940,6 +999,18 @@ namespace rct {
         }
         catch (...) { return false; }
     }
+    }
+
+    bool verRctCLSAGSimple(const key &message, const clsag &sig, const ctkeyV & pubs, const key & C_offset) {
+        try
+        {
+            clsag_ring_points points;
+            if (!decompress_clsag_ring(pubs, points))
+                return false;
+            return verRctCLSAGSimple(message, sig, pubs, C_offset, points);
+        }
+        catch (...) { return false; }
+    }
 
 
     //These functions get keys from blockchain
@@ -40,6 +40,8 @@ using namespace epee;
 #include "common/download.h"
 #include "common/util.h"
 #include "common/perf_timer.h"
+#include "common/trace.h"
+#include "metrics.h"
 #include "int-util.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/account.h"
@@ -160,6 +162,7 @@ namespace cryptonote
     command_line::add_arg(desc, arg_rpc_payment_difficulty);
     command_line::add_arg(desc, arg_rpc_payment_credits);
     command_line::add_arg(desc, arg_rpc_payment_allow_free_loopback);
+    command_line::add_arg(desc, arg_rpc_metrics);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   core_rpc_server::core_rpc_server(
@@ -287,6 +290,8 @@ namespace cryptonote
       }
     }
     disable_rpc_ban = rpc_config->disable_rpc_ban;
+    if (command_line::get_arg(vm, arg_rpc_metrics))
+      epee::metrics::set_enabled(true);
     std::string address = command_line::get_arg(vm, arg_rpc_payment_address);
     if (!address.empty() && allow_rpc_payment)
     {
@@ -419,6 +424,22 @@ namespace cryptonote
   }
 #define CHECK_CORE_READY() do { if(!check_core_ready()){res.status =  CORE_RPC_STATUS_BUSY;return true;} } while(0)
 
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context *ctx)
+  {
+    if (m_restricted || !epee::metrics::is_enabled())
+      return false;
+
+    std::string &s = response_info.m_body;
+    s = epee::metrics::get_exposition();
+    s += "# HELP dinastycoin_height Blockchain height\n# TYPE dinastycoin_height gauge\ndinastycoin_height ";
+    s += std::to_string(m_core.get_current_blockchain_height());
+    s += "\n# HELP dinastycoin_txpool_transactions Transactions in the pool\n# TYPE dinastycoin_txpool_transactions gauge\ndinastycoin_txpool_transactions ";
+    s += std::to_string(m_core.get_pool_transactions_count(true));
+    s += "\n";
+    response_info.m_mime_tipe = "text/plain; version=0.0.4";
+    return true;
+  }
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_height(const COMMAND_RPC_GET_HEIGHT::request& req, COMMAND_RPC_GET_HEIGHT::response& res, const connection_context *ctx)
   {
@@ -588,6 +609,8 @@ namespace cryptonote
         return false;
       }
     }
+    if (req.max_block_count && req.max_block_count < max_blocks)
+      max_blocks = req.max_block_count;
 
     std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > > bs;
     if(!m_core.find_blockchain_supplement(req.start_height, req.block_ids, bs, res.current_height, res.start_height, req.prune, !req.no_miner_tx, max_blocks, COMMAND_RPC_GET_BLOCKS_FAST_MAX_TX_COUNT))
@@ -1506,6 +1529,28 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_set_trace(const COMMAND_RPC_SET_TRACE::request& req, COMMAND_RPC_SET_TRACE::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(set_trace);
+    if (req.clear)
+      tools::clear_trace();
+    tools::set_tracing(req.enable);
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_trace(const COMMAND_RPC_GET_TRACE::request& req, COMMAND_RPC_GET_TRACE::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_trace);
+    res.enabled = tools::is_tracing();
+    for (const tools::trace_span_summary &summary: tools::get_trace_summary())
+      res.spans.push_back({summary.name, summary.count, summary.total_ns, summary.max_ns});
+    if (req.chrome_trace)
+      res.chrome_trace = tools::get_chrome_trace();
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_set_log_categories(const COMMAND_RPC_SET_LOG_CATEGORIES::request& req, COMMAND_RPC_SET_LOG_CATEGORIES::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(set_log_categories);
@@ -1593,6 +1638,28 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_transaction_pool_delta(const COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_transaction_pool_delta);
+    bool r;
+    if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTION_POOL_DELTA>(invoke_http_mode::BIN, "/get_transaction_pool_delta.bin", req, res, r))
+      return r;
+
+    CHECK_PAYMENT(req, res, 1);
+
+    const bool restricted = m_restricted && ctx;
+    const bool request_has_rpc_origin = ctx != NULL;
+    const bool allow_sensitive = !request_has_rpc_origin || !restricted;
+
+    m_core.get_pool_transaction_hashes_since(req.token, res.full, res.added, res.removed, res.token, allow_sensitive);
+    const size_t n_txes = res.added.size() + res.removed.size();
+    if (n_txes > 0)
+      CHECK_PAYMENT_SAME_TS(req, res, n_txes * COST_PER_POOL_HASH);
+
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_transaction_pool_stats(const COMMAND_RPC_GET_TRANSACTION_POOL_STATS::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_STATS::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(get_transaction_pool_stats);
@@ -3490,4 +3557,10 @@ namespace cryptonote
     , "Allow free access from the loopback address (ie, the local host)"
     , false
     };
+
+  const command_line::arg_descriptor<bool> core_rpc_server::arg_rpc_metrics = {
+      "rpc-metrics"
+    , "Serve metrics in the Prometheus text format on /metrics of the unrestricted RPC port, including PERF_TIMER durations (without needing perf log categories)"
+    , false
+    };
 }  // namespace cryptonote
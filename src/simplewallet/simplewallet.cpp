@@ -225,11 +225,11 @@ namespace
   const char* USAGE_SET_DESCRIPTION("set_description [free text note]");
   const char* USAGE_SIGN("sign [<account_index>,<address_index>] [--spend|--view] <filename>");
   const char* USAGE_VERIFY("verify <filename> <address> <signature>");
-  const char* USAGE_EXPORT_KEY_IMAGES("export_key_images [all] <filename>");
+  const char* USAGE_EXPORT_KEY_IMAGES("export_key_images [all] [legacy] <filename>");
   const char* USAGE_IMPORT_KEY_IMAGES("import_key_images <filename>");
   const char* USAGE_HW_KEY_IMAGES_SYNC("hw_key_images_sync");
   const char* USAGE_HW_RECONNECT("hw_reconnect");
-  const char* USAGE_EXPORT_OUTPUTS("export_outputs [all] <filename>");
+  const char* USAGE_EXPORT_OUTPUTS("export_outputs [all] [legacy] <filename>");
   const char* USAGE_IMPORT_OUTPUTS("import_outputs <filename>");
   const char* USAGE_SHOW_TRANSFER("show_transfer <txid>");
   const char* USAGE_MAKE_MULTISIG("make_multisig <threshold> <string1> [<string>...]");
@@ -2889,6 +2889,23 @@ bool simple_wallet::set_credits_target(const std::vector<std::string> &args/* =
   return true;
 }
 
+bool simple_wallet::set_refresh_pipeline_depth(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
+{
+  const auto pwd_container = get_and_verify_password();
+  if (pwd_container)
+  {
+    uint32_t depth;
+    if (!epee::string_tools::get_xtype_from_string(depth, args[1]) || depth == 0)
+    {
+      fail_msg_writer() << tr("Invalid depth");
+      return true;
+    }
+    m_wallet->refresh_pipeline_depth(depth);
+    m_wallet->rewrite(m_wallet_file, pwd_container->password());
+  }
+  return true;
+}
+
 bool simple_wallet::set_key_reuse_mitigation2(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
 {
   const auto pwd_container = get_and_verify_password();
@@ -2997,6 +3014,19 @@ bool simple_wallet::set_track_uses(const std::vector<std::string> &args/* = std:
   return true;
 }
 
+bool simple_wallet::set_cache_journal(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
+{
+  const auto pwd_container = get_and_verify_password();
+  if (pwd_container)
+  {
+    parse_bool_and_use(args[1], [&](bool r) {
+      m_wallet->cache_journal_enabled(r);
+      m_wallet->rewrite(m_wallet_file, pwd_container->password());
+    });
+  }
+  return true;
+}
+
 bool simple_wallet::set_inactivity_lock_timeout(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
 {
 #ifdef _WIN32
@@ -3388,6 +3418,8 @@ simple_wallet::simple_wallet()
                                   "  Ignore outputs of amount below this threshold when spending.\n "
                                   "track-uses <1|0>\n "
                                   "  Whether to keep track of owned outputs uses.\n "
+                                  "cache-journal <1|0>\n "
+                                  "  Whether to append changes to a journal when saving the wallet cache, instead of rewriting the whole cache every time.\n "
                                   "setup-background-mining <1|0>\n "
                                   "  Whether to enable background mining. Set this to support the network and to get a chance to receive new dinastycoin.\n "
                                   "device-name <device_name[:device_spec]>\n "
@@ -3400,6 +3432,8 @@ simple_wallet::simple_wallet()
                                   "  Whether to automatically start mining for RPC payment if the daemon requires it.\n"
                                   "credits-target <unsigned int>\n"
                                   "  The RPC payment credits balance to target (0 for default).\n "
+                                  "refresh-pipeline-depth <unsigned int>\n "
+                                  "  How many spans of blocks to download and parse ahead of the one being scanned when refreshing.\n "
                                   "inactivity-lock-timeout <unsigned int>\n "
                                   "  How many seconds to wait before locking the wallet (0 to disable)."));
   m_cmd_binder.set_handler("encrypted_seed",
@@ -3503,7 +3537,7 @@ simple_wallet::simple_wallet()
   m_cmd_binder.set_handler("export_key_images",
                            boost::bind(&simple_wallet::on_command, this, &simple_wallet::export_key_images, _1),
                            tr(USAGE_EXPORT_KEY_IMAGES),
-                           tr("Export a signed set of key images to a <filename>."));
+                           tr("Export a signed set of key images to a <filename>. With \"legacy\", write the older format, readable by wallets which do not support chunked exports."));
   m_cmd_binder.set_handler("import_key_images",
                            boost::bind(&simple_wallet::on_command, this, &simple_wallet::import_key_images, _1),
                            tr(USAGE_IMPORT_KEY_IMAGES),
@@ -3519,7 +3553,7 @@ simple_wallet::simple_wallet()
   m_cmd_binder.set_handler("export_outputs",
                            boost::bind(&simple_wallet::on_command, this, &simple_wallet::export_outputs, _1),
                            tr(USAGE_EXPORT_OUTPUTS),
-                           tr("Export a set of outputs owned by this wallet."));
+                           tr("Export a set of outputs owned by this wallet. With \"legacy\", write the older format, readable by wallets which do not support chunked exports."));
   m_cmd_binder.set_handler("import_outputs",
                            boost::bind(&simple_wallet::on_command, this, &simple_wallet::import_outputs, _1),
                            tr(USAGE_IMPORT_OUTPUTS),
@@ -3801,6 +3835,7 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     success_msg_writer() << "ignore-outputs-above = " << cryptonote::print_money(m_wallet->ignore_outputs_above());
     success_msg_writer() << "ignore-outputs-below = " << cryptonote::print_money(m_wallet->ignore_outputs_below());
     success_msg_writer() << "track-uses = " << m_wallet->track_uses();
+    success_msg_writer() << "cache-journal = " << m_wallet->cache_journal_enabled();
     success_msg_writer() << "setup-background-mining = " << setup_background_mining_string;
     success_msg_writer() << "device-name = " << m_wallet->device_name();
     success_msg_writer() << "export-format = " << (m_wallet->export_format() == tools::wallet2::ExportFormat::Ascii ? "ascii" : "binary");
@@ -3812,6 +3847,7 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     success_msg_writer() << "persistent-rpc-client-id = " << m_wallet->persistent_rpc_client_id();
     success_msg_writer() << "auto-mine-for-rpc-payment-threshold = " << m_wallet->auto_mine_for_rpc_payment_threshold();
     success_msg_writer() << "credits-target = " << m_wallet->credits_target();
+    success_msg_writer() << "refresh-pipeline-depth = " << m_wallet->refresh_pipeline_depth();
     success_msg_writer() << "load-deprecated-formats = " << m_wallet->load_deprecated_formats();
     return true;
   }
@@ -3870,6 +3906,7 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     CHECK_SIMPLE_VARIABLE("ignore-outputs-above", set_ignore_outputs_above, tr("amount"));
     CHECK_SIMPLE_VARIABLE("ignore-outputs-below", set_ignore_outputs_below, tr("amount"));
     CHECK_SIMPLE_VARIABLE("track-uses", set_track_uses, tr("0 or 1"));
+    CHECK_SIMPLE_VARIABLE("cache-journal", set_cache_journal, tr("0 or 1"));
     CHECK_SIMPLE_VARIABLE("inactivity-lock-timeout", set_inactivity_lock_timeout, tr("unsigned integer (seconds, 0 to disable)"));
     CHECK_SIMPLE_VARIABLE("setup-background-mining", set_setup_background_mining, tr("1/yes or 0/no"));
     CHECK_SIMPLE_VARIABLE("device-name", set_device_name, tr("<device_name[:device_spec]>"));
@@ -3878,6 +3915,7 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     CHECK_SIMPLE_VARIABLE("persistent-rpc-client-id", set_persistent_rpc_client_id, tr("0 or 1"));
     CHECK_SIMPLE_VARIABLE("auto-mine-for-rpc-payment-threshold", set_auto_mine_for_rpc_payment_threshold, tr("floating point >= 0"));
     CHECK_SIMPLE_VARIABLE("credits-target", set_credits_target, tr("unsigned integer"));
+    CHECK_SIMPLE_VARIABLE("refresh-pipeline-depth", set_refresh_pipeline_depth, tr("unsigned integer > 0"));
   }
   fail_msg_writer() << tr("set: unrecognized argument(s)");
   return true;
@@ -10025,6 +10063,13 @@ bool simple_wallet::export_key_images(const std::vector<std::string> &args_)
     args.erase(args.begin());
   }
 
+  bool legacy = false;
+  if (args.size() >= 2 && args[0] == "legacy")
+  {
+    legacy = true;
+    args.erase(args.begin());
+  }
+
   if (args.size() != 1)
   {
     PRINT_USAGE(USAGE_EXPORT_KEY_IMAGES);
@@ -10039,7 +10084,7 @@ bool simple_wallet::export_key_images(const std::vector<std::string> &args_)
 
   try
   {
-    if (!m_wallet->export_key_images(filename, all))
+    if (!m_wallet->export_key_images(filename, all, legacy))
     {
       fail_msg_writer() << tr("failed to save file ") << filename;
       return true;
@@ -10180,6 +10225,13 @@ bool simple_wallet::export_outputs(const std::vector<std::string> &args_)
     args.erase(args.begin());
   }
 
+  bool legacy = false;
+  if (args.size() >= 2 && args[0] == "legacy")
+  {
+    legacy = true;
+    args.erase(args.begin());
+  }
+
   if (args.size() != 1)
   {
     PRINT_USAGE(USAGE_EXPORT_OUTPUTS);
@@ -10194,8 +10246,7 @@ bool simple_wallet::export_outputs(const std::vector<std::string> &args_)
 
   try
   {
-    std::string data = m_wallet->export_outputs_to_str(all);
-    bool r = m_wallet->save_to_file(filename, data);
+    bool r = m_wallet->export_outputs_to_file(filename, all, legacy);
     if (!r)
     {
       fail_msg_writer() << tr("failed to save file ") << filename;
@@ -10227,23 +10278,18 @@ bool simple_wallet::import_outputs(const std::vector<std::string> &args)
   }
   std::string filename = args[0];
 
-  std::string data;
-  bool r = m_wallet->load_from_file(filename, data);
-  if (!r)
-  {
-    fail_msg_writer() << tr("failed to read file ") << filename;
-    return true;
-  }
-
   try
   {
     SCOPED_WALLET_UNLOCK();
-    size_t n_outputs = m_wallet->import_outputs_from_str(data);
+    size_t n_outputs = m_wallet->import_outputs_from_file(filename, &m_import_outputs_cursor);
     success_msg_writer() << boost::lexical_cast<std::string>(n_outputs) << " outputs imported";
   }
   catch (const std::exception &e)
   {
     fail_msg_writer() << "Failed to import outputs " << filename << ": " << e.what();
+    if (m_import_outputs_cursor.next_chunk > 0)
+      fail_msg_writer() << boost::format(tr("%llu outputs were imported before the error, importing the same file again will resume from there"))
+          % (unsigned long long)m_import_outputs_cursor.next_output;
     return true;
   }
 
@@ -1231,8 +1231,7 @@ bool WalletImpl::exportOutputs(const string &filename, bool all)
 
     try
     {
-        std::string data = m_wallet->export_outputs_to_str(all);
-        bool r = m_wallet->save_to_file(filename, data);
+        bool r = m_wallet->export_outputs_to_file(filename, all);
         if (!r)
         {
             LOG_ERROR("Failed to save file " << filename);
@@ -1259,18 +1258,9 @@ bool WalletImpl::importOutputs(const string &filename)
         return false;
     }
 
-    std::string data;
-    bool r = m_wallet->load_from_file(filename, data);
-    if (!r)
-    {
-        LOG_ERROR("Failed to read file: " << filename);
-        setStatusError(string(tr("Failed to read file: ")) + filename);
-        return false;
-    }
-
     try
     {
-        size_t n_outputs = m_wallet->import_outputs_from_str(data);
+        size_t n_outputs = m_wallet->import_outputs_from_file(filename);
         LOG_PRINT_L2(std::to_string(n_outputs) << " outputs imported");
     }
     catch (const std::exception &e)
@@ -0,0 +1,215 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <unordered_map>
+#include "misc_log_ex.h"
+#include "cache_journal.h"
+
+#undef DINASTYCOIN_DEFAULT_LOG_CATEGORY
+#define DINASTYCOIN_DEFAULT_LOG_CATEGORY "wallet.cache_journal"
+
+// chunk sizes are kept between 2 kB and 64 kB, 8 kB on average
+#define CACHE_JOURNAL_MIN_CHUNK_SIZE 2048
+#define CACHE_JOURNAL_MAX_CHUNK_SIZE 65536
+#define CACHE_JOURNAL_CHUNK_MASK 0x1fff
+
+namespace
+{
+  struct gear_table
+  {
+    uint64_t values[256];
+    gear_table()
+    {
+      // splitmix64, with a fixed seed: chunk boundaries must not change between runs
+      uint64_t state = 0x6361636865206a72;
+      for (size_t i = 0; i < 256; ++i)
+      {
+        uint64_t z = (state += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        values[i] = z ^ (z >> 31);
+      }
+    }
+  };
+
+  const gear_table &get_gear_table()
+  {
+    static const gear_table table;
+    return table;
+  }
+
+  crypto::hash get_chunk_hash(const std::string &data, size_t offset, size_t size)
+  {
+    return crypto::cn_fast_hash(data.data() + offset, size);
+  }
+
+  // a cache is identified by its list of chunk hashes, so the data is only hashed once
+  crypto::hash get_chunks_hash(const std::vector<crypto::hash> &chunks)
+  {
+    return crypto::cn_fast_hash(chunks.data(), chunks.size() * sizeof(crypto::hash));
+  }
+}
+
+namespace tools
+{
+
+cache_journal::cache_journal():
+  m_has_base(false),
+  m_base_hash(crypto::null_hash)
+{
+}
+
+std::vector<std::pair<size_t, size_t>> cache_journal::split(const std::string &data)
+{
+  const uint64_t *gear = get_gear_table().values;
+  std::vector<std::pair<size_t, size_t>> chunks;
+  chunks.reserve(data.size() / (CACHE_JOURNAL_CHUNK_MASK + 1) + 1);
+
+  const size_t size = data.size();
+  size_t start = 0;
+  while (start < size)
+  {
+    const size_t max_end = std::min(size, start + CACHE_JOURNAL_MAX_CHUNK_SIZE);
+    size_t end = std::min(size, start + CACHE_JOURNAL_MIN_CHUNK_SIZE);
+    uint64_t h = 0;
+    while (end < max_end)
+    {
+      h = (h << 1) + gear[(unsigned char)data[end++]];
+      if ((h & CACHE_JOURNAL_CHUNK_MASK) == 0)
+        break;
+    }
+    chunks.push_back(std::make_pair(start, end - start));
+    start = end;
+  }
+  return chunks;
+}
+
+void cache_journal::clear()
+{
+  m_has_base = false;
+  m_base_hash = crypto::null_hash;
+  m_chunks.clear();
+}
+
+void cache_journal::reset(const std::string &base_cache)
+{
+  reset(base_cache, split(base_cache));
+}
+
+std::vector<crypto::hash> cache_journal::reset(const std::string &base_cache, const std::vector<std::pair<size_t, size_t>> &chunks)
+{
+  clear();
+  std::vector<crypto::hash> hashes;
+  hashes.reserve(chunks.size());
+  for (const auto &chunk: chunks)
+  {
+    hashes.push_back(get_chunk_hash(base_cache, chunk.first, chunk.second));
+    m_chunks.insert(hashes.back());
+  }
+  m_base_hash = get_chunks_hash(hashes);
+  m_has_base = true;
+  return hashes;
+}
+
+cache_journal_entry cache_journal::make_entry(const std::string &cache)
+{
+  CHECK_AND_ASSERT_THROW_MES(m_has_base, "Cache journal has no base");
+
+  cache_journal_entry entry;
+  entry.base_hash = m_base_hash;
+  const std::vector<std::pair<size_t, size_t>> chunks = split(cache);
+  entry.chunks.reserve(chunks.size());
+  for (const auto &chunk: chunks)
+  {
+    const crypto::hash hash = get_chunk_hash(cache, chunk.first, chunk.second);
+    entry.chunks.push_back(hash);
+    if (m_chunks.insert(hash).second)
+      entry.new_chunks.push_back(cache.substr(chunk.first, chunk.second));
+  }
+  entry.cache_hash = get_chunks_hash(entry.chunks);
+  return entry;
+}
+
+size_t cache_journal::replay(const std::string &base_cache, const std::vector<cache_journal_entry> &entries, std::string &cache, bool &stale)
+{
+  const std::vector<std::pair<size_t, size_t>> base_chunks = split(base_cache);
+  const std::vector<crypto::hash> base_hashes = reset(base_cache, base_chunks);
+  cache = base_cache;
+  stale = false;
+
+  // chunk data is only referenced, not copied, until the final cache is assembled
+  std::unordered_map<crypto::hash, std::pair<const std::string*, std::pair<size_t, size_t>>> data;
+  for (size_t i = 0; i < base_chunks.size(); ++i)
+    data.emplace(base_hashes[i], std::make_pair(&base_cache, base_chunks[i]));
+
+  const cache_journal_entry *latest = NULL;
+  size_t applied = 0;
+  for (const cache_journal_entry &entry: entries)
+  {
+    if (entry.base_hash != m_base_hash)
+    {
+      MDEBUG("Skipping cache journal record for another base cache");
+      stale = true;
+      continue;
+    }
+    for (const std::string &chunk: entry.new_chunks)
+      data.emplace(get_chunk_hash(chunk, 0, chunk.size()), std::make_pair(&chunk, std::make_pair((size_t)0, chunk.size())));
+    latest = &entry;
+    ++applied;
+  }
+  if (!latest)
+    return 0;
+
+  std::string rebuilt;
+  for (const crypto::hash &hash: latest->chunks)
+  {
+    const auto i = data.find(hash);
+    if (i == data.end())
+    {
+      MERROR("Cache journal references a missing chunk, ignoring journal");
+      stale = true;
+      return 0;
+    }
+    rebuilt.append(*i->second.first, i->second.second.first, i->second.second.second);
+  }
+  // chunks are looked up by the hash of their data, so the list hash vouches for the whole cache
+  if (get_chunks_hash(latest->chunks) != latest->cache_hash)
+  {
+    MERROR("Cache journal replay produced an unexpected cache, ignoring journal");
+    stale = true;
+    return 0;
+  }
+
+  for (const crypto::hash &hash: latest->chunks)
+    m_chunks.insert(hash);
+  cache = std::move(rebuilt);
+  return applied;
+}
+
+}
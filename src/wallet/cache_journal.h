@@ -0,0 +1,92 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include "crypto/hash.h"
+#include "serialization/serialization.h"
+#include "serialization/string.h"
+#include "serialization/containers.h"
+#include "serialization/crypto.h"
+
+namespace tools
+{
+  // One append-only record of the wallet cache journal. The cache is cut into
+  // content defined chunks, and a record lists all chunks making up the cache
+  // at the time it was written, but only carries the data of the chunks which
+  // were not already stored in the base cache file or in a previous record.
+  struct cache_journal_entry
+  {
+    // both are hashes of the list of chunk hashes
+    crypto::hash base_hash;
+    crypto::hash cache_hash;
+    std::vector<crypto::hash> chunks;
+    std::vector<std::string> new_chunks;
+
+    BEGIN_SERIALIZE_OBJECT()
+      VERSION_FIELD(0)
+      FIELD(base_hash)
+      FIELD(cache_hash)
+      FIELD(chunks)
+      FIELD(new_chunks)
+    END_SERIALIZE()
+  };
+
+  class cache_journal
+  {
+  public:
+    cache_journal();
+
+    // splits data into content defined chunks, as (offset, size) pairs
+    static std::vector<std::pair<size_t, size_t>> split(const std::string &data);
+
+    // forgets everything and starts over from a freshly compacted cache
+    void reset(const std::string &base_cache);
+    void clear();
+    bool has_base() const { return m_has_base; }
+
+    // builds the record taking the stored state to cache, and marks its chunks as stored
+    cache_journal_entry make_entry(const std::string &cache);
+
+    // rebuilds the latest cache from the base cache and the journal records, skipping
+    // records which do not apply to this base. Returns the number of records applied,
+    // and sets stale if any record could not be applied.
+    size_t replay(const std::string &base_cache, const std::vector<cache_journal_entry> &entries, std::string &cache, bool &stale);
+
+  private:
+    std::vector<crypto::hash> reset(const std::string &base_cache, const std::vector<std::pair<size_t, size_t>> &chunks);
+
+    bool m_has_base;
+    crypto::hash m_base_hash;
+    std::unordered_set<crypto::hash> m_chunks;
+  };
+}
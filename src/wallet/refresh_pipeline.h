@@ -0,0 +1,130 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace tools
+{
+  // Runs a producer on its own thread, up to depth items ahead of the
+  // consumer, and hands the items over in the order they were produced.
+  // The producer blocks when the queue is full, so it gets a thread of its
+  // own rather than a threadpool task, which could end up running inline
+  // on the consuming thread.
+  template<typename T>
+  class refresh_pipeline
+  {
+  public:
+    // fills in the next item, and sets last if no more should follow it.
+    // Returns false if there is no item, which ends the pipeline. Must not
+    // throw: errors are reported in the item itself
+    typedef std::function<bool(T&, bool&)> producer;
+
+    refresh_pipeline(): m_depth(1), m_running(false), m_stop(false) {}
+    ~refresh_pipeline() { stop(); }
+
+    void start(size_t depth, const producer &produce)
+    {
+      stop();
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        m_depth = std::max<size_t>(depth, 1);
+        m_running = true;
+        m_stop = false;
+      }
+      m_thread = boost::thread([this, produce]() {
+        while (true)
+        {
+          T item;
+          bool last = false;
+          if (!produce(item, last))
+            break;
+
+          boost::unique_lock<boost::mutex> lock(m_mutex);
+          while (!m_stop && m_queue.size() >= m_depth)
+            m_cond.wait(lock);
+          if (m_stop)
+            break;
+          m_queue.push_back(std::move(item));
+          m_cond.notify_all();
+          if (last)
+            break;
+        }
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        m_running = false;
+        m_cond.notify_all();
+      });
+    }
+
+    // waits for the next item, returns false once the producer has stopped
+    // and everything it produced was handed over
+    bool next(T &item)
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      while (m_queue.empty() && m_running)
+        m_cond.wait(lock);
+      if (m_queue.empty())
+        return false;
+      item = std::move(m_queue.front());
+      m_queue.pop_front();
+      m_cond.notify_all();
+      return true;
+    }
+
+    // stops the producer once its current item is done, and drops what it queued
+    void stop()
+    {
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        m_stop = true;
+        m_cond.notify_all();
+      }
+      if (m_thread.joinable())
+        m_thread.join();
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      m_queue.clear();
+      m_running = false;
+    }
+
+  private:
+    boost::mutex m_mutex;
+    boost::condition_variable m_cond;
+    std::deque<T> m_queue;
+    size_t m_depth;
+    bool m_running;
+    bool m_stop;
+    boost::thread m_thread;
+  };
+}
@@ -203,6 +203,8 @@ static size_t get_ring_data_size(size_t n_entries)
   return n_entries * (32 + 1024); // highball 1kB for the ring data to make sure
 }
 
+static const size_t MAX_RING_CACHE_SIZE = 65536;
+
 enum { BLACKBALL_BLACKBALL, BLACKBALL_UNBLACKBALL, BLACKBALL_QUERY, BLACKBALL_CLEAR};
 
 namespace tools
@@ -210,7 +212,9 @@ namespace tools
 
 ringdb::ringdb(std::string filename, const std::string &genesis):
   filename(filename),
-  env(NULL)
+  env(NULL),
+  ring_cache_key(crypto::null_hash),
+  ring_cache_txnid(0)
 {
   MDB_txn *txn;
   bool tx_active = false;
@@ -261,19 +265,30 @@ void ringdb::close()
   }
 }
 
-bool ringdb::add_rings(const crypto::chacha_key &chacha_key, const cryptonote::transaction_prefix &tx)
+void ringdb::use_ring_cache(const crypto::chacha_key &chacha_key)
 {
-  MDB_txn *txn;
-  int dbr;
-  bool tx_active = false;
+  crypto::hash key_hash;
+  crypto::cn_fast_hash(chacha_key.data(), chacha_key.size(), key_hash);
+  if (key_hash != ring_cache_key || ring_cache.size() > MAX_RING_CACHE_SIZE)
+  {
+    ring_cache.clear();
+    ring_cache_key = key_hash;
+  }
+}
 
-  dbr = resize_env(env, filename.c_str(), get_ring_data_size(tx.vin.size()));
-  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set env map size");
-  dbr = mdb_txn_begin(env, NULL, 0, &txn);
-  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
-  epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){if (tx_active) mdb_txn_abort(txn);});
-  tx_active = true;
+void ringdb::sync_ring_cache(uint64_t txnid)
+{
+  if (txnid != ring_cache_txnid)
+  {
+    ring_cache.clear();
+    ring_cache_txnid = txnid;
+  }
+}
 
+bool ringdb::add_rings(const crypto::chacha_key &chacha_key, const cryptonote::transaction_prefix &tx)
+{
+  std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> rings;
+  rings.reserve(tx.vin.size());
   for (const auto &in: tx.vin)
   {
     if (in.type() != typeid(cryptonote::txin_to_key))
@@ -283,13 +298,9 @@ bool ringdb::add_rings(const crypto::chacha_key &chacha_key, const cryptonote::t
     if (ring_size == 1)
       continue;
 
-    store_relative_ring(txn, dbi_rings, txin.k_image, txin.key_offsets, chacha_key);
+    rings.push_back(std::make_pair(txin.k_image, txin.key_offsets));
   }
-
-  dbr = mdb_txn_commit(txn);
-  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn adding ring to database: " + std::string(mdb_strerror(dbr)));
-  tx_active = false;
-  return true;
+  return set_rings(chacha_key, rings, true);
 }
 
 bool ringdb::remove_rings(const crypto::chacha_key &chacha_key, const std::vector<crypto::key_image> &key_images)
@@ -305,6 +316,12 @@ bool ringdb::remove_rings(const crypto::chacha_key &chacha_key, const std::vecto
   epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){if (tx_active) mdb_txn_abort(txn);});
   tx_active = true;
 
+  // a write transaction follows the last committed one
+  const uint64_t txnid = mdb_txn_id(txn);
+  use_ring_cache(chacha_key);
+  sync_ring_cache(txnid - 1);
+
+  bool removed = false;
   for (const crypto::key_image &key_image: key_images)
   {
     MDB_val key, data;
@@ -321,11 +338,16 @@ bool ringdb::remove_rings(const crypto::chacha_key &chacha_key, const std::vecto
     MDEBUG("Removing ring data for key image " << key_image);
     dbr = mdb_del(txn, dbi_rings, &key, NULL);
     THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to remove ring to database: " + std::string(mdb_strerror(dbr)));
+    ring_cache.erase(key_image);
+    removed = true;
   }
 
   dbr = mdb_txn_commit(txn);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn removing ring to database: " + std::string(mdb_strerror(dbr)));
   tx_active = false;
+  // a transaction which changed nothing is not committed, and does not get a new id
+  if (removed)
+    ring_cache_txnid = txnid;
   return true;
 }
 
@@ -352,12 +374,26 @@ bool ringdb::get_ring(const crypto::chacha_key &chacha_key, const crypto::key_im
   int dbr;
   bool tx_active = false;
 
+  MDB_envinfo mei;
+  dbr = mdb_env_info(env, &mei);
+  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to get LMDB env info: " + std::string(mdb_strerror(dbr)));
+  use_ring_cache(chacha_key);
+  sync_ring_cache(mei.me_last_txnid);
+  const auto i = ring_cache.find(key_image);
+  if (i != ring_cache.end())
+  {
+    outs = i->second;
+    return true;
+  }
+
   dbr = resize_env(env, filename.c_str(), 0);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set env map size: " + std::string(mdb_strerror(dbr)));
   dbr = mdb_txn_begin(env, NULL, 0, &txn);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
   epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){if (tx_active) mdb_txn_abort(txn);});
   tx_active = true;
+  // this is a write transaction too, but it changes nothing, so its id is not used up
+  sync_ring_cache(mdb_txn_id(txn) - 1);
 
   MDB_val key, data;
   std::string key_ciphertext = encrypt(key_image, chacha_key, 0);
@@ -386,27 +422,44 @@ bool ringdb::get_ring(const crypto::chacha_key &chacha_key, const crypto::key_im
   dbr = mdb_txn_commit(txn);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn getting ring from database: " + std::string(mdb_strerror(dbr)));
   tx_active = false;
+  ring_cache[key_image] = outs;
   return true;
 }
 
 bool ringdb::set_ring(const crypto::chacha_key &chacha_key, const crypto::key_image &key_image, const std::vector<uint64_t> &outs, bool relative)
+{
+  return set_rings(chacha_key, {std::make_pair(key_image, outs)}, relative);
+}
+
+bool ringdb::set_rings(const crypto::chacha_key &chacha_key, const std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> &rings, bool relative)
 {
   MDB_txn *txn;
   int dbr;
   bool tx_active = false;
 
-  dbr = resize_env(env, filename.c_str(), outs.size() * 64);
+  if (rings.empty())
+    return true;
+
+  dbr = resize_env(env, filename.c_str(), get_ring_data_size(rings.size()));
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set env map size: " + std::string(mdb_strerror(dbr)));
   dbr = mdb_txn_begin(env, NULL, 0, &txn);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
   epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){if (tx_active) mdb_txn_abort(txn);});
   tx_active = true;
 
-  store_relative_ring(txn, dbi_rings, key_image, relative ? outs : cryptonote::absolute_output_offsets_to_relative(outs), chacha_key);
+  const uint64_t txnid = mdb_txn_id(txn);
+  use_ring_cache(chacha_key);
+  sync_ring_cache(txnid - 1);
+  for (const auto &ring: rings)
+  {
+    store_relative_ring(txn, dbi_rings, ring.first, relative ? ring.second : cryptonote::absolute_output_offsets_to_relative(ring.second), chacha_key);
+    ring_cache.erase(ring.first);
+  }
 
   dbr = mdb_txn_commit(txn);
-  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn setting ring to database: " + std::string(mdb_strerror(dbr)));
+  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn setting rings to database: " + std::string(mdb_strerror(dbr)));
   tx_active = false;
+  ring_cache_txnid = txnid;
   return true;
 }
 
@@ -30,6 +30,7 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <lmdb.h>
 #include "wipeable_string.h"
 #include "crypto/crypto.h"
@@ -49,6 +50,8 @@ namespace tools
     bool remove_rings(const crypto::chacha_key &chacha_key, const cryptonote::transaction_prefix &tx);
     bool get_ring(const crypto::chacha_key &chacha_key, const crypto::key_image &key_image, std::vector<uint64_t> &outs);
     bool set_ring(const crypto::chacha_key &chacha_key, const crypto::key_image &key_image, const std::vector<uint64_t> &outs, bool relative);
+    // stores all rings in a single database transaction
+    bool set_rings(const crypto::chacha_key &chacha_key, const std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> &rings, bool relative);
 
     bool blackball(const std::pair<uint64_t, uint64_t> &output);
     bool blackball(const std::vector<std::pair<uint64_t, uint64_t>> &outputs);
@@ -58,11 +61,21 @@ namespace tools
 
   private:
     bool blackball_worker(const std::vector<std::pair<uint64_t, uint64_t>> &outputs, int op);
+    void use_ring_cache(const crypto::chacha_key &chacha_key);
+    void sync_ring_cache(uint64_t txnid);
 
   private:
     std::string filename;
     MDB_env *env;
     MDB_dbi dbi_rings;
     MDB_dbi dbi_blackballs;
+
+    // absolute rings read or written through this object, valid for ring_cache_key
+    // only, and as of LMDB transaction ring_cache_txnid. Other processes (or other
+    // ringdb objects) may share the database, so the cache is dropped whenever the
+    // last committed transaction is not that one
+    std::unordered_map<crypto::key_image, std::vector<uint64_t>> ring_cache;
+    crypto::hash ring_cache_key;
+    uint64_t ring_cache_txnid;
   };
 }
@@ -0,0 +1,151 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "misc_log_ex.h"
+#include "shared_block_cache.h"
+
+#undef DINASTYCOIN_DEFAULT_LOG_CATEGORY
+#define DINASTYCOIN_DEFAULT_LOG_CATEGORY "wallet.block_cache"
+
+namespace tools
+{
+  //----------------------------------------------------------------------------------------------------
+  shared_block_cache::shared_block_cache(size_t max_size, uint64_t max_age):
+    m_max_size(max_size),
+    m_max_age(max_age),
+    m_size(0),
+    m_hits(0),
+    m_misses(0)
+  {
+  }
+  //----------------------------------------------------------------------------------------------------
+  crypto::hash shared_block_cache::make_key(const std::string &daemon_address, cryptonote::network_type nettype, uint64_t start_height, const std::list<crypto::hash> &short_chain_history, bool no_miner_tx)
+  {
+    const uint8_t net = nettype;
+    std::string data;
+    data.reserve(daemon_address.size() + 2 + sizeof(start_height) + 1 + short_chain_history.size() * sizeof(crypto::hash));
+    data.append(daemon_address);
+    data.push_back(0);
+    data.push_back(net);
+    data.append((const char*)&start_height, sizeof(start_height));
+    data.push_back(no_miner_tx ? 1 : 0);
+    for (const crypto::hash &h: short_chain_history)
+      data.append((const char*)&h, sizeof(h));
+    return crypto::cn_fast_hash(data.data(), data.size());
+  }
+  //----------------------------------------------------------------------------------------------------
+  size_t shared_block_cache::get_entry_size(const entry &e)
+  {
+    // blobs, plus about as much again for their parsed form
+    size_t size = 0;
+    for (const cryptonote::block_complete_entry &bce: *e.blocks)
+    {
+      size += bce.block.size();
+      for (const cryptonote::tx_blob_entry &tx: bce.txs)
+        size += tx.blob.size();
+    }
+    return size * 2;
+  }
+  //----------------------------------------------------------------------------------------------------
+  std::shared_ptr<const shared_block_cache::entry> shared_block_cache::find(const crypto::hash &key)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    prune(time(NULL));
+    auto i = m_entries.find(key);
+    if (i == m_entries.end())
+    {
+      ++m_misses;
+      return NULL;
+    }
+    ++m_hits;
+    return i->second.e;
+  }
+  //----------------------------------------------------------------------------------------------------
+  void shared_block_cache::add(const crypto::hash &key, const std::shared_ptr<const entry> &e)
+  {
+    const size_t size = get_entry_size(*e);
+    if (size > m_max_size)
+      return;
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    auto i = m_entries.find(key);
+    if (i != m_entries.end())
+      return;
+    m_entries[key] = {e, size, time(NULL)};
+    m_order.push_back(key);
+    m_size += size;
+    prune(time(NULL));
+  }
+  //----------------------------------------------------------------------------------------------------
+  void shared_block_cache::clear()
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_order.clear();
+    m_size = 0;
+  }
+  //----------------------------------------------------------------------------------------------------
+  size_t shared_block_cache::size() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    return m_size;
+  }
+  //----------------------------------------------------------------------------------------------------
+  uint64_t shared_block_cache::get_hits() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    return m_hits;
+  }
+  //----------------------------------------------------------------------------------------------------
+  uint64_t shared_block_cache::get_misses() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    return m_misses;
+  }
+  //----------------------------------------------------------------------------------------------------
+  void shared_block_cache::prune(time_t now)
+  {
+    // entries are dropped oldest first, when too old or when over the size limit
+    while (!m_order.empty())
+    {
+      auto i = m_entries.find(m_order.front());
+      if (i == m_entries.end())
+      {
+        m_order.pop_front();
+        continue;
+      }
+      const bool expired = (uint64_t)(now - i->second.added) > m_max_age;
+      if (!expired && m_size <= m_max_size)
+        break;
+      MDEBUG("Dropping cached blocks from height " << i->second.e->blocks_start_height << (expired ? " (expired)" : " (cache full)"));
+      m_size -= i->second.size;
+      m_entries.erase(i);
+      m_order.pop_front();
+    }
+  }
+}
@@ -0,0 +1,92 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <deque>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+#include "crypto/hash.h"
+#include "wallet2.h"
+
+namespace tools
+{
+  // Recent getblocks.bin answers, already parsed, shared between the wallets
+  // of one process: when several wallets refresh from the same point against
+  // the same daemon, the blocks are downloaded and deserialized only once.
+  class shared_block_cache
+  {
+  public:
+    struct entry
+    {
+      uint64_t blocks_start_height;
+      uint64_t current_height;
+      wallet2::shared_blocks blocks;
+      wallet2::shared_parsed_blocks parsed_blocks;
+    };
+
+    shared_block_cache(size_t max_size = DEFAULT_MAX_SIZE, uint64_t max_age = DEFAULT_MAX_AGE);
+
+    // the daemon answer only depends on these, so wallets sharing them share the answer
+    static crypto::hash make_key(const std::string &daemon_address, cryptonote::network_type nettype, uint64_t start_height, const std::list<crypto::hash> &short_chain_history, bool no_miner_tx);
+    static size_t get_entry_size(const entry &e);
+
+    std::shared_ptr<const entry> find(const crypto::hash &key);
+    void add(const crypto::hash &key, const std::shared_ptr<const entry> &e);
+    void clear();
+
+    size_t size() const;
+    uint64_t get_hits() const;
+    uint64_t get_misses() const;
+
+    static const size_t DEFAULT_MAX_SIZE = 64 * 1024 * 1024;
+    static const uint64_t DEFAULT_MAX_AGE = 60; // seconds
+
+  private:
+    struct slot
+    {
+      std::shared_ptr<const entry> e;
+      size_t size;
+      time_t added;
+    };
+
+    void prune(time_t now);
+
+    mutable boost::mutex m_mutex;
+    std::unordered_map<crypto::hash, slot> m_entries;
+    std::deque<crypto::hash> m_order;
+    size_t m_max_size;
+    uint64_t m_max_age;
+    size_t m_size;
+    uint64_t m_hits;
+    uint64_t m_misses;
+  };
+}
@@ -30,6 +30,7 @@
 
 #include <numeric>
 #include <tuple>
+#include <deque>
 #include <boost/format.hpp>
 #include <boost/optional/optional.hpp>
 #include <boost/algorithm/string/classification.hpp>
@@ -39,8 +40,11 @@
 #include <boost/asio/ip/address.hpp>
 #include <boost/range/adaptor/transformed.hpp>
 #include <boost/preprocessor/stringize.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <openssl/evp.h>
 #include "include_base_utils.h"
+#include "file_io_utils.h"
 using namespace epee;
 
 #include "cryptonote_config.h"
@@ -81,6 +85,8 @@ using namespace epee;
 #include "common/perf_timer.h"
 #include "ringct/rctSigs.h"
 #include "ringdb.h"
+#include "shared_block_cache.h"
+#include "refresh_pipeline.h"
 #include "device/device_cold.hpp"
 #include "device_trezor/device_trezor.hpp"
 #include "net/socks_connect.h"
@@ -119,11 +125,16 @@ using namespace cryptonote;
 #define SUBADDRESS_LOOKAHEAD_MAJOR 50
 #define SUBADDRESS_LOOKAHEAD_MINOR 200
 
-#define KEY_IMAGE_EXPORT_FILE_MAGIC "Dinastycoin key image export\003"
+#define KEY_IMAGE_EXPORT_FILE_MAGIC "Dinastycoin key image export\004"
+#define KEY_IMAGE_EXPORT_FILE_MAGIC_V3 "Dinastycoin key image export\003"
 
 #define MULTISIG_EXPORT_FILE_MAGIC "Dinastycoin multisig export\001"
 
-#define OUTPUT_EXPORT_FILE_MAGIC "Dinastycoin output export\004"
+#define OUTPUT_EXPORT_FILE_MAGIC "Dinastycoin output export\005"
+#define OUTPUT_EXPORT_FILE_MAGIC_V4 "Dinastycoin output export\004"
+
+#define EXPORT_CHUNK_SIZE 1024 // key images or outputs per encrypted chunk
+#define EXPORT_CHUNK_BATCH 16 // chunks built or read at a time when streaming an export
 
 #define SEGREGATION_FORK_HEIGHT 99999999
 #define TESTNET_SEGREGATION_FORK_HEIGHT 99999999
@@ -132,6 +143,12 @@ using namespace cryptonote;
 
 #define FIRST_REFRESH_GRANULARITY     1024
 
+#define DEFAULT_REFRESH_PIPELINE_DEPTH 2
+#define REFRESH_SPAN_INITIAL_BLOCKS 100
+#define REFRESH_SPAN_MIN_BLOCKS 20
+#define REFRESH_SPAN_MAX_BYTES (16 * 1024 * 1024) // per span, up to pipeline depth of them are held at once
+#define REFRESH_SPAN_TARGET_MS 2000
+
 #define GAMMA_SHAPE 19.28
 #define GAMMA_SCALE (1/1.61)
 
@@ -785,6 +802,19 @@ std::string strjoin(const std::vector<size_t> &V, const char *sep)
   return ss.str();
 }
 
+static void get_tx_rings(const cryptonote::transaction_prefix &tx, std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> &rings)
+{
+  for (const auto &in: tx.vin)
+  {
+    if (in.type() != typeid(cryptonote::txin_to_key))
+      continue;
+    const auto &txin = boost::get<cryptonote::txin_to_key>(in);
+    if (txin.key_offsets.size() == 1)
+      continue;
+    rings.push_back(std::make_pair(txin.k_image, txin.key_offsets));
+  }
+}
+
 static bool emplace_or_replace(std::unordered_multimap<crypto::hash, tools::wallet2::pool_payment_details> &container,
   const crypto::hash &key, const tools::wallet2::pool_payment_details &pd)
 {
@@ -1203,6 +1233,7 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, std
   m_ignore_outputs_above(MONEY_SUPPLY),
   m_ignore_outputs_below(0),
   m_track_uses(false),
+  m_cache_journal_enabled(false),
   m_inactivity_lock_timeout(DEFAULT_INACTIVITY_LOCK_TIMEOUT),
   m_setup_background_mining(BackgroundMiningMaybe),
   m_persistent_rpc_client_id(false),
@@ -1228,6 +1259,7 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, std
   m_key_device_type(hw::device::device_type::SOFTWARE),
   m_ring_history_saved(false),
   m_ringdb(),
+  m_defer_rings(false),
   m_last_block_reward(0),
   m_unattended(unattended),
   m_devices_registered(false),
@@ -1237,7 +1269,14 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, std
   m_rpc_version(0),
   m_export_format(ExportFormat::Binary),
   m_load_deprecated_formats(false),
-  m_credits_target(0)
+  m_credits_target(0),
+  m_refresh_pipeline_depth(DEFAULT_REFRESH_PIPELINE_DEPTH),
+  m_refresh_span_blocks(REFRESH_SPAN_INITIAL_BLOCKS),
+  m_refresh_bytes_per_block(0),
+  m_pool_token(0),
+  m_cache_journal_base_size(0),
+  m_cache_journal_size(0),
+  m_cache_journal_compact(false)
 {
   set_rpc_client_secret_key(rct::rct2sk(rct::skGen()));
 }
@@ -2150,6 +2189,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 	    td.m_internal_output_index = o;
 	    td.m_global_output_index = o_indices[o];
 	    td.m_tx = (const cryptonote::transaction_prefix&)tx;
+	    td.compact_tx();
 	    td.m_txid = txid;
             td.m_key_image = tx_scan_info[o].ki;
             td.m_key_image_known = !m_watch_only && !m_multisig;
@@ -2251,6 +2291,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 	    td.m_internal_output_index = o;
 	    td.m_global_output_index = o_indices[o];
 	    td.m_tx = (const cryptonote::transaction_prefix&)tx;
+	    td.compact_tx();
 	    td.m_txid = txid;
             td.m_amount = amount;
             td.m_pk_index = pk_index - 1;
@@ -2491,7 +2532,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           m_callback->on_unconfirmed_money_received(height, txid, tx, payment.m_amount, payment.m_subaddr_index);
       }
       else
-        m_payments.emplace(payment_id, payment);
+        index_payment(*m_payments.emplace(payment_id, payment));
       LOG_PRINT_L2("Payment found in " << (pool ? "pool" : "block") << ": " << payment_id << " / " << payment.m_tx_hash << " / " << payment.m_amount);
     }
 
@@ -2517,7 +2558,9 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
   if(unconf_it != m_unconfirmed_txs.end()) {
     if (store_tx_info()) {
       try {
-        m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+        const auto inserted = m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+        if (inserted.second)
+          index_confirmed_tx(*inserted.first);
       }
       catch (...) {
         // can fail if the tx has unexpected input types
@@ -2531,6 +2574,8 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
 void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::transaction &tx, uint64_t height, uint64_t ts, uint64_t spent, uint64_t received, uint32_t subaddr_account, const std::set<uint32_t>& subaddr_indices)
 {
   std::pair<std::unordered_map<crypto::hash, confirmed_transfer_details>::iterator, bool> entry = m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details()));
+  if (!entry.second)
+    unindex_confirmed_tx(*entry.first);
   // fill with the info we know, some info might already be there
   if (entry.second)
   {
@@ -2567,8 +2612,13 @@ void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::trans
   entry.first->second.m_block_height = height;
   entry.first->second.m_timestamp = ts;
   entry.first->second.m_unlock_time = tx.unlock_time;
+  index_confirmed_tx(*entry.first);
 
-  add_rings(tx);
+  // written all at once when the whole batch of blocks is processed
+  if (m_defer_rings)
+    get_tx_rings(tx, m_deferred_rings);
+  else
+    add_rings(tx);
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::should_skip_block(const cryptonote::block &b, uint64_t height) const
@@ -2664,7 +2714,9 @@ void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height,
   req.prune = true;
   req.start_height = start_height;
   req.no_miner_tx = m_refresh_type == RefreshNoCoinbase;
+  req.max_block_count = m_refresh_span_blocks;
 
+  const auto pull_start = std::chrono::steady_clock::now();
   {
     const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
     uint64_t pre_call_credits = m_rpc_payment_state.credits;
@@ -2677,13 +2729,48 @@ void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height,
     check_rpc_cost("/getblocks.bin", res.credits, pre_call_credits, 1 + res.blocks.size() * COST_PER_BLOCK);
   }
 
+  const uint64_t elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - pull_start).count();
+  uint64_t n_bytes = 0;
+  for (const auto &b: res.blocks)
+  {
+    n_bytes += b.block.size();
+    for (const auto &tx: b.txs)
+      n_bytes += tx.blob.size();
+  }
+  update_refresh_span(res.blocks.size(), n_bytes, elapsed_ms);
+
   blocks_start_height = res.start_height;
   blocks = std::move(res.blocks);
   o_indices = std::move(res.output_indices);
   current_height = res.current_height;
 
   MDEBUG("Pulled blocks: blocks_start_height " << blocks_start_height << ", count " << blocks.size()
-      << ", height " << blocks_start_height + blocks.size() << ", node height " << res.current_height);
+      << ", height " << blocks_start_height + blocks.size() << ", node height " << res.current_height
+      << ", " << n_bytes << " bytes in " << elapsed_ms << " ms");
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::update_refresh_span(size_t n_blocks, uint64_t n_bytes, uint64_t elapsed_ms)
+{
+  if (n_blocks == 0)
+    return;
+
+  const uint64_t bytes_per_block = n_bytes / n_blocks;
+  m_refresh_bytes_per_block = m_refresh_bytes_per_block ? (3 * m_refresh_bytes_per_block + bytes_per_block) / 4 : bytes_per_block;
+
+  // a full span that came back quickly means the round trip dominates, so ask
+  // for more per call; a slow one means we're bandwidth bound and the scan
+  // would wait on it, so ask for less
+  uint64_t span = m_refresh_span_blocks;
+  if (n_blocks >= span && elapsed_ms < REFRESH_SPAN_TARGET_MS)
+    span *= 2;
+  else if (elapsed_ms > 2 * REFRESH_SPAN_TARGET_MS)
+    span /= 2;
+
+  // keep the memory held by the pipeline bounded for dense blocks
+  const uint64_t max_span = std::min<uint64_t>(COMMAND_RPC_GET_BLOCKS_FAST_MAX_BLOCK_COUNT,
+      std::max<uint64_t>(REFRESH_SPAN_MAX_BYTES / std::max<uint64_t>(m_refresh_bytes_per_block, 1), REFRESH_SPAN_MIN_BLOCKS));
+  m_refresh_span_blocks = std::max<uint64_t>(std::min(span, max_span), REFRESH_SPAN_MIN_BLOCKS);
+  MDEBUG("Refresh span now " << m_refresh_span_blocks << " blocks, " << m_refresh_bytes_per_block << " bytes per block");
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes)
@@ -2740,6 +2827,14 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
 
   THROW_WALLET_EXCEPTION_IF(blocks.size() != parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
   THROW_WALLET_EXCEPTION_IF(!m_blockchain.is_in_bounds(current_index), error::out_of_hashchain_bounds_error);
+
+  m_defer_rings = true;
+  auto rings_flusher = epee::misc_utils::create_scope_leave_handler([this](){
+    m_defer_rings = false;
+    if (!m_deferred_rings.empty() && !set_rings(m_deferred_rings, true))
+      MERROR("Failed to save rings for " << m_deferred_rings.size() << " inputs");
+    m_deferred_rings.clear();
+  });
   //added by kgc
   force_confirm_genesis_block(start_height,output_tracker_cache);
   //end
@@ -2894,58 +2989,76 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   refresh(trusted_daemon, start_height, blocks_fetched, received_money);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception)
+void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<crypto::hash> &prev_block_hashes, shared_blocks &blocks, shared_parsed_blocks &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception)
 {
   error = false;
   last = false;
   exception = NULL;
+  blocks.reset();
+  parsed_blocks.reset();
+  std::vector<cryptonote::block_complete_entry> new_blocks;
+  std::vector<parsed_block> new_parsed_blocks;
 
   try
   {
     drop_from_short_history(short_chain_history, 3);
 
-    THROW_WALLET_EXCEPTION_IF(prev_blocks.size() != prev_parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
-
     // prepend the last 3 blocks, should be enough to guard against a block or two's reorg
-    auto s = std::next(prev_parsed_blocks.rbegin(), std::min((size_t)3, prev_parsed_blocks.size())).base();
-    for (; s != prev_parsed_blocks.end(); ++s)
+    for (const crypto::hash &hash: prev_block_hashes)
+    {
+      short_chain_history.push_front(hash);
+    }
+
+    // another wallet of this process may already have pulled and parsed these
+    crypto::hash cache_key = crypto::null_hash;
+    if (m_shared_block_cache)
     {
-      short_chain_history.push_front(s->hash);
+      cache_key = shared_block_cache::make_key(get_daemon_address(), m_nettype, start_height, short_chain_history, m_refresh_type == RefreshNoCoinbase);
+      std::shared_ptr<const shared_block_cache::entry> cached = m_shared_block_cache->find(cache_key);
+      if (cached)
+      {
+        MDEBUG("Using shared blocks: blocks_start_height " << cached->blocks_start_height << ", count " << cached->blocks->size());
+        blocks_start_height = cached->blocks_start_height;
+        blocks = cached->blocks;
+        parsed_blocks = cached->parsed_blocks;
+        last = !blocks->empty() && cryptonote::get_block_height(parsed_blocks->back().block) + 1 == cached->current_height;
+        return;
+      }
     }
 
     // pull the new blocks
     std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> o_indices;
     uint64_t current_height;
-    pull_blocks(start_height, blocks_start_height, short_chain_history, blocks, o_indices, current_height);
-    THROW_WALLET_EXCEPTION_IF(blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
+    pull_blocks(start_height, blocks_start_height, short_chain_history, new_blocks, o_indices, current_height);
+    THROW_WALLET_EXCEPTION_IF(new_blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
 
     tools::threadpool& tpool = tools::threadpool::getInstance();
     tools::threadpool::waiter waiter(tpool);
-    parsed_blocks.resize(blocks.size());
-    for (size_t i = 0; i < blocks.size(); ++i)
+    new_parsed_blocks.resize(new_blocks.size());
+    for (size_t i = 0; i < new_blocks.size(); ++i)
     {
-      tpool.submit(&waiter, boost::bind(&wallet2::parse_block_round, this, std::cref(blocks[i].block),
-        std::ref(parsed_blocks[i].block), std::ref(parsed_blocks[i].hash), std::ref(parsed_blocks[i].error)), true);
+      tpool.submit(&waiter, boost::bind(&wallet2::parse_block_round, this, std::cref(new_blocks[i].block),
+        std::ref(new_parsed_blocks[i].block), std::ref(new_parsed_blocks[i].hash), std::ref(new_parsed_blocks[i].error)), true);
     }
     THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
-    for (size_t i = 0; i < blocks.size(); ++i)
+    for (size_t i = 0; i < new_blocks.size(); ++i)
     {
-      if (parsed_blocks[i].error)
+      if (new_parsed_blocks[i].error)
       {
         error = true;
         break;
       }
-      parsed_blocks[i].o_indices = std::move(o_indices[i]);
+      new_parsed_blocks[i].o_indices = std::move(o_indices[i]);
     }
 
     boost::mutex error_lock;
-    for (size_t i = 0; i < blocks.size(); ++i)
+    for (size_t i = 0; i < new_blocks.size(); ++i)
     {
-      parsed_blocks[i].txes.resize(blocks[i].txs.size());
-      for (size_t j = 0; j < blocks[i].txs.size(); ++j)
+      new_parsed_blocks[i].txes.resize(new_blocks[i].txs.size());
+      for (size_t j = 0; j < new_blocks[i].txs.size(); ++j)
       {
         tpool.submit(&waiter, [&, i, j](){
-          if (!parse_and_validate_tx_base_from_blob(blocks[i].txs[j].blob, parsed_blocks[i].txes[j]))
+          if (!parse_and_validate_tx_base_from_blob(new_blocks[i].txs[j].blob, new_parsed_blocks[i].txes[j]))
           {
             boost::unique_lock<boost::mutex> lock(error_lock);
             error = true;
@@ -2954,13 +3067,31 @@ void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks
       }
     }
     THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
-    last = !blocks.empty() && cryptonote::get_block_height(parsed_blocks.back().block) + 1 == current_height;
+    last = !new_blocks.empty() && cryptonote::get_block_height(new_parsed_blocks.back().block) + 1 == current_height;
+    blocks = std::make_shared<const std::vector<cryptonote::block_complete_entry>>(std::move(new_blocks));
+    parsed_blocks = std::make_shared<const std::vector<parsed_block>>(std::move(new_parsed_blocks));
+
+    if (m_shared_block_cache && !error)
+    {
+      std::shared_ptr<shared_block_cache::entry> entry = std::make_shared<shared_block_cache::entry>();
+      entry->blocks_start_height = blocks_start_height;
+      entry->current_height = current_height;
+      entry->blocks = blocks;
+      entry->parsed_blocks = parsed_blocks;
+      m_shared_block_cache->add(cache_key, entry);
+    }
   }
   catch(...)
   {
     error = true;
     exception = std::current_exception();
   }
+
+  // callers look at what was pulled even on error
+  if (!blocks)
+    blocks = std::make_shared<const std::vector<cryptonote::block_complete_entry>>(std::move(new_blocks));
+  if (!parsed_blocks)
+    parsed_blocks = std::make_shared<const std::vector<parsed_block>>(std::move(new_parsed_blocks));
 }
 
 void wallet2::remove_obsolete_pool_txs(const std::vector<crypto::hash> &tx_hashes)
@@ -2990,6 +3121,46 @@ void wallet2::remove_obsolete_pool_txs(const std::vector<crypto::hash> &tx_hashe
   }
 }
 
+//----------------------------------------------------------------------------------------------------
+void wallet2::pull_pool_hashes(std::vector<crypto::hash> &tx_hashes)
+{
+  const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
+  uint64_t pre_call_credits = m_rpc_payment_state.credits;
+
+  if (m_rpc_version < MAKE_CORE_RPC_VERSION(3, 11))
+  {
+    cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::request req;
+    cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::response res;
+    req.client = get_client_signature();
+    bool r = epee::net_utils::invoke_http_json("/get_transaction_pool_hashes.bin", req, res, *m_http_client, rpc_timeout);
+    THROW_ON_RPC_RESPONSE_ERROR(r, {}, res, "get_transaction_pool_hashes.bin", error::get_tx_pool_error);
+    check_rpc_cost("/get_transaction_pool_hashes.bin", res.credits, pre_call_credits, 1 + res.tx_hashes.size() * COST_PER_POOL_HASH);
+    tx_hashes = std::move(res.tx_hashes);
+    m_pool_tx_hashes.clear();
+    m_pool_token = 0;
+    return;
+  }
+
+  // only ask for what changed since last time, the daemon sends the whole
+  // pool if it can't tell (eg, it restarted or we're too far behind)
+  cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::request req;
+  cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response res;
+  req.token = m_pool_token;
+  req.client = get_client_signature();
+  bool r = epee::net_utils::invoke_http_bin("/get_transaction_pool_delta.bin", req, res, *m_http_client, rpc_timeout);
+  THROW_ON_RPC_RESPONSE_ERROR(r, {}, res, "get_transaction_pool_delta.bin", error::get_tx_pool_error);
+  check_rpc_cost("/get_transaction_pool_delta.bin", res.credits, pre_call_credits, 1 + (res.added.size() + res.removed.size()) * COST_PER_POOL_HASH);
+
+  if (res.full)
+    m_pool_tx_hashes.clear();
+  for (const crypto::hash &txid: res.removed)
+    m_pool_tx_hashes.erase(txid);
+  m_pool_tx_hashes.insert(res.added.begin(), res.added.end());
+  m_pool_token = res.token;
+  MDEBUG("Pool delta: " << (res.full ? "full, " : "") << res.added.size() << " added, " << res.removed.size() << " removed, " << m_pool_tx_hashes.size() << " in pool");
+
+  tx_hashes.assign(m_pool_tx_hashes.begin(), m_pool_tx_hashes.end());
+}
 //----------------------------------------------------------------------------------------------------
 void wallet2::update_pool_state(std::vector<std::tuple<cryptonote::transaction, crypto::hash, bool>> &process_txs, bool refreshed)
 {
@@ -3000,17 +3171,9 @@ void wallet2::update_pool_state(std::vector<std::tuple<cryptonote::transaction,
   });
 
   // get the pool state
-  cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::request req;
-  cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::response res;
-
-  {
-    const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
-    uint64_t pre_call_credits = m_rpc_payment_state.credits;
-    req.client = get_client_signature();
-    bool r = epee::net_utils::invoke_http_json("/get_transaction_pool_hashes.bin", req, res, *m_http_client, rpc_timeout);
-    THROW_ON_RPC_RESPONSE_ERROR(r, {}, res, "get_transaction_pool_hashes.bin", error::get_tx_pool_error);
-    check_rpc_cost("/get_transaction_pool_hashes.bin", res.credits, pre_call_credits, 1 + res.tx_hashes.size() * COST_PER_POOL_HASH);
-  }
+  std::vector<crypto::hash> tx_hashes;
+  pull_pool_hashes(tx_hashes);
+  const std::unordered_set<crypto::hash> tx_hashes_set(tx_hashes.begin(), tx_hashes.end());
   MTRACE("update_pool_state got pool");
 
   // remove any pending tx that's not in the pool
@@ -3021,15 +3184,7 @@ void wallet2::update_pool_state(std::vector<std::tuple<cryptonote::transaction,
   while (it != m_unconfirmed_txs.end())
   {
     const crypto::hash &txid = it->first;
-    bool found = false;
-    for (const auto &it2: res.tx_hashes)
-    {
-      if (it2 == txid)
-      {
-        found = true;
-        break;
-      }
-    }
+    const bool found = tx_hashes_set.find(txid) != tx_hashes_set.end();
     auto pit = it++;
     if (!found)
     {
@@ -3079,13 +3234,13 @@ void wallet2::update_pool_state(std::vector<std::tuple<cryptonote::transaction,
   // the in transfers list instead (or nowhere if it just
   // disappeared without being mined)
   if (refreshed)
-    remove_obsolete_pool_txs(res.tx_hashes);
+    remove_obsolete_pool_txs(tx_hashes);
 
   MTRACE("update_pool_state done second loop");
 
   // gather txids of new pool txes to us
   std::vector<std::pair<crypto::hash, bool>> txids;
-  for (const auto &txid: res.tx_hashes)
+  for (const auto &txid: tx_hashes)
   {
     bool txid_found_in_up = false;
     for (const auto &up: m_unconfirmed_payments)
@@ -3395,11 +3550,9 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   size_t try_count = 0;
   crypto::hash last_tx_hash_id = m_transfers.size() ? m_transfers.back().m_txid : null_hash;
   std::list<crypto::hash> short_chain_history;
-  tools::threadpool& tpool = tools::threadpool::getInstance();
-  tools::threadpool::waiter waiter(tpool);
   uint64_t blocks_start_height;
-  std::vector<cryptonote::block_complete_entry> blocks;
-  std::vector<parsed_block> parsed_blocks;
+  shared_blocks blocks = std::make_shared<const std::vector<cryptonote::block_complete_entry>>();
+  shared_parsed_blocks parsed_blocks = std::make_shared<const std::vector<parsed_block>>();
   bool refreshed = false;
   std::shared_ptr<std::map<std::pair<uint64_t, uint64_t>, size_t>> output_tracker_cache;
   hw::device &hwdev = m_account.get_device();
@@ -3439,40 +3592,66 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   std::vector<std::tuple<cryptonote::transaction, crypto::hash, bool>> process_pool_txs;
   update_pool_state(process_pool_txs, true);
 
-  bool first = true, last = false;
-  while(m_run.load(std::memory_order_relaxed))
+  // spans are pulled and parsed by a producer thread, up to m_refresh_pipeline_depth
+  // ahead of the one being scanned. Each pull only needs the hashes of the end
+  // of the previous span, so the producer doesn't wait on the scan
+  struct refresh_span
   {
-    uint64_t next_blocks_start_height;
-    std::vector<cryptonote::block_complete_entry> next_blocks;
-    std::vector<parsed_block> next_parsed_blocks;
+    uint64_t blocks_start_height;
+    shared_blocks blocks;
+    shared_parsed_blocks parsed_blocks;
+    bool last;
     bool error;
     std::exception_ptr exception;
+  };
+  refresh_pipeline<refresh_span> pipeline;
+  auto start_pipeline = [&]() {
+    std::vector<crypto::hash> prev_block_hashes;
+    uint64_t prev_blocks_start_height = std::numeric_limits<uint64_t>::max();
+    pipeline.start(m_refresh_pipeline_depth, [&, prev_block_hashes, prev_blocks_start_height](refresh_span &span, bool &done) mutable {
+      if (!m_run.load(std::memory_order_relaxed))
+        return false;
+      span.blocks_start_height = 0;
+      pull_and_parse_next_blocks(start_height, span.blocks_start_height, short_chain_history, prev_block_hashes, span.blocks, span.parsed_blocks, span.last, span.error, span.exception);
+      done = span.error || span.last || span.blocks->empty() || span.blocks_start_height == prev_blocks_start_height;
+      prev_blocks_start_height = span.blocks_start_height;
+      prev_block_hashes.clear();
+      const std::vector<parsed_block> &span_parsed_blocks = *span.parsed_blocks;
+      for (size_t i = span_parsed_blocks.size() - std::min<size_t>(3, span_parsed_blocks.size()); i < span_parsed_blocks.size(); ++i)
+        prev_block_hashes.push_back(span_parsed_blocks[i].hash);
+      return true;
+    });
+  };
+  auto next_span = [&](refresh_span &span) { return pipeline.next(span); };
+  auto stop_pipeline = [&]() { pipeline.stop(); };
+
+  bool first = true;
+  while(m_run.load(std::memory_order_relaxed))
+  {
+    refresh_span next;
+    bool error = false;
     try
     {
-      // pull the next set of blocks while we're processing the current one
-      error = false;
-      exception = NULL;
-      next_blocks.clear();
-      next_parsed_blocks.clear();
       added_blocks = 0;
-      if (!first && blocks.empty())
+      if (!first && blocks->empty())
       {
         m_node_rpc_proxy.set_height(m_blockchain.size());
         refreshed = true;
         break;
       }
-      if (!last)
-        tpool.submit(&waiter, [&]{pull_and_parse_next_blocks(start_height, next_blocks_start_height, short_chain_history, blocks, parsed_blocks, next_blocks, next_parsed_blocks, last, error, exception);});
+      if (first)
+        start_pipeline();
 
       if (!first)
       {
         try
         {
-          process_parsed_blocks(blocks_start_height, blocks, parsed_blocks, added_blocks, output_tracker_cache.get());
+          process_parsed_blocks(blocks_start_height, *blocks, *parsed_blocks, added_blocks, output_tracker_cache.get());
         }
         catch (const tools::error::out_of_hashchain_bounds_error&)
         {
           MINFO("Daemon claims next refresh block is out of hash chain bounds, resetting hash chain");
+          stop_pipeline();
           uint64_t stop_height = m_blockchain.offset();
           std::vector<crypto::hash> tip(m_blockchain.size() - m_blockchain.offset());
           for (size_t i = m_blockchain.offset(); i < m_blockchain.size(); ++i)
@@ -3500,8 +3679,17 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
         }
         blocks_fetched += added_blocks;
       }
-      THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
-      if(!first && blocks_start_height == next_blocks_start_height)
+      if (!error && !next_span(next))
+      {
+        // the producer stopped after handing over the last span
+        if (m_run.load(std::memory_order_relaxed))
+        {
+          m_node_rpc_proxy.set_height(m_blockchain.size());
+          refreshed = true;
+        }
+        break;
+      }
+      if(!error && !first && blocks_start_height == next.blocks_start_height)
       {
         m_node_rpc_proxy.set_height(m_blockchain.size());
         refreshed = true;
@@ -3511,47 +3699,47 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
       first = false;
 
       // handle error from async fetching thread
-      if (error)
+      if (error || next.error)
       {
-        if (exception)
-          std::rethrow_exception(exception);
+        if (next.exception)
+          std::rethrow_exception(next.exception);
         else
           throw std::runtime_error("proxy exception in refresh thread");
       }
 
       // if we've got at least 10 blocks to refresh, assume we're starting
       // a long refresh, and setup a tracking output cache if we need to
-      if (m_track_uses && (!output_tracker_cache || output_tracker_cache->empty()) && next_blocks.size() >= 10)
+      if (m_track_uses && (!output_tracker_cache || output_tracker_cache->empty()) && next.blocks->size() >= 10)
         output_tracker_cache = create_output_tracker_cache();
 
       // switch to the new blocks from the daemon
-      blocks_start_height = next_blocks_start_height;
-      blocks = std::move(next_blocks);
-      parsed_blocks = std::move(next_parsed_blocks);
+      blocks_start_height = next.blocks_start_height;
+      blocks = std::move(next.blocks);
+      parsed_blocks = std::move(next.parsed_blocks);
     }
     catch (const tools::error::password_needed&)
     {
       blocks_fetched += added_blocks;
-      THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+      stop_pipeline();
       throw;
     }
     catch (const error::payment_required&)
     {
       // no point in trying again, it'd just eat up credits
-      THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+      stop_pipeline();
       throw;
     }
     catch (const std::exception&)
     {
       blocks_fetched += added_blocks;
-      THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+      stop_pipeline();
       if(try_count < 3)
       {
         LOG_PRINT_L1("Another try pull_blocks (try_count=" << try_count << ")...");
         first = true;
         start_height = 0;
-        blocks.clear();
-        parsed_blocks.clear();
+        blocks = std::make_shared<const std::vector<cryptonote::block_complete_entry>>();
+        parsed_blocks = std::make_shared<const std::vector<parsed_block>>();
         short_chain_history.clear();
         get_short_chain_history(short_chain_history, 1);
         ++try_count;
@@ -3563,6 +3751,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
       }
     }
   }
+  stop_pipeline();
   if(last_tx_hash_id != (m_transfers.size() ? m_transfers.back().m_txid : null_hash))
     received_money = true;
 
@@ -3723,7 +3912,10 @@ void wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, ui
   for (auto it = m_payments.begin(); it != m_payments.end(); )
   {
     if(height <= it->second.m_block_height)
+    {
+      unindex_payment(*it);
       it = m_payments.erase(it);
+    }
     else
       ++it;
   }
@@ -3731,7 +3923,10 @@ void wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, ui
   for (auto it = m_confirmed_txs.begin(); it != m_confirmed_txs.end(); )
   {
     if(height <= it->second.m_block_height)
+    {
+      unindex_confirmed_tx(*it);
       it = m_confirmed_txs.erase(it);
+    }
     else
       ++it;
   }
@@ -3768,6 +3963,9 @@ bool wallet2::clear()
   m_subaddress_labels.clear();
   m_multisig_rounds_passed = 0;
   m_device_last_key_image_sync = 0;
+  invalidate_transfer_history_index();
+  m_cache_journal.clear();
+  m_cache_journal_compact = false;
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -3784,6 +3982,7 @@ void wallet2::clear_soft(bool keep_key_images)
   m_unconfirmed_payments.clear();
   m_scanned_pool_txs[0].clear();
   m_scanned_pool_txs[1].clear();
+  invalidate_transfer_history_index();
 
   cryptonote::block b;
   generate_genesis(b);
@@ -3967,6 +4166,9 @@ boost::optional<wallet2::keys_file_data> wallet2::get_keys_file_data(const epee:
   value2.SetInt(m_track_uses ? 1 : 0);
   json.AddMember("track_uses", value2, json.GetAllocator());
 
+  value2.SetInt(m_cache_journal_enabled ? 1 : 0);
+  json.AddMember("cache_journal", value2, json.GetAllocator());
+
   value2.SetInt(m_inactivity_lock_timeout);
   json.AddMember("inactivity_lock_timeout", value2, json.GetAllocator());
 
@@ -4018,6 +4220,9 @@ boost::optional<wallet2::keys_file_data> wallet2::get_keys_file_data(const epee:
   value2.SetUint64(m_credits_target);
   json.AddMember("credits_target", value2, json.GetAllocator());
 
+  value2.SetUint(m_refresh_pipeline_depth);
+  json.AddMember("refresh_pipeline_depth", value2, json.GetAllocator());
+
   // Serialize the JSON object
   rapidjson::StringBuffer buffer;
   rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
@@ -4050,6 +4255,9 @@ void wallet2::setup_keys(const epee::wipeable_string &password)
   memcpy(cache_key_data.data(), &key, HASH_SIZE);
   cache_key_data[HASH_SIZE] = config::HASH_KEY_WALLET_CACHE;
   cn_fast_hash(cache_key_data.data(), HASH_SIZE+1, (crypto::hash&)m_cache_key);
+  // the cache file and any journal records are encrypted with the old key,
+  // so the next store must write a full cache and drop the journal
+  m_cache_journal_compact = true;
   get_ringdb_key();
 }
 //----------------------------------------------------------------------------------------------------
@@ -4151,6 +4359,7 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_ignore_outputs_above = MONEY_SUPPLY;
     m_ignore_outputs_below = 0;
     m_track_uses = false;
+    m_cache_journal_enabled = false;
     m_inactivity_lock_timeout = DEFAULT_INACTIVITY_LOCK_TIMEOUT;
     m_setup_background_mining = BackgroundMiningMaybe;
     m_subaddress_lookahead_major = SUBADDRESS_LOOKAHEAD_MAJOR;
@@ -4165,6 +4374,7 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_persistent_rpc_client_id = false;
     m_auto_mine_for_rpc_payment_threshold = -1.0f;
     m_credits_target = 0;
+    m_refresh_pipeline_depth = DEFAULT_REFRESH_PIPELINE_DEPTH;
   }
   else if(json.IsObject())
   {
@@ -4323,6 +4533,8 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_ignore_outputs_below = field_ignore_outputs_below;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, track_uses, int, Int, false, false);
     m_track_uses = field_track_uses;
+    GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, cache_journal, int, Int, false, false);
+    m_cache_journal_enabled = field_cache_journal;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, inactivity_lock_timeout, uint32_t, Uint, false, DEFAULT_INACTIVITY_LOCK_TIMEOUT);
     m_inactivity_lock_timeout = field_inactivity_lock_timeout;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, setup_background_mining, BackgroundMiningSetupType, Int, false, BackgroundMiningMaybe);
@@ -4393,6 +4605,8 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_auto_mine_for_rpc_payment_threshold = field_auto_mine_for_rpc_payment;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, credits_target, uint64_t, Uint64, false, 0);
     m_credits_target = field_credits_target;
+    GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, refresh_pipeline_depth, uint32_t, Uint, false, DEFAULT_REFRESH_PIPELINE_DEPTH);
+    m_refresh_pipeline_depth = field_refresh_pipeline_depth;
   }
   else
   {
@@ -5683,6 +5897,8 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
       std::string cache_data;
       cache_data.resize(cache_file_data.cache_data.size());
       crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), m_cache_key, cache_file_data.iv, &cache_data[0]);
+      if (use_fs)
+        load_cache_journal(cache_data);
 
       try {
         bool loaded = false;
@@ -5710,6 +5926,8 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
 
         if (!loaded)
         {
+          // older caches are never journaled, the next store will write a full cache
+          m_cache_journal.clear();
           std::stringstream iss;
           iss << cache_data;
           boost::archive::portable_binary_iarchive ar(iss);
@@ -5718,6 +5936,7 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
       }
       catch(...)
       {
+        m_cache_journal.clear();
         // try with previous scheme: direct from keys
         crypto::chacha_key key;
         generate_chacha_key_from_secret_keys(key);
@@ -5753,6 +5972,7 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
     }
     catch (...)
     {
+      m_cache_journal.clear();
       LOG_PRINT_L1("Failed to load encrypted cache, trying unencrypted");
       try {
         std::stringstream iss;
@@ -5771,6 +5991,10 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
         ar >> *this;
       }
     }
+    // caches written before compact_tx existed still hold the ring members
+    for (transfer_details &td: m_transfers)
+      td.compact_tx();
+    invalidate_transfer_history_index();
     THROW_WALLET_EXCEPTION_IF(
       m_account_public_address.m_spend_public_key != m_account.get_keys().m_account_address.m_spend_public_key ||
       m_account_public_address.m_view_public_key  != m_account.get_keys().m_account_address.m_view_public_key,
@@ -5916,8 +6140,8 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
   }
 
   // get wallet cache data
-  boost::optional<wallet2::cache_file_data> cache_file_data = get_cache_file_data(password);
-  THROW_WALLET_EXCEPTION_IF(cache_file_data == boost::none, error::wallet_internal_error, "failed to generate wallet cache data");
+  std::string cache_data;
+  THROW_WALLET_EXCEPTION_IF(!get_cache_data(cache_data), error::wallet_internal_error, "failed to generate wallet cache data");
 
   const std::string new_file = same_file ? m_wallet_file + ".new" : path;
   const std::string old_file = m_wallet_file;
@@ -5948,6 +6172,14 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
     if (!r) {
       LOG_ERROR("error removing file: " << old_file);
     }
+    // remove old cache journal, it does not apply to the new wallet file
+    if (boost::filesystem::exists(old_file + ".journal"))
+    {
+      r = boost::filesystem::remove(old_file + ".journal");
+      if (!r) {
+        LOG_ERROR("error removing file: " << old_file << ".journal");
+      }
+    }
     // remove old keys file
     r = boost::filesystem::remove(old_keys_file);
     if (!r) {
@@ -5961,14 +6193,16 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
         LOG_ERROR("error removing file: " << old_mms_file);
       }
     }
-  } else {
+  } else if (!store_cache_journal(cache_data)) {
+    wallet2::cache_file_data cache_file_data = encrypt_cache_data(cache_data);
+
     // save to new file
 #ifdef WIN32
     // On Windows avoid using std::ofstream which does not work with UTF-8 filenames
     // The price to pay is temporary higher memory consumption for string stream + binary archive
     std::ostringstream oss;
     binary_archive<true> oar(oss);
-    bool success = ::serialization::serialize(oar, cache_file_data.get());
+    bool success = ::serialization::serialize(oar, cache_file_data);
     if (success) {
         success = save_to_file(new_file, oss.str());
     }
@@ -5977,7 +6211,7 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
     std::ofstream ostr;
     ostr.open(new_file, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
     binary_archive<true> oar(ostr);
-    bool success = ::serialization::serialize(oar, cache_file_data.get());
+    bool success = ::serialization::serialize(oar, cache_file_data);
     ostr.close();
     THROW_WALLET_EXCEPTION_IF(!success || !ostr.good(), error::file_save_error, new_file);
 #endif
@@ -5985,6 +6219,9 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
     // here we have "*.new" file, we need to rename it to be without ".new"
     std::error_code e = tools::replace_file(new_file, m_wallet_file);
     THROW_WALLET_EXCEPTION_IF(e, error::file_save_error, m_wallet_file, e);
+
+    // the full cache now supersedes the journal
+    reset_cache_journal(cache_data);
   }
   
   if (m_message_store.get_active())
@@ -5996,6 +6233,14 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
 }
 //----------------------------------------------------------------------------------------------------
 boost::optional<wallet2::cache_file_data> wallet2::get_cache_file_data(const epee::wipeable_string &passwords)
+{
+  std::string cache_data;
+  if (!get_cache_data(cache_data))
+    return boost::none;
+  return encrypt_cache_data(cache_data);
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::get_cache_data(std::string &cache_data)
 {
   trim_hashchain();
   try
@@ -6003,21 +6248,141 @@ boost::optional<wallet2::cache_file_data> wallet2::get_cache_file_data(const epe
     std::stringstream oss;
     binary_archive<true> ar(oss);
     if (!::serialization::serialize(ar, *this))
-      return boost::none;
-
-    boost::optional<wallet2::cache_file_data> cache_file_data = (wallet2::cache_file_data) {};
-    cache_file_data.get().cache_data = oss.str();
-    std::string cipher;
-    cipher.resize(cache_file_data.get().cache_data.size());
-    cache_file_data.get().iv = crypto::rand<crypto::chacha_iv>();
-    crypto::chacha20(cache_file_data.get().cache_data.data(), cache_file_data.get().cache_data.size(), m_cache_key, cache_file_data.get().iv, &cipher[0]);
-    cache_file_data.get().cache_data = cipher;
-    return cache_file_data;
+      return false;
+    cache_data = oss.str();
+    return true;
   }
   catch(...)
   {
-    return boost::none;
+    return false;
+  }
+}
+//----------------------------------------------------------------------------------------------------
+wallet2::cache_file_data wallet2::encrypt_cache_data(const std::string &cache_data) const
+{
+  wallet2::cache_file_data cache_file_data;
+  cache_file_data.cache_data.resize(cache_data.size());
+  cache_file_data.iv = crypto::rand<crypto::chacha_iv>();
+  crypto::chacha20(cache_data.data(), cache_data.size(), m_cache_key, cache_file_data.iv, &cache_file_data.cache_data[0]);
+  return cache_file_data;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::load_cache_journal(std::string &cache_data)
+{
+  const std::string journal_file = m_wallet_file + ".journal";
+  m_cache_journal_base_size = cache_data.size();
+  m_cache_journal_size = 0;
+  m_cache_journal_compact = false;
+
+  boost::system::error_code e;
+  if (!boost::filesystem::exists(journal_file, e) || e)
+  {
+    // chunk hashes are only needed to write journal records
+    if (m_cache_journal_enabled)
+      m_cache_journal.reset(cache_data);
+    else
+      m_cache_journal.clear();
+    return;
+  }
+
+  // a journal left over from when it was enabled still holds the latest
+  // cache, it is replayed and then folded into a full store
+  if (!m_cache_journal_enabled)
+    m_cache_journal_compact = true;
+
+  std::string journal_buf;
+  if (!load_from_file(journal_file, journal_buf, std::numeric_limits<size_t>::max()))
+  {
+    MERROR("Failed to read cache journal " << journal_file << ", ignoring it");
+    m_cache_journal.clear();
+    m_cache_journal_compact = true;
+    return;
+  }
+
+  // records are appended one after the other, a torn record at the end is the
+  // trace of an interrupted store, and everything before it is still usable
+  std::vector<cache_journal_entry> entries;
+  std::istringstream iss(journal_buf);
+  binary_archive<false> ar(iss);
+  while (ar.remaining_bytes() > 0)
+  {
+    wallet2::cache_file_data record;
+    if (!::serialization::serialize(ar, record) || !iss.good())
+    {
+      MWARNING("Truncated record in cache journal " << journal_file);
+      m_cache_journal_compact = true;
+      break;
+    }
+    std::string plain;
+    plain.resize(record.cache_data.size());
+    crypto::chacha20(record.cache_data.data(), record.cache_data.size(), m_cache_key, record.iv, &plain[0]);
+    cache_journal_entry entry;
+    if (!::serialization::parse_binary(plain, entry))
+    {
+      MWARNING("Invalid record in cache journal " << journal_file);
+      m_cache_journal_compact = true;
+      break;
+    }
+    entries.push_back(std::move(entry));
+  }
+
+  bool stale = false;
+  const size_t applied = m_cache_journal.replay(cache_data, entries, cache_data, stale);
+  if (stale)
+    m_cache_journal_compact = true;
+  m_cache_journal_size = journal_buf.size();
+  MDEBUG("Replayed " << applied << "/" << entries.size() << " cache journal records");
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::store_cache_journal(const std::string &cache_data)
+{
+  if (!m_cache_journal_enabled || !m_cache_journal.has_base() || m_cache_journal_compact)
+    return false;
+
+  // compact once the journal reaches half the size of the full cache
+  if (m_cache_journal_size * 2 > m_cache_journal_base_size)
+    return false;
+
+  boost::system::error_code e;
+  if (!boost::filesystem::exists(m_wallet_file, e) || e)
+    return false;
+
+  // make_entry marks the new chunks as stored, so any failure from here on must force a full store
+  m_cache_journal_compact = true;
+  cache_journal_entry entry = m_cache_journal.make_entry(cache_data);
+  std::string plain;
+  THROW_WALLET_EXCEPTION_IF(!::serialization::dump_binary(entry, plain), error::wallet_internal_error, "Failed to serialize cache journal record");
+  wallet2::cache_file_data record = encrypt_cache_data(plain);
+  std::string record_blob;
+  THROW_WALLET_EXCEPTION_IF(!::serialization::dump_binary(record, record_blob), error::wallet_internal_error, "Failed to serialize cache journal record");
+
+  const std::string journal_file = m_wallet_file + ".journal";
+  bool r = epee::file_io_utils::append_string_to_file(journal_file, record_blob);
+  THROW_WALLET_EXCEPTION_IF(!r, error::file_save_error, journal_file);
+
+  m_cache_journal_size += record_blob.size();
+  m_cache_journal_compact = false;
+  MDEBUG("Stored " << entry.new_chunks.size() << "/" << entry.chunks.size() << " cache chunks to journal, " << record_blob.size() << " bytes");
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::reset_cache_journal(const std::string &cache_data)
+{
+  const std::string journal_file = m_wallet_file + ".journal";
+  boost::system::error_code e;
+  if (boost::filesystem::exists(journal_file, e))
+  {
+    if (!boost::filesystem::remove(journal_file, e))
+      MERROR("Failed to remove cache journal " << journal_file << ": " << e.message());
   }
+
+  if (m_cache_journal_enabled)
+    m_cache_journal.reset(cache_data);
+  else
+    m_cache_journal.clear();
+  m_cache_journal_base_size = cache_data.size();
+  m_cache_journal_size = 0;
+  m_cache_journal_compact = false;
 }
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::balance(uint32_t index_major, bool strict) const
@@ -6050,6 +6415,16 @@ uint64_t wallet2::unlocked_balance(uint32_t index_major, bool strict, uint64_t *
   return amount;
 }
 //----------------------------------------------------------------------------------------------------
+static void get_time_to_unlock(const wallet2::transfer_details &td, uint64_t blockchain_height, uint64_t now, uint64_t &blocks_to_unlock, uint64_t &time_to_unlock)
+{
+  uint64_t unlock_height = td.m_block_height + std::max<uint64_t>(CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+  if (td.m_tx.unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER && td.m_tx.unlock_time > unlock_height)
+    unlock_height = td.m_tx.unlock_time;
+  uint64_t unlock_time = td.m_tx.unlock_time >= CRYPTONOTE_MAX_BLOCK_NUMBER ? td.m_tx.unlock_time : 0;
+  blocks_to_unlock = unlock_height > blockchain_height ? unlock_height - blockchain_height : 0;
+  time_to_unlock = unlock_time > now ? unlock_time - now : 0;
+}
+//----------------------------------------------------------------------------------------------------
 std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_major, bool strict) const
 {
   std::map<uint32_t, uint64_t> amount_per_subaddr;
@@ -6100,12 +6475,7 @@ std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> wallet2::
       }
       else
       {
-        uint64_t unlock_height = td.m_block_height + std::max<uint64_t>(CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
-        if (td.m_tx.unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER && td.m_tx.unlock_time > unlock_height)
-          unlock_height = td.m_tx.unlock_time;
-        uint64_t unlock_time = td.m_tx.unlock_time >= CRYPTONOTE_MAX_BLOCK_NUMBER ? td.m_tx.unlock_time : 0;
-        blocks_to_unlock = unlock_height > blockchain_height ? unlock_height - blockchain_height : 0;
-        time_to_unlock = unlock_time > now ? unlock_time - now : 0;
+        get_time_to_unlock(td, blockchain_height, now, blocks_to_unlock, time_to_unlock);
         amount = 0;
       }
       auto found = amount_per_subaddr.find(td.m_subaddr_index.minor);
@@ -6130,6 +6500,76 @@ uint64_t wallet2::balance_all(bool strict) const
   return r;
 }
 //----------------------------------------------------------------------------------------------------
+std::shared_ptr<const wallet2::balance_snapshot> wallet2::make_balance_snapshot(const balance_snapshot *previous)
+{
+  if (m_light_wallet)
+    return NULL;
+
+  PERF_TIMER(make_balance_snapshot);
+  std::shared_ptr<balance_snapshot> snapshot = std::make_shared<balance_snapshot>();
+  snapshot->height = get_blockchain_current_height();
+  snapshot->multisig_import_needed = multisig() && has_multisig_partial_key_images();
+  snapshot->accounts.resize(m_subaddress_labels.size());
+  for (uint32_t index_major = 0; index_major < m_subaddress_labels.size(); ++index_major)
+  {
+    std::vector<balance_snapshot::subaddress_entry> &account = snapshot->accounts[index_major];
+    account.resize(m_subaddress_labels[index_major].size());
+    for (uint32_t index_minor = 0; index_minor < account.size(); ++index_minor)
+    {
+      // subaddresses never change, but are expensive to derive
+      if (previous && index_major < previous->accounts.size() && index_minor < previous->accounts[index_major].size())
+        account[index_minor].address = previous->accounts[index_major][index_minor].address;
+      else
+        account[index_minor].address = get_subaddress_as_str({index_major, index_minor});
+      account[index_minor].label = m_subaddress_labels[index_major][index_minor];
+    }
+  }
+
+  const uint64_t blockchain_height = get_blockchain_current_height();
+  const uint64_t now = time(NULL);
+  for (const transfer_details &td: m_transfers)
+  {
+    const cryptonote::subaddress_index &index = td.m_subaddr_index;
+    if (index.major >= snapshot->accounts.size() || index.minor >= snapshot->accounts[index.major].size())
+      continue;
+    balance_snapshot::subaddress_entry &entry = snapshot->accounts[index.major][index.minor];
+    entry.used = true;
+    if (!td.m_spent)
+      ++entry.num_unspent_outputs;
+    if (td.m_frozen)
+      continue;
+
+    const bool unlocked = is_transfer_unlocked(td);
+    uint64_t blocks_to_unlock = 0, time_to_unlock = 0;
+    if (!unlocked)
+      get_time_to_unlock(td, blockchain_height, now, blocks_to_unlock, time_to_unlock);
+    for (int strict = 0; strict < 2; ++strict)
+    {
+      if (is_spent(td, strict))
+        continue;
+      entry.has_balance[strict] = true;
+      entry.balance[strict] += td.amount();
+      if (unlocked)
+        entry.unlocked_balance[strict] += td.amount();
+      entry.blocks_to_unlock[strict] = std::max(entry.blocks_to_unlock[strict], blocks_to_unlock);
+      entry.time_to_unlock[strict] = std::max(entry.time_to_unlock[strict], time_to_unlock);
+    }
+  }
+
+  // all changes go to 0-th subaddress (in the current subaddress account)
+  for (const auto& utx: m_unconfirmed_txs)
+  {
+    const uint32_t index_major = utx.second.m_subaddr_account;
+    if (utx.second.m_state == wallet2::unconfirmed_transfer_details::failed || index_major >= snapshot->accounts.size() || snapshot->accounts[index_major].empty())
+      continue;
+    balance_snapshot::subaddress_entry &entry = snapshot->accounts[index_major][0];
+    entry.has_balance[0] = true;
+    entry.balance[0] += utx.second.m_change;
+  }
+
+  return snapshot;
+}
+//----------------------------------------------------------------------------------------------------
 uint64_t wallet2::unlocked_balance_all(bool strict, uint64_t *blocks_to_unlock, uint64_t *time_to_unlock)
 {
   uint64_t r = 0;
@@ -6169,29 +6609,17 @@ void wallet2::get_payments(const crypto::hash& payment_id, std::list<wallet2::pa
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
 {
-  auto range = std::make_pair(m_payments.begin(), m_payments.end());
-  std::for_each(range.first, range.second, [&payments, &min_height, &max_height, &subaddr_account, &subaddr_indices](const payment_container::value_type& x) {
-    if (min_height < x.second.m_block_height && max_height >= x.second.m_block_height &&
-      (!subaddr_account || *subaddr_account == x.second.m_subaddr_index.major) &&
-      (subaddr_indices.empty() || subaddr_indices.count(x.second.m_subaddr_index.minor) == 1))
-    {
-      payments.push_back(x);
-    }
-  });
+  std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>> confirmed_payments;
+  transfer_history_key last;
+  get_transfer_history(payments, confirmed_payments, true, false, min_height, max_height, subaddr_account, subaddr_indices, boost::none, 0, last);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments_out(std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments,
     uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
 {
-  for (auto i = m_confirmed_txs.begin(); i != m_confirmed_txs.end(); ++i) {
-    if (i->second.m_block_height <= min_height || i->second.m_block_height > max_height)
-      continue;
-    if (subaddr_account && *subaddr_account != i->second.m_subaddr_account)
-      continue;
-    if (!subaddr_indices.empty() && std::count_if(i->second.m_subaddr_indices.begin(), i->second.m_subaddr_indices.end(), [&subaddr_indices](uint32_t index) { return subaddr_indices.count(index) == 1; }) == 0)
-      continue;
-    confirmed_payments.push_back(*i);
-  }
+  std::list<std::pair<crypto::hash,wallet2::payment_details>> payments;
+  transfer_history_key last;
+  get_transfer_history(payments, confirmed_payments, false, true, min_height, max_height, subaddr_account, subaddr_indices, boost::none, 0, last);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_unconfirmed_payments_out(std::list<std::pair<crypto::hash,wallet2::unconfirmed_transfer_details>>& unconfirmed_payments, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
@@ -6214,6 +6642,176 @@ void wallet2::get_unconfirmed_payments(std::list<std::pair<crypto::hash,wallet2:
   }
 }
 //----------------------------------------------------------------------------------------------------
+bool wallet2::get_transfer_history(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments,
+    bool in, bool out, uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices,
+    const boost::optional<transfer_history_key> &after, size_t max_count, transfer_history_key &last) const
+{
+  if (min_height == std::numeric_limits<uint64_t>::max() || min_height >= max_height)
+    return false;
+
+  static const payment_history_index no_payments;
+  static const confirmed_tx_history_index no_confirmed_txs;
+  const transfer_history_index &index = get_transfer_history_index();
+  const payment_history_index *payments_index = &index.payments;
+  const confirmed_tx_history_index *confirmed_txs_index = &index.confirmed_txs;
+  if (subaddr_account)
+  {
+    const auto i = index.payments_by_account.find(*subaddr_account);
+    payments_index = i == index.payments_by_account.end() ? &no_payments : &i->second;
+    const auto j = index.confirmed_txs_by_account.find(*subaddr_account);
+    confirmed_txs_index = j == index.confirmed_txs_by_account.end() ? &no_confirmed_txs : &j->second;
+  }
+  if (!in)
+    payments_index = &no_payments;
+  if (!out)
+    confirmed_txs_index = &no_confirmed_txs;
+
+  // start at the first transfer above min_height, or right after the given position
+  const transfer_history_key start{min_height + 1, crypto::null_hash, false, {0, 0}};
+  const bool resume = after && !(*after < start);
+  auto pi = resume ? payments_index->upper_bound(*after) : payments_index->lower_bound(start);
+  auto ci = resume ? confirmed_txs_index->upper_bound(*after) : confirmed_txs_index->lower_bound(start);
+
+  const auto payment_matches = [&](const payment_history_index::value_type &e) {
+    return subaddr_indices.empty() || subaddr_indices.count(e.first.m_subaddr_index.minor) == 1;
+  };
+  const auto confirmed_tx_matches = [&](const confirmed_tx_history_index::value_type &e) {
+    if (subaddr_indices.empty())
+      return true;
+    const std::set<uint32_t> &indices = e.second->second.m_subaddr_indices;
+    return std::any_of(indices.begin(), indices.end(), [&subaddr_indices](uint32_t index) { return subaddr_indices.count(index) == 1; });
+  };
+
+  size_t count = 0;
+  while (true)
+  {
+    while (pi != payments_index->end() && pi->first.m_block_height <= max_height && !payment_matches(*pi))
+      ++pi;
+    while (ci != confirmed_txs_index->end() && ci->first.m_block_height <= max_height && !confirmed_tx_matches(*ci))
+      ++ci;
+    const bool has_payment = pi != payments_index->end() && pi->first.m_block_height <= max_height;
+    const bool has_confirmed_tx = ci != confirmed_txs_index->end() && ci->first.m_block_height <= max_height;
+    if (!has_payment && !has_confirmed_tx)
+      return false;
+    if (max_count > 0 && count == max_count)
+      return true;
+    if (has_payment && (!has_confirmed_tx || !(ci->first < pi->first)))
+    {
+      payments.push_back(*pi->second);
+      last = pi->first;
+      ++pi;
+    }
+    else
+    {
+      confirmed_payments.push_back(*ci->second);
+      last = ci->first;
+      ++ci;
+    }
+    ++count;
+  }
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::transfer_history_key::operator<(const transfer_history_key &other) const
+{
+  if (m_block_height != other.m_block_height)
+    return m_block_height < other.m_block_height;
+  const int cmp = memcmp(m_tx_hash.data, other.m_tx_hash.data, sizeof(m_tx_hash.data));
+  if (cmp != 0)
+    return cmp < 0;
+  if (m_out != other.m_out)
+    return !m_out;
+  if (m_subaddr_index.major != other.m_subaddr_index.major)
+    return m_subaddr_index.major < other.m_subaddr_index.major;
+  return m_subaddr_index.minor < other.m_subaddr_index.minor;
+}
+//----------------------------------------------------------------------------------------------------
+static wallet2::transfer_history_key make_transfer_history_key(const wallet2::payment_details &pd)
+{
+  return {pd.m_block_height, pd.m_tx_hash, false, pd.m_subaddr_index};
+}
+//----------------------------------------------------------------------------------------------------
+static wallet2::transfer_history_key make_transfer_history_key(const crypto::hash &txid, const wallet2::confirmed_transfer_details &ctd)
+{
+  return {ctd.m_block_height, txid, true, {ctd.m_subaddr_account, 0}};
+}
+//----------------------------------------------------------------------------------------------------
+template<typename T>
+static void erase_from_history_index(std::multimap<wallet2::transfer_history_key, const T*> &index, const wallet2::transfer_history_key &key, const T *value)
+{
+  const auto range = index.equal_range(key);
+  for (auto i = range.first; i != range.second; ++i)
+  {
+    if (i->second == value)
+    {
+      index.erase(i);
+      return;
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::index_payment(const std::pair<const crypto::hash, payment_details> &payment)
+{
+  if (!m_transfer_history_index.valid)
+    return;
+  const transfer_history_key key = make_transfer_history_key(payment.second);
+  m_transfer_history_index.payments.emplace(key, &payment);
+  m_transfer_history_index.payments_by_account[key.m_subaddr_index.major].emplace(key, &payment);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::unindex_payment(const std::pair<const crypto::hash, payment_details> &payment)
+{
+  if (!m_transfer_history_index.valid)
+    return;
+  const transfer_history_key key = make_transfer_history_key(payment.second);
+  erase_from_history_index(m_transfer_history_index.payments, key, &payment);
+  erase_from_history_index(m_transfer_history_index.payments_by_account[key.m_subaddr_index.major], key, &payment);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::index_confirmed_tx(const std::pair<const crypto::hash, confirmed_transfer_details> &ctd)
+{
+  if (!m_transfer_history_index.valid)
+    return;
+  const transfer_history_key key = make_transfer_history_key(ctd.first, ctd.second);
+  m_transfer_history_index.confirmed_txs.emplace(key, &ctd);
+  m_transfer_history_index.confirmed_txs_by_account[ctd.second.m_subaddr_account].emplace(key, &ctd);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::unindex_confirmed_tx(const std::pair<const crypto::hash, confirmed_transfer_details> &ctd)
+{
+  if (!m_transfer_history_index.valid)
+    return;
+  const transfer_history_key key = make_transfer_history_key(ctd.first, ctd.second);
+  erase_from_history_index(m_transfer_history_index.confirmed_txs, key, &ctd);
+  erase_from_history_index(m_transfer_history_index.confirmed_txs_by_account[ctd.second.m_subaddr_account], key, &ctd);
+}
+//----------------------------------------------------------------------------------------------------
+const wallet2::transfer_history_index &wallet2::get_transfer_history_index() const
+{
+  transfer_history_index &index = m_transfer_history_index;
+  if (index.valid)
+    return index;
+
+  PERF_TIMER(rebuild_transfer_history_index);
+  index.payments.clear();
+  index.confirmed_txs.clear();
+  index.payments_by_account.clear();
+  index.confirmed_txs_by_account.clear();
+  for (const auto &payment: m_payments)
+  {
+    const transfer_history_key key = make_transfer_history_key(payment.second);
+    index.payments.emplace(key, &payment);
+    index.payments_by_account[key.m_subaddr_index.major].emplace(key, &payment);
+  }
+  for (const auto &ctd: m_confirmed_txs)
+  {
+    const transfer_history_key key = make_transfer_history_key(ctd.first, ctd.second);
+    index.confirmed_txs.emplace(key, &ctd);
+    index.confirmed_txs_by_account[ctd.second.m_subaddr_account].emplace(key, &ctd);
+  }
+  index.valid = true;
+  return index;
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::rescan_spent()
 {
   // This is RPC call that can take a long time if there are many outputs,
@@ -7788,6 +8386,15 @@ bool wallet2::set_ring(const crypto::key_image &key_image, const std::vector<uin
   catch (const std::exception &e) { return false; }
 }
 
+bool wallet2::set_rings(const std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> &rings, bool relative)
+{
+  if (!m_ringdb)
+    return false;
+
+  try { return m_ringdb->set_rings(get_ringdb_key(), rings, relative); }
+  catch (const std::exception &e) { return false; }
+}
+
 bool wallet2::unset_ring(const std::vector<crypto::key_image> &key_images)
 {
   if (!m_ringdb)
@@ -7873,6 +8480,7 @@ bool wallet2::find_and_save_rings(bool force)
 
     MDEBUG("Scanning " << res.txs.size() << " transactions");
     THROW_WALLET_EXCEPTION_IF(slice + res.txs.size() > txs_hashes.size(), error::wallet_internal_error, "Unexpected tx array size");
+    std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> rings;
     for (size_t i = 0; i < res.txs.size(); ++i, ++it)
     {
     const auto &tx_info = res.txs[i];
@@ -7881,8 +8489,9 @@ bool wallet2::find_and_save_rings(bool force)
       THROW_WALLET_EXCEPTION_IF(!get_pruned_tx(tx_info, tx, tx_hash), error::wallet_internal_error,
           "Failed to get transaction from daemon");
       THROW_WALLET_EXCEPTION_IF(!(tx_hash == *it), error::wallet_internal_error, "Wrong txid received");
-      THROW_WALLET_EXCEPTION_IF(!add_rings(get_ringdb_key(), tx), error::wallet_internal_error, "Failed to save ring");
+      get_tx_rings(tx, rings);
     }
+    THROW_WALLET_EXCEPTION_IF(!set_rings(rings, true), error::wallet_internal_error, "Failed to save rings");
   }
 
   MINFO("Found and saved rings for " << txs_hashes.size() << " transactions");
@@ -8722,6 +9331,8 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
   }
 
   // save those outs in the ringdb for reuse
+  std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> rings;
+  rings.reserve(selected_transfers.size());
   for (size_t i = 0; i < selected_transfers.size(); ++i)
   {
     const size_t idx = selected_transfers[i];
@@ -8731,9 +9342,10 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
     ring.reserve(outs[i].size());
     for (const auto &e: outs[i])
       ring.push_back(std::get<0>(e));
-    if (!set_ring(td.m_key_image, ring, false))
-      MERROR("Failed to set ring for " << td.m_key_image);
+    rings.push_back(std::make_pair(td.m_key_image, std::move(ring)));
   }
+  if (!set_rings(rings, false))
+    MERROR("Failed to set rings for " << rings.size() << " outputs");
 }
 
 template<typename T>
@@ -9634,7 +10246,7 @@ void wallet2::light_wallet_get_address_txs()
         }
       } else {
         if (std::find(payments_txs.begin(), payments_txs.end(), tx_hash) == payments_txs.end()) {
-          m_payments.emplace(tx_hash, payment);
+          index_payment(*m_payments.emplace(tx_hash, payment));
           if (0 != m_callback) {
             m_callback->on_lw_money_received(t.height, payment.m_tx_hash, payment.m_amount);
           }
@@ -9682,7 +10294,9 @@ void wallet2::light_wallet_get_address_txs()
             ctd.m_payment_id = payment_id;
             ctd.m_block_height = t.height;
             ctd.m_timestamp = t.timestamp;
-            m_confirmed_txs.emplace(tx_hash,ctd);
+            const auto inserted = m_confirmed_txs.emplace(tx_hash,ctd);
+            if (inserted.second)
+              index_confirmed_tx(*inserted.first);
           }
           if (0 != m_callback)
           {
@@ -12533,40 +13147,196 @@ crypto::public_key wallet2::get_tx_pub_key_from_received_outs(const tools::walle
   return tx_pub_key;
 }
 
-bool wallet2::export_key_images(const std::string &filename, bool all) const
+// Chunked export data is the plaintext magic followed by length prefixed
+// chunks, each encrypted and authenticated on its own so they can be built
+// and checked in parallel. The first chunk is a header giving the number of
+// chunks after it, and each of those starts with its index, so dropped or
+// reordered chunks are detected. Chunks are built and consumed
+// EXPORT_CHUNK_BATCH at a time, so a file is streamed in bounded memory.
+static void add_le32(std::string &data, uint32_t value)
+{
+  data += (char)(value & 0xff);
+  data += (char)((value >> 8) & 0xff);
+  data += (char)((value >> 16) & 0xff);
+  data += (char)((value >> 24) & 0xff);
+}
+
+static uint32_t get_le32(const char *data)
+{
+  return (uint8_t)data[0] | (((uint8_t)data[1]) << 8) | (((uint8_t)data[2]) << 16) | (((uint32_t)(uint8_t)data[3]) << 24);
+}
+
+static void write_export_chunk(std::ostream &s, const std::string &chunk)
+{
+  std::string size;
+  add_le32(size, chunk.size());
+  s.write(size.data(), size.size());
+  s.write(chunk.data(), chunk.size());
+}
+
+// reads the next chunk, or skips it if chunk is NULL. Returns false if the
+// data ends before the chunk does
+static bool read_export_chunk(std::istream &s, std::string *chunk)
+{
+  char size_data[4];
+  if (!s.read(size_data, sizeof(size_data)))
+    return false;
+  const uint32_t size = get_le32(size_data);
+  const std::streampos pos = s.tellg();
+  if (!s.seekg(0, std::ios_base::end))
+    return false;
+  const std::streamoff available = s.tellg() - pos;
+  if (!s.seekg(pos) || available < (std::streamoff)size)
+    return false;
+  if (!chunk)
+    return !!s.seekg(size, std::ios_base::cur);
+  chunk->resize(size);
+  return size == 0 || !!s.read(&(*chunk)[0], size);
+}
+
+static bool at_export_end(std::istream &s)
+{
+  return s.peek() == std::char_traits<char>::eof();
+}
+
+// runs f(c) for every chunk on the threadpool. Exceptions are kept per chunk
+// and rethrown on the calling thread, the first failing chunk's first, so the
+// caller sees the specific error rather than a generic threadpool failure
+template<typename F>
+static void for_each_export_chunk(size_t n_chunks, const F &f)
+{
+  std::vector<std::exception_ptr> errors(n_chunks);
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter(tpool);
+  for (size_t c = 0; c < n_chunks; ++c)
+  {
+    tpool.submit(&waiter, [&f, &errors, c](){
+      try { f(c); }
+      catch (...) { errors[c] = std::current_exception(); }
+    }, true);
+  }
+  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+  for (const std::exception_ptr &e: errors)
+    if (e)
+      std::rethrow_exception(e);
+}
+
+// Binary exports are streamed straight to the file. Ascii exports are armored
+// whole, and on Windows std::ofstream does not work with UTF-8 filenames, so
+// those are built in memory first
+template<typename F>
+static bool save_export_to_file(const wallet2 &wallet, const std::string &filename, const F &write)
+{
+#ifndef WIN32
+  if (wallet.export_format() == wallet2::ExportFormat::Binary)
+  {
+    std::ofstream ostr;
+    ostr.open(filename, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+    if (!ostr)
+      return false;
+    try
+    {
+      write(ostr);
+      ostr.close();
+    }
+    catch (...)
+    {
+      ostr.close();
+      boost::system::error_code ec;
+      boost::filesystem::remove(filename, ec);
+      throw;
+    }
+    return !ostr.fail();
+  }
+#endif
+  std::ostringstream oss;
+  write(oss);
+  return wallet.save_to_file(filename, oss.str());
+}
+
+bool wallet2::export_key_images(const std::string &filename, bool all, bool legacy) const
 {
   PERF_TIMER(export_key_images);
-  std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> ski = export_key_images(all);
-  std::string magic(KEY_IMAGE_EXPORT_FILE_MAGIC, strlen(KEY_IMAGE_EXPORT_FILE_MAGIC));
+  return save_export_to_file(*this, filename, [&](std::ostream &s){ write_key_images(s, all, legacy); });
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::write_key_images(std::ostream &s, bool all, bool legacy) const
+{
   const cryptonote::account_public_address &keys = get_account().get_keys().m_account_address;
-  const uint32_t offset = ski.first;
 
-  std::string data;
-  data.reserve(4 + ski.second.size() * (sizeof(crypto::key_image) + sizeof(crypto::signature)) + 2 * sizeof(crypto::public_key));
-  data.resize(4);
-  data[0] = offset & 0xff;
-  data[1] = (offset >> 8) & 0xff;
-  data[2] = (offset >> 16) & 0xff;
-  data[3] = (offset >> 24) & 0xff;
-  data += std::string((const char *)&keys.m_spend_public_key, sizeof(crypto::public_key));
-  data += std::string((const char *)&keys.m_view_public_key, sizeof(crypto::public_key));
-  for (const auto &i: ski.second)
+  if (legacy)
+  {
+    // one encrypted blob, as read by wallets which predate chunked exports
+    std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> ski = export_key_images(all);
+    const uint32_t offset = ski.first;
+
+    std::string data;
+    data.reserve(4 + ski.second.size() * (sizeof(crypto::key_image) + sizeof(crypto::signature)) + 2 * sizeof(crypto::public_key));
+    add_le32(data, offset);
+    data += std::string((const char *)&keys.m_spend_public_key, sizeof(crypto::public_key));
+    data += std::string((const char *)&keys.m_view_public_key, sizeof(crypto::public_key));
+    for (const auto &i: ski.second)
+    {
+      data += std::string((const char *)&i.first, sizeof(crypto::key_image));
+      data += std::string((const char *)&i.second, sizeof(crypto::signature));
+    }
+
+    // encrypt data, keep magic plaintext
+    PERF_TIMER(export_key_images_encrypt);
+    const std::string ciphertext = encrypt_with_view_secret_key(data);
+    s.write(KEY_IMAGE_EXPORT_FILE_MAGIC_V3, strlen(KEY_IMAGE_EXPORT_FILE_MAGIC_V3));
+    s.write(ciphertext.data(), ciphertext.size());
+    return;
+  }
+
+  size_t offset = 0;
+  if (!all)
   {
-    data += std::string((const char *)&i.first, sizeof(crypto::key_image));
-    data += std::string((const char *)&i.second, sizeof(crypto::signature));
+    while (offset < m_transfers.size() && !m_transfers[offset].m_key_image_request)
+      ++offset;
   }
+  const size_t n_chunks = (m_transfers.size() - offset + EXPORT_CHUNK_SIZE - 1) / EXPORT_CHUNK_SIZE;
+
+  std::string header;
+  add_le32(header, offset);
+  header += std::string((const char *)&keys.m_spend_public_key, sizeof(crypto::public_key));
+  header += std::string((const char *)&keys.m_view_public_key, sizeof(crypto::public_key));
+  add_le32(header, n_chunks);
 
   // encrypt data, keep magic plaintext
-  PERF_TIMER(export_key_images_encrypt);
-  std::string ciphertext = encrypt_with_view_secret_key(data);
-  return save_to_file(filename, magic + ciphertext);
+  const crypto::secret_key &skey = get_account().get_keys().m_view_secret_key;
+  crypto::chacha_key key;
+  crypto::generate_chacha_key(&skey, sizeof(skey), key, m_kdf_rounds);
+  s.write(KEY_IMAGE_EXPORT_FILE_MAGIC, strlen(KEY_IMAGE_EXPORT_FILE_MAGIC));
+  write_export_chunk(s, encrypt_with_chacha_key(header.data(), header.size(), key, skey, true));
+
+  std::vector<std::string> chunks;
+  for (size_t first = 0; first < n_chunks; first += EXPORT_CHUNK_BATCH)
+  {
+    const size_t begin = offset + first * EXPORT_CHUNK_SIZE, end = std::min<size_t>(begin + EXPORT_CHUNK_BATCH * EXPORT_CHUNK_SIZE, m_transfers.size());
+    const std::vector<std::pair<crypto::key_image, crypto::signature>> ski = sign_key_images(begin, end);
+    chunks.resize(std::min<size_t>(EXPORT_CHUNK_BATCH, n_chunks - first));
+    for_each_export_chunk(chunks.size(), [&](size_t c){
+      const size_t chunk_begin = c * EXPORT_CHUNK_SIZE, chunk_end = std::min<size_t>(chunk_begin + EXPORT_CHUNK_SIZE, ski.size());
+      std::string data;
+      data.reserve(4 + (chunk_end - chunk_begin) * (sizeof(crypto::key_image) + sizeof(crypto::signature)));
+      add_le32(data, first + c);
+      for (size_t n = chunk_begin; n < chunk_end; ++n)
+      {
+        data += std::string((const char *)&ski[n].first, sizeof(crypto::key_image));
+        data += std::string((const char *)&ski[n].second, sizeof(crypto::signature));
+      }
+      chunks[c] = encrypt_with_chacha_key(data.data(), data.size(), key, skey, true);
+    });
+    for (const std::string &chunk: chunks)
+      write_export_chunk(s, chunk);
+  }
 }
 
 //----------------------------------------------------------------------------------------------------
 std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> wallet2::export_key_images(bool all) const
 {
   PERF_TIMER(export_key_images_raw);
-  std::vector<std::pair<crypto::key_image, crypto::signature>> ski;
 
   size_t offset = 0;
   if (!all)
@@ -12575,8 +13345,13 @@ std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>
       ++offset;
   }
 
-  ski.reserve(m_transfers.size() - offset);
-  for (size_t n = offset; n < m_transfers.size(); ++n)
+  return std::make_pair(offset, sign_key_images(offset, m_transfers.size()));
+}
+//----------------------------------------------------------------------------------------------------
+std::vector<std::pair<crypto::key_image, crypto::signature>> wallet2::sign_key_images(size_t begin, size_t end) const
+{
+  std::vector<std::pair<crypto::key_image, crypto::signature>> ski(end - begin);
+  auto sign = [&](size_t n)
   {
     const transfer_details &td = m_transfers[n];
 
@@ -12615,21 +13390,63 @@ std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>
 
     crypto::generate_ring_signature((const crypto::hash&)td.m_key_image, td.m_key_image, key_ptrs, in_ephemeral.sec, 0, &signature);
 
-    ski.push_back(std::make_pair(td.m_key_image, signature));
+    ski[n - begin] = std::make_pair(td.m_key_image, signature);
+  };
+
+  // hardware devices get one request at a time
+  if (m_account.get_device().get_type() != hw::device::device_type::SOFTWARE)
+  {
+    for (size_t n = begin; n < end; ++n)
+      sign(n);
+    return ski;
   }
-  return std::make_pair(offset, ski);
+
+  const size_t n_batches = (end - begin + EXPORT_CHUNK_SIZE - 1) / EXPORT_CHUNK_SIZE;
+  for_each_export_chunk(n_batches, [&](size_t c){
+    const size_t batch_begin = begin + c * EXPORT_CHUNK_SIZE, batch_end = std::min<size_t>(batch_begin + EXPORT_CHUNK_SIZE, end);
+    for (size_t n = batch_begin; n < batch_end; ++n)
+      sign(n);
+  });
+  return ski;
 }
 
 uint64_t wallet2::import_key_images(const std::string &filename, uint64_t &spent, uint64_t &unspent)
 {
   PERF_TIMER(import_key_images_fsu);
+  const std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> ski = load_key_images(filename);
+  return import_key_images(ski.second, ski.first, spent, unspent);
+}
+//----------------------------------------------------------------------------------------------------
+std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> wallet2::load_key_images(const std::string &filename) const
+{
+  PERF_TIMER(load_key_images);
+  const size_t magiclen = strlen(KEY_IMAGE_EXPORT_FILE_MAGIC);
+  static_assert(sizeof(KEY_IMAGE_EXPORT_FILE_MAGIC) == sizeof(KEY_IMAGE_EXPORT_FILE_MAGIC_V3), "Unexpected magic size");
+
+#ifndef WIN32
+  // chunked binary files are streamed, see save_export_to_file
+  {
+    std::ifstream istr;
+    istr.open(filename, std::ios_base::binary | std::ios_base::in);
+    THROW_WALLET_EXCEPTION_IF(!istr, error::wallet_internal_error, std::string(tr("failed to read file ")) + filename);
+    std::string magic(magiclen, '\0');
+    if (istr.read(&magic[0], magiclen) && !memcmp(magic.data(), KEY_IMAGE_EXPORT_FILE_MAGIC, magiclen))
+      return read_key_images(istr, filename);
+  }
+#endif
+
   std::string data;
   bool r = load_from_file(filename, data);
 
   THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, std::string(tr("failed to read file ")) + filename);
 
-  const size_t magiclen = strlen(KEY_IMAGE_EXPORT_FILE_MAGIC);
-  if (data.size() < magiclen || memcmp(data.data(), KEY_IMAGE_EXPORT_FILE_MAGIC, magiclen))
+  if (data.size() >= magiclen && !memcmp(data.data(), KEY_IMAGE_EXPORT_FILE_MAGIC, magiclen))
+  {
+    std::istringstream iss(data);
+    iss.seekg(magiclen);
+    return read_key_images(iss, filename);
+  }
+  if (data.size() < magiclen || memcmp(data.data(), KEY_IMAGE_EXPORT_FILE_MAGIC_V3, magiclen))
   {
     THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Bad key image export file magic in ") + filename);
   }
@@ -12646,7 +13463,7 @@ uint64_t wallet2::import_key_images(const std::string &filename, uint64_t &spent
 
   const size_t headerlen = 4 + 2 * sizeof(crypto::public_key);
   THROW_WALLET_EXCEPTION_IF(data.size() < headerlen, error::wallet_internal_error, std::string("Bad data size from file ") + filename);
-  const uint32_t offset = (uint8_t)data[0] | (((uint8_t)data[1]) << 8) | (((uint8_t)data[2]) << 16) | (((uint8_t)data[3]) << 24);
+  const uint32_t offset = get_le32(&data[0]);
   const crypto::public_key &public_spend_key = *(const crypto::public_key*)&data[4];
   const crypto::public_key &public_view_key = *(const crypto::public_key*)&data[4 + sizeof(crypto::public_key)];
   const cryptonote::account_public_address &keys = get_account().get_keys().m_account_address;
@@ -12661,17 +13478,94 @@ uint64_t wallet2::import_key_images(const std::string &filename, uint64_t &spent
       error::wallet_internal_error, std::string("Bad data size from file ") + filename);
   size_t nki = (data.size() - headerlen) / record_size;
 
-  std::vector<std::pair<crypto::key_image, crypto::signature>> ski;
-  ski.reserve(nki);
+  std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> ski;
+  ski.first = offset;
+  ski.second.reserve(nki);
   for (size_t n = 0; n < nki; ++n)
   {
     crypto::key_image key_image = *reinterpret_cast<const crypto::key_image*>(&data[headerlen + n * record_size]);
     crypto::signature signature = *reinterpret_cast<const crypto::signature*>(&data[headerlen + n * record_size + sizeof(crypto::key_image)]);
 
-    ski.push_back(std::make_pair(key_image, signature));
+    ski.second.push_back(std::make_pair(key_image, signature));
   }
-  
-  return import_key_images(ski, offset, spent, unspent);
+
+  return ski;
+}
+//----------------------------------------------------------------------------------------------------
+std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> wallet2::read_key_images(std::istream &s, const std::string &filename) const
+{
+  PERF_TIMER(read_key_images);
+  const crypto::secret_key &skey = get_account().get_keys().m_view_secret_key;
+  crypto::chacha_key key;
+  crypto::generate_chacha_key(&skey, sizeof(skey), key, m_kdf_rounds);
+
+  std::string chunk, header;
+  THROW_WALLET_EXCEPTION_IF(!read_export_chunk(s, &chunk), error::wallet_internal_error, std::string("Bad data size from file ") + filename);
+  try
+  {
+    header = decrypt_with_chacha_key(chunk, key, skey, true);
+  }
+  catch (const std::exception &e)
+  {
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Failed to decrypt ") + filename + ": " + e.what());
+  }
+
+  const size_t headerlen = 4 + 2 * sizeof(crypto::public_key) + 4;
+  THROW_WALLET_EXCEPTION_IF(header.size() != headerlen, error::wallet_internal_error, std::string("Bad data size from file ") + filename);
+  const uint32_t offset = get_le32(&header[0]);
+  const crypto::public_key &public_spend_key = *(const crypto::public_key*)&header[4];
+  const crypto::public_key &public_view_key = *(const crypto::public_key*)&header[4 + sizeof(crypto::public_key)];
+  const uint32_t n_chunks = get_le32(&header[4 + 2 * sizeof(crypto::public_key)]);
+  const cryptonote::account_public_address &keys = get_account().get_keys().m_account_address;
+  if (public_spend_key != keys.m_spend_public_key || public_view_key != keys.m_view_public_key)
+  {
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string( "Key images from ") + filename + " are for a different account");
+  }
+  THROW_WALLET_EXCEPTION_IF(offset > m_transfers.size(), error::wallet_internal_error, "Offset larger than known outputs");
+
+  // the key images are applied in one go once all are read, since spent
+  // outputs are matched against the whole set, so only the ciphertext is
+  // kept to a batch of chunks
+  const size_t record_size = sizeof(crypto::key_image) + sizeof(crypto::signature);
+  std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> ski;
+  ski.first = offset;
+  std::vector<std::string> chunks;
+  std::vector<std::vector<std::pair<crypto::key_image, crypto::signature>>> parts;
+  for (size_t first = 0; first < n_chunks; first += EXPORT_CHUNK_BATCH)
+  {
+    chunks.resize(std::min<size_t>(EXPORT_CHUNK_BATCH, n_chunks - first));
+    for (std::string &chunk: chunks)
+      THROW_WALLET_EXCEPTION_IF(!read_export_chunk(s, &chunk), error::wallet_internal_error, std::string("Missing or extra chunks in file ") + filename);
+
+    parts.clear();
+    parts.resize(chunks.size());
+    for_each_export_chunk(chunks.size(), [&](size_t c){
+      std::string body;
+      try
+      {
+        body = decrypt_with_chacha_key(chunks[c], key, skey, true);
+      }
+      catch (const std::exception &e)
+      {
+        THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Failed to decrypt ") + filename + ": " + e.what());
+      }
+      THROW_WALLET_EXCEPTION_IF(body.size() < 4 || (body.size() - 4) % record_size, error::wallet_internal_error, "Bad key image chunk size");
+      THROW_WALLET_EXCEPTION_IF(get_le32(&body[0]) != first + c, error::wallet_internal_error, "Unexpected key image chunk index");
+      const size_t nki = (body.size() - 4) / record_size;
+      parts[c].reserve(nki);
+      for (size_t n = 0; n < nki; ++n)
+      {
+        const crypto::key_image &key_image = *reinterpret_cast<const crypto::key_image*>(&body[4 + n * record_size]);
+        const crypto::signature &signature = *reinterpret_cast<const crypto::signature*>(&body[4 + n * record_size + sizeof(crypto::key_image)]);
+        parts[c].push_back(std::make_pair(key_image, signature));
+      }
+    });
+    for (const auto &part: parts)
+      ski.second.insert(ski.second.end(), part.begin(), part.end());
+  }
+  THROW_WALLET_EXCEPTION_IF(!at_export_end(s), error::wallet_internal_error, std::string("Missing or extra chunks in file ") + filename);
+
+  return ski;
 }
 
 //----------------------------------------------------------------------------------------------------
@@ -12694,6 +13588,36 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
 
   req.key_images.reserve(signed_key_images.size());
 
+  // the domain and signature checks are independent per output and dominate
+  // the cost of a large import, so run them up front in batches on the
+  // threadpool; errors are still reported below, in order
+  enum { ki_status_ok = 0, ki_status_bad_domain, ki_status_bad_signature };
+  std::vector<uint8_t> ki_status(signed_key_images.size(), ki_status_ok);
+  PERF_TIMER_START(import_key_images_verify);
+  {
+    auto verify = [&](size_t n) {
+      const transfer_details &td = m_transfers[n + offset];
+      const crypto::key_image &key_image = signed_key_images[n].first;
+      if (td.m_key_image_known && key_image == td.m_key_image)
+        return;
+      const cryptonote::tx_out &out = td.m_tx.vout[td.m_internal_output_index];
+      if (out.target.type() != typeid(txout_to_key))
+        return; // reported below
+      const crypto::public_key &pkey = boost::get<cryptonote::txout_to_key>(out.target).key;
+      if (!(rct::scalarmultKey(rct::ki2rct(key_image), rct::curveOrder()) == rct::identity()))
+        ki_status[n] = ki_status_bad_domain;
+      else if (!crypto::check_ring_signature((const crypto::hash&)key_image, key_image, std::vector<const crypto::public_key*>{&pkey}, &signed_key_images[n].second))
+        ki_status[n] = ki_status_bad_signature;
+    };
+    const size_t n_batches = (signed_key_images.size() + EXPORT_CHUNK_SIZE - 1) / EXPORT_CHUNK_SIZE;
+    for_each_export_chunk(n_batches, [&](size_t c){
+      const size_t start = c * EXPORT_CHUNK_SIZE, end = std::min<size_t>(start + EXPORT_CHUNK_SIZE, signed_key_images.size());
+      for (size_t n = start; n < end; ++n)
+        verify(n);
+    });
+  }
+  PERF_TIMER_STOP(import_key_images_verify);
+
   PERF_TIMER_START(import_key_images_A);
   for (size_t n = 0; n < signed_key_images.size(); ++n)
   {
@@ -12708,15 +13632,15 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
     const cryptonote::txout_to_key &o = boost::get<cryptonote::txout_to_key>(out.target);
     const crypto::public_key pkey = o.key;
 
-    if (!td.m_key_image_known || !(key_image == td.m_key_image))
+    if (ki_status[n] != ki_status_ok)
     {
       std::vector<const crypto::public_key*> pkeys;
       pkeys.push_back(&pkey);
-      THROW_WALLET_EXCEPTION_IF(!(rct::scalarmultKey(rct::ki2rct(key_image), rct::curveOrder()) == rct::identity()),
+      THROW_WALLET_EXCEPTION_IF(ki_status[n] == ki_status_bad_domain,
           error::wallet_internal_error, "Key image out of validity domain: input " + boost::lexical_cast<std::string>(n + offset) + "/"
           + boost::lexical_cast<std::string>(signed_key_images.size()) + ", key image " + epee::string_tools::pod_to_hex(key_image));
 
-      THROW_WALLET_EXCEPTION_IF(!crypto::check_ring_signature((const crypto::hash&)key_image, key_image, pkeys, &signature),
+      THROW_WALLET_EXCEPTION_IF(ki_status[n] == ki_status_bad_signature,
           error::signature_check_failed, boost::lexical_cast<std::string>(n + offset) + "/"
           + boost::lexical_cast<std::string>(signed_key_images.size()) + ", key image " + epee::string_tools::pod_to_hex(key_image)
           + ", signature " + epee::string_tools::pod_to_hex(signature) + ", pubkey " + epee::string_tools::pod_to_hex(*pkeys[0]));
@@ -12933,6 +13857,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       {
         if (j->second.m_tx_hash == *spent_txid)
         {
+          unindex_payment(*j);
           m_payments.erase(j);
           break;
         }
@@ -12951,7 +13876,9 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       pd.m_amount_in = pd.m_amount_out = td.amount();         // fee is unknown
       pd.m_block_height = 0;  // spent block height is unknown
       const crypto::hash &spent_txid = crypto::null_hash; // spent txid is unknown
-      m_confirmed_txs.insert(std::make_pair(spent_txid, pd));
+      const auto inserted = m_confirmed_txs.insert(std::make_pair(spent_txid, pd));
+      if (inserted.second)
+        index_confirmed_tx(*inserted.first);
     }
     PERF_TIMER_STOP(import_key_images_G);
   }
@@ -13018,6 +13945,7 @@ void wallet2::import_payments(const payment_container &payments)
   {
     m_payments.emplace(p);
   }
+  invalidate_transfer_history_index();
 }
 void wallet2::import_payments_out(const std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>> &confirmed_payments)
 {
@@ -13026,6 +13954,7 @@ void wallet2::import_payments_out(const std::list<std::pair<crypto::hash,wallet2
   {
     m_confirmed_txs.emplace(p);
   }
+  invalidate_transfer_history_index();
 }
 
 std::tuple<size_t,crypto::hash,std::vector<crypto::hash>> wallet2::export_blockchain() const
@@ -13081,23 +14010,82 @@ std::pair<uint64_t, std::vector<tools::wallet2::transfer_details>> wallet2::expo
   return std::make_pair(offset, outs);
 }
 //----------------------------------------------------------------------------------------------------
-std::string wallet2::export_outputs_to_str(bool all) const
+std::string wallet2::export_outputs_to_str(bool all, bool legacy) const
 {
   PERF_TIMER(export_outputs_to_str);
+  std::ostringstream oss;
+  write_outputs(oss, all, legacy);
+  return oss.str();
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::export_outputs_to_file(const std::string &filename, bool all, bool legacy) const
+{
+  PERF_TIMER(export_outputs_to_file);
+  return save_export_to_file(*this, filename, [&](std::ostream &s){ write_outputs(s, all, legacy); });
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::write_outputs(std::ostream &s, bool all, bool legacy) const
+{
+  const cryptonote::account_public_address &keys = get_account().get_keys().m_account_address;
 
-  std::stringstream oss;
-  binary_archive<true> ar(oss);
-  auto outputs = export_outputs(all);
-  THROW_WALLET_EXCEPTION_IF(!::serialization::serialize(ar, outputs), error::wallet_internal_error, "Failed to serialize output data");
+  if (legacy)
+  {
+    // one encrypted blob, as read by wallets which predate chunked exports
+    std::stringstream oss;
+    binary_archive<true> ar(oss);
+    auto outputs = export_outputs(all);
+    THROW_WALLET_EXCEPTION_IF(!::serialization::serialize(ar, outputs), error::wallet_internal_error, "Failed to serialize output data");
+
+    std::string header;
+    header += std::string((const char *)&keys.m_spend_public_key, sizeof(crypto::public_key));
+    header += std::string((const char *)&keys.m_view_public_key, sizeof(crypto::public_key));
+    PERF_TIMER(export_outputs_encryption);
+    const std::string ciphertext = encrypt_with_view_secret_key(header + oss.str());
+    s.write(OUTPUT_EXPORT_FILE_MAGIC_V4, strlen(OUTPUT_EXPORT_FILE_MAGIC_V4));
+    s.write(ciphertext.data(), ciphertext.size());
+    return;
+  }
+
+  size_t offset = 0;
+  if (!all)
+    while (offset < m_transfers.size() && (m_transfers[offset].m_key_image_known && !m_transfers[offset].m_key_image_request))
+      ++offset;
+  const size_t count = m_transfers.size() - offset;
+  const size_t n_chunks = (count + EXPORT_CHUNK_SIZE - 1) / EXPORT_CHUNK_SIZE;
 
-  std::string magic(OUTPUT_EXPORT_FILE_MAGIC, strlen(OUTPUT_EXPORT_FILE_MAGIC));
-  const cryptonote::account_public_address &keys = get_account().get_keys().m_account_address;
   std::string header;
   header += std::string((const char *)&keys.m_spend_public_key, sizeof(crypto::public_key));
   header += std::string((const char *)&keys.m_view_public_key, sizeof(crypto::public_key));
-  PERF_TIMER(export_outputs_encryption);
-  std::string ciphertext = encrypt_with_view_secret_key(header + oss.str());
-  return magic + ciphertext;
+  add_le32(header, offset);
+  add_le32(header, count);
+  add_le32(header, n_chunks);
+
+  const crypto::secret_key &skey = get_account().get_keys().m_view_secret_key;
+  crypto::chacha_key key;
+  crypto::generate_chacha_key(&skey, sizeof(skey), key, m_kdf_rounds);
+  s.write(OUTPUT_EXPORT_FILE_MAGIC, strlen(OUTPUT_EXPORT_FILE_MAGIC));
+  write_export_chunk(s, encrypt_with_chacha_key(header.data(), header.size(), key, skey, true));
+
+  // serialize and encrypt a batch of chunks at a time, so we never hold a
+  // copy of more than that many outputs
+  std::vector<std::string> chunks;
+  for (size_t first = 0; first < n_chunks; first += EXPORT_CHUNK_BATCH)
+  {
+    chunks.resize(std::min<size_t>(EXPORT_CHUNK_BATCH, n_chunks - first));
+    for_each_export_chunk(chunks.size(), [&](size_t c){
+      const size_t begin = offset + (first + c) * EXPORT_CHUNK_SIZE, end = std::min<size_t>(begin + EXPORT_CHUNK_SIZE, m_transfers.size());
+      std::vector<tools::wallet2::transfer_details> outs(m_transfers.begin() + begin, m_transfers.begin() + end);
+      std::stringstream oss;
+      binary_archive<true> ar(oss);
+      THROW_WALLET_EXCEPTION_IF(!::serialization::serialize(ar, outs), error::wallet_internal_error, "Failed to serialize output data");
+      std::string data;
+      add_le32(data, first + c);
+      data += oss.str();
+      chunks[c] = encrypt_with_chacha_key(data.data(), data.size(), key, skey, true);
+    });
+    for (const std::string &chunk: chunks)
+      write_export_chunk(s, chunk);
+  }
 }
 //----------------------------------------------------------------------------------------------------
 size_t wallet2::import_outputs(const std::pair<uint64_t, std::vector<tools::wallet2::transfer_details>> &outputs)
@@ -13108,13 +14096,23 @@ size_t wallet2::import_outputs(const std::pair<uint64_t, std::vector<tools::wall
       "Imported outputs omit more outputs that we know of");
 
   const size_t offset = outputs.first;
-  const size_t original_size = m_transfers.size();
-  m_transfers.resize(offset + outputs.second.size());
   for (size_t i = 0; i < offset; ++i)
     m_transfers[i].m_key_image_request = false;
-  for (size_t i = 0; i < outputs.second.size(); ++i)
+  import_outputs_at(offset, outputs.second);
+  m_transfers.resize(offset + outputs.second.size());
+
+  return m_transfers.size();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::import_outputs_at(size_t offset, const std::vector<tools::wallet2::transfer_details> &outputs)
+{
+  const size_t original_size = m_transfers.size();
+  if (offset + outputs.size() > original_size)
+    m_transfers.resize(offset + outputs.size());
+  for (size_t i = 0; i < outputs.size(); ++i)
   {
-    transfer_details td = outputs.second[i];
+    transfer_details td = outputs[i];
+    td.compact_tx();
 
     // skip those we've already imported, or which have different data
     if (i + offset < original_size)
@@ -13164,16 +14162,21 @@ process:
     m_pub_keys[td.get_public_key()] = i + offset;
     m_transfers[i + offset] = std::move(td);
   }
-
-  return m_transfers.size();
 }
 //----------------------------------------------------------------------------------------------------
 size_t wallet2::import_outputs_from_str(const std::string &outputs_st)
 {
   PERF_TIMER(import_outputs_from_str);
-  std::string data = outputs_st;
   const size_t magiclen = strlen(OUTPUT_EXPORT_FILE_MAGIC);
-  if (data.size() < magiclen || memcmp(data.data(), OUTPUT_EXPORT_FILE_MAGIC, magiclen))
+  static_assert(sizeof(OUTPUT_EXPORT_FILE_MAGIC) == sizeof(OUTPUT_EXPORT_FILE_MAGIC_V4), "Unexpected magic size");
+  if (outputs_st.size() >= magiclen && !memcmp(outputs_st.data(), OUTPUT_EXPORT_FILE_MAGIC, magiclen))
+  {
+    std::istringstream iss(outputs_st);
+    iss.seekg(magiclen);
+    return read_outputs(iss, NULL);
+  }
+  std::string data = outputs_st;
+  if (data.size() < magiclen || memcmp(data.data(), OUTPUT_EXPORT_FILE_MAGIC_V4, magiclen))
   {
     THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Bad magic from outputs"));
   }
@@ -13247,6 +14250,156 @@ size_t wallet2::import_outputs_from_str(const std::string &outputs_st)
   return imported_outputs;
 }
 //----------------------------------------------------------------------------------------------------
+size_t wallet2::import_outputs_from_file(const std::string &filename, import_cursor *cursor)
+{
+  PERF_TIMER(import_outputs_from_file);
+  const size_t magiclen = strlen(OUTPUT_EXPORT_FILE_MAGIC);
+
+#ifndef WIN32
+  // chunked binary files are streamed, see save_export_to_file
+  {
+    std::ifstream istr;
+    istr.open(filename, std::ios_base::binary | std::ios_base::in);
+    THROW_WALLET_EXCEPTION_IF(!istr, error::wallet_internal_error, std::string(tr("failed to read file ")) + filename);
+    std::string magic(magiclen, '\0');
+    if (istr.read(&magic[0], magiclen) && !memcmp(magic.data(), OUTPUT_EXPORT_FILE_MAGIC, magiclen))
+      return read_outputs(istr, cursor);
+  }
+#endif
+
+  std::string data;
+  bool r = load_from_file(filename, data);
+  THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, std::string(tr("failed to read file ")) + filename);
+  if (data.size() >= magiclen && !memcmp(data.data(), OUTPUT_EXPORT_FILE_MAGIC, magiclen))
+  {
+    std::istringstream iss(data);
+    iss.seekg(magiclen);
+    return read_outputs(iss, cursor);
+  }
+  return import_outputs_from_str(data);
+}
+//----------------------------------------------------------------------------------------------------
+size_t wallet2::read_outputs(std::istream &s, import_cursor *cursor)
+{
+  PERF_TIMER(read_outputs);
+  const crypto::secret_key &skey = get_account().get_keys().m_view_secret_key;
+  crypto::chacha_key key;
+  crypto::generate_chacha_key(&skey, sizeof(skey), key, m_kdf_rounds);
+
+  std::string chunk, header;
+  THROW_WALLET_EXCEPTION_IF(!read_export_chunk(s, &chunk), error::wallet_internal_error, std::string("Bad data size for outputs"));
+  const crypto::hash file_id = crypto::cn_fast_hash(chunk.data(), chunk.size());
+  try
+  {
+    header = decrypt_with_chacha_key(chunk, key, skey, true);
+  }
+  catch (const std::exception &e)
+  {
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Failed to decrypt outputs: ") + e.what());
+  }
+
+  const size_t headerlen = 2 * sizeof(crypto::public_key) + 3 * 4;
+  THROW_WALLET_EXCEPTION_IF(header.size() != headerlen, error::wallet_internal_error, std::string("Bad data size for outputs"));
+  const crypto::public_key &public_spend_key = *(const crypto::public_key*)&header[0];
+  const crypto::public_key &public_view_key = *(const crypto::public_key*)&header[sizeof(crypto::public_key)];
+  const cryptonote::account_public_address &keys = get_account().get_keys().m_account_address;
+  if (public_spend_key != keys.m_spend_public_key || public_view_key != keys.m_view_public_key)
+  {
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Outputs from are for a different account"));
+  }
+  const uint32_t offset = get_le32(&header[2 * sizeof(crypto::public_key)]);
+  const uint32_t count = get_le32(&header[2 * sizeof(crypto::public_key) + 4]);
+  const uint32_t n_chunks = get_le32(&header[2 * sizeof(crypto::public_key) + 8]);
+  THROW_WALLET_EXCEPTION_IF(offset > m_transfers.size(), error::wallet_internal_error,
+      "Imported outputs omit more outputs that we know of");
+
+  // carry on from where an earlier import of this same export stopped
+  import_cursor start;
+  if (cursor && cursor->file_id == file_id)
+    start = *cursor;
+  THROW_WALLET_EXCEPTION_IF(start.next_chunk > n_chunks || start.next_output > count || offset + start.next_output > m_transfers.size(),
+      error::wallet_internal_error, "Bad import cursor");
+  for (size_t c = 0; c < start.next_chunk; ++c)
+    THROW_WALLET_EXCEPTION_IF(!read_export_chunk(s, NULL), error::wallet_internal_error, "Missing or extra chunks in outputs");
+
+  for (size_t i = 0; i < offset; ++i)
+    m_transfers[i].m_key_image_request = false;
+
+  // chunks are applied in order as they are read, up to the first one which
+  // fails, and the cursor moved past each, so a failed import can be resumed
+  // without redoing them
+  uint64_t next_output = start.next_output;
+  std::vector<std::string> chunks;
+  std::vector<std::vector<tools::wallet2::transfer_details>> parts;
+  std::vector<std::exception_ptr> errors;
+  for (size_t first = start.next_chunk; first < n_chunks; first += EXPORT_CHUNK_BATCH)
+  {
+    chunks.resize(std::min<size_t>(EXPORT_CHUNK_BATCH, n_chunks - first));
+    for (std::string &chunk: chunks)
+      THROW_WALLET_EXCEPTION_IF(!read_export_chunk(s, &chunk), error::wallet_internal_error, "Missing or extra chunks in outputs");
+    THROW_WALLET_EXCEPTION_IF(first + chunks.size() == n_chunks && !at_export_end(s), error::wallet_internal_error, "Missing or extra chunks in outputs");
+
+    PERF_TIMER_START(import_outputs_decrypt);
+    parts.clear();
+    parts.resize(chunks.size());
+    errors.clear();
+    errors.resize(chunks.size());
+    for_each_export_chunk(chunks.size(), [&](size_t c){
+      try
+      {
+        std::string body;
+        try
+        {
+          body = decrypt_with_chacha_key(chunks[c], key, skey, true);
+        }
+        catch (const std::exception &e)
+        {
+          THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Failed to decrypt outputs: ") + e.what());
+        }
+        THROW_WALLET_EXCEPTION_IF(body.size() < 4, error::wallet_internal_error, "Bad output chunk size");
+        THROW_WALLET_EXCEPTION_IF(get_le32(&body[0]) != first + c, error::wallet_internal_error, "Unexpected output chunk index");
+        std::stringstream iss;
+        iss << body.substr(4);
+        binary_archive<false> ar(iss);
+        THROW_WALLET_EXCEPTION_IF(!::serialization::serialize(ar, parts[c]) || !::serialization::check_stream_state(ar),
+            error::wallet_internal_error, "Failed to load output chunk");
+      }
+      catch (...) { errors[c] = std::current_exception(); }
+    });
+    PERF_TIMER_STOP(import_outputs_decrypt);
+
+    for (size_t c = 0; c < parts.size(); ++c)
+    {
+      if (errors[c])
+        std::rethrow_exception(errors[c]);
+      THROW_WALLET_EXCEPTION_IF(parts[c].size() > count - next_output, error::wallet_internal_error, "Unexpected number of outputs");
+      try
+      {
+        import_outputs_at(offset + next_output, parts[c]);
+      }
+      catch (const std::exception &e)
+      {
+        THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Failed to import outputs") + e.what());
+      }
+      next_output += parts[c].size();
+      std::vector<tools::wallet2::transfer_details>().swap(parts[c]);
+      if (cursor)
+      {
+        cursor->file_id = file_id;
+        cursor->next_chunk = first + c + 1;
+        cursor->next_output = next_output;
+      }
+    }
+  }
+  THROW_WALLET_EXCEPTION_IF(next_output != count, error::wallet_internal_error, "Unexpected number of outputs");
+  THROW_WALLET_EXCEPTION_IF(n_chunks == start.next_chunk && !at_export_end(s), error::wallet_internal_error, "Missing or extra chunks in outputs");
+
+  m_transfers.resize(offset + count);
+  if (cursor)
+    *cursor = import_cursor();
+  return m_transfers.size();
+}
+//----------------------------------------------------------------------------------------------------
 crypto::public_key wallet2::get_multisig_signer_public_key(const crypto::secret_key &spend_skey) const
 {
   crypto::public_key pkey;
@@ -13572,6 +14725,11 @@ std::string wallet2::encrypt(const char *plaintext, size_t len, const crypto::se
 {
   crypto::chacha_key key;
   crypto::generate_chacha_key(&skey, sizeof(skey), key, m_kdf_rounds);
+  return encrypt_with_chacha_key(plaintext, len, key, skey, authenticated);
+}
+//----------------------------------------------------------------------------------------------------
+std::string wallet2::encrypt_with_chacha_key(const char *plaintext, size_t len, const crypto::chacha_key &key, const crypto::secret_key &skey, bool authenticated) const
+{
   std::string ciphertext;
   crypto::chacha_iv iv = crypto::rand<crypto::chacha_iv>();
   ciphertext.resize(len + sizeof(iv) + (authenticated ? sizeof(crypto::signature) : 0));
@@ -13611,13 +14769,19 @@ std::string wallet2::encrypt_with_view_secret_key(const std::string &plaintext,
 //----------------------------------------------------------------------------------------------------
 template<typename T>
 T wallet2::decrypt(const std::string &ciphertext, const crypto::secret_key &skey, bool authenticated) const
+{
+  crypto::chacha_key key;
+  crypto::generate_chacha_key(&skey, sizeof(skey), key, m_kdf_rounds);
+  return decrypt_with_chacha_key<T>(ciphertext, key, skey, authenticated);
+}
+//----------------------------------------------------------------------------------------------------
+template<typename T>
+T wallet2::decrypt_with_chacha_key(const std::string &ciphertext, const crypto::chacha_key &key, const crypto::secret_key &skey, bool authenticated) const
 {
   const size_t prefix_size = sizeof(chacha_iv) + (authenticated ? sizeof(crypto::signature) : 0);
   THROW_WALLET_EXCEPTION_IF(ciphertext.size() < prefix_size,
     error::wallet_internal_error, "Unexpected ciphertext size");
 
-  crypto::chacha_key key;
-  crypto::generate_chacha_key(&skey, sizeof(skey), key, m_kdf_rounds);
   const crypto::chacha_iv &iv = *(const crypto::chacha_iv*)&ciphertext[0];
   if (authenticated)
   {
@@ -71,6 +71,7 @@
 #include "message_store.h"
 #include "wallet_light_rpc.h"
 #include "wallet_rpc_helpers.h"
+#include "cache_journal.h"
 
 #undef DINASTYCOIN_DEFAULT_LOG_CATEGORY
 #define DINASTYCOIN_DEFAULT_LOG_CATEGORY "wallet.wallet2"
@@ -86,11 +87,13 @@
   THROW_ON_RPC_RESPONSE_ERROR(r, err, res, method, tools::error::wallet_generic_rpc_error, method, res.status)
 
 class Serialization_portability_wallet_Test;
+class Serialization_transfer_details_compact_on_load_Test;
 class wallet_accessor_test;
 
 namespace tools
 {
   class ringdb;
+  class shared_block_cache;
   class wallet2;
   class Notify;
 
@@ -228,6 +231,7 @@ private:
   class wallet2
   {
     friend class ::Serialization_portability_wallet_Test;
+    friend class ::Serialization_transfer_details_compact_on_load_Test;
     friend class ::wallet_accessor_test;
     friend class wallet_keys_unlocker;
     friend class wallet_device_callback;
@@ -349,6 +353,23 @@ private:
       uint64_t amount() const { return m_amount; }
       const crypto::public_key &get_public_key() const { return boost::get<const cryptonote::txout_to_key>(m_tx.vout[m_internal_output_index].target).key; }
 
+      // once the tx is processed, the ring members of its inputs are never used again,
+      // only their key images are (to spot our own spends when importing key images)
+      void compact_tx()
+      {
+        for (cryptonote::txin_v &in: m_tx.vin)
+        {
+          if (in.type() == typeid(cryptonote::txin_to_key))
+          {
+            std::vector<uint64_t> &key_offsets = boost::get<cryptonote::txin_to_key>(in).key_offsets;
+            std::vector<uint64_t>().swap(key_offsets);
+          }
+        }
+        m_tx.vin.shrink_to_fit();
+        m_tx.vout.shrink_to_fit();
+        m_tx.extra.shrink_to_fit();
+      }
+
       BEGIN_SERIALIZE_OBJECT()
         FIELD(m_block_height)
         FIELD(m_tx)
@@ -517,6 +538,39 @@ private:
     typedef std::vector<transfer_details> transfer_container;
     typedef serializable_unordered_multimap<crypto::hash, payment_details> payment_container;
 
+    // Balances and addresses at a given height, which read only queries can use while the wallet is busy
+    struct balance_snapshot
+    {
+      struct subaddress_entry
+      {
+        std::string address;
+        std::string label;
+        bool used = false;
+        uint64_t num_unspent_outputs = 0;
+        // the following are indexed by the "strict" flag of the balance functions
+        bool has_balance[2] = {false, false};
+        uint64_t balance[2] = {0, 0};
+        uint64_t unlocked_balance[2] = {0, 0};
+        uint64_t blocks_to_unlock[2] = {0, 0};
+        uint64_t time_to_unlock[2] = {0, 0};
+      };
+
+      uint64_t height;
+      bool multisig_import_needed;
+      std::vector<std::vector<subaddress_entry>> accounts;
+    };
+
+    // Position of a confirmed transfer in the transfer history, which is ordered by height
+    struct transfer_history_key
+    {
+      uint64_t m_block_height;
+      crypto::hash m_tx_hash;
+      bool m_out;
+      cryptonote::subaddress_index m_subaddr_index;
+
+      bool operator<(const transfer_history_key &other) const;
+    };
+
     struct multisig_sig
     {
       rct::rctSig sigs;
@@ -680,6 +734,23 @@ private:
       bool error;
     };
 
+    // spans of blocks are immutable once parsed, so they can be shared between wallets
+    typedef std::shared_ptr<const std::vector<cryptonote::block_complete_entry>> shared_blocks;
+    typedef std::shared_ptr<const std::vector<parsed_block>> shared_parsed_blocks;
+
+    // how far an interrupted import_outputs_from_file got: chunks before
+    // next_chunk are applied, and the next one starts at next_output. The file
+    // is told by the hash of its encrypted header, which differs between
+    // exports, so a cursor is never used with another file
+    struct import_cursor
+    {
+      crypto::hash file_id;
+      size_t next_chunk;
+      uint64_t next_output;
+
+      import_cursor(): file_id(crypto::null_hash), next_chunk(0), next_output(0) {}
+    };
+
     struct is_out_data
     {
       crypto::public_key pkey;
@@ -947,6 +1018,12 @@ private:
     std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> unlocked_balance_per_subaddress(uint32_t subaddr_index_major, bool strict);
     // all locked & unlocked balances of all subaddress accounts
     uint64_t balance_all(bool strict) const;
+    /*!
+     * \brief make_balance_snapshot  Capture balances, subaddresses and labels of all accounts in one pass
+     * \param previous               An older snapshot to reuse subaddress strings from, may be NULL
+     * \return                       The new snapshot, or NULL for light wallets
+     */
+    std::shared_ptr<const balance_snapshot> make_balance_snapshot(const balance_snapshot *previous = NULL);
     uint64_t unlocked_balance_all(bool strict, uint64_t *blocks_to_unlock = NULL, uint64_t *time_to_unlock = NULL);
     template<typename T>
     void transfer_selected(const std::vector<cryptonote::tx_destination_entry>& dsts, const std::vector<size_t>& selected_transfers, size_t fake_outputs_count,
@@ -1001,6 +1078,16 @@ private:
       uint64_t min_height, uint64_t max_height = (uint64_t)-1, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
     void get_unconfirmed_payments_out(std::list<std::pair<crypto::hash,wallet2::unconfirmed_transfer_details>>& unconfirmed_payments, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
     void get_unconfirmed_payments(std::list<std::pair<crypto::hash,wallet2::pool_payment_details>>& unconfirmed_payments, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
+    /*!
+     * \brief get_transfer_history  Get confirmed incoming and/or outgoing transfers, ordered by height, a page at a time
+     * \param after                 Only return transfers after this position (none to start from the beginning)
+     * \param max_count             Maximum number of transfers to return, 0 for no limit
+     * \param last                  Set to the position of the last transfer returned
+     * \return                      Whether more transfers are available after last
+     */
+    bool get_transfer_history(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments,
+      bool in, bool out, uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices,
+      const boost::optional<transfer_history_key> &after, size_t max_count, transfer_history_key &last) const;
 
     uint64_t get_blockchain_current_height() const { return m_light_wallet_blockchain_height ? m_light_wallet_blockchain_height : m_blockchain.size(); }
     void rescan_spent();
@@ -1226,6 +1313,10 @@ private:
     void ignore_outputs_below(uint64_t value) { m_ignore_outputs_below = value; }
     bool track_uses() const { return m_track_uses; }
     void track_uses(bool value) { m_track_uses = value; }
+    bool cache_journal_enabled() const { return m_cache_journal_enabled; }
+    void cache_journal_enabled(bool value) { m_cache_journal_enabled = value; }
+    const std::shared_ptr<shared_block_cache> &get_shared_block_cache() const { return m_shared_block_cache; }
+    void set_shared_block_cache(const std::shared_ptr<shared_block_cache> &cache) { m_shared_block_cache = cache; }
     BackgroundMiningSetupType setup_background_mining() const { return m_setup_background_mining; }
     void setup_background_mining(BackgroundMiningSetupType value) { m_setup_background_mining = value; }
     uint32_t inactivity_lock_timeout() const { return m_inactivity_lock_timeout; }
@@ -1246,6 +1337,8 @@ private:
     void set_rpc_client_secret_key(const crypto::secret_key &key) { m_rpc_client_secret_key = key; m_node_rpc_proxy.set_client_secret_key(key); }
     uint64_t credits_target() const { return m_credits_target; }
     void credits_target(uint64_t threshold) { m_credits_target = threshold; }
+    uint32_t refresh_pipeline_depth() const { return m_refresh_pipeline_depth; }
+    void refresh_pipeline_depth(uint32_t depth) { m_refresh_pipeline_depth = depth; }
 
     bool get_tx_key_cached(const crypto::hash &txid, crypto::secret_key &tx_key, std::vector<crypto::secret_key> &additional_tx_keys) const;
     void set_tx_key(const crypto::hash &txid, const crypto::secret_key &tx_key, const std::vector<crypto::secret_key> &additional_tx_keys, const boost::optional<cryptonote::account_public_address> &single_destination_subaddress = boost::none);
@@ -1368,16 +1461,19 @@ private:
 
     // Import/Export wallet data
     std::pair<uint64_t, std::vector<tools::wallet2::transfer_details>> export_outputs(bool all = false) const;
-    std::string export_outputs_to_str(bool all = false) const;
+    std::string export_outputs_to_str(bool all = false, bool legacy = false) const;
+    bool export_outputs_to_file(const std::string &filename, bool all = false, bool legacy = false) const;
     size_t import_outputs(const std::pair<uint64_t, std::vector<tools::wallet2::transfer_details>> &outputs);
     size_t import_outputs_from_str(const std::string &outputs_st);
+    size_t import_outputs_from_file(const std::string &filename, import_cursor *cursor = NULL);
     payment_container export_payments() const;
     void import_payments(const payment_container &payments);
     void import_payments_out(const std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>> &confirmed_payments);
     std::tuple<size_t, crypto::hash, std::vector<crypto::hash>> export_blockchain() const;
     void import_blockchain(const std::tuple<size_t, crypto::hash, std::vector<crypto::hash>> &bc);
-    bool export_key_images(const std::string &filename, bool all = false) const;
+    bool export_key_images(const std::string &filename, bool all = false, bool legacy = false) const;
     std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> export_key_images(bool all = false) const;
+    std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> load_key_images(const std::string &filename) const;
     uint64_t import_key_images(const std::vector<std::pair<crypto::key_image, crypto::signature>> &signed_key_images, size_t offset, uint64_t &spent, uint64_t &unspent, bool check_spent = true);
     uint64_t import_key_images(const std::string &filename, uint64_t &spent, uint64_t &unspent);
     bool import_key_images(std::vector<crypto::key_image> key_images, size_t offset=0, boost::optional<std::unordered_set<size_t>> selected_transfers=boost::none);
@@ -1504,6 +1600,7 @@ private:
     bool get_ring(const crypto::key_image &key_image, std::vector<uint64_t> &outs);
     bool get_rings(const crypto::hash &txid, std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> &outs);
     bool set_ring(const crypto::key_image &key_image, const std::vector<uint64_t> &outs, bool relative);
+    bool set_rings(const std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> &rings, bool relative);
     bool unset_ring(const std::vector<crypto::key_image> &key_images);
     bool unset_ring(const crypto::hash &txid);
     bool find_and_save_rings(bool force = true);
@@ -1584,7 +1681,17 @@ private:
     void pull_blocks(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, uint64_t &current_height);
     void pull_hashes(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes);
     void fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, bool force = false);
-    void pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception);
+    void update_refresh_span(size_t n_blocks, uint64_t n_bytes, uint64_t elapsed_ms);
+    void pull_pool_hashes(std::vector<crypto::hash> &tx_hashes);
+    std::string encrypt_with_chacha_key(const char *plaintext, size_t len, const crypto::chacha_key &key, const crypto::secret_key &skey, bool authenticated) const;
+    template<typename T=std::string> T decrypt_with_chacha_key(const std::string &ciphertext, const crypto::chacha_key &key, const crypto::secret_key &skey, bool authenticated) const;
+    void write_key_images(std::ostream &s, bool all, bool legacy) const;
+    std::vector<std::pair<crypto::key_image, crypto::signature>> sign_key_images(size_t begin, size_t end) const;
+    std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> read_key_images(std::istream &s, const std::string &filename) const;
+    void write_outputs(std::ostream &s, bool all, bool legacy) const;
+    size_t read_outputs(std::istream &s, import_cursor *cursor);
+    void import_outputs_at(size_t offset, const std::vector<tools::wallet2::transfer_details> &outputs);
+    void pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<crypto::hash> &prev_block_hashes, shared_blocks &blocks, shared_parsed_blocks &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception);
     void process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
     //added by kgc
     void force_confirm_genesis_block(uint64_t start_height, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache);
@@ -1619,6 +1726,30 @@ private:
     std::vector<size_t> get_only_rct(const std::vector<size_t> &unused_dust_indices, const std::vector<size_t> &unused_transfers_indices) const;
     void scan_output(const cryptonote::transaction &tx, bool miner_tx, const crypto::public_key &tx_pub_key, size_t i, tx_scan_info_t &tx_scan_info, int &num_vouts_received, std::unordered_map<cryptonote::subaddress_index, uint64_t> &tx_money_got_in_outs, std::vector<size_t> &outs, bool pool);
     void trim_hashchain();
+    // Secondary indices over m_payments and m_confirmed_txs, by height and by account. They point
+    // to elements of the unordered containers, which are stable across rehashing, and are updated
+    // along with them, or invalidated and lazily rebuilt after bulk changes.
+    typedef std::multimap<transfer_history_key, const std::pair<const crypto::hash, payment_details>*> payment_history_index;
+    typedef std::multimap<transfer_history_key, const std::pair<const crypto::hash, confirmed_transfer_details>*> confirmed_tx_history_index;
+    struct transfer_history_index
+    {
+      bool valid = false;
+      payment_history_index payments;
+      confirmed_tx_history_index confirmed_txs;
+      std::map<uint32_t, payment_history_index> payments_by_account;
+      std::map<uint32_t, confirmed_tx_history_index> confirmed_txs_by_account;
+    };
+    void index_payment(const std::pair<const crypto::hash, payment_details> &payment);
+    void unindex_payment(const std::pair<const crypto::hash, payment_details> &payment);
+    void index_confirmed_tx(const std::pair<const crypto::hash, confirmed_transfer_details> &ctd);
+    void unindex_confirmed_tx(const std::pair<const crypto::hash, confirmed_transfer_details> &ctd);
+    void invalidate_transfer_history_index() const { m_transfer_history_index.valid = false; }
+    const transfer_history_index &get_transfer_history_index() const;
+    bool get_cache_data(std::string &cache_data);
+    wallet2::cache_file_data encrypt_cache_data(const std::string &cache_data) const;
+    void load_cache_journal(std::string &cache_data);
+    bool store_cache_journal(const std::string &cache_data);
+    void reset_cache_journal(const std::string &cache_data);
     crypto::key_image get_multisig_composite_key_image(size_t n) const;
     rct::multisig_kLRki get_multisig_composite_kLRki(size_t n,  const std::unordered_set<crypto::public_key> &ignore_set, std::unordered_set<rct::key> &used_L, std::unordered_set<rct::key> &new_used_L) const;
     rct::multisig_kLRki get_multisig_kLRki(size_t n, const rct::key &k) const;
@@ -1685,6 +1816,7 @@ private:
 
     transfer_container m_transfers;
     payment_container m_payments;
+    mutable transfer_history_index m_transfer_history_index;
     serializable_unordered_map<crypto::key_image, size_t> m_key_images;
     serializable_unordered_map<crypto::public_key, size_t> m_pub_keys;
     cryptonote::account_public_address m_account_public_address;
@@ -1745,6 +1877,7 @@ private:
     uint64_t m_ignore_outputs_above;
     uint64_t m_ignore_outputs_below;
     bool m_track_uses;
+    bool m_cache_journal_enabled;
     uint32_t m_inactivity_lock_timeout;
     BackgroundMiningSetupType m_setup_background_mining;
     bool m_persistent_rpc_client_id;
@@ -1752,6 +1885,8 @@ private:
     bool m_is_initialized;
     NodeRPCProxy m_node_rpc_proxy;
     std::unordered_set<crypto::hash> m_scanned_pool_txs[2];
+    std::unordered_set<crypto::hash> m_pool_tx_hashes; // pool as of m_pool_token
+    uint64_t m_pool_token;
     size_t m_subaddress_lookahead_major, m_subaddress_lookahead_minor;
     std::string m_device_name;
     std::string m_device_derivation_path;
@@ -1762,6 +1897,9 @@ private:
     crypto::secret_key m_rpc_client_secret_key;
     rpc_payment_state_t m_rpc_payment_state;
     uint64_t m_credits_target;
+    uint32_t m_refresh_pipeline_depth;
+    uint64_t m_refresh_span_blocks;
+    uint64_t m_refresh_bytes_per_block;
 
     // Aux transaction data from device
     serializable_unordered_map<crypto::hash, std::string> m_tx_device;
@@ -1783,6 +1921,9 @@ private:
     std::string m_ring_database;
     bool m_ring_history_saved;
     std::unique_ptr<ringdb> m_ringdb;
+    bool m_defer_rings;
+    std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> m_deferred_rings;
+    std::shared_ptr<shared_block_cache> m_shared_block_cache;
     boost::optional<crypto::chacha_key> m_ringdb_key;
 
     uint64_t m_last_block_reward;
@@ -1805,6 +1946,11 @@ private:
     ExportFormat m_export_format;
     bool m_load_deprecated_formats;
 
+    tools::cache_journal m_cache_journal;
+    uint64_t m_cache_journal_base_size;
+    uint64_t m_cache_journal_size;
+    bool m_cache_journal_compact;
+
     static boost::mutex default_daemon_address_lock;
     static std::string default_daemon_address;
   };
@@ -39,6 +39,7 @@ using namespace epee;
 #include "version.h"
 #include "wallet_rpc_server.h"
 #include "wallet/wallet_args.h"
+#include "wallet/shared_block_cache.h"
 #include "common/command_line.h"
 #include "common/i18n.h"
 #include "cryptonote_config.h"
@@ -59,6 +60,7 @@ using namespace epee;
 #define DINASTYCOIN_DEFAULT_LOG_CATEGORY "wallet.rpc"
 
 #define DEFAULT_AUTO_REFRESH_PERIOD 20 // seconds
+#define RPC_SERVER_THREADS 4
 
 namespace
 {
@@ -67,6 +69,7 @@ namespace
   const command_line::arg_descriptor<bool> arg_restricted = {"restricted-rpc", "Restricts to view-only commands", false};
   const command_line::arg_descriptor<std::string> arg_wallet_dir = {"wallet-dir", "Directory for newly created wallets"};
   const command_line::arg_descriptor<bool> arg_prompt_for_password = {"prompt-for-password", "Prompts for password when not provided", false};
+  const command_line::arg_descriptor<size_t> arg_max_wallets = {"max-wallets", "Keep up to this many wallets open, addressed as /wallet/<name>/json_rpc, sharing block downloads", 1};
 
   constexpr const char default_rpc_username[] = "dinastycoin";
 
@@ -104,6 +107,61 @@ namespace
         entry.suggested_confirmations_threshold = std::max(entry.suggested_confirmations_threshold, (unlock_time - now + DIFFICULTY_TARGET_V2 - 1) / DIFFICULTY_TARGET_V2);
     }
   }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::string transfer_history_cursor_to_str(const tools::wallet2::transfer_history_key &key)
+  {
+    return std::to_string(key.m_block_height) + ":" + epee::string_tools::pod_to_hex(key.m_tx_hash) + ":" + (key.m_out ? "out" : "in") + ":" +
+        std::to_string(key.m_subaddr_index.major) + ":" + std::to_string(key.m_subaddr_index.minor);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool transfer_history_cursor_from_str(const std::string &str, tools::wallet2::transfer_history_key &key)
+  {
+    std::vector<std::string> fields;
+    boost::split(fields, str, boost::is_any_of(":"));
+    if (fields.size() != 5)
+      return false;
+    if (!epee::string_tools::get_xtype_from_string(key.m_block_height, fields[0]))
+      return false;
+    if (!epee::string_tools::hex_to_pod(fields[1], key.m_tx_hash))
+      return false;
+    if (fields[2] != "in" && fields[2] != "out")
+      return false;
+    key.m_out = fields[2] == "out";
+    return epee::string_tools::get_xtype_from_string(key.m_subaddr_index.major, fields[3]) &&
+        epee::string_tools::get_xtype_from_string(key.m_subaddr_index.minor, fields[4]);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  // the body of the json rpc request this thread is handling, parsed once by handle_http_request
+  thread_local epee::serialization::portable_storage *t_json_rpc_request = NULL;
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool is_snapshot_method(const std::string &method)
+  {
+    return method == "get_balance" || method == "getbalance" || method == "get_address" || method == "getaddress" ||
+        method == "get_height" || method == "getheight" || method == "get_version";
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool is_long_running_method(const std::string &method)
+  {
+    return boost::starts_with(method, "transfer") || boost::starts_with(method, "sweep_") || method == "refresh" ||
+        boost::starts_with(method, "rescan_") || boost::starts_with(method, "import_") || method == "submit_multisig";
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool is_wallet_opening_method(const std::string &method)
+  {
+    return method == "open_wallet" || method == "create_wallet" || method == "restore_deterministic_wallet" || method == "generate_from_keys";
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool get_wallet_name_from_uri(const std::string &uri, std::string &name)
+  {
+    static const std::string prefix = "/wallet/", suffix = "/json_rpc";
+    if (uri.size() <= prefix.size() + suffix.size() || !boost::starts_with(uri, prefix) || !boost::ends_with(uri, suffix))
+      return false;
+    name = uri.substr(prefix.size(), uri.size() - prefix.size() - suffix.size());
+    return name.find('/') == std::string::npos;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  // set while a call is being answered from the balance snapshot rather than the wallet
+  thread_local const tools::wallet2::balance_snapshot *t_balance_snapshot = NULL;
 }
 
 namespace tools
@@ -114,19 +172,363 @@ namespace tools
   }
 
   //------------------------------------------------------------------------------------------------------------------------------
-  wallet_rpc_server::wallet_rpc_server():m_wallet(NULL), rpc_login_file(), m_stop(false), m_restricted(false), m_vm(NULL)
+  wallet_rpc_server::wallet_rpc_server():m_default_wallet(NULL), rpc_login_file(), m_stop(false), m_restricted(false), m_vm(NULL), m_max_wallets(1), m_balance_snapshot_dirty(true)
   {
+    // calls made without a wallet, eg opening one, are serialized by the lock of the NULL wallet
+    m_wallet_locks[NULL] = std::make_shared<boost::mutex>();
   }
   //------------------------------------------------------------------------------------------------------------------------------
   wallet_rpc_server::~wallet_rpc_server()
   {
-    if (m_wallet)
-      delete m_wallet;
+    for (const auto &i: m_wallets)
+      if (i.second != m_default_wallet)
+        delete i.second;
+    if (m_default_wallet)
+      delete m_default_wallet;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   void wallet_rpc_server::set_wallet(wallet2 *cr)
   {
-    m_wallet = cr;
+    m_default_wallet = cr;
+    if (m_default_wallet)
+      register_wallet(m_default_wallet);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  wallet2 *&wallet_rpc_server::request_wallet::get()
+  {
+    static thread_local wallet2 *wallet = NULL;
+    return wallet;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::register_wallet(wallet2 *wallet)
+  {
+    const std::string name = boost::filesystem::path(wallet->get_wallet_file()).filename().string();
+    m_wallets[name] = wallet;
+    m_wallet_locks[wallet] = std::make_shared<boost::mutex>();
+    if (m_max_wallets > 1)
+    {
+      if (!m_shared_block_cache)
+        m_shared_block_cache = std::make_shared<shared_block_cache>();
+      wallet->set_shared_block_cache(m_shared_block_cache);
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::unregister_wallet(const wallet2 *wallet)
+  {
+    // the wallet object itself was already deleted by the call closing it
+    for (auto i = m_wallets.begin(); i != m_wallets.end(); ++i)
+    {
+      if (i->second == wallet)
+      {
+        m_wallets.erase(i);
+        break;
+      }
+    }
+    m_wallet_locks.erase(wallet);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::shared_ptr<boost::mutex> wallet_rpc_server::get_wallet_lock(const wallet2 *wallet) const
+  {
+    // m_wallet_mutex must be held
+    const auto i = m_wallet_locks.find(wallet);
+    return i == m_wallet_locks.end() ? nullptr : i->second;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::lock_wallet(boost::unique_lock<boost::mutex> &lock, const wallet2 *wallet, std::shared_ptr<boost::mutex> &wallet_mutex, boost::unique_lock<boost::mutex> &wallet_lock)
+  {
+    // lock holds m_wallet_mutex, which is released while waiting for a busy
+    // wallet so the other wallets stay usable. Returns false if the wallet was
+    // closed in the meantime, in which case the caller has to look it up again
+    wallet_mutex = get_wallet_lock(wallet);
+    if (!wallet_mutex)
+      return true;
+    wallet_lock = boost::unique_lock<boost::mutex>(*wallet_mutex, boost::try_to_lock);
+    if (wallet_lock.owns_lock())
+      return true;
+    lock.unlock();
+    wallet_lock.lock();
+    lock.lock();
+    if (get_wallet_lock(wallet) == wallet_mutex)
+      return true;
+    wallet_lock.unlock();
+    return false;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::find_wallet(const std::string *name, wallet2 *&wallet) const
+  {
+    // m_wallet_mutex must be held. Without a name, this is the default wallet, if any
+    if (!name)
+    {
+      wallet = m_default_wallet;
+      return true;
+    }
+    const auto i = m_wallets.find(*name);
+    if (i == m_wallets.end())
+      return false;
+    wallet = i->second;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::too_many_wallets(epee::json_rpc::error& er)
+  {
+    boost::unique_lock<boost::mutex> lock(m_wallet_mutex);
+    if (m_max_wallets <= 1 || m_wallets.size() < m_max_wallets)
+      return false;
+    er.code = WALLET_RPC_ERROR_CODE_TOO_MANY_WALLETS;
+    er.message = "Too many open wallets, close one first";
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context)
+  {
+    MINFO("HTTP [" << m_conn_context.m_remote_address.host_str() << "] " << query_info.m_http_method_str << " " << query_info.m_URI);
+    response.m_response_code = 200;
+    response.m_response_comment = "Ok";
+    try
+    {
+      bool handled = false;
+      std::string wallet_name;
+      const bool wallet_uri = get_wallet_name_from_uri(query_info.m_URI, wallet_name);
+      // the method picks how the wallet is locked, and the parsed body is then dispatched as is
+      epee::serialization::portable_storage json_rpc_request;
+      std::string method;
+      if ((wallet_uri || query_info.m_URI == "/json_rpc") && json_rpc_request.load_from_json(query_info.m_body))
+      {
+        json_rpc_request.get_value("method", method, nullptr);
+        t_json_rpc_request = &json_rpc_request;
+      }
+      auto json_rpc_cleanup = epee::misc_utils::create_scope_leave_handler([](){ t_json_rpc_request = NULL; });
+
+      // the wallet is picked by the uri, the methods are the same as on /json_rpc
+      epee::net_utils::http::http_request_info wallet_query_info;
+      if (wallet_uri)
+      {
+        wallet_query_info = query_info;
+        wallet_query_info.m_URI = "/json_rpc";
+      }
+      const epee::net_utils::http::http_request_info &request = wallet_uri ? wallet_query_info : query_info;
+      const std::string *name = wallet_uri ? &wallet_name : NULL;
+
+      // look the wallet up and lock it, then let go of m_wallet_mutex so
+      // calls on other wallets can run alongside this one
+      boost::unique_lock<boost::mutex> lock(m_wallet_mutex);
+      const bool opens_wallet = is_wallet_opening_method(method) && (m_max_wallets > 1 || wallet_uri);
+      wallet2 *wallet = NULL;
+      std::shared_ptr<boost::mutex> wallet_mutex;
+      boost::unique_lock<boost::mutex> wallet_lock;
+      std::shared_ptr<const wallet2::balance_snapshot> snapshot;
+      bool found;
+      while ((found = find_wallet(name, wallet)))
+      {
+        if (opens_wallet)
+          wallet = NULL; // the new wallet is opened next to the current ones
+        if (wallet && wallet == m_default_wallet && is_snapshot_method(method))
+        {
+          // answered from the snapshot if the wallet is busy, eg refreshing
+          wallet_mutex = get_wallet_lock(wallet);
+          wallet_lock = boost::unique_lock<boost::mutex>(*wallet_mutex, boost::try_to_lock);
+          if (!wallet_lock.owns_lock() && (snapshot = get_balance_snapshot()))
+            break;
+        }
+        if (!wallet_lock.owns_lock() && !lock_wallet(lock, wallet, wallet_mutex, wallet_lock))
+          continue; // closed while we waited
+        wallet2 *current;
+        if (!wallet && !opens_wallet && find_wallet(name, current) && current)
+        {
+          // a wallet was opened while we waited
+          wallet_lock.unlock();
+          continue;
+        }
+        break;
+      }
+      if (!found)
+      {
+        lock.unlock();
+        response.m_response_code = 404;
+        response.m_response_comment = "Not found";
+        return true;
+      }
+      if (wallet && wallet == m_default_wallet && !snapshot)
+      {
+        if (m_balance_snapshot_dirty && is_long_running_method(method))
+          update_balance_snapshot();
+        m_balance_snapshot_dirty = true;
+      }
+      lock.unlock();
+
+      m_wallet = snapshot ? NULL : wallet;
+      t_balance_snapshot = snapshot.get();
+      auto wallet_cleanup = epee::misc_utils::create_scope_leave_handler([this](){ m_wallet = NULL; t_balance_snapshot = NULL; });
+      auto update_wallets = [&]()
+      {
+        // the call opened or closed a wallet. This runs before the wallet lock
+        // is released, so callers waiting on it then find the new wallet
+        wallet2 *new_wallet = m_wallet;
+        if (snapshot || new_wallet == wallet)
+          return;
+        lock.lock();
+        if (wallet)
+          unregister_wallet(wallet);
+        if (new_wallet)
+          register_wallet(new_wallet);
+        if (wallet == m_default_wallet || new_wallet)
+        {
+          m_default_wallet = new_wallet;
+          boost::unique_lock<boost::mutex> snapshot_lock(m_balance_snapshot_mutex);
+          m_balance_snapshot.reset();
+        }
+        lock.unlock();
+      };
+      try { handled = handle_http_request_map(request, response, m_conn_context); }
+      catch (...) { update_wallets(); throw; }
+      update_wallets();
+
+      if (!handled)
+      {
+        response.m_response_code = 404;
+        response.m_response_comment = "Not found";
+      }
+    }
+    catch (const std::exception &e)
+    {
+      MERROR(m_conn_context << "Exception in handle_http_request_map: " << e.what());
+      response.m_response_code = 500;
+      response.m_response_comment = "Internal Server Error";
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  epee::serialization::portable_storage *wallet_rpc_server::get_json_rpc_request()
+  {
+    return t_json_rpc_request;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::shared_ptr<const wallet2::balance_snapshot> wallet_rpc_server::get_balance_snapshot()
+  {
+    boost::unique_lock<boost::mutex> lock(m_balance_snapshot_mutex);
+    return m_balance_snapshot;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::update_balance_snapshot()
+  {
+    // m_wallet_mutex and the default wallet's lock must be held
+    std::shared_ptr<const wallet2::balance_snapshot> snapshot;
+    try
+    {
+      if (m_default_wallet)
+        snapshot = m_default_wallet->make_balance_snapshot(get_balance_snapshot().get());
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to update balance snapshot: " << e.what());
+    }
+    m_balance_snapshot_dirty = false;
+    boost::unique_lock<boost::mutex> lock(m_balance_snapshot_mutex);
+    m_balance_snapshot = snapshot;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::fill_balance_from_snapshot(const wallet2::balance_snapshot &snapshot, const wallet_rpc::COMMAND_RPC_GET_BALANCE::request& req, wallet_rpc::COMMAND_RPC_GET_BALANCE::response& res, epee::json_rpc::error& er)
+  {
+    if (!req.all_accounts)
+    {
+      if (req.account_index >= snapshot.accounts.size())
+      {
+        er.code = WALLET_RPC_ERROR_CODE_ACCOUNT_INDEX_OUT_OF_BOUNDS;
+        er.message = "Account index is out of bound";
+        return false;
+      }
+      for (uint32_t i: req.address_indices)
+      {
+        if (i >= snapshot.accounts[req.account_index].size())
+        {
+          er.code = WALLET_RPC_ERROR_CODE_ADDRESS_INDEX_OUT_OF_BOUNDS;
+          er.message = "Address index is out of bound";
+          return false;
+        }
+      }
+    }
+
+    const int strict = req.strict ? 1 : 0;
+    res.balance = 0;
+    res.unlocked_balance = 0;
+    res.blocks_to_unlock = 0;
+    res.time_to_unlock = 0;
+    res.multisig_import_needed = snapshot.multisig_import_needed;
+    res.per_subaddress.clear();
+    const uint32_t first_account = req.all_accounts ? 0 : req.account_index;
+    const uint32_t last_account = req.all_accounts ? snapshot.accounts.size() : req.account_index + 1;
+    for (uint32_t account_index = first_account; account_index < last_account; ++account_index)
+    {
+      const std::vector<wallet2::balance_snapshot::subaddress_entry> &account = snapshot.accounts[account_index];
+      std::set<uint32_t> address_indices;
+      if (!req.all_accounts && !req.address_indices.empty())
+        address_indices = req.address_indices;
+      for (uint32_t i = 0; i < account.size(); ++i)
+      {
+        const wallet2::balance_snapshot::subaddress_entry &entry = account[i];
+        res.balance += entry.balance[strict];
+        res.unlocked_balance += entry.unlocked_balance[strict];
+        res.blocks_to_unlock = std::max(res.blocks_to_unlock, entry.blocks_to_unlock[strict]);
+        res.time_to_unlock = std::max(res.time_to_unlock, entry.time_to_unlock[strict]);
+        if ((req.all_accounts || req.address_indices.empty()) && entry.has_balance[strict])
+          address_indices.insert(i);
+      }
+      for (uint32_t i: address_indices)
+      {
+        const wallet2::balance_snapshot::subaddress_entry &entry = account[i];
+        wallet_rpc::COMMAND_RPC_GET_BALANCE::per_subaddress_info info;
+        info.account_index = account_index;
+        info.address_index = i;
+        info.address = entry.address;
+        info.balance = entry.balance[strict];
+        info.unlocked_balance = entry.unlocked_balance[strict];
+        info.blocks_to_unlock = entry.blocks_to_unlock[strict];
+        info.time_to_unlock = entry.time_to_unlock[strict];
+        info.label = entry.label;
+        info.num_unspent_outputs = entry.num_unspent_outputs;
+        res.per_subaddress.emplace_back(std::move(info));
+      }
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::fill_address_from_snapshot(const wallet2::balance_snapshot &snapshot, const wallet_rpc::COMMAND_RPC_GET_ADDRESS::request& req, wallet_rpc::COMMAND_RPC_GET_ADDRESS::response& res, epee::json_rpc::error& er)
+  {
+    if (req.account_index >= snapshot.accounts.size() || snapshot.accounts[req.account_index].empty())
+    {
+      er.code = WALLET_RPC_ERROR_CODE_ACCOUNT_INDEX_OUT_OF_BOUNDS;
+      er.message = "Account index is out of bound";
+      return false;
+    }
+    const std::vector<wallet2::balance_snapshot::subaddress_entry> &account = snapshot.accounts[req.account_index];
+    for (uint32_t i: req.address_index)
+    {
+      if (i >= account.size())
+      {
+        er.code = WALLET_RPC_ERROR_CODE_ADDRESS_INDEX_OUT_OF_BOUNDS;
+        er.message = "Address index is out of bound";
+        return false;
+      }
+    }
+
+    res.addresses.clear();
+    std::vector<uint32_t> req_address_index = req.address_index;
+    if (req_address_index.empty())
+    {
+      for (uint32_t i = 0; i < account.size(); ++i)
+        req_address_index.push_back(i);
+    }
+    for (uint32_t i : req_address_index)
+    {
+      res.addresses.resize(res.addresses.size() + 1);
+      auto& info = res.addresses.back();
+      info.address = account[i].address;
+      info.label = account[i].label;
+      info.address_index = i;
+      info.used = account[i].used;
+    }
+    res.address = account[0].address;
+    return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::run()
@@ -137,10 +539,47 @@ namespace tools
         return true;
       if (boost::posix_time::microsec_clock::universal_time() < m_last_auto_refresh_time + boost::posix_time::seconds(m_auto_refresh_period))
         return true;
-      try {
-        if (m_wallet) m_wallet->refresh(m_wallet->is_trusted_daemon());
-      } catch (const std::exception& ex) {
-        LOG_ERROR("Exception at while refreshing, what=" << ex.what());
+      // each wallet is refreshed under its own lock only, so a slow refresh
+      // does not hold up calls to the other wallets. The wallets after the
+      // first mostly find the blocks it pulled in the shared cache
+      std::vector<std::pair<wallet2*, std::shared_ptr<boost::mutex>>> wallets;
+      {
+        boost::unique_lock<boost::mutex> lock(m_wallet_mutex);
+        if (m_default_wallet)
+          wallets.push_back(std::make_pair(m_default_wallet, get_wallet_lock(m_default_wallet)));
+        for (const auto &i: m_wallets)
+          if (i.second != m_default_wallet)
+            wallets.push_back(std::make_pair(i.second, get_wallet_lock(i.second)));
+      }
+      for (const auto &w: wallets)
+      {
+        if (!w.second)
+          continue;
+        boost::unique_lock<boost::mutex> wallet_lock(*w.second);
+        bool is_default;
+        {
+          boost::unique_lock<boost::mutex> lock(m_wallet_mutex);
+          if (get_wallet_lock(w.first) != w.second)
+            continue; // closed in the meantime
+          is_default = w.first == m_default_wallet;
+          // read-only calls made during the refresh are served from the snapshot
+          if (is_default && m_balance_snapshot_dirty)
+            update_balance_snapshot();
+        }
+        try {
+          w.first->refresh(w.first->is_trusted_daemon());
+        } catch (const std::exception& ex) {
+          LOG_ERROR("Exception at while refreshing " << w.first->get_wallet_file() << ", what=" << ex.what());
+          if (is_default)
+            m_balance_snapshot_dirty = true;
+          continue;
+        }
+        if (is_default)
+        {
+          boost::unique_lock<boost::mutex> lock(m_wallet_mutex);
+          if (w.first == m_default_wallet)
+            update_balance_snapshot();
+        }
       }
       m_last_auto_refresh_time = boost::posix_time::microsec_clock::universal_time();
       return true;
@@ -154,18 +593,35 @@ namespace tools
       return true;
     }, 500);
 
-    //DO NOT START THIS SERVER IN MORE THEN 1 THREADS WITHOUT REFACTORING
-    return epee::http_server_impl_base<wallet_rpc_server, connection_context>::run(1, true);
+    // calls touching a wallet are serialized by its lock, the extra threads
+    // let other wallets and read-only calls be used while a long call is running
+    return epee::http_server_impl_base<wallet_rpc_server, connection_context>::run(RPC_SERVER_THREADS, true);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   void wallet_rpc_server::stop()
   {
-    if (m_wallet)
+    for (const auto &i: m_wallets)
     {
-      m_wallet->store();
-      m_wallet->deinit();
-      delete m_wallet;
-      m_wallet = NULL;
+      if (i.second == m_default_wallet)
+        continue;
+      try
+      {
+        i.second->store();
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to save wallet " << i.first << ": " << e.what());
+      }
+      i.second->deinit();
+      delete i.second;
+    }
+    m_wallets.clear();
+    if (m_default_wallet)
+    {
+      m_default_wallet->store();
+      m_default_wallet->deinit();
+      delete m_default_wallet;
+      m_default_wallet = NULL;
     }
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -181,6 +637,13 @@ namespace tools
     std::string bind_port = command_line::get_arg(*m_vm, arg_rpc_bind_port);
     const bool disable_auth = command_line::get_arg(*m_vm, arg_disable_rpc_login);
     m_restricted = command_line::get_arg(*m_vm, arg_restricted);
+    m_max_wallets = std::max<size_t>(command_line::get_arg(*m_vm, arg_max_wallets), 1);
+    if (m_max_wallets > 1)
+    {
+      // set_wallet ran before we knew
+      for (const auto &i: m_wallets)
+        register_wallet(i.second);
+    }
     if (!command_line::is_arg_defaulted(*m_vm, arg_wallet_dir))
     {
       if (!command_line::is_arg_defaulted(*m_vm, wallet_args::arg_wallet_file()))
@@ -270,17 +733,17 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   void wallet_rpc_server::check_background_mining()
   {
-    if (!m_wallet)
+    if (!m_default_wallet)
       return;
 
-    tools::wallet2::BackgroundMiningSetupType setup = m_wallet->setup_background_mining();
+    tools::wallet2::BackgroundMiningSetupType setup = m_default_wallet->setup_background_mining();
     if (setup == tools::wallet2::BackgroundMiningNo)
     {
       MLOG_RED(el::Level::Warning, "Background mining not enabled. Run \"set setup-background-mining 1\" in dinasty-wallet-cli to change.");
       return;
     }
 
-    if (!m_wallet->is_trusted_daemon())
+    if (!m_default_wallet->is_trusted_daemon())
     {
       MDEBUG("Using an untrusted daemon, skipping background mining check");
       return;
@@ -288,7 +751,7 @@ namespace tools
 
     cryptonote::COMMAND_RPC_MINING_STATUS::request req;
     cryptonote::COMMAND_RPC_MINING_STATUS::response res;
-    bool r = m_wallet->invoke_http_json("/mining_status", req, res);
+    bool r = m_default_wallet->invoke_http_json("/mining_status", req, res);
     if (!r || res.status != CORE_RPC_STATUS_OK)
     {
       MERROR("Failed to query mining status: " << (r ? res.status : "No connection to daemon"));
@@ -308,11 +771,11 @@ namespace tools
 
     cryptonote::COMMAND_RPC_START_MINING::request req2;
     cryptonote::COMMAND_RPC_START_MINING::response res2;
-    req2.miner_address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
+    req2.miner_address = m_default_wallet->get_account().get_public_address_str(m_default_wallet->nettype());
     req2.threads_count = 1;
     req2.do_background_mining = true;
     req2.ignore_battery = false;
-    r = m_wallet->invoke_http_json("/start_mining", req2, res);
+    r = m_default_wallet->invoke_http_json("/start_mining", req2, res);
     if (!r || res2.status != CORE_RPC_STATUS_OK)
     {
       MERROR("Failed to setup background mining: " << (r ? res.status : "No connection to daemon"));
@@ -436,6 +899,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_getbalance(const wallet_rpc::COMMAND_RPC_GET_BALANCE::request& req, wallet_rpc::COMMAND_RPC_GET_BALANCE::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
+    if (t_balance_snapshot)
+      return fill_balance_from_snapshot(*t_balance_snapshot, req, res, er);
     if (!m_wallet) return not_open(er);
     try
     {
@@ -501,6 +966,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_getaddress(const wallet_rpc::COMMAND_RPC_GET_ADDRESS::request& req, wallet_rpc::COMMAND_RPC_GET_ADDRESS::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
+    if (t_balance_snapshot)
+      return fill_address_from_snapshot(*t_balance_snapshot, req, res, er);
     if (!m_wallet) return not_open(er);
     try
     {
@@ -749,6 +1216,11 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_getheight(const wallet_rpc::COMMAND_RPC_GET_HEIGHT::request& req, wallet_rpc::COMMAND_RPC_GET_HEIGHT::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
+    if (t_balance_snapshot)
+    {
+      res.height = t_balance_snapshot->height;
+      return true;
+    }
     if (!m_wallet) return not_open(er);
     try
     {
@@ -2581,26 +3053,40 @@ namespace tools
       subaddr_indices.clear();
     }
 
-    if (req.in)
+    // confirmed transfers can be paged through, pending and pool ones are only returned with the first page
+    boost::optional<tools::wallet2::transfer_history_key> cursor;
+    if (!req.cursor.empty())
+    {
+      tools::wallet2::transfer_history_key key;
+      if (!transfer_history_cursor_from_str(req.cursor, key))
+      {
+        er.code = WALLET_RPC_ERROR_CODE_WRONG_CURSOR;
+        er.message = "Invalid cursor: " + req.cursor;
+        return false;
+      }
+      cursor = key;
+    }
+
+    if (req.in || req.out)
     {
       std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
-      m_wallet->get_payments(payments, min_height, max_height, account_index, subaddr_indices);
+      std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> payments_out;
+      tools::wallet2::transfer_history_key last;
+      if (m_wallet->get_transfer_history(payments, payments_out, req.in, req.out, min_height, max_height, account_index, subaddr_indices, cursor, req.max_results, last))
+        res.next_cursor = transfer_history_cursor_to_str(last);
       for (std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
         res.in.push_back(wallet_rpc::transfer_entry());
         fill_transfer_entry(res.in.back(), i->second.m_tx_hash, i->first, i->second);
       }
-    }
-
-    if (req.out)
-    {
-      std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> payments;
-      m_wallet->get_payments_out(payments, min_height, max_height, account_index, subaddr_indices);
-      for (std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
+      for (std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>::const_iterator i = payments_out.begin(); i != payments_out.end(); ++i) {
         res.out.push_back(wallet_rpc::transfer_entry());
         fill_transfer_entry(res.out.back(), i->first, i->second);
       }
     }
 
+    if (cursor)
+      return true;
+
     if (req.pending || req.failed) {
       std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>> upayments;
       m_wallet->get_unconfirmed_payments_out(upayments, account_index, subaddr_indices);
@@ -2744,7 +3230,7 @@ namespace tools
 
     try
     {
-      res.outputs_data_hex = epee::string_tools::buff_to_hex_nodelimer(m_wallet->export_outputs_to_str(req.all));
+      res.outputs_data_hex = epee::string_tools::buff_to_hex_nodelimer(m_wallet->export_outputs_to_str(req.all, req.legacy));
     }
     catch (const std::exception &e)
     {
@@ -3190,6 +3676,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_create_wallet(const wallet_rpc::COMMAND_RPC_CREATE_WALLET::request& req, wallet_rpc::COMMAND_RPC_CREATE_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
+    if (too_many_wallets(er))
+      return false;
     if (m_wallet_dir.empty())
     {
       er.code = WALLET_RPC_ERROR_CODE_NO_WALLET_DIR;
@@ -3293,6 +3781,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_open_wallet(const wallet_rpc::COMMAND_RPC_OPEN_WALLET::request& req, wallet_rpc::COMMAND_RPC_OPEN_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
+    if (too_many_wallets(er))
+      return false;
     if (m_wallet_dir.empty())
     {
       er.code = WALLET_RPC_ERROR_CODE_NO_WALLET_DIR;
@@ -3498,6 +3988,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_generate_from_keys(const wallet_rpc::COMMAND_RPC_GENERATE_FROM_KEYS::request &req, wallet_rpc::COMMAND_RPC_GENERATE_FROM_KEYS::response &res, epee::json_rpc::error &er, const connection_context *ctx)
   {
+    if (too_many_wallets(er))
+      return false;
     if (m_wallet_dir.empty())
     {
       er.code = WALLET_RPC_ERROR_CODE_NO_WALLET_DIR;
@@ -3663,6 +4155,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_restore_deterministic_wallet(const wallet_rpc::COMMAND_RPC_RESTORE_DETERMINISTIC_WALLET::request &req, wallet_rpc::COMMAND_RPC_RESTORE_DETERMINISTIC_WALLET::response &res, epee::json_rpc::error &er, const connection_context *ctx)
   {
+    if (too_many_wallets(er))
+      return false;
     if (m_wallet_dir.empty())
     {
       er.code = WALLET_RPC_ERROR_CODE_NO_WALLET_DIR;
@@ -4638,6 +5132,7 @@ int main(int argc, char** argv) {
   command_line::add_arg(desc_params, arg_from_json);
   command_line::add_arg(desc_params, arg_wallet_dir);
   command_line::add_arg(desc_params, arg_prompt_for_password);
+  command_line::add_arg(desc_params, arg_max_wallets);
   command_line::add_arg(desc_params, arg_rpc_client_secret_key);
 
   daemonizer::init_options(hidden_options, desc_params);
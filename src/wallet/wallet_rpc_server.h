@@ -32,7 +32,11 @@
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include "common/util.h"
 #include "net/http_server_impl_base.h"
 #include "math_helper.h"
@@ -64,10 +68,12 @@ namespace tools
 
   private:
 
-    CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+    // forwards http requests to the uri map, serializing access to the wallet
+    bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context);
+    static epee::serialization::portable_storage *get_json_rpc_request();
 
     BEGIN_URI_MAP2()
-      BEGIN_JSON_RPC_MAP("/json_rpc")
+      BEGIN_JSON_RPC_MAP_PARSED("/json_rpc", get_json_rpc_request())
         MAP_JON_RPC_WE("get_balance",        on_getbalance,         wallet_rpc::COMMAND_RPC_GET_BALANCE)
         MAP_JON_RPC_WE("get_address",        on_getaddress,         wallet_rpc::COMMAND_RPC_GET_ADDRESS)
         MAP_JON_RPC_WE("get_address_index",  on_getaddress_index,   wallet_rpc::COMMAND_RPC_GET_ADDRESS_INDEX)
@@ -270,7 +276,32 @@ namespace tools
 
       void check_background_mining();
 
-      wallet2 *m_wallet;
+      std::shared_ptr<const wallet2::balance_snapshot> get_balance_snapshot();
+      void update_balance_snapshot();
+      bool fill_balance_from_snapshot(const wallet2::balance_snapshot &snapshot, const wallet_rpc::COMMAND_RPC_GET_BALANCE::request& req, wallet_rpc::COMMAND_RPC_GET_BALANCE::response& res, epee::json_rpc::error& er);
+      bool fill_address_from_snapshot(const wallet2::balance_snapshot &snapshot, const wallet_rpc::COMMAND_RPC_GET_ADDRESS::request& req, wallet_rpc::COMMAND_RPC_GET_ADDRESS::response& res, epee::json_rpc::error& er);
+      void register_wallet(wallet2 *wallet);
+      void unregister_wallet(const wallet2 *wallet);
+      bool too_many_wallets(epee::json_rpc::error& er);
+      std::shared_ptr<boost::mutex> get_wallet_lock(const wallet2 *wallet) const;
+      bool lock_wallet(boost::unique_lock<boost::mutex> &lock, const wallet2 *wallet, std::shared_ptr<boost::mutex> &wallet_mutex, boost::unique_lock<boost::mutex> &wallet_lock);
+      bool find_wallet(const std::string *name, wallet2 *&wallet) const;
+
+      // the wallet the call running on this thread works on, resolved once per
+      // request by handle_http_request. Calls on different wallets run at the
+      // same time, so it is kept per thread rather than swapped in and out
+      class request_wallet
+      {
+      public:
+        wallet2 *operator->() const { return get(); }
+        operator wallet2*() const { return get(); }
+        request_wallet &operator=(wallet2 *wallet) { get() = wallet; return *this; }
+      private:
+        static wallet2 *&get();
+      };
+
+      request_wallet m_wallet;
+      wallet2 *m_default_wallet;
       std::string m_wallet_dir;
       tools::private_file rpc_login_file;
       std::atomic<bool> m_stop;
@@ -278,5 +309,25 @@ namespace tools
       const boost::program_options::variables_map *m_vm;
       uint32_t m_auto_refresh_period;
       boost::posix_time::ptime m_last_auto_refresh_time;
+
+      // with --max-wallets > 1, all open wallets, by file name. m_default_wallet
+      // is the one addressed by /json_rpc, others by /wallet/<name>/json_rpc
+      std::map<std::string, wallet2*> m_wallets;
+      size_t m_max_wallets;
+      std::shared_ptr<shared_block_cache> m_shared_block_cache;
+
+      // one per open wallet, held while the wallet is used. A refresh holds
+      // only the lock of the wallet being refreshed, so it does not hold up
+      // calls to the other wallets
+      std::unordered_map<const wallet2*, std::shared_ptr<boost::mutex>> m_wallet_locks;
+
+      // guards m_default_wallet, m_wallets and m_wallet_locks. It is only held
+      // while a request looks up its wallet, and never while waiting for a
+      // wallet lock. Read-only calls which find the default wallet busy (eg,
+      // during a refresh) are answered from m_balance_snapshot
+      boost::mutex m_wallet_mutex;
+      boost::mutex m_balance_snapshot_mutex;
+      std::shared_ptr<const wallet2::balance_snapshot> m_balance_snapshot;
+      std::atomic<bool> m_balance_snapshot_dirty;
   };
 }
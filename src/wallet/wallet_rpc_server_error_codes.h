@@ -77,3 +77,5 @@
 #define WALLET_RPC_ERROR_CODE_INVALID_LOG_LEVEL      -44
 #define WALLET_RPC_ERROR_CODE_ATTRIBUTE_NOT_FOUND    -45
 #define WALLET_RPC_ERROR_CODE_INVALID_SIGNATURE_TYPE -47
+#define WALLET_RPC_ERROR_CODE_WRONG_CURSOR           -48
+#define WALLET_RPC_ERROR_CODE_TOO_MANY_WALLETS       -49
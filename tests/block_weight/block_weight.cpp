@@ -29,7 +29,10 @@
 #define IN_UNIT_TESTS
 
 #include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
 #include <math.h>
+#include <chrono>
 #include "cryptonote_core/blockchain.h"
 #include "cryptonote_core/tx_pool.h"
 #include "cryptonote_core/cryptonote_core.h"
@@ -44,6 +47,9 @@ enum test_t
   test_min = 2,
 };
 
+#define REORG_ROUNDS 500
+#define REORG_MAX_DEPTH 64
+
 namespace
 {
 
@@ -54,10 +60,11 @@ private:
   {
     size_t weight;
     uint64_t long_term_weight;
+    crypto::hash hash;
   };
 
 public:
-  TestDB() { m_open = true; }
+  TestDB(): n_added(0) { m_open = true; }
 
   virtual void add_block( const cryptonote::block& blk
                         , size_t block_weight
@@ -67,7 +74,10 @@ public:
                         , uint64_t num_rct_outs
                         , const crypto::hash& blk_hash
                         ) override {
-    blocks.push_back({block_weight, long_term_block_weight});
+    // blocks replaced by a reorg get a different hash than the ones they replace
+    crypto::hash hash = crypto::null_hash;
+    *(uint64_t*)&hash = n_added++;
+    blocks.push_back({block_weight, long_term_block_weight, hash});
   }
   virtual uint64_t height() const override { return blocks.size(); }
   virtual size_t get_block_weight(const uint64_t &h) const override { return blocks[h].weight; }
@@ -85,15 +95,13 @@ public:
     return ret;
   }
   virtual crypto::hash get_block_hash_from_height(const uint64_t &height) const override {
-    crypto::hash hash = crypto::null_hash;
-    *(uint64_t*)&hash = height;
-    return hash;
+    return blocks[height].hash;
   }
   virtual crypto::hash top_block_hash(uint64_t *block_height = NULL) const override {
     uint64_t h = height();
     crypto::hash top = crypto::null_hash;
     if (h)
-      *(uint64_t*)&top = h - 1;
+      top = blocks[h - 1].hash;
     if (block_height)
       *block_height = h - 1;
     return top;
@@ -105,6 +113,7 @@ public:
 private:
   std::vector<block_t> blocks;
   std::vector<uint8_t> hf;
+  uint64_t n_added;
 };
 
 }
@@ -193,9 +202,102 @@ static void test(test_t t, uint64_t blocks)
   }
 }
 
-int main()
+static void add_test_block(cryptonote::Blockchain *bc, uint64_t w, uint64_t ltw, uint8_t version)
+{
+  cryptonote::block b;
+  b.major_version = version;
+  b.minor_version = version;
+  bc->get_db().add_block(std::make_pair(std::move(b), ""), w, ltw, bc->get_db().height(), bc->get_db().height(), {});
+}
+
+static void check_long_term_median(cryptonote::Blockchain *bc, uint64_t long_term_median)
+{
+  const uint64_t db_height = bc->get_db().height();
+  uint64_t nblocks = std::min<uint64_t>(LONG_TERM_BLOCK_WEIGHT_WINDOW, db_height);
+  if (nblocks == db_height)
+    --nblocks;
+  std::vector<uint64_t> weights = bc->get_db().get_long_term_block_weights(db_height - nblocks - 1, nblocks);
+  const uint64_t expected = std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, epee::misc_utils::median(weights));
+  if (long_term_median != expected)
+  {
+    fprintf(stderr, "Long term median mismatch at height %" PRIu64 ": %" PRIu64 ", expected %" PRIu64 "\n", db_height, long_term_median, expected);
+    exit(1);
+  }
+}
+
+// pops and replaces random numbers of blocks, checking the cached long term
+// median against a full recalculation, and reports the time spent updating
+static void test_reorg()
+{
+  PREFIX(10);
+
+  for (uint64_t h = 0; h < 2 * LONG_TERM_BLOCK_WEIGHT_WINDOW; ++h)
+  {
+    const uint64_t w = 90 + lcg() % 500000;
+    add_test_block(blockchain, w, h < LONG_TERM_BLOCK_WEIGHT_WINDOW ? w : blockchain->get_next_long_term_block_weight(w), h < LONG_TERM_BLOCK_WEIGHT_WINDOW ? 1 : 10);
+    if (!blockchain->update_next_cumulative_weight_limit())
+    {
+      fprintf(stderr, "Failed to update cumulative weight limit\n");
+      exit(1);
+    }
+  }
+
+  std::chrono::steady_clock::duration elapsed{0};
+  uint64_t updates = 0;
+  for (int round = 0; round < REORG_ROUNDS; ++round)
+  {
+    const uint64_t depth = 1 + lcg() % REORG_MAX_DEPTH;
+    // on odd rounds, the new blocks are only seen after the whole reorg
+    const bool batched = round & 1;
+    uint64_t long_term_median;
+    for (uint64_t i = 0; i < depth; ++i)
+    {
+      cryptonote::block b;
+      std::vector<cryptonote::transaction> txs;
+      blockchain->get_db().pop_block(b, txs);
+      if (!batched)
+      {
+        const auto start = std::chrono::steady_clock::now();
+        if (!blockchain->update_next_cumulative_weight_limit(&long_term_median))
+        {
+          fprintf(stderr, "Failed to update cumulative weight limit after pop\n");
+          exit(1);
+        }
+        elapsed += std::chrono::steady_clock::now() - start;
+        ++updates;
+        check_long_term_median(blockchain, long_term_median);
+      }
+    }
+    for (uint64_t i = 0; i < depth + 1; ++i)
+    {
+      const uint64_t w = 90 + lcg() % 500000;
+      add_test_block(blockchain, w, blockchain->get_next_long_term_block_weight(w), 10);
+      if (batched && i < depth)
+        continue;
+      const auto start = std::chrono::steady_clock::now();
+      if (!blockchain->update_next_cumulative_weight_limit(&long_term_median))
+      {
+        fprintf(stderr, "Failed to update cumulative weight limit after reorg\n");
+        exit(1);
+      }
+      elapsed += std::chrono::steady_clock::now() - start;
+      ++updates;
+      check_long_term_median(blockchain, long_term_median);
+    }
+  }
+
+  printf("%d reorgs, %" PRIu64 " weight limit updates, %.3f us per update\n", REORG_ROUNDS, updates,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / 1000. / updates);
+}
+
+int main(int argc, char **argv)
 {
   TRY_ENTRY();
+  if (argc > 1 && !strcmp(argv[1], "--reorg"))
+  {
+    test_reorg();
+    return 0;
+  }
   test(test_max, 2 * LONG_TERM_BLOCK_WEIGHT_WINDOW);
   test(test_lcg, 9 * LONG_TERM_BLOCK_WEIGHT_WINDOW);
   test(test_min, 1 * LONG_TERM_BLOCK_WEIGHT_WINDOW);
@@ -163,6 +163,7 @@ int main(int argc, char* argv[])
     GENERATE_AND_PLAY(txpool_double_spend_local);
     GENERATE_AND_PLAY(txpool_double_spend_keyimage);
     GENERATE_AND_PLAY(txpool_stem_loop);
+    GENERATE_AND_PLAY(txpool_hashes_since);
 
     // Double spend
     GENERATE_AND_PLAY(gen_double_spend_in_tx<false>);
@@ -267,6 +268,8 @@ int main(int argc, char* argv[])
     GENERATE_AND_PLAY(gen_bp_tx_invalid_bulletproof2_type);
 
     GENERATE_AND_PLAY(gen_rct2_tx_clsag_malleability);
+    GENERATE_AND_PLAY(gen_rct2_tx_clsag_preverified);
+    GENERATE_AND_PLAY(gen_rct2_tx_clsag_low_fee_not_preverified);
 
     GENERATE_AND_PLAY(gen_block_low_coinbase);
 
@@ -222,3 +222,32 @@ bool gen_rct2_tx_clsag_malleability::generate(std::vector<test_event_entry>& eve
     return true;
   });
 }
+
+bool gen_rct2_tx_clsag_preverified::generate(std::vector<test_event_entry>& events) const
+{
+  const int mixin = 10;
+  const uint64_t amounts_paid[] = {5000, 5000, (uint64_t)-1};
+  const rct::RCTConfig rct_config[] = { { rct::RangeProofPaddedBulletproof, 3 } };
+  DO_CALLBACK(events, "mark_preverified_count");
+  if (!generate_with(events, mixin, 1, amounts_paid, true, rct_config, HF_VERSION_CLSAG + 1, NULL, NULL))
+    return false;
+  DO_CALLBACK(events, "check_preverified");
+  return true;
+}
+
+bool gen_rct2_tx_clsag_low_fee_not_preverified::generate(std::vector<test_event_entry>& events) const
+{
+  // a fee of 1 atomic unit, which add_tx rejects before looking at the rings
+  const int mixin = 10;
+  const uint64_t amounts_paid[] = {5000000000000 - 5000 - 1, 5000, (uint64_t)-1};
+  const rct::RCTConfig rct_config[] = { { rct::RangeProofPaddedBulletproof, 3 } };
+  DO_CALLBACK(events, "mark_preverified_count");
+  if (!generate_with(events, mixin, 1, amounts_paid, false, rct_config, HF_VERSION_CLSAG + 1, NULL, [&](cryptonote::transaction &tx, size_t tx_idx) {
+    DEFINE_TESTS_ERROR_CONTEXT("gen_rct2_tx_clsag_low_fee_not_preverified");
+    CHECK_TEST_CONDITION(tx.rct_signatures.txnFee == 1);
+    return true;
+  }))
+    return false;
+  DO_CALLBACK(events, "check_not_preverified");
+  return true;
+}
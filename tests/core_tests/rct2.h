@@ -30,15 +30,20 @@
 
 #pragma once 
 #include "chaingen.h"
+#include "metrics.h"
 
 struct gen_rct2_tx_validation_base : public test_chain_unit_base
 {
   gen_rct2_tx_validation_base()
     : m_invalid_tx_index(0)
     , m_invalid_block_index(0)
+    , m_preverified_count(0)
   {
     REGISTER_CALLBACK_METHOD(gen_rct2_tx_validation_base, mark_invalid_tx);
     REGISTER_CALLBACK_METHOD(gen_rct2_tx_validation_base, mark_invalid_block);
+    REGISTER_CALLBACK_METHOD(gen_rct2_tx_validation_base, mark_preverified_count);
+    REGISTER_CALLBACK_METHOD(gen_rct2_tx_validation_base, check_preverified);
+    REGISTER_CALLBACK_METHOD(gen_rct2_tx_validation_base, check_not_preverified);
   }
 
   bool check_tx_verification_context(const cryptonote::tx_verification_context& tvc, bool tx_added, size_t event_idx, const cryptonote::transaction& /*tx*/)
@@ -81,6 +86,31 @@ struct gen_rct2_tx_validation_base : public test_chain_unit_base
     return true;
   }
 
+  static uint64_t get_preverified_count()
+  {
+    return epee::metrics::get_counter("dinastycoin_txpool_preverified_txes_total", "Incoming transactions whose ring signatures were checked ahead of adding them to the pool").value();
+  }
+
+  bool mark_preverified_count(cryptonote::core& /*c*/, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+  {
+    m_preverified_count = get_preverified_count();
+    return true;
+  }
+
+  bool check_preverified(cryptonote::core& /*c*/, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+  {
+    DEFINE_TESTS_ERROR_CONTEXT("gen_rct2_tx_validation_base::check_preverified");
+    CHECK_EQ(m_preverified_count + 1, get_preverified_count());
+    return true;
+  }
+
+  bool check_not_preverified(cryptonote::core& /*c*/, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+  {
+    DEFINE_TESTS_ERROR_CONTEXT("gen_rct2_tx_validation_base::check_not_preverified");
+    CHECK_EQ(m_preverified_count, get_preverified_count());
+    return true;
+  }
+
   bool generate_with(std::vector<test_event_entry>& events, size_t mixin,
       size_t n_txes, const uint64_t *amounts_paid, bool valid, const rct::RCTConfig *rct_config, uint8_t hf_version,
       const std::function<bool(std::vector<cryptonote::tx_source_entry> &sources, std::vector<cryptonote::tx_destination_entry> &destinations, size_t)> &pre_tx,
@@ -91,6 +121,7 @@ struct gen_rct2_tx_validation_base : public test_chain_unit_base
 private:
   size_t m_invalid_tx_index;
   size_t m_invalid_block_index;
+  uint64_t m_preverified_count;
 };
 
 template<>
@@ -114,3 +145,15 @@ struct gen_rct2_tx_clsag_malleability : public gen_rct2_tx_validation_base
   bool generate(std::vector<test_event_entry>& events) const;
 };
 template<> struct get_test_options<gen_rct2_tx_clsag_malleability>: public get_rct2_versioned_test_options<HF_VERSION_CLSAG + 1> {};
+
+struct gen_rct2_tx_clsag_preverified : public gen_rct2_tx_validation_base
+{
+  bool generate(std::vector<test_event_entry>& events) const;
+};
+template<> struct get_test_options<gen_rct2_tx_clsag_preverified>: public get_rct2_versioned_test_options<HF_VERSION_CLSAG + 1> {};
+
+struct gen_rct2_tx_clsag_low_fee_not_preverified : public gen_rct2_tx_validation_base
+{
+  bool generate(std::vector<test_event_entry>& events) const;
+};
+template<> struct get_test_options<gen_rct2_tx_clsag_low_fee_not_preverified>: public get_rct2_versioned_test_options<HF_VERSION_CLSAG + 1> {};
@@ -638,3 +638,181 @@ bool txpool_stem_loop::generate(std::vector<test_event_entry>& events) const
 
   return true;
 }
+
+static std::vector<crypto::hash> get_event_tx_hashes(const std::vector<test_event_entry>& events)
+{
+  std::vector<crypto::hash> hashes;
+  for (const test_event_entry& e : events)
+  {
+    if (const cryptonote::transaction* tx = boost::get<cryptonote::transaction>(&e))
+      hashes.push_back(cryptonote::get_transaction_hash(*tx));
+  }
+  return hashes;
+}
+
+static bool check_hashes(const char* what, const std::vector<crypto::hash>& got, const std::vector<crypto::hash>& expected)
+{
+  if (std::unordered_set<crypto::hash>(got.begin(), got.end()) != std::unordered_set<crypto::hash>(expected.begin(), expected.end()) || got.size() != expected.size())
+  {
+    MERROR("Expected " << expected.size() << " " << what << " hashes but got " << got.size() << " different ones");
+    return false;
+  }
+  return true;
+}
+
+txpool_hashes_since::txpool_hashes_since()
+  : test_chain_unit_base()
+  , m_token(0)
+{
+  REGISTER_CALLBACK_METHOD(txpool_hashes_since, mark_token);
+  REGISTER_CALLBACK_METHOD(txpool_hashes_since, check_stem_hidden);
+  REGISTER_CALLBACK_METHOD(txpool_hashes_since, check_relayed);
+  REGISTER_CALLBACK_METHOD(txpool_hashes_since, check_token_fallback);
+  REGISTER_CALLBACK_METHOD(txpool_hashes_since, check_removed);
+}
+
+bool txpool_hashes_since::mark_token(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  bool full;
+  std::vector<crypto::hash> added, removed;
+  return c.get_pool_transaction_hashes_since(0, full, added, removed, m_token, true);
+}
+
+bool txpool_hashes_since::check_stem_hidden(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& events)
+{
+  const std::vector<crypto::hash> txes = get_event_tx_hashes(events);
+  bool full = true;
+  std::vector<crypto::hash> added, removed;
+  uint64_t new_token;
+  if (!c.get_pool_transaction_hashes_since(m_token, full, added, removed, new_token, false) || full)
+  {
+    MERROR("Expected an incremental answer for a recent token");
+    return false;
+  }
+  if (!check_hashes("public added", added, {}) || !check_hashes("public removed", removed, {}))
+    return false;
+
+  if (!c.get_pool_transaction_hashes_since(m_token, full, added, removed, new_token, true) || full)
+  {
+    MERROR("Expected an incremental answer for a recent token");
+    return false;
+  }
+  return check_hashes("added", added, {txes.back()}) && check_hashes("removed", removed, {});
+}
+
+bool txpool_hashes_since::check_relayed(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& events)
+{
+  const std::vector<crypto::hash> txes = get_event_tx_hashes(events);
+  cryptonote::blobdata blob;
+  if (!c.get_pool_transaction(txes.back(), blob, cryptonote::relay_category::all))
+  {
+    MERROR("Failed to retrieve stem tx from pool");
+    return false;
+  }
+
+  // the stem tx becomes public when fluffed
+  c.on_transactions_relayed({&blob, 1}, cryptonote::relay_method::fluff);
+  bool full = true;
+  std::vector<crypto::hash> added, removed;
+  uint64_t new_token;
+  if (!c.get_pool_transaction_hashes_since(m_token, full, added, removed, new_token, false) || full)
+  {
+    MERROR("Expected an incremental answer for a recent token");
+    return false;
+  }
+  if (!check_hashes("public added", added, {txes.back()}) || !check_hashes("public removed", removed, {}))
+    return false;
+  m_token = new_token;
+
+  // relaying it again changes nothing anyone can see
+  c.on_transactions_relayed({&blob, 1}, cryptonote::relay_method::fluff);
+  c.on_transactions_relayed({&blob, 1}, cryptonote::relay_method::fluff);
+  if (!c.get_pool_transaction_hashes_since(m_token, full, added, removed, new_token, true) || full)
+  {
+    MERROR("Expected an incremental answer for a recent token");
+    return false;
+  }
+  if (new_token != m_token)
+  {
+    MERROR("Re-relaying a public tx added pool events");
+    return false;
+  }
+  return check_hashes("added", added, {}) && check_hashes("removed", removed, {});
+}
+
+bool txpool_hashes_since::check_token_fallback(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  std::vector<crypto::hash> hashes;
+  if (!c.get_pool_transaction_hashes(hashes, false))
+  {
+    MERROR("Failed to get broadcasted transaction pool hashes");
+    return false;
+  }
+
+  // a token from the future (eg, from before a restart) gets the whole pool
+  bool full = false;
+  std::vector<crypto::hash> added, removed;
+  uint64_t new_token;
+  if (!c.get_pool_transaction_hashes_since(m_token + 1000, full, added, removed, new_token, false) || !full)
+  {
+    MERROR("Expected a full answer for an unknown token");
+    return false;
+  }
+  if (new_token != m_token)
+  {
+    MERROR("Expected the current token " << m_token << " but got " << new_token);
+    return false;
+  }
+  return check_hashes("full public", added, hashes) && check_hashes("full removed", removed, {});
+}
+
+bool txpool_hashes_since::check_removed(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& events)
+{
+  const std::vector<crypto::hash> txes = get_event_tx_hashes(events);
+  if (txes.size() != 2)
+  {
+    MERROR("Expected 2 txes, got " << txes.size());
+    return false;
+  }
+  bool full = true;
+  std::vector<crypto::hash> added, removed;
+  uint64_t new_token;
+
+  // the tx which was never public is not disclosed when mined
+  if (!c.get_pool_transaction_hashes_since(m_token, full, added, removed, new_token, false) || full)
+  {
+    MERROR("Expected an incremental answer for a recent token");
+    return false;
+  }
+  if (!check_hashes("public added", added, {}) || !check_hashes("public removed", removed, {txes[0]}))
+    return false;
+
+  if (!c.get_pool_transaction_hashes_since(m_token, full, added, removed, new_token, true) || full)
+  {
+    MERROR("Expected an incremental answer for a recent token");
+    return false;
+  }
+  return check_hashes("added", added, {}) && check_hashes("removed", removed, txes);
+}
+
+bool txpool_hashes_since::generate(std::vector<test_event_entry>& events) const
+{
+  INIT_MEMPOOL_TEST();
+
+  DO_CALLBACK(events, "mark_token");
+  SET_EVENT_VISITOR_SETT(events, event_visitor_settings::set_txs_stem);
+  MAKE_TX(events, tx_0, miner_account, bob_account, send_amount, blk_0);
+  DO_CALLBACK(events, "check_stem_hidden");
+  DO_CALLBACK(events, "check_relayed");
+
+  MAKE_TX(events, tx_1, miner_account, bob_account, send_amount, blk_0);
+  DO_CALLBACK(events, "mark_token");
+  DO_CALLBACK(events, "check_token_fallback");
+
+  SET_EVENT_VISITOR_SETT(events, 0);
+  std::list<cryptonote::transaction> txes{tx_0, tx_1};
+  MAKE_NEXT_BLOCK_TX_LIST(events, blk_1, blk_0r, miner_account, txes);
+  DO_CALLBACK(events, "check_removed");
+
+  return true;
+}
@@ -136,3 +136,19 @@ struct txpool_stem_loop : txpool_double_spend_base
 
   bool generate(std::vector<test_event_entry>& events) const;
 };
+
+class txpool_hashes_since : public test_chain_unit_base
+{
+  uint64_t m_token;
+
+public:
+  txpool_hashes_since();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool mark_token(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_stem_hidden(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_relayed(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_token_fallback(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_removed(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
@@ -34,6 +34,7 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <chrono>
 #include <stdexcept>
 
 #include "misc_log_ex.h"
@@ -43,6 +44,80 @@
 using namespace std;
 
 #define DEFAULT_TEST_DIFFICULTY_TARGET        120
+#define BENCH_ROUNDS                          20
+
+static bool load_data(const char *filename, std::vector<uint64_t> &timestamps, std::vector<cryptonote::difficulty_type> &cumulative_difficulties)
+{
+    fstream data(filename, fstream::in);
+    if (!data.is_open())
+        return false;
+    uint64_t timestamp;
+    cryptonote::difficulty_type difficulty, cumulative_difficulty = 0;
+    while (data >> timestamp >> difficulty) {
+        timestamps.push_back(timestamp);
+        cumulative_difficulties.push_back(cumulative_difficulty += difficulty);
+    }
+    return true;
+}
+
+// computes the difficulty for every block in the data set, as the daemon does:
+// once by building and passing window vectors, once with a difficulty_window
+template<typename F, typename G>
+static int bench(const char *name, const std::vector<uint64_t> &timestamps, const std::vector<cryptonote::difficulty_type> &cumulative_difficulties, size_t blocks_count, F vectors, G window)
+{
+    std::vector<cryptonote::difficulty_type> expected(timestamps.size()), found(timestamps.size());
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+        for (size_t n = 0; n < timestamps.size(); ++n) {
+            const size_t begin = n > blocks_count ? n - blocks_count : 0;
+            expected[n] = vectors(std::vector<uint64_t>(timestamps.begin() + begin, timestamps.begin() + n),
+                std::vector<cryptonote::difficulty_type>(cumulative_difficulties.begin() + begin, cumulative_difficulties.begin() + n));
+        }
+    }
+    const auto vectors_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+        cryptonote::difficulty_window w(blocks_count);
+        for (size_t n = 0; n < timestamps.size(); ++n) {
+            found[n] = window(w);
+            w.push_back(timestamps[n], cumulative_difficulties[n]);
+        }
+    }
+    const auto window_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    for (size_t n = 0; n < timestamps.size(); ++n) {
+        if (expected[n] != found[n]) {
+            cerr << name << ": window mismatch for block " << n << endl
+                << "Expected: " << expected[n] << endl
+                << "Found: " << found[n] << endl;
+            return 1;
+        }
+    }
+
+    const size_t blocks = timestamps.size() * BENCH_ROUNDS;
+    cout << name << ": vectors " << vectors_ns / blocks << " ns/block, window " << window_ns / blocks << " ns/block" << endl;
+    return 0;
+}
+
+static int bench_difficulty(const char *filename)
+{
+    std::vector<uint64_t> timestamps;
+    std::vector<cryptonote::difficulty_type> cumulative_difficulties;
+    if (!load_data(filename, timestamps, cumulative_difficulties)) {
+        cerr << "Failed to load " << filename << endl;
+        return 1;
+    }
+
+    int ret = bench("next_difficulty", timestamps, cumulative_difficulties, DIFFICULTY_BLOCKS_COUNT,
+        [](std::vector<uint64_t> t, std::vector<cryptonote::difficulty_type> c) { return cryptonote::next_difficulty(std::move(t), std::move(c), DEFAULT_TEST_DIFFICULTY_TARGET); },
+        [](const cryptonote::difficulty_window &w) { return w.next_difficulty(DEFAULT_TEST_DIFFICULTY_TARGET); });
+    ret |= bench("next_difficulty_13", timestamps, cumulative_difficulties, DIFFICULTY_BLOCKS_COUNT_V13,
+        [](std::vector<uint64_t> t, std::vector<cryptonote::difficulty_type> c) { return cryptonote::next_difficulty_13(std::move(t), std::move(c), DEFAULT_TEST_DIFFICULTY_TARGET); },
+        [](const cryptonote::difficulty_window &w) { return w.next_difficulty_13(DEFAULT_TEST_DIFFICULTY_TARGET); });
+    return ret;
+}
 
 static int test_wide_difficulty(const char *filename)
 {
@@ -93,6 +168,10 @@ int main(int argc, char *argv[]) {
     {
         return test_wide_difficulty(argv[2]);
     }
+    if (argc == 3 && strcmp(argv[1], "--bench") == 0)
+    {
+        return bench_difficulty(argv[2]);
+    }
 
     vector<uint64_t> timestamps, cumulative_difficulties;
     std::vector<cryptonote::difficulty_type> wide_cumulative_difficulties;
@@ -102,6 +181,7 @@ int main(int argc, char *argv[]) {
     uint64_t timestamp;
     uint64_t difficulty, cumulative_difficulty = 0;
     cryptonote::difficulty_type wide_cumulative_difficulty = 0;
+    cryptonote::difficulty_window window(DIFFICULTY_BLOCKS_COUNT);
     size_t n = 0;
     while (data >> timestamp >> difficulty) {
         size_t begin, end;
@@ -130,9 +210,33 @@ int main(int argc, char *argv[]) {
                 << "Found: " << wide_res << endl;
             return 1;
         }
+        if (window.next_difficulty(DEFAULT_TEST_DIFFICULTY_TARGET) != wide_res) {
+            cerr << "Wrong window difficulty for block " << n << endl
+                << "Expected: " << wide_res << endl
+                << "Found: " << window.next_difficulty(DEFAULT_TEST_DIFFICULTY_TARGET) << endl;
+            return 1;
+        }
+        // rewinding and extending a fork of the window must not change the result
+        if (window.size() > 8) {
+            cryptonote::difficulty_window fork = window;
+            const size_t first = n - fork.size();
+            for (size_t i = 0; i < 5; ++i)
+                fork.pop_back();
+            for (size_t i = 0; i < 3; ++i)
+                fork.pop_front();
+            for (size_t i = 3; i-- > 0; )
+                fork.push_front(timestamps[first + i], wide_cumulative_difficulties[first + i]);
+            for (size_t i = n - 5; i < n; ++i)
+                fork.push_back(timestamps[i], wide_cumulative_difficulties[i]);
+            if (fork.next_difficulty(DEFAULT_TEST_DIFFICULTY_TARGET) != wide_res) {
+                cerr << "Wrong forked window difficulty for block " << n << endl;
+                return 1;
+            }
+        }
         timestamps.push_back(timestamp);
         cumulative_difficulties.push_back(cumulative_difficulty += difficulty);
         wide_cumulative_difficulties.push_back(wide_cumulative_difficulty += difficulty);
+        window.push_back(timestamp, wide_cumulative_difficulty);
         ++n;
     }
     if (!data.eof()) {
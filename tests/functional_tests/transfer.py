@@ -188,6 +188,22 @@ class TransferTest():
         res = self.wallet[0].get_transfers()
         assert len(res['in']) == height # coinbases
         assert len(res.out) == 1 # not mined yet
+        assert not 'next_cursor' in res or res.next_cursor == ''
+
+        # page through the same transfers
+        paged_in, paged_out, cursor, pages = [], [], '', 0
+        while True:
+          page = self.wallet[0].get_transfers(pending = False, failed = False, pool = False, max_results = 7, cursor = cursor)
+          paged_in += page['in'] if 'in' in page else []
+          paged_out += page.out if 'out' in page else []
+          pages += 1
+          if not 'next_cursor' in page or page.next_cursor == '':
+            break
+          cursor = page.next_cursor
+        assert pages == (height + 1 + 6) // 7
+        assert sorted([e.txid for e in paged_in]) == sorted([e.txid for e in res['in']])
+        assert [e.height for e in paged_in] == sorted([e.height for e in paged_in])
+        assert [e.txid for e in paged_out] == [e.txid for e in res.out]
         assert not 'pending' in res or len(res.pending) == 0
         assert not 'pool' in res or len(res.pool) == 0
         assert not 'failed' in res or len(res.failed) == 0
@@ -32,6 +32,8 @@
 
 #include "common/util.h"
 #include "common/command_line.h"
+#include "file_io_utils.h"
+#include "storages/portable_storage_template_helper.h"
 #include "performance_tests.h"
 #include "performance_utils.h"
 
@@ -62,15 +64,27 @@
 #include "multiexp.h"
 #include "sig_mlsag.h"
 #include "sig_clsag.h"
+#include "scan_tx.h"
+#include "tx_serialization.h"
 
 namespace po = boost::program_options;
 
+static std::string results_to_csv(const test_results &results)
+{
+  std::string csv = "name,calls,samples,mean_ns,median_ns,min_ns,max_ns,stddev_ns,ci95_ns\n";
+  for (const auto &r: results.results)
+  {
+    // test names contain commas (template arguments)
+    csv += "\"" + r.name + "\"," + std::to_string(r.calls) + "," + std::to_string(r.samples) + "," + std::to_string(r.mean) + "," +
+      std::to_string(r.median) + "," + std::to_string(r.min) + "," + std::to_string(r.max) + "," + std::to_string(r.stddev) + "," + std::to_string(r.ci95) + "\n";
+  }
+  return csv;
+}
+
 int main(int argc, char** argv)
 {
   TRY_ENTRY();
   tools::on_startup();
-  set_process_affinity(1);
-  set_thread_high_priority();
 
   mlog_configure(mlog_get_default_log_path("performance_tests.log"), true);
 
@@ -80,11 +94,27 @@ int main(int argc, char** argv)
   const command_line::arg_descriptor<bool> arg_stats = { "stats", "Including statistics (min/median)", false };
   const command_line::arg_descriptor<unsigned> arg_loop_multiplier = { "loop-multiplier", "Run for that many times more loops", 1 };
   const command_line::arg_descriptor<std::string> arg_timings_database = { "timings-database", "Keep timings history in a file" };
+  const command_line::arg_descriptor<unsigned> arg_warmup_calls = { "warmup-calls", "Untimed calls to make before timing each test", 0 };
+  const command_line::arg_descriptor<unsigned> arg_repetitions = { "repetitions", "Time each test that many times, each repetition giving a sample unless --stats is used (default 5 with --baseline and without --stats)", 1 };
+  const command_line::arg_descriptor<int> arg_cpu = { "cpu", "Pin the tests to this CPU core, or -1 to leave them unpinned", 1 };
+  const command_line::arg_descriptor<bool> arg_no_high_priority = { "no-high-priority", "Do not raise the thread priority", false };
+  const command_line::arg_descriptor<std::string> arg_output = { "output", "Save the results to this file" };
+  const command_line::arg_descriptor<std::string> arg_output_format = { "output-format", "Format of the --output file: json or csv", "json" };
+  const command_line::arg_descriptor<std::string> arg_baseline = { "baseline", "Compare with the results saved by a previous run with --output, and fail on regressions" };
+  const command_line::arg_descriptor<double> arg_regression_threshold = { "regression-threshold", "Slowdown relative to the baseline below which a test never counts as a regression", 0.05 };
   command_line::add_arg(desc_options, arg_filter);
   command_line::add_arg(desc_options, arg_verbose);
   command_line::add_arg(desc_options, arg_stats);
   command_line::add_arg(desc_options, arg_loop_multiplier);
   command_line::add_arg(desc_options, arg_timings_database);
+  command_line::add_arg(desc_options, arg_warmup_calls);
+  command_line::add_arg(desc_options, arg_repetitions);
+  command_line::add_arg(desc_options, arg_cpu);
+  command_line::add_arg(desc_options, arg_no_high_priority);
+  command_line::add_arg(desc_options, arg_output);
+  command_line::add_arg(desc_options, arg_output_format);
+  command_line::add_arg(desc_options, arg_baseline);
+  command_line::add_arg(desc_options, arg_regression_threshold);
 
   po::variables_map vm;
   bool r = command_line::handle_error_helper(desc_options, [&]()
@@ -103,7 +133,46 @@ int main(int argc, char** argv)
     p.td = TimingsDatabase(timings_database);
   p.verbose = command_line::get_arg(vm, arg_verbose);
   p.stats = command_line::get_arg(vm, arg_stats);
+  p.results.stats = p.stats;
   p.loop_multiplier = command_line::get_arg(vm, arg_loop_multiplier);
+  p.warmup_calls = command_line::get_arg(vm, arg_warmup_calls);
+  p.repetitions = std::max(1u, command_line::get_arg(vm, arg_repetitions));
+  p.regression_threshold = command_line::get_arg(vm, arg_regression_threshold);
+
+  const std::string output = command_line::get_arg(vm, arg_output);
+  const std::string output_format = command_line::get_arg(vm, arg_output_format);
+  if (output_format != "json" && output_format != "csv")
+  {
+    std::cerr << "Invalid output format: " << output_format << std::endl;
+    return 1;
+  }
+
+  const std::string baseline = command_line::get_arg(vm, arg_baseline);
+  if (!baseline.empty())
+  {
+    test_results baseline_results;
+    if (!epee::serialization::load_t_from_json_file(baseline_results, baseline))
+    {
+      std::cerr << "Failed to load baseline from " << baseline << std::endl;
+      return 1;
+    }
+    if (baseline_results.stats != p.stats)
+    {
+      std::cerr << "The baseline in " << baseline << " was " << (baseline_results.stats ? "" : "not ") << "taken with --stats, and can only be compared with a run which " << (baseline_results.stats ? "also uses" : "does not use") << " it" << std::endl;
+      return 1;
+    }
+    for (const auto &r: baseline_results.results)
+      p.baseline[r.name] = r;
+    // a single repetition gives a single sample, too few to tell a regression from noise
+    if (!p.stats && command_line::is_arg_defaulted(vm, arg_repetitions))
+      p.repetitions = 5;
+  }
+
+  const int cpu = command_line::get_arg(vm, arg_cpu);
+  if (cpu >= 0)
+    set_process_affinity(cpu);
+  if (!command_line::get_arg(vm, arg_no_high_priority))
+    set_thread_high_priority();
 
   performance_timer timer;
   timer.start();
@@ -193,6 +262,14 @@ int main(int argc, char** argv)
 
   TEST_PERFORMANCE0(filter, p, test_is_out_to_acc);
   TEST_PERFORMANCE0(filter, p, test_is_out_to_acc_precomp);
+  TEST_PERFORMANCE2(filter, p, test_scan_tx, 2, true);
+  TEST_PERFORMANCE2(filter, p, test_scan_tx, 2, false);
+  TEST_PERFORMANCE2(filter, p, test_scan_tx, 16, true);
+  TEST_PERFORMANCE2(filter, p, test_scan_tx, 16, false);
+  TEST_PERFORMANCE3(filter, p, test_tx_serialization, 11, 2, false);
+  TEST_PERFORMANCE3(filter, p, test_tx_serialization, 11, 2, true);
+  TEST_PERFORMANCE3(filter, p, test_tx_serialization, 11, 16, false);
+  TEST_PERFORMANCE3(filter, p, test_tx_serialization, 11, 16, true);
   TEST_PERFORMANCE0(filter, p, test_generate_key_image_helper);
   TEST_PERFORMANCE0(filter, p, test_generate_key_derivation);
   TEST_PERFORMANCE0(filter, p, test_generate_key_image);
@@ -229,6 +306,9 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 64, 2, 2);
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 128, 2, 2);
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 256, 2, 2);
+  TEST_PERFORMANCE4(filter, p, test_sig_clsag, 11, 2, 2, true); // CLSAG verification, same ring every call
+  TEST_PERFORMANCE4(filter, p, test_sig_clsag, 16, 2, 2, true);
+  TEST_PERFORMANCE4(filter, p, test_sig_clsag, 64, 2, 2, true);
 
   TEST_PERFORMANCE2(filter, p, test_ringct_mlsag, 11, false);
   TEST_PERFORMANCE2(filter, p, test_ringct_mlsag, 11, true);
@@ -573,6 +653,31 @@ int main(int argc, char** argv)
 
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
+  if (!output.empty())
+  {
+    std::string s;
+    if (output_format == "csv")
+      s = results_to_csv(p.results);
+    else if (!epee::serialization::store_t_to_json(p.results, s))
+    {
+      std::cerr << "Failed to serialize results" << std::endl;
+      return 1;
+    }
+    if (!epee::file_io_utils::save_string_to_file(output, s))
+    {
+      std::cerr << "Failed to save results to " << output << std::endl;
+      return 1;
+    }
+  }
+
+  if (!p.regressions.empty())
+  {
+    std::cout << p.regressions.size() << " regression(s) against " << baseline << ":" << std::endl;
+    for (const auto &name: p.regressions)
+      std::cout << "  " << name << std::endl;
+    return 1;
+  }
+
   return 0;
   CATCH_ENTRY_L0("main", 1);
 }
@@ -32,12 +32,14 @@
 
 #include <iostream>
 #include <stdint.h>
+#include <map>
 
 #include <boost/chrono.hpp>
 #include <boost/regex.hpp>
 
 #include "misc_language.h"
 #include "stats.h"
+#include "serialization/keyvalue_serialization.h"
 #include "common/perf_timer.h"
 #include "common/timings.h"
 
@@ -62,17 +64,68 @@ public:
     return static_cast<int>(boost::chrono::duration_cast<boost::chrono::milliseconds>(elapsed).count());
   }
 
+  uint64_t elapsed_ns()
+  {
+    clock::duration elapsed = clock::now() - m_start;
+    return boost::chrono::duration_cast<boost::chrono::nanoseconds>(elapsed).count();
+  }
+
 private:
   clock::time_point m_base;
   clock::time_point m_start;
 };
 
+// times are in nanoseconds, and whole numbers so the JSON reads back
+struct test_result
+{
+  std::string name;
+  uint64_t calls;
+  uint64_t samples;
+  uint64_t mean;
+  uint64_t median;
+  uint64_t min;
+  uint64_t max;
+  uint64_t stddev;
+  uint64_t ci95;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(name)
+    KV_SERIALIZE(calls)
+    KV_SERIALIZE(samples)
+    KV_SERIALIZE(mean)
+    KV_SERIALIZE(median)
+    KV_SERIALIZE(min)
+    KV_SERIALIZE(max)
+    KV_SERIALIZE(stddev)
+    KV_SERIALIZE(ci95)
+  END_KV_SERIALIZE_MAP()
+};
+
+// with stats, the samples are single calls, otherwise they are the mean of each
+// repetition, and results taken one way can not be compared with the other
+struct test_results
+{
+  bool stats;
+  std::vector<test_result> results;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(stats)
+    KV_SERIALIZE(results)
+  END_KV_SERIALIZE_MAP()
+};
+
 struct Params
 {
   TimingsDatabase td;
   bool verbose;
   bool stats;
   unsigned loop_multiplier;
+  unsigned warmup_calls;
+  unsigned repetitions;
+  test_results results;
+  std::map<std::string, test_result> baseline;
+  double regression_threshold;
+  std::vector<std::string> regressions;
 };
 
 template <typename T>
@@ -80,9 +133,9 @@ class test_runner
 {
 public:
   test_runner(const Params &params)
-    : m_elapsed(0)
+    : m_elapsed_ns(0)
     , m_params(params)
-    , m_per_call_timers(T::loop_count * params.loop_multiplier, {true})
+    , m_per_call_timers(T::loop_count * params.loop_multiplier * params.repetitions, {true})
   {
   }
 
@@ -97,32 +150,51 @@ public:
     performance_timer timer;
     timer.start();
     warm_up();
+    for (size_t i = 0; i < m_params.warmup_calls; ++i)
+    {
+      if (!test.test())
+        return false;
+    }
     if (m_params.verbose)
       std::cout << "Warm up: " << timer.elapsed_ms() << " ms" << std::endl;
 
-    timer.start();
-    for (size_t i = 0; i < T::loop_count * m_params.loop_multiplier; ++i)
+    // with --stats, every call is a sample, otherwise the mean time per call of each repetition is
+    const size_t calls = T::loop_count * m_params.loop_multiplier;
+    m_elapsed_ns = 0;
+    for (size_t r = 0; r < m_params.repetitions; ++r)
     {
-      if (m_params.stats)
-        m_per_call_timers[i].resume();
-      if (!test.test())
-        return false;
-      if (m_params.stats)
-        m_per_call_timers[i].pause();
+      timer.start();
+      for (size_t i = r * calls; i < (r + 1) * calls; ++i)
+      {
+        if (m_params.stats)
+          m_per_call_timers[i].resume();
+        if (!test.test())
+          return false;
+        if (m_params.stats)
+          m_per_call_timers[i].pause();
+      }
+      const uint64_t elapsed_ns = timer.elapsed_ns();
+      m_elapsed_ns += elapsed_ns;
+      if (!m_params.stats)
+        m_samples.push_back(elapsed_ns / calls);
+    }
+    if (m_params.stats)
+    {
+      for (const auto &t: m_per_call_timers)
+        m_samples.push_back(t.value());
     }
-    m_elapsed = timer.elapsed_ms();
-    m_stats.reset(new Stats<tools::PerformanceTimer, uint64_t>(m_per_call_timers));
+    m_stats.reset(new Stats<uint64_t>(m_samples));
 
     return true;
   }
 
-  int elapsed_time() const { return m_elapsed; }
+  int elapsed_time() const { return m_elapsed_ns / 1000000; }
   size_t get_size() const { return m_stats->get_size(); }
 
   int time_per_call(int scale = 1) const
   {
     static_assert(0 < T::loop_count, "T::loop_count must be greater than 0");
-    return m_elapsed * scale / (T::loop_count * m_params.loop_multiplier);
+    return m_elapsed_ns * scale / 1000000 / (T::loop_count * m_params.loop_multiplier * m_params.repetitions);
   }
 
   uint64_t get_min() const { return m_stats->get_min(); }
@@ -131,6 +203,7 @@ public:
   uint64_t get_median() const { return m_stats->get_median(); }
   double get_stddev() const { return m_stats->get_standard_deviation(); }
   double get_non_parametric_skew() const { return m_stats->get_non_parametric_skew(); }
+  double get_ci95() const { return m_stats->get_size() > 1 ? m_stats->get_confidence_interval_95() : 0.0; }
   std::vector<uint64_t> get_quantiles(size_t n) const { return m_stats->get_quantiles(n); }
 
   bool is_same_distribution(size_t npoints, double mean, double stddev) const
@@ -155,12 +228,27 @@ private:
 
 private:
   volatile uint64_t m_warm_up;  ///<! This field is intended for preclude compiler optimizations
-  int m_elapsed;
+  uint64_t m_elapsed_ns;
   Params m_params;
   std::vector<tools::PerformanceTimer> m_per_call_timers;
-  std::unique_ptr<Stats<tools::PerformanceTimer, uint64_t>> m_stats;
+  std::vector<uint64_t> m_samples;
+  std::unique_ptr<Stats<uint64_t>> m_stats;
 };
 
+/**
+ * A regression is a slowdown beyond the threshold which is also significant
+ * at the 99% level, so both runs need at least two samples
+ */
+template <typename T>
+bool is_regression(const test_runner<T> &runner, const test_result &prev, double threshold)
+{
+  if (prev.mean == 0 || runner.get_mean() <= prev.mean * (1 + threshold))
+    return false;
+  if (runner.get_size() < 2 || prev.samples < 2)
+    return false;
+  return !runner.is_same_distribution(prev.samples, prev.mean, prev.stddev);
+}
+
 template <typename T>
 void run_test(const std::string &filter, Params &params, const char* test_name)
 {
@@ -174,7 +262,7 @@ void run_test(const std::string &filter, Params &params, const char* test_name)
     if (params.verbose)
     {
       std::cout << test_name << " - OK:\n";
-      std::cout << "  loop count:    " << T::loop_count * params.loop_multiplier << '\n';
+      std::cout << "  loop count:    " << T::loop_count * params.loop_multiplier * params.repetitions << '\n';
       std::cout << "  elapsed:       " << runner.elapsed_time() << " ms\n";
       if (params.stats)
       {
@@ -182,11 +270,12 @@ void run_test(const std::string &filter, Params &params, const char* test_name)
         std::cout << "  max:       " << runner.get_max() << " ns\n";
         std::cout << "  median:    " << runner.get_median() << " ns\n";
         std::cout << "  std dev:   " << runner.get_stddev() << " ns\n";
+        std::cout << "  95% CI:    " << runner.get_ci95() << " ns\n";
       }
     }
     else
     {
-      std::cout << test_name << " (" << T::loop_count * params.loop_multiplier << " calls) - OK:";
+      std::cout << test_name << " (" << T::loop_count * params.loop_multiplier * params.repetitions << " calls) - OK:";
     }
     const char *unit = "ms";
     double scale = 1000000;
@@ -211,6 +300,9 @@ void run_test(const std::string &filter, Params &params, const char* test_name)
     std::vector<TimingsDatabase::instance> prev_instances = params.td.get(test_name);
     params.td.add(test_name, {time(NULL), runner.get_size(), min, max, mean, med, stddev, npskew, quantiles});
 
+    params.results.results.push_back({test_name, T::loop_count * params.loop_multiplier * params.repetitions, runner.get_size(),
+        (uint64_t)mean, (uint64_t)med, (uint64_t)min, (uint64_t)max, (uint64_t)stddev, (uint64_t)runner.get_ci95()});
+
     std::cout << (params.verbose ? "  time per call: " : " ") << time_per_call << " " << unit << "/call" << (params.verbose ? "\n" : "");
     if (params.stats)
     {
@@ -232,6 +324,15 @@ cmp += "  -- " + std::to_string(prev_instance.mean);
       }
       std::cout << " (min " << mins << " " << unit << ", 90th " << p95s << " " << unit << ", median " << meds << " " << unit << ", std dev " << stddevs << " " << unit << ")" << cmp;
     }
+    const auto prev = params.baseline.find(test_name);
+    if (prev != params.baseline.end())
+    {
+      const double pc = prev->second.mean ? 100. * (mean - prev->second.mean) / prev->second.mean : 0.;
+      const bool regression = is_regression(runner, prev->second, params.regression_threshold);
+      std::cout << " [baseline " << (pc >= 0 ? "+" : "") << pc << "%" << (regression ? ", REGRESSION" : "") << "]";
+      if (regression)
+        params.regressions.push_back(test_name);
+    }
     std::cout << std::endl;
   }
   else
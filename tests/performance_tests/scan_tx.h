@@ -0,0 +1,112 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2015-2019 The Monero Project
+#pragma once
+
+#include <vector>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "ringct/rctOps.h"
+
+#include "multi_tx_test_base.h"
+
+// What a wallet does for each transaction it sees while refreshing: find its
+// outputs, and decode the amounts of those it owns
+template<size_t a_outputs, bool a_owned>
+class test_scan_tx : private multi_tx_test_base<2>
+{
+  static_assert(0 < a_outputs, "outputs must be greater than 0");
+
+public:
+  static const size_t loop_count = a_outputs < 16 ? 100 : 10;
+  static const size_t outputs = a_outputs;
+  static const bool owned = a_owned;
+
+  typedef multi_tx_test_base<2> base_class;
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    if (!base_class::init())
+      return false;
+
+    m_alice.generate();
+    m_bob.generate();
+
+    std::vector<tx_destination_entry> destinations;
+    for (size_t n = 0; n < outputs; ++n)
+      destinations.push_back(tx_destination_entry(this->m_source_amount / outputs, m_alice.get_keys().m_account_address, false));
+
+    crypto::secret_key tx_key;
+    std::vector<crypto::secret_key> additional_tx_keys;
+    std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+    subaddresses[this->m_miners[this->real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0,0};
+    if (!construct_tx_and_get_tx_key(this->m_miners[this->real_source_idx].get_keys(), subaddresses, this->m_sources, destinations, cryptonote::account_public_address{}, std::vector<uint8_t>(), m_tx, 0, tx_key, additional_tx_keys, true, {rct::RangeProofPaddedBulletproof, 2}))
+      return false;
+
+    return true;
+  }
+
+  bool test()
+  {
+    const cryptonote::account_keys &keys = owned ? m_alice.get_keys() : m_bob.get_keys();
+    const crypto::public_key tx_pub_key = cryptonote::get_tx_pub_key_from_extra(m_tx);
+
+    crypto::key_derivation derivation;
+    if (!crypto::generate_key_derivation(tx_pub_key, keys.m_view_secret_key, derivation))
+      return false;
+
+    size_t found = 0;
+    for (size_t n = 0; n < m_tx.vout.size(); ++n)
+    {
+      const cryptonote::txout_to_key &tx_out = boost::get<cryptonote::txout_to_key>(m_tx.vout[n].target);
+      crypto::public_key pk;
+      if (!crypto::derive_public_key(derivation, n, keys.m_account_address.m_spend_public_key, pk))
+        return false;
+      if (pk != tx_out.key)
+        continue;
+
+      crypto::secret_key scalar;
+      crypto::derivation_to_scalar(derivation, n, scalar);
+      rct::ecdhTuple ecdh_info = m_tx.rct_signatures.ecdhInfo[n];
+      rct::ecdhDecode(ecdh_info, rct::sk2rct(scalar), m_tx.rct_signatures.type == rct::RCTTypeBulletproof2 || m_tx.rct_signatures.type == rct::RCTTypeCLSAG);
+      ++found;
+    }
+    return found == (owned ? outputs : 0);
+  }
+
+private:
+  cryptonote::account_base m_alice;
+  cryptonote::account_base m_bob;
+  cryptonote::transaction m_tx;
+};
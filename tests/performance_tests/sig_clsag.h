@@ -36,7 +36,11 @@
 
 using namespace rct;
 
-template<size_t a_N, size_t a_T, size_t a_w>
+// With a_warm, every call verifies the same ring, whose members are then in the
+// verifier's per thread cache of decompressed ring members after the first call.
+// Otherwise calls cycle through enough distinct rings to keep missing it, as
+// when verifying unrelated transactions
+template<size_t a_N, size_t a_T, size_t a_w, bool a_warm = false>
 class test_sig_clsag
 {
     public:
@@ -47,17 +51,77 @@ class test_sig_clsag
 
         bool init()
         {
+            // comfortably more ring members than the verifier caches
+            const size_t n_rings = a_warm ? 1 : 4096 / N + 1;
+            rings.resize(n_rings);
+            for (ring_set &ring: rings)
+                make_ring(ring);
+            next_ring = 0;
+            return true;
+        }
+
+        bool test()
+        {
+            const ring_set &ring = rings[next_ring];
+            next_ring = (next_ring + 1) % rings.size();
+
+            for (size_t u = 0; u < w; u++)
+            {
+                if (!verRctCLSAGSimple(ring.messages[u],ring.sigs[u],ring.pubs,ring.C_offsets[u]))
+                {
+                    return false;
+                }
+            }
+
+            // Check balanace
+            std::vector<MultiexpData> balance;
+            balance.reserve(w + T);
+            balance.resize(0);
+            key ZERO = zero();
+            key ONE = identity();
+            key MINUS_ONE;
+            sc_sub(MINUS_ONE.bytes,ZERO.bytes,ONE.bytes);
+            for (size_t u = 0; u < w; u++)
+            {
+                balance.push_back({ONE,ring.C_offsets[u]});
+            }
+            for (size_t j = 0; j < T; j++)
+            {
+                balance.push_back({MINUS_ONE,ring.Q[j]});
+            }
+            if (!(straus(balance) == ONE)) // group identity
+            {
+                return false;
+            }
+
+            return true;
+        }
+
+    private:
+        struct ring_set
+        {
+            ctkeyV pubs;
+            keyV Q;
+            keyV C_offsets;
+            keyV messages;
+            std::vector<clsag> sigs;
+        };
+
+        void make_ring(ring_set &ring)
+        {
+            ctkeyV &pubs = ring.pubs;
             pubs.reserve(N);
             pubs.resize(N);
 
-            r = keyV(w); // M[l[u]] = Com(0,r[u])
+            keyV r = keyV(w); // M[l[u]] = Com(0,r[u])
 
-            a = keyV(w); // P[l[u]] = Com(a[u],s[u])
-            s = keyV(w);
+            keyV a = keyV(w); // P[l[u]] = Com(a[u],s[u])
+            keyV s = keyV(w);
 
+            keyV &Q = ring.Q;
             Q = keyV(T); // Q[j] = Com(b[j],t[j])
-            b = keyV(T);
-            t = keyV(T);
+            keyV b = keyV(T);
+            keyV t = keyV(T);
 
             // Random keys
             key temp;
@@ -69,10 +133,12 @@ class test_sig_clsag
 
             // Signing and commitment keys (assumes fixed signing indices 0,1,...,w-1 for this test)
             // TODO: random signing indices
+            keyV &C_offsets = ring.C_offsets;
             C_offsets = keyV(w); // P[l[u]] - C_offsets[u] = Com(0,s[u]-s1[u])
-            s1 = keyV(w);
+            keyV s1 = keyV(w);
             key a_sum = zero();
             key s1_sum = zero();
+            keyV &messages = ring.messages;
             messages = keyV(w);
             for (size_t u = 0; u < w; u++)
             {
@@ -109,6 +175,7 @@ class test_sig_clsag
             addKeys2(Q[T-1],t[T-1],b[T-1],H);
 
             // Build proofs
+            std::vector<clsag> &sigs = ring.sigs;
             sigs.reserve(w);
             sigs.resize(0);
             ctkey sk;
@@ -119,54 +186,8 @@ class test_sig_clsag
 
                 sigs.push_back(proveRctCLSAGSimple(messages[u],pubs,sk,s1[u],C_offsets[u],NULL,NULL,NULL,u,hw::get_device("default")));
             }
-
-            return true;
-        }
-
-        bool test()
-        {
-            for (size_t u = 0; u < w; u++)
-            {
-                if (!verRctCLSAGSimple(messages[u],sigs[u],pubs,C_offsets[u]))
-                {
-                    return false;
-                }
-            }
-
-            // Check balanace
-            std::vector<MultiexpData> balance;
-            balance.reserve(w + T);
-            balance.resize(0);
-            key ZERO = zero();
-            key ONE = identity();
-            key MINUS_ONE;
-            sc_sub(MINUS_ONE.bytes,ZERO.bytes,ONE.bytes);
-            for (size_t u = 0; u < w; u++)
-            {
-                balance.push_back({ONE,C_offsets[u]});
-            }
-            for (size_t j = 0; j < T; j++)
-            {
-                balance.push_back({MINUS_ONE,Q[j]});
-            }
-            if (!(straus(balance) == ONE)) // group identity
-            {
-                return false;
-            }
-
-            return true;
         }
 
-    private:
-        ctkeyV pubs;
-        keyV Q;
-        keyV r;
-        keyV s;
-        keyV s1;
-        keyV t;
-        keyV a;
-        keyV b;
-        keyV C_offsets;
-        keyV messages;
-        std::vector<clsag> sigs;
+        std::vector<ring_set> rings;
+        size_t next_ring;
 };
@@ -0,0 +1,359 @@
+#!/usr/bin/env python3
+
+# Parts are Copyright (c) 2019, The Dinastycoin team
+# 
+# All rights reserved.
+# 
+# Redistribution and use in source and binary forms, with or without modification, are
+# permitted provided that the following conditions are met:
+# 
+# 1. Redistributions of source code must retain the above copyright notice, this list of
+#    conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list
+#    of conditions and the following disclaimer in the documentation and/or other
+#    materials provided with the distribution.
+# 
+# 3. Neither the name of the copyright holder nor the names of its contributors may be
+#    used to endorse or promote products derived from this software without specific
+#    prior written permission.
+# 
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+# THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+# STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+# THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""End to end sync benchmark
+
+A seed dinastycoind is loaded from a bootstrap.raw file (as written by
+dinasty-blockchain-export) and serves that chain segment over the normal
+levin protocol to a second, empty dinastycoind which is only allowed to
+talk to it. The time taken by the second daemon to sync, along with its
+CPU time, memory and disk I/O, is written out as JSON, and can be checked
+against a previous run with --baseline. With --repetitions, the sync is
+timed several times, and the means are compared, taking their spread into
+account.
+"""
+
+from __future__ import print_function
+import sys
+import os
+import time
+import json
+import shutil
+import socket
+import argparse
+import subprocess
+import requests
+from signal import SIGTERM
+
+SEED_P2P_PORT = 18680
+SEED_RPC_PORT = 18681
+TARGET_P2P_PORT = 18690
+TARGET_RPC_PORT = 18691
+
+# metric name, whether a higher value is better
+COMPARED_RESULTS = [
+  ('blocks_per_second', True),
+  ('cpu_seconds', False),
+  ('max_rss_kb', False),
+  ('read_bytes', False),
+  ('write_bytes', False),
+]
+
+parser = argparse.ArgumentParser(description = 'Measure how fast dinastycoind syncs a recorded chain segment from a local peer')
+parser.add_argument('--builddir', required = True, help = 'build directory containing bin/dinastycoind and bin/dinasty-blockchain-import')
+parser.add_argument('--bootstrap', required = True, help = 'bootstrap.raw file to serve')
+parser.add_argument('--blocks', type = int, default = 0, help = 'only serve this many blocks from the bootstrap file (default: all)')
+parser.add_argument('--workdir', default = 'sync-benchmark-directory', help = 'where to keep the daemons\' data directories and logs')
+parser.add_argument('--output', help = 'write the results to this JSON file')
+parser.add_argument('--baseline', help = 'compare the results with those of a previous run')
+parser.add_argument('--tolerance', type = float, default = 0.05, help = 'relative regression against the baseline that is considered a failure (default: 0.05)')
+parser.add_argument('--repetitions', type = int, help = 'sync that many times, from an empty daemon each time (default: 3 with --baseline, 1 otherwise)')
+parser.add_argument('--timeout', type = int, default = 3600, help = 'give up if the sync takes longer than this many seconds')
+parser.add_argument('--daemon-arg', action = 'append', default = [], help = 'extra argument for the syncing dinastycoind, may be repeated (eg --daemon-arg=--block-sync-size=50)')
+args = parser.parse_args()
+if args.repetitions is None:
+  # a single sync gives a single sample, too few to tell a regression from noise
+  args.repetitions = 3 if args.baseline else 1
+args.repetitions = max(args.repetitions, 1)
+
+dinastycoind = os.path.join(args.builddir, 'bin', 'dinastycoind')
+blockchain_import = os.path.join(args.builddir, 'bin', 'dinasty-blockchain-import')
+seed_dir = os.path.join(args.workdir, 'seed')
+target_dir = os.path.join(args.workdir, 'target')
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'utils', 'python-rpc'))
+from framework.daemon import Daemon
+
+def read_proc(pid, name):
+  try:
+    with open('/proc/' + str(pid) + '/' + name) as f:
+      return f.read()
+  except (IOError, OSError):
+    return ''
+
+def get_process_stats(pid):
+  stats = {'cpu_seconds': 0.0, 'rss_kb': 0, 'max_rss_kb': 0, 'read_bytes': 0, 'write_bytes': 0}
+  stat = read_proc(pid, 'stat')
+  if stat:
+    # fields after the parenthesised command name, utime and stime are the 14th and 15th fields
+    fields = stat[stat.rfind(')') + 2:].split()
+    stats['cpu_seconds'] = (int(fields[11]) + int(fields[12])) / float(os.sysconf('SC_CLK_TCK'))
+  for line in read_proc(pid, 'status').splitlines():
+    if line.startswith('VmRSS:'):
+      stats['rss_kb'] = int(line.split()[1])
+    elif line.startswith('VmHWM:'):
+      stats['max_rss_kb'] = int(line.split()[1])
+  for line in read_proc(pid, 'io').splitlines():
+    if line.startswith('read_bytes:'):
+      stats['read_bytes'] = int(line.split()[1])
+    elif line.startswith('write_bytes:'):
+      stats['write_bytes'] = int(line.split()[1])
+  return stats
+
+def get_histograms(port, names):
+  # sum and count of histograms from /metrics, if the daemon has --rpc-metrics
+  histograms = {}
+  try:
+    text = requests.get('http://127.0.0.1:' + str(port) + '/metrics', timeout = 10).text
+  except requests.exceptions.RequestException:
+    return histograms
+  for line in text.splitlines():
+    for name in names:
+      for suffix in ['_sum', '_count']:
+        if line.startswith(name + suffix + ' '):
+          histograms.setdefault(name, {})[suffix[1:]] = float(line.split()[1])
+  return histograms
+
+def get_height(daemon):
+  try:
+    return daemon.get_info().height
+  except (requests.exceptions.RequestException, ValueError, AssertionError, KeyError):
+    return None
+
+def wait_for_port(port, process):
+  for i in range(120):
+    if process.poll() is not None:
+      return False
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.settimeout(1)
+    if s.connect_ex(('127.0.0.1', port)) == 0:
+      s.close()
+      return True
+    s.close()
+    time.sleep(1)
+  return False
+
+def stop(processes):
+  for p in processes:
+    try: p.send_signal(SIGTERM)
+    except OSError: pass
+  for p in processes:
+    try:
+      p.wait(timeout = 60)
+    except subprocess.TimeoutExpired:
+      p.kill()
+      p.wait()
+  del processes[:]
+
+def mean_and_stddev(values):
+  mean = sum(values) / float(len(values))
+  if len(values) < 2:
+    return mean, 0.0
+  return mean, (sum((v - mean) ** 2 for v in values) / float(len(values) - 1)) ** 0.5
+
+def is_significant(old_mean, old_stddev, old_n, new_mean, new_stddev, new_n):
+  # Welch's t statistic, against a conservative 99% threshold, as there
+  # are few repetitions. One sample on either side can not tell
+  if old_n < 2 or new_n < 2:
+    return False
+  se = (old_stddev ** 2 / old_n + new_stddev ** 2 / new_n) ** 0.5
+  if se == 0:
+    return new_mean != old_mean
+  return abs(new_mean - old_mean) / se > 3.0
+
+def git_revision():
+  try:
+    return subprocess.check_output(['git', 'rev-parse', 'HEAD'], cwd = os.path.dirname(os.path.abspath(__file__))).decode().strip()
+  except (subprocess.CalledProcessError, OSError):
+    return ''
+
+if not os.path.isdir(args.workdir):
+  os.makedirs(args.workdir)
+
+# the imported seed is kept between runs, and only rebuilt if it was made from another file or block count
+seed_key = os.path.abspath(args.bootstrap) + ':' + str(os.path.getsize(args.bootstrap)) + ':' + str(args.blocks)
+seed_stamp = os.path.join(seed_dir, 'sync-benchmark-seed')
+seed_imported = False
+if os.path.exists(seed_stamp):
+  with open(seed_stamp) as f:
+    seed_imported = f.read() == seed_key
+if not seed_imported:
+  print('Importing ' + args.bootstrap + ' into the seed daemon...')
+  shutil.rmtree(seed_dir, ignore_errors = True)
+  os.makedirs(seed_dir)
+  cmd = [blockchain_import, '--input-file', args.bootstrap, '--data-dir', seed_dir, '--dangerous-unverified-import', '1']
+  if args.blocks > 0:
+    cmd += ['--block-stop', str(args.blocks)]
+  with open(os.path.join(args.workdir, 'import.log'), 'w') as log:
+    subprocess.check_call(cmd, stdout = log, stderr = subprocess.STDOUT)
+  with open(seed_stamp, 'w') as f:
+    f.write(seed_key)
+
+baseline = None
+if args.baseline:
+  # checked before syncing, there's no point in a run which can not be compared
+  with open(args.baseline) as f:
+    baseline = json.load(f)
+  mismatches = []
+  if baseline.get('version') != 2:
+    mismatches.append('format version ' + str(baseline.get('version')))
+  if baseline.get('bootstrap') != os.path.abspath(args.bootstrap):
+    mismatches.append('bootstrap ' + str(baseline.get('bootstrap')))
+  if baseline.get('requested_blocks', 0) != args.blocks:
+    mismatches.append('block count ' + str(baseline.get('requested_blocks')))
+  if baseline.get('daemon_args') != args.daemon_arg:
+    mismatches.append('daemon arguments ' + str(baseline.get('daemon_args')))
+  if mismatches:
+    print('The baseline in ' + args.baseline + ' was made with a different ' + ', '.join(mismatches) + ', and can not be compared with this run')
+    sys.exit(1)
+
+common_args = ['--no-igd', '--non-interactive', '--disable-dns-checkpoints', '--check-updates', 'disabled', '--rpc-ssl', 'disabled', '--log-level', '0', '--p2p-bind-ip', '127.0.0.1', '--rpc-bind-ip', '127.0.0.1']
+seed_cmd = [dinastycoind] + common_args + ['--data-dir', seed_dir, '--p2p-bind-port', str(SEED_P2P_PORT), '--rpc-bind-port', str(SEED_RPC_PORT), '--zmq-rpc-bind-port', str(SEED_RPC_PORT + 1), '--add-exclusive-node', '127.0.0.1:' + str(TARGET_P2P_PORT), '--no-sync']
+target_cmd = [dinastycoind] + common_args + ['--data-dir', target_dir, '--p2p-bind-port', str(TARGET_P2P_PORT), '--rpc-bind-port', str(TARGET_RPC_PORT), '--zmq-rpc-bind-port', str(TARGET_RPC_PORT + 1), '--add-exclusive-node', '127.0.0.1:' + str(SEED_P2P_PORT), '--rpc-metrics'] + args.daemon_arg
+
+def sync_once(seed_height, processes, target_log):
+  shutil.rmtree(target_dir, ignore_errors = True)
+  os.makedirs(target_dir)
+  target = subprocess.Popen(target_cmd, stdout = target_log, stderr = subprocess.STDOUT)
+  processes.append(target)
+  if not wait_for_port(TARGET_RPC_PORT, target):
+    print('Failed to start the syncing daemon, see ' + target_log.name)
+    sys.exit(1)
+
+  daemon = Daemon(port = TARGET_RPC_PORT)
+  start_height = get_height(daemon) or 1
+  # the daemon's startup is not part of the sync, so timing and resource usage start from here
+  start_time = time.time()
+  start_stats = get_process_stats(target.pid)
+  samples = []
+  height = start_height
+  while height < seed_height:
+    if target.poll() is not None:
+      print('The syncing daemon exited, see ' + target_log.name)
+      sys.exit(1)
+    if time.time() - start_time > args.timeout:
+      print('Timed out at height ' + str(height))
+      sys.exit(1)
+    time.sleep(1)
+    height = get_height(daemon) or height
+    stats = get_process_stats(target.pid)
+    samples.append([round(time.time() - start_time, 3), height, round(stats['cpu_seconds'] - start_stats['cpu_seconds'], 3), stats['rss_kb']])
+  elapsed = time.time() - start_time
+
+  stats = get_process_stats(target.pid)
+  for name in ['cpu_seconds', 'read_bytes', 'write_bytes']:
+    stats[name] -= start_stats[name]
+  histograms = get_histograms(TARGET_RPC_PORT, ['dinastycoin_block_verification_seconds', 'dinastycoin_lmdb_txn_commit_seconds'])
+  stop([target])
+  processes.remove(target)
+
+  lmdb_size = 0
+  for root, dirs, files in os.walk(os.path.join(target_dir, 'lmdb')):
+    lmdb_size += sum(os.path.getsize(os.path.join(root, name)) for name in files)
+
+  blocks = seed_height - start_height
+  run = {
+    'start_height': start_height,
+    'blocks': blocks,
+    'seconds': round(elapsed, 3),
+    'blocks_per_second': round(blocks / elapsed, 3) if elapsed > 0 else 0,
+    'cpu_seconds': round(stats['cpu_seconds'], 3),
+    'cpu_utilisation': round(stats['cpu_seconds'] / elapsed, 3) if elapsed > 0 else 0,
+    'max_rss_kb': stats['max_rss_kb'],
+    'read_bytes': stats['read_bytes'],
+    'write_bytes': stats['write_bytes'],
+    'lmdb_size_bytes': lmdb_size,
+    'histograms': histograms,
+    'samples': samples,
+  }
+  print('Synced ' + str(blocks) + ' blocks in ' + str(run['seconds']) + ' s: ' + str(run['blocks_per_second']) + ' blocks/s, ' +
+    str(run['cpu_seconds']) + ' s CPU, ' + str(run['max_rss_kb']) + ' kB max RSS, ' +
+    str(run['read_bytes']) + ' bytes read, ' + str(run['write_bytes']) + ' bytes written')
+  return run
+
+# the daemons are stopped whatever happens, including exceptions and Ctrl-C
+processes = []
+runs = []
+seed_log = open(os.path.join(args.workdir, 'seed.log'), 'w')
+target_log = open(os.path.join(args.workdir, 'target.log'), 'w')
+try:
+  processes.append(subprocess.Popen(seed_cmd, stdout = seed_log, stderr = subprocess.STDOUT))
+  if not wait_for_port(SEED_RPC_PORT, processes[0]):
+    print('Failed to start the seed daemon, see ' + seed_log.name)
+    sys.exit(1)
+
+  seed_height = get_height(Daemon(port = SEED_RPC_PORT))
+  print('Seed daemon serving ' + str(seed_height) + ' blocks')
+
+  for repetition in range(args.repetitions):
+    if args.repetitions > 1:
+      print('Repetition ' + str(repetition + 1) + '/' + str(args.repetitions))
+    runs.append(sync_once(seed_height, processes, target_log))
+finally:
+  stop(processes)
+
+results = {
+  'version': 2,
+  'revision': git_revision(),
+  'bootstrap': os.path.abspath(args.bootstrap),
+  'requested_blocks': args.blocks,
+  'daemon_args': args.daemon_arg,
+  'start_height': runs[0]['start_height'],
+  'end_height': seed_height,
+  'blocks': runs[0]['blocks'],
+  'repetitions': len(runs),
+  'runs': runs,
+}
+# the compared metrics are the means over the repetitions, with their spread
+for name in ['seconds', 'cpu_utilisation', 'lmdb_size_bytes'] + [name for name, higher_is_better in COMPARED_RESULTS]:
+  mean, stddev = mean_and_stddev([run[name] for run in runs])
+  results[name] = round(mean, 3)
+  results[name + '_stddev'] = round(stddev, 3)
+
+if args.repetitions > 1:
+  print('Mean over ' + str(len(runs)) + ' syncs: ' + str(results['blocks_per_second']) + ' +/- ' + str(results['blocks_per_second_stddev']) + ' blocks/s')
+
+if args.output:
+  with open(args.output, 'w') as f:
+    json.dump(results, f, indent = 2, sort_keys = True)
+
+failed = False
+if baseline:
+  if baseline.get('blocks') != results['blocks']:
+    print('The baseline synced ' + str(baseline.get('blocks')) + ' blocks, this run ' + str(results['blocks']) + ', they can not be compared')
+    sys.exit(1)
+  # a regression is a change beyond the tolerance which is also larger than the noise
+  for name, higher_is_better in COMPARED_RESULTS:
+    old = baseline.get(name, 0)
+    new = results[name]
+    if not old:
+      continue
+    change = (new - old) / float(old)
+    regression = -change if higher_is_better else change
+    verdict = 'ok'
+    if regression > args.tolerance:
+      if is_significant(old, baseline.get(name + '_stddev', 0), baseline.get('repetitions', 1), new, results[name + '_stddev'], results['repetitions']):
+        verdict = 'REGRESSION'
+        failed = True
+      else:
+        verdict = 'within noise'
+    print('{0:<20} {1:>28} {2:>28} {3:>+8.1f}%  {4}'.format(name, str(old) + ' +/- ' + str(baseline.get(name + '_stddev', 0)), str(new) + ' +/- ' + str(results[name + '_stddev']), change * 100, verdict))
+
+sys.exit(1 if failed else 0)
@@ -0,0 +1,208 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+#include "crypto/crypto.h"
+#include "wallet/cache_journal.h"
+#include "wallet/wallet2.h"
+
+static std::string random_data(size_t size)
+{
+  std::string data(size, 0);
+  crypto::generate_random_bytes_not_thread_safe(size, &data[0]);
+  return data;
+}
+
+TEST(cache_journal, split_covers_data)
+{
+  const std::string data = random_data(1000000);
+  const auto chunks = tools::cache_journal::split(data);
+  ASSERT_FALSE(chunks.empty());
+  size_t offset = 0;
+  for (const auto &chunk: chunks)
+  {
+    ASSERT_EQ(chunk.first, offset);
+    ASSERT_GT(chunk.second, 0);
+    ASSERT_LE(chunk.second, 65536);
+    offset += chunk.second;
+  }
+  ASSERT_EQ(offset, data.size());
+  ASSERT_EQ(chunks, tools::cache_journal::split(data));
+}
+
+TEST(cache_journal, empty)
+{
+  ASSERT_TRUE(tools::cache_journal::split("").empty());
+
+  tools::cache_journal journal;
+  ASSERT_FALSE(journal.has_base());
+  journal.reset("");
+  ASSERT_TRUE(journal.has_base());
+  const tools::cache_journal_entry entry = journal.make_entry("");
+  ASSERT_TRUE(entry.chunks.empty());
+  ASSERT_TRUE(entry.new_chunks.empty());
+}
+
+TEST(cache_journal, unchanged)
+{
+  const std::string base = random_data(500000);
+  tools::cache_journal journal;
+  journal.reset(base);
+  const tools::cache_journal_entry entry = journal.make_entry(base);
+  ASSERT_FALSE(entry.chunks.empty());
+  ASSERT_TRUE(entry.new_chunks.empty());
+}
+
+TEST(cache_journal, insertion_is_local)
+{
+  const std::string base = random_data(1000000);
+  std::string cache = base;
+  cache.insert(300000, random_data(100));
+  cache.append(random_data(5000));
+
+  tools::cache_journal journal;
+  journal.reset(base);
+  const tools::cache_journal_entry entry = journal.make_entry(cache);
+  size_t bytes = 0;
+  for (const std::string &chunk: entry.new_chunks)
+    bytes += chunk.size();
+  ASSERT_LT(bytes, 4 * 65536 + 5100);
+
+  std::string replayed;
+  bool stale;
+  tools::cache_journal other;
+  ASSERT_EQ(other.replay(base, {entry}, replayed, stale), 1);
+  ASSERT_FALSE(stale);
+  ASSERT_EQ(replayed, cache);
+}
+
+TEST(cache_journal, replay_chain)
+{
+  const std::string base = random_data(300000);
+  std::vector<tools::cache_journal_entry> entries;
+  tools::cache_journal journal;
+  journal.reset(base);
+
+  std::string cache = base;
+  for (int i = 0; i < 5; ++i)
+  {
+    cache.replace(i * 50000, 10, random_data(10));
+    cache.append(random_data(1000));
+    entries.push_back(journal.make_entry(cache));
+  }
+
+  std::string replayed;
+  bool stale;
+  tools::cache_journal other;
+  ASSERT_EQ(other.replay(base, entries, replayed, stale), entries.size());
+  ASSERT_FALSE(stale);
+  ASSERT_EQ(replayed, cache);
+
+  // the replayed journal knows the same chunks as the one which wrote it
+  cache.append(random_data(1000));
+  const tools::cache_journal_entry next = other.make_entry(cache);
+  entries.push_back(next);
+  ASSERT_EQ(other.replay(base, entries, replayed, stale), entries.size());
+  ASSERT_EQ(replayed, cache);
+}
+
+TEST(cache_journal, stale_records)
+{
+  const std::string old_base = random_data(200000);
+  const std::string base = random_data(200000);
+  tools::cache_journal journal;
+  journal.reset(old_base);
+  const tools::cache_journal_entry entry = journal.make_entry(old_base + "x");
+
+  std::string replayed;
+  bool stale;
+  tools::cache_journal other;
+  ASSERT_EQ(other.replay(base, {entry}, replayed, stale), 0);
+  ASSERT_TRUE(stale);
+  ASSERT_EQ(replayed, base);
+}
+
+TEST(cache_journal, missing_chunk)
+{
+  const std::string base = random_data(200000);
+  tools::cache_journal journal;
+  journal.reset(base);
+  tools::cache_journal_entry entry = journal.make_entry(base + random_data(10000));
+  ASSERT_FALSE(entry.new_chunks.empty());
+  entry.new_chunks.pop_back();
+
+  std::string replayed;
+  bool stale;
+  tools::cache_journal other;
+  ASSERT_EQ(other.replay(base, {entry}, replayed, stale), 0);
+  ASSERT_TRUE(stale);
+  ASSERT_EQ(replayed, base);
+}
+
+TEST(cache_journal, change_password)
+{
+  const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  ASSERT_TRUE(boost::filesystem::create_directory(dir));
+  const std::string wallet_file = (dir / "wallet").string();
+  const std::string journal_file = wallet_file + ".journal";
+
+  {
+    tools::wallet2 wallet(cryptonote::TESTNET, 1, true);
+    wallet.set_offline();
+    wallet.generate(wallet_file, "old");
+    wallet.cache_journal_enabled(true);
+    wallet.store();
+    wallet.set_attribute("first", "1");
+    wallet.store();
+    ASSERT_TRUE(boost::filesystem::exists(journal_file));
+
+    // the journal was encrypted with the old key, it must not survive a password change
+    wallet.change_password(wallet_file, "old", "new");
+    ASSERT_FALSE(boost::filesystem::exists(journal_file));
+    wallet.set_attribute("second", "2");
+    wallet.store();
+    ASSERT_TRUE(boost::filesystem::exists(journal_file));
+  }
+
+  {
+    tools::wallet2 wallet(cryptonote::TESTNET, 1, true);
+    wallet.set_offline();
+    wallet.load(wallet_file, "new");
+    ASSERT_TRUE(wallet.cache_journal_enabled());
+    std::string value;
+    ASSERT_TRUE(wallet.get_attribute("first", value));
+    ASSERT_EQ(value, "1");
+    ASSERT_TRUE(wallet.get_attribute("second", value));
+    ASSERT_EQ(value, "2");
+  }
+
+  boost::filesystem::remove_all(dir);
+}
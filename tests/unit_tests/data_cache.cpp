@@ -0,0 +1,75 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "ringct/rctOps.h"
+#include "common/data_cache.h"
+#include "cryptonote_core/tx_verification_utils.h"
+
+TEST(data_cache, bounded)
+{
+  tools::data_cache<int, 3> cache;
+  ASSERT_FALSE(cache.has(0));
+  for (int i = 0; i < 3; ++i)
+    cache.add(i);
+  ASSERT_EQ(cache.size(), 3);
+  for (int i = 0; i < 3; ++i)
+    ASSERT_TRUE(cache.has(i));
+  cache.add(1);
+  ASSERT_EQ(cache.size(), 3);
+  cache.add(3);
+  ASSERT_EQ(cache.size(), 3);
+  ASSERT_FALSE(cache.has(0));
+  ASSERT_TRUE(cache.has(1));
+  ASSERT_TRUE(cache.has(3));
+  cache.clear();
+  ASSERT_EQ(cache.size(), 0);
+  ASSERT_FALSE(cache.has(1));
+}
+
+TEST(tx_verification_cache, ring_key_covers_ring_members)
+{
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  rct::ctkeyM pubkeys(2, rct::ctkeyV(11));
+  for (auto &ring: pubkeys)
+    for (auto &member: ring)
+      member = {rct::skGen(), rct::skGen()};
+  const crypto::hash key = cryptonote::get_tx_ring_verification_key(txid, pubkeys);
+  ASSERT_EQ(key, cryptonote::get_tx_ring_verification_key(txid, pubkeys));
+
+  cryptonote::tx_verification_cache cache;
+  cache.add_ring(key);
+  ASSERT_TRUE(cache.has_ring(key));
+  ASSERT_FALSE(cache.has_semantics(txid));
+
+  // a reorg moving one ring member to another output
+  pubkeys[1][5].dest = rct::skGen();
+  ASSERT_FALSE(cache.has_ring(cryptonote::get_tx_ring_verification_key(txid, pubkeys)));
+  ASSERT_NE(key, cryptonote::get_tx_ring_verification_key(crypto::rand<crypto::hash>(), pubkeys));
+}
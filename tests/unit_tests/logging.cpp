@@ -28,6 +28,8 @@
 //
 // Parts of this file are originally copyright (c) 2015-2019 The Monero Project
 
+#include <atomic>
+#include <thread>
 #include <boost/filesystem.hpp>
 #include "gtest/gtest.h"
 #include "file_io_utils.h"
@@ -195,3 +197,102 @@ TEST(logging, multiline)
   cleanup();
 }
 
+
+TEST(logging, async_file)
+{
+  static const int n_threads = 4, n_lines = 1000;
+  init();
+  mlog_set_categories("global:INFO");
+  mlog_set_async_file_logging(true);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < n_threads; ++t)
+    threads.emplace_back([t]() { for (int i = 0; i < n_lines; ++i) MCINFO("global", "thread " << t << " line " << i); });
+  for (std::thread &t: threads)
+    t.join();
+  el::Helpers::flushAsyncFileLogging();
+  std::string str;
+  ASSERT_TRUE(load_log_to_string(log_filename, str));
+  ASSERT_EQ(nlines(str), n_threads * n_lines);
+  for (int t = 0; t < n_threads; ++t)
+  {
+    size_t pos = 0;
+    for (int i = 0; i < n_lines; ++i)
+    {
+      const size_t next = str.find("thread " + std::to_string(t) + " line " + std::to_string(i) + "\n");
+      ASSERT_TRUE(next != std::string::npos);
+      ASSERT_TRUE(i == 0 || next > pos);
+      pos = next;
+    }
+  }
+
+  // fatal lines are written right away
+  MCFATAL("global", "fatal line");
+  ASSERT_TRUE(load_log_to_string(log_filename, str));
+  ASSERT_TRUE(str.find("fatal line") != std::string::npos);
+
+  // stopping writes what is still queued, then lines are written directly
+  for (int i = 0; i < 100; ++i)
+    MCINFO("global", "queued " << i);
+  mlog_set_async_file_logging(false);
+  ASSERT_TRUE(load_log_to_string(log_filename, str));
+  ASSERT_TRUE(str.find("queued 99\n") != std::string::npos);
+  MCINFO("global", "direct");
+  ASSERT_TRUE(load_log_to_string(log_filename, str));
+  ASSERT_TRUE(str.find("direct") != std::string::npos);
+  cleanup();
+}
+
+TEST(logging, async_file_overflow)
+{
+  // more lines than the writer queues, while another thread keeps flushing
+  // the logger, which waits for the writer with the logger lock held
+  static const int n_lines = 100000;
+  init();
+  mlog_set_categories("global:INFO");
+  mlog_set_async_file_logging(true);
+  std::atomic<bool> done(false);
+  std::thread flusher([&]() { while (!done) el::Loggers::flushAll(); });
+  for (int i = 0; i < n_lines; ++i)
+    MCINFO("global", "line " << i);
+  done = true;
+  flusher.join();
+  el::Helpers::flushAsyncFileLogging();
+  std::string str;
+  ASSERT_TRUE(load_log_to_string(log_filename, str));
+  ASSERT_EQ(nlines(str), n_lines);
+  ASSERT_TRUE(str.find("line " + std::to_string(n_lines - 1) + "\n") != std::string::npos);
+  mlog_set_async_file_logging(false);
+  cleanup();
+}
+
+TEST(logging, allowed_categories_cache)
+{
+  init();
+  mlog_set_categories("x:WARNING");
+  el::base::VRegistry *registry = ELPP->vRegistry();
+  ASSERT_FALSE(registry->allowed(el::Level::Info, "x"));
+  ASSERT_TRUE(registry->allowed(el::Level::Warning, "x"));
+
+  // another thread fills its own copy of the cache, which must be dropped
+  // when the categories change
+  std::atomic<int> step(0);
+  bool before = true, after = false, other = true;
+  std::thread t([&]() {
+    before = registry->allowed(el::Level::Info, "x");
+    step = 1;
+    while (step != 2)
+      std::this_thread::yield();
+    after = registry->allowed(el::Level::Info, "x");
+    other = registry->allowed(el::Level::Info, "y");
+  });
+  while (step != 1)
+    std::this_thread::yield();
+  mlog_set_categories("x:INFO");
+  step = 2;
+  t.join();
+  ASSERT_FALSE(before);
+  ASSERT_TRUE(after);
+  ASSERT_FALSE(other);
+  ASSERT_TRUE(registry->allowed(el::Level::Info, "x"));
+  cleanup();
+}
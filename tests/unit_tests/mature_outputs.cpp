@@ -0,0 +1,164 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+
+#include "gtest/gtest.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "blockchain_db/testdb.h"
+
+namespace
+{
+
+// every output has the same amount here, so the per amount walk over the
+// outputs of a non zero amount counts the same outputs as the rct fast path
+class TestDB: public cryptonote::BaseTestDB
+{
+public:
+  TestDB() { m_open = true; }
+
+  virtual void add_block( const cryptonote::block& blk
+                        , size_t block_weight
+                        , uint64_t long_term_block_weight
+                        , const cryptonote::difficulty_type& cumulative_difficulty
+                        , const uint64_t& coins_generated
+                        , uint64_t num_rct_outs
+                        , const crypto::hash& blk_hash
+                        ) override {
+    cumulative_rct_outs.push_back(get_num_outputs(0) + num_rct_outs);
+    hashes.push_back(blk_hash);
+  }
+  virtual uint64_t height() const override { return hashes.size(); }
+  virtual crypto::hash top_block_hash(uint64_t *block_height = NULL) const override {
+    if (block_height)
+      *block_height = height() - 1;
+    return hashes.empty() ? crypto::null_hash : hashes.back();
+  }
+  virtual void pop_block(cryptonote::block &blk, std::vector<cryptonote::transaction> &txs) override {
+    cumulative_rct_outs.pop_back();
+    hashes.pop_back();
+  }
+  virtual std::vector<uint64_t> get_block_cumulative_rct_outputs(const std::vector<uint64_t> &heights) const override {
+    std::vector<uint64_t> ret;
+    for (uint64_t h: heights)
+      ret.push_back(cumulative_rct_outs[h]);
+    return ret;
+  }
+  virtual uint64_t get_num_outputs(const uint64_t& amount) const override {
+    return cumulative_rct_outs.empty() ? 0 : cumulative_rct_outs.back();
+  }
+  virtual cryptonote::tx_out_index get_output_tx_and_index(const uint64_t& amount, const uint64_t& index) const override {
+    // the tx hash records the height of the block the output is in
+    const uint64_t height = std::upper_bound(cumulative_rct_outs.begin(), cumulative_rct_outs.end(), index) - cumulative_rct_outs.begin();
+    crypto::hash txid = crypto::null_hash;
+    *(uint64_t*)&txid = height;
+    return cryptonote::tx_out_index(txid, 0);
+  }
+  virtual uint64_t get_tx_block_height(const crypto::hash& h) const override { return *(const uint64_t*)&h; }
+
+private:
+  std::vector<uint64_t> cumulative_rct_outs;
+  std::vector<crypto::hash> hashes;
+};
+
+void pop_block(cryptonote::Blockchain &bc)
+{
+  cryptonote::block b;
+  std::vector<cryptonote::transaction> txs;
+  bc.get_db().pop_block(b, txs);
+}
+
+void add_block(cryptonote::Blockchain &bc, size_t n_outs, uint32_t nonce)
+{
+  cryptonote::block b;
+  b.nonce = nonce;
+  b.miner_tx.version = 2;
+  b.miner_tx.vout.resize(n_outs);
+  bc.get_db().add_block(std::make_pair(b, ""), 0, 0, 0, 0, {});
+}
+
+}
+
+#define PREFIX \
+  std::unique_ptr<cryptonote::Blockchain> bc; \
+  cryptonote::tx_memory_pool txpool(*bc); \
+  bc.reset(new cryptonote::Blockchain(txpool)); \
+  struct get_test_options { \
+    const std::pair<uint8_t, uint64_t> hard_forks[2]; \
+    const cryptonote::test_options test_options = { \
+      hard_forks, \
+    }; \
+    get_test_options(): hard_forks{std::make_pair(1, (uint64_t)0), std::make_pair((uint8_t)0, (uint64_t)0)} {} \
+  } opts; \
+  bool r = bc->init(new TestDB(), cryptonote::FAKECHAIN, true, &opts.test_options, 0, NULL); \
+  ASSERT_TRUE(r)
+
+TEST(mature_outputs, matches_walk)
+{
+  PREFIX;
+
+  for (uint32_t h = 1; h < 3 * CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE; ++h)
+  {
+    add_block(*bc, h % 4, h);
+    ASSERT_EQ(bc->get_num_mature_outputs(0), bc->get_num_mature_outputs(1));
+  }
+  ASSERT_GT(bc->get_num_mature_outputs(0), 0);
+}
+
+TEST(mature_outputs, pop)
+{
+  PREFIX;
+
+  for (uint32_t h = 1; h < 3 * CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE; ++h)
+    add_block(*bc, 1 + h % 3, h);
+  while (bc->get_db().height() > 1)
+  {
+    ASSERT_EQ(bc->get_num_mature_outputs(0), bc->get_num_mature_outputs(1));
+    pop_block(*bc);
+  }
+  ASSERT_EQ(bc->get_num_mature_outputs(0), 0);
+}
+
+TEST(mature_outputs, reorg)
+{
+  PREFIX;
+
+  for (uint32_t h = 1; h < 3 * CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE; ++h)
+    add_block(*bc, 2, h);
+  const uint64_t before = bc->get_num_mature_outputs(0);
+  ASSERT_EQ(before, bc->get_num_mature_outputs(1));
+
+  // replace the blocks back to the last mature one, at the same heights but
+  // with other hashes and output counts, so a cache keyed on height goes stale
+  for (size_t n = 0; n < CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE + 2; ++n)
+    pop_block(*bc);
+  ASSERT_EQ(bc->get_num_mature_outputs(0), bc->get_num_mature_outputs(1));
+  for (uint32_t n = 0; n < CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE + 2; ++n)
+    add_block(*bc, 5, 1000000 + n);
+  ASSERT_EQ(bc->get_num_mature_outputs(0), bc->get_num_mature_outputs(1));
+  ASSERT_NE(bc->get_num_mature_outputs(0), before);
+}
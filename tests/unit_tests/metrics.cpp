@@ -0,0 +1,94 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "metrics.h"
+
+TEST(metrics, counter)
+{
+  epee::metrics::counter &c = epee::metrics::get_counter("test_counter_total", "test", epee::metrics::label("a", "b"));
+  const uint64_t start = c.value();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&c](){ for (int i = 0; i < 1000; ++i) c.inc(2); });
+  for (std::thread &t: threads)
+    t.join();
+  ASSERT_EQ(c.value(), start + 8000);
+  ASSERT_EQ(&c, &epee::metrics::get_counter("test_counter_total", "test", epee::metrics::label("a", "b")));
+  ASSERT_NE(&c, &epee::metrics::get_counter("test_counter_total", "test", epee::metrics::label("a", "c")));
+}
+
+TEST(metrics, histogram)
+{
+  epee::metrics::histogram h;
+  h.observe(0);
+  h.observe(1);
+  h.observe(2);
+  h.observe(3);
+  h.observe(4);
+  h.observe(5);
+  h.observe(std::numeric_limits<uint64_t>::max());
+  uint64_t buckets[epee::metrics::histogram::NUM_BUCKETS], count, sum;
+  h.get(buckets, count, sum);
+  ASSERT_EQ(count, 7);
+  ASSERT_EQ(buckets[0], 2); // <= 1
+  ASSERT_EQ(buckets[1], 1); // 2
+  ASSERT_EQ(buckets[2], 2); // 3, 4
+  ASSERT_EQ(buckets[3], 1); // 5
+  ASSERT_EQ(buckets[64], 1);
+}
+
+TEST(metrics, label)
+{
+  ASSERT_EQ(epee::metrics::label("k", "v"), "k=\"v\"");
+  ASSERT_EQ(epee::metrics::label("k", "a\"b\\c\nd"), "k=\"a\\\"b\\\\c\\nd\"");
+}
+
+TEST(metrics, exposition)
+{
+  epee::metrics::get_counter("test_exposition_total", "exposition test").inc(3);
+  epee::metrics::histogram &h = epee::metrics::get_histogram("test_exposition_seconds", "exposition test", 0.5, epee::metrics::label("m", "x"));
+  h.observe(2);
+  h.observe(3);
+  const std::string s = epee::metrics::get_exposition();
+  ASSERT_NE(s.find("# TYPE test_exposition_total counter\ntest_exposition_total 3\n"), std::string::npos);
+  ASSERT_NE(s.find("# TYPE test_exposition_seconds histogram\n"), std::string::npos);
+  ASSERT_NE(s.find("test_exposition_seconds_bucket{m=\"x\",le=\"1\"} 1\n"), std::string::npos);
+  ASSERT_NE(s.find("test_exposition_seconds_bucket{m=\"x\",le=\"2\"} 2\n"), std::string::npos);
+  ASSERT_NE(s.find("test_exposition_seconds_bucket{m=\"x\",le=\"+Inf\"} 2\n"), std::string::npos);
+  ASSERT_NE(s.find("test_exposition_seconds_sum{m=\"x\"} 2.5\n"), std::string::npos);
+  ASSERT_NE(s.find("test_exposition_seconds_count{m=\"x\"} 2\n"), std::string::npos);
+}
+
+TEST(metrics, type_mismatch)
+{
+  epee::metrics::get_counter("test_mismatch", "mismatch test");
+  ASSERT_THROW(epee::metrics::get_histogram("test_mismatch", "mismatch test", 1.0), std::exception);
+}
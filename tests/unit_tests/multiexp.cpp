@@ -314,3 +314,26 @@ TEST(multiexp, scalarmult_triple)
     }
   }
 }
+
+TEST(multiexp, scratch_reuse)
+{
+  // multiexps without a cache reuse per thread buffers, so mix sizes going
+  // up and down, and past the sizes those buffers are kept for
+  static const size_t sizes[] = {16, 2, 200, 7, 300, 1, 5000, 64, 3};
+  std::vector<rct::MultiexpData> data;
+  for (size_t n: sizes)
+  {
+    data.clear();
+    for (size_t i = 0; i < n; ++i)
+      data.push_back({rct::skGen(), get_p3(rct::scalarmultBase(rct::skGen()))});
+    const rct::key expected = basic(data);
+    ASSERT_TRUE(expected == straus(data));
+    ASSERT_TRUE(expected == pippenger(data));
+    const size_t cache_size = n / 2;
+    if (cache_size > 0)
+    {
+      std::shared_ptr<rct::pippenger_cached_data> cache = rct::pippenger_init_cache(data, 0, cache_size);
+      ASSERT_TRUE(expected == pippenger(data, cache, cache_size));
+    }
+  }
+}
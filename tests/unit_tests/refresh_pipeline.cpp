@@ -0,0 +1,252 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "gtest/gtest.h"
+
+#include <boost/thread/thread.hpp>
+#include "common/threadpool.h"
+#include "crypto/crypto.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "wallet/refresh_pipeline.h"
+
+namespace
+{
+  struct span
+  {
+    uint64_t start_height;
+    std::vector<cryptonote::blobdata> blobs;
+    std::vector<crypto::hash> hashes;
+    std::vector<cryptonote::block> blocks;
+    bool error;
+  };
+
+  // a chain of block blobs, as a daemon would serve them
+  std::vector<cryptonote::blobdata> make_chain(size_t n)
+  {
+    std::vector<cryptonote::blobdata> chain;
+    crypto::hash prev_id = crypto::null_hash;
+    for (size_t i = 0; i < n; ++i)
+    {
+      cryptonote::block b;
+      b.major_version = 1;
+      b.minor_version = 1;
+      b.timestamp = 1000000 + i * 120;
+      b.prev_id = prev_id;
+      b.nonce = crypto::rand<uint32_t>();
+      b.miner_tx.version = 1;
+      b.miner_tx.unlock_time = i + 60;
+      b.miner_tx.vin.push_back(cryptonote::txin_gen{i});
+      chain.push_back(cryptonote::block_to_blob(b));
+      prev_id = cryptonote::get_block_hash(b);
+    }
+    return chain;
+  }
+
+  // pulls the span following the last of prev_hashes and parses it on the
+  // threadpool, as wallet2::pull_and_parse_next_blocks does. Span sizes vary,
+  // and each pull takes a random while, so the producer and the consumer of
+  // a pipeline run at different paces
+  class fake_daemon
+  {
+  public:
+    fake_daemon(const std::vector<cryptonote::blobdata> &chain): m_chain(chain)
+    {
+      for (size_t i = 0; i < chain.size(); ++i)
+      {
+        cryptonote::block b;
+        crypto::hash hash;
+        if (cryptonote::parse_and_validate_block_from_blob(chain[i], b, hash))
+          m_heights[hash] = i;
+      }
+    }
+
+    bool pull_and_parse(const std::vector<crypto::hash> &prev_hashes, span &s)
+    {
+      uint64_t start = 0;
+      if (!prev_hashes.empty())
+      {
+        const auto i = m_heights.find(prev_hashes.back());
+        if (i == m_heights.end())
+          return false;
+        start = i->second + 1;
+      }
+      const size_t n = std::min<size_t>(1 + start * 7 % 13, m_chain.size() - start);
+      s.start_height = start;
+      s.blobs.assign(m_chain.begin() + start, m_chain.begin() + start + n);
+      s.hashes.resize(n);
+      s.blocks.resize(n);
+      s.error = false;
+      std::vector<char> errors(n, 0);
+
+      tools::threadpool& tpool = tools::threadpool::getInstance();
+      tools::threadpool::waiter waiter(tpool);
+      for (size_t i = 0; i < n; ++i)
+        tpool.submit(&waiter, [&, i](){ errors[i] = !cryptonote::parse_and_validate_block_from_blob(s.blobs[i], s.blocks[i], s.hashes[i]); }, true);
+      if (!waiter.wait())
+        return false;
+      for (char e: errors)
+        s.error |= !!e;
+      boost::this_thread::sleep_for(boost::chrono::microseconds(crypto::rand<uint32_t>() % 2000));
+      return true;
+    }
+
+  private:
+    const std::vector<cryptonote::blobdata> &m_chain;
+    std::unordered_map<crypto::hash, uint64_t> m_heights;
+  };
+
+  // feeds each pull the hashes at the end of the previous span, like wallet2::refresh
+  tools::refresh_pipeline<span>::producer make_producer(fake_daemon &daemon, size_t chain_size)
+  {
+    std::vector<crypto::hash> prev_hashes;
+    return [&daemon, chain_size, prev_hashes](span &s, bool &last) mutable {
+      if (!daemon.pull_and_parse(prev_hashes, s))
+        return false;
+      last = s.error || s.blobs.empty() || s.start_height + s.blobs.size() == chain_size;
+      prev_hashes.assign(s.hashes.end() - std::min<size_t>(3, s.hashes.size()), s.hashes.end());
+      return true;
+    };
+  }
+
+  void expect_same(const std::vector<span> &serial, const std::vector<span> &pipelined)
+  {
+    ASSERT_EQ(serial.size(), pipelined.size());
+    for (size_t i = 0; i < serial.size(); ++i)
+    {
+      ASSERT_EQ(serial[i].start_height, pipelined[i].start_height);
+      ASSERT_EQ(serial[i].blobs, pipelined[i].blobs);
+      ASSERT_EQ(serial[i].hashes, pipelined[i].hashes);
+      ASSERT_EQ(serial[i].error, pipelined[i].error);
+      ASSERT_EQ(serial[i].blocks.size(), pipelined[i].blocks.size());
+      for (size_t j = 0; j < serial[i].blocks.size(); ++j)
+        ASSERT_EQ(cryptonote::block_to_blob(serial[i].blocks[j]), cryptonote::block_to_blob(pipelined[i].blocks[j]));
+    }
+  }
+}
+
+TEST(refresh_pipeline, matches_serial)
+{
+  const std::vector<cryptonote::blobdata> chain = make_chain(500);
+  fake_daemon daemon(chain);
+
+  std::vector<span> serial;
+  auto produce = make_producer(daemon, chain.size());
+  while (true)
+  {
+    span s;
+    bool last = false;
+    ASSERT_TRUE(produce(s, last));
+    serial.push_back(std::move(s));
+    if (last)
+      break;
+  }
+  ASSERT_GT(serial.size(), 10);
+  uint64_t height = 0;
+  for (const span &s: serial)
+  {
+    ASSERT_FALSE(s.error);
+    ASSERT_EQ(s.start_height, height);
+    height += s.blobs.size();
+  }
+  ASSERT_EQ(height, chain.size());
+
+  for (size_t depth: {0, 1, 2, 3, 8, 64})
+  {
+    tools::refresh_pipeline<span> pipeline;
+    pipeline.start(depth, make_producer(daemon, chain.size()));
+    std::vector<span> pipelined;
+    span s;
+    while (pipeline.next(s))
+    {
+      pipelined.push_back(std::move(s));
+      boost::this_thread::sleep_for(boost::chrono::microseconds(crypto::rand<uint32_t>() % 2000));
+    }
+    expect_same(serial, pipelined);
+  }
+}
+
+TEST(refresh_pipeline, parse_error_ends_pipeline)
+{
+  std::vector<cryptonote::blobdata> chain = make_chain(100);
+  chain[50] = "garbage";
+  fake_daemon daemon(chain);
+
+  tools::refresh_pipeline<span> pipeline;
+  pipeline.start(4, make_producer(daemon, chain.size()));
+  std::vector<span> spans;
+  span s;
+  while (pipeline.next(s))
+    spans.push_back(std::move(s));
+  ASSERT_FALSE(spans.empty());
+  for (size_t i = 0; i + 1 < spans.size(); ++i)
+    ASSERT_FALSE(spans[i].error);
+  ASSERT_TRUE(spans.back().error);
+  ASSERT_LE(spans.back().start_height, 50);
+  ASSERT_GT(spans.back().start_height + spans.back().blobs.size(), 50);
+}
+
+TEST(refresh_pipeline, stop_and_restart)
+{
+  const std::vector<cryptonote::blobdata> chain = make_chain(300);
+  fake_daemon daemon(chain);
+
+  tools::refresh_pipeline<span> pipeline;
+  span s;
+
+  // the producer is left blocked on a full queue
+  pipeline.start(2, make_producer(daemon, chain.size()));
+  ASSERT_TRUE(pipeline.next(s));
+  ASSERT_EQ(s.start_height, 0);
+  pipeline.stop();
+  ASSERT_FALSE(pipeline.next(s));
+
+  // a new run starts from scratch, with nothing left over from the last one
+  pipeline.start(2, make_producer(daemon, chain.size()));
+  uint64_t height = 0;
+  while (pipeline.next(s))
+  {
+    ASSERT_EQ(s.start_height, height);
+    height += s.blobs.size();
+  }
+  ASSERT_EQ(height, chain.size());
+}
+
+TEST(refresh_pipeline, producer_ends_without_item)
+{
+  tools::refresh_pipeline<int> pipeline;
+  int produced = 0;
+  pipeline.start(3, [&produced](int &i, bool &last) {
+    if (produced == 10)
+      return false;
+    i = produced++;
+    return true;
+  });
+  int i, expected = 0;
+  while (pipeline.next(i))
+    ASSERT_EQ(i, expected++);
+  ASSERT_EQ(expected, 10);
+}
@@ -29,8 +29,12 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
 #include <fcntl.h>
 #include <string.h>
+#include <functional>
 #include <boost/filesystem.hpp>
 
 #include "gtest/gtest.h"
@@ -82,6 +86,7 @@ class RingDB: public tools::ringdb
 public:
   RingDB(const char *genesis = ""): tools::ringdb(make_filename(), genesis) { }
   ~RingDB() { close(); boost::filesystem::remove_all(filename); free(filename); }
+  const char *get_filename() const { return filename; }
 
 private:
   std::string make_filename()
@@ -142,6 +147,80 @@ TEST(ringdb, different_genesis)
   ASSERT_FALSE(ringdb.get_ring(KEY_2, KEY_IMAGE_1, outs2));
 }
 
+TEST(ringdb, set_rings)
+{
+  RingDB ringdb;
+  std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> rings;
+  for (uint64_t i = 0; i < 100; ++i)
+    rings.push_back(std::make_pair(generate_key_image(), std::vector<uint64_t>{i, i + 10, i + 20}));
+  ASSERT_TRUE(ringdb.set_rings(KEY_1, rings, false));
+  for (const auto &ring: rings)
+  {
+    std::vector<uint64_t> outs;
+    ASSERT_TRUE(ringdb.get_ring(KEY_1, ring.first, outs));
+    ASSERT_EQ(outs, ring.second);
+  }
+}
+
+TEST(ringdb, cached_ring_updated)
+{
+  RingDB ringdb;
+  std::vector<uint64_t> outs, outs2;
+  outs.push_back(43); outs.push_back(7320); outs.push_back(8429);
+  ASSERT_TRUE(ringdb.set_ring(KEY_1, KEY_IMAGE_1, outs, false));
+  ASSERT_TRUE(ringdb.get_ring(KEY_1, KEY_IMAGE_1, outs2));
+  outs[1] = 7321;
+  ASSERT_TRUE(ringdb.set_ring(KEY_1, KEY_IMAGE_1, outs, false));
+  ASSERT_TRUE(ringdb.get_ring(KEY_1, KEY_IMAGE_1, outs2));
+  ASSERT_EQ(outs, outs2);
+  ASSERT_TRUE(ringdb.remove_rings(KEY_1, std::vector<crypto::key_image>(1, KEY_IMAGE_1)));
+  ASSERT_FALSE(ringdb.get_ring(KEY_1, KEY_IMAGE_1, outs2));
+}
+
+#ifndef _WIN32
+static bool in_other_process(const char *filename, const std::function<void(tools::ringdb&)> &f)
+{
+  const pid_t pid = fork();
+  if (pid < 0)
+    return false;
+  if (pid == 0)
+  {
+    int ret = 0;
+    try { tools::ringdb ringdb(filename, ""); f(ringdb); ringdb.close(); }
+    catch (...) { ret = 1; }
+    _exit(ret);
+  }
+  int status;
+  return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+TEST(ringdb, cached_ring_written_by_other_process)
+{
+  RingDB ringdb;
+  const crypto::key_image key_image_2 = generate_key_image();
+  std::vector<uint64_t> outs{43, 7320, 8429}, outs2;
+  ASSERT_TRUE(ringdb.set_ring(KEY_1, KEY_IMAGE_1, outs, false));
+  ASSERT_TRUE(ringdb.get_ring(KEY_1, KEY_IMAGE_1, outs2));
+
+  outs[1] = 7321;
+  ASSERT_TRUE(in_other_process(ringdb.get_filename(), [&](tools::ringdb &other) { other.set_ring(KEY_1, KEY_IMAGE_1, outs, false); }));
+  ASSERT_TRUE(ringdb.get_ring(KEY_1, KEY_IMAGE_1, outs2));
+  ASSERT_EQ(outs, outs2);
+
+  // a write of our own does not hide one made by another process just before it
+  outs[2] = 8430;
+  ASSERT_TRUE(in_other_process(ringdb.get_filename(), [&](tools::ringdb &other) { other.set_ring(KEY_1, KEY_IMAGE_1, outs, false); }));
+  ASSERT_TRUE(ringdb.set_ring(KEY_1, key_image_2, outs, false));
+  ASSERT_TRUE(ringdb.get_ring(KEY_1, KEY_IMAGE_1, outs2));
+  ASSERT_EQ(outs, outs2);
+
+  ASSERT_TRUE(in_other_process(ringdb.get_filename(), [&](tools::ringdb &other) { other.remove_rings(KEY_1, std::vector<crypto::key_image>(1, KEY_IMAGE_1)); }));
+  ASSERT_FALSE(ringdb.get_ring(KEY_1, KEY_IMAGE_1, outs2));
+  ASSERT_TRUE(ringdb.get_ring(KEY_1, key_image_2, outs2));
+  ASSERT_EQ(outs, outs2);
+}
+#endif
+
 TEST(spent_outputs, not_found)
 {
   RingDB ringdb;
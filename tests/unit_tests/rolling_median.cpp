@@ -79,6 +79,31 @@ TEST(rolling_median, series)
   }
 }
 
+TEST(rolling_median, rollback)
+{
+  epee::misc_utils::rolling_median_t<uint64_t> m(100);
+  std::vector<uint64_t> random, median;
+  random.reserve(1000);
+  median.reserve(1000);
+  for (int i = 0; i < 1000; ++i)
+  {
+    random.push_back(crypto::rand<uint64_t>() % 1000);
+    m.insert(random.back());
+    median.push_back(m.median());
+  }
+  for (int i = 999; i > 500; --i)
+  {
+    m.rollback(random[i - 100]);
+    ASSERT_EQ(median[i - 1], m.median());
+    ASSERT_EQ(m.size(), 100);
+  }
+  for (int i = 501; i < 1000; ++i)
+  {
+    m.insert(random[i]);
+    ASSERT_EQ(median[i], m.median());
+  }
+}
+
 TEST(rolling_median, clear_whole)
 {
   epee::misc_utils::rolling_median_t<uint64_t> m(100);
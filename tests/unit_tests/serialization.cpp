@@ -1178,3 +1178,74 @@ TEST(Serialization, difficulty_type)
 
   ASSERT_EQ(v_original, v_unserialized);
 }
+
+TEST(Serialization, transfer_details_compact_tx)
+{
+  tools::wallet2::transfer_details td = AUTO_VAL_INIT(td);
+  cryptonote::txin_to_key txin;
+  txin.amount = 0;
+  txin.key_offsets = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+  txin.k_image = rct::rct2ki(rct::identity());
+  td.m_tx.vin.push_back(txin);
+  cryptonote::tx_out txout;
+  txout.amount = 0;
+  txout.target = cryptonote::txout_to_key(rct::rct2pk(rct::H));
+  td.m_tx.vout.push_back(txout);
+  td.m_tx.extra = {1, 2, 3};
+
+  std::stringstream ss;
+  boost::archive::portable_binary_oarchive a(ss);
+  a << td;
+
+  // serialization itself keeps the ring members
+  tools::wallet2::transfer_details td2;
+  boost::archive::portable_binary_iarchive a2(ss);
+  a2 >> td2;
+  ASSERT_EQ(boost::get<cryptonote::txin_to_key>(td2.m_tx.vin[0]).key_offsets.size(), 11);
+
+  td2.compact_tx();
+  ASSERT_EQ(td2.m_tx.vin.size(), 1);
+  ASSERT_TRUE(boost::get<cryptonote::txin_to_key>(td2.m_tx.vin[0]).key_offsets.empty());
+  ASSERT_EQ(boost::get<cryptonote::txin_to_key>(td2.m_tx.vin[0]).k_image, txin.k_image);
+  ASSERT_EQ(td2.get_public_key(), rct::rct2pk(rct::H));
+  ASSERT_EQ(td2.m_tx.extra, td.m_tx.extra);
+}
+
+TEST(Serialization, transfer_details_compact_on_load)
+{
+  const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  ASSERT_TRUE(boost::filesystem::create_directory(dir));
+  const std::string wallet_file = (dir / "wallet").string();
+
+  tools::wallet2::transfer_details td = AUTO_VAL_INIT(td);
+  cryptonote::txin_to_key txin;
+  txin.amount = 0;
+  txin.key_offsets = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+  txin.k_image = rct::rct2ki(rct::identity());
+  td.m_tx.vin.push_back(txin);
+  cryptonote::tx_out txout;
+  txout.amount = 0;
+  txout.target = cryptonote::txout_to_key(rct::rct2pk(rct::H));
+  td.m_tx.vout.push_back(txout);
+
+  // a cache as written before compact_tx existed, with the ring members still there
+  {
+    tools::wallet2 w(cryptonote::TESTNET, 1, true);
+    w.set_offline();
+    w.generate(wallet_file, "test");
+    w.m_transfers.push_back(td);
+    w.store();
+  }
+
+  tools::wallet2 w(cryptonote::TESTNET, 1, true);
+  w.set_offline();
+  w.load(wallet_file, "test");
+  ASSERT_EQ(w.m_transfers.size(), 1);
+  const cryptonote::transaction_prefix &tx = w.m_transfers[0].m_tx;
+  ASSERT_EQ(tx.vin.size(), 1);
+  ASSERT_TRUE(boost::get<cryptonote::txin_to_key>(tx.vin[0]).key_offsets.empty());
+  ASSERT_EQ(boost::get<cryptonote::txin_to_key>(tx.vin[0]).k_image, txin.k_image);
+  ASSERT_EQ(w.m_transfers[0].get_public_key(), rct::rct2pk(rct::H));
+
+  boost::filesystem::remove_all(dir);
+}
@@ -0,0 +1,103 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "gtest/gtest.h"
+
+#include "wallet/shared_block_cache.h"
+
+static std::shared_ptr<tools::shared_block_cache::entry> make_entry(uint64_t start_height, size_t blob_size)
+{
+  std::shared_ptr<tools::shared_block_cache::entry> e = std::make_shared<tools::shared_block_cache::entry>();
+  e->blocks_start_height = start_height;
+  e->current_height = start_height + 1;
+  std::vector<cryptonote::block_complete_entry> blocks(1);
+  blocks[0].block = std::string(blob_size, 'x');
+  e->blocks = std::make_shared<const std::vector<cryptonote::block_complete_entry>>(std::move(blocks));
+  e->parsed_blocks = std::make_shared<const std::vector<tools::wallet2::parsed_block>>(1);
+  return e;
+}
+
+TEST(shared_block_cache, key)
+{
+  const crypto::hash h0 = crypto::cn_fast_hash("0", 1), h1 = crypto::cn_fast_hash("1", 1);
+  const crypto::hash key = tools::shared_block_cache::make_key("127.0.0.1:18081", cryptonote::MAINNET, 10, {h0, h1}, false);
+  ASSERT_EQ(key, tools::shared_block_cache::make_key("127.0.0.1:18081", cryptonote::MAINNET, 10, {h0, h1}, false));
+  ASSERT_NE(key, tools::shared_block_cache::make_key("127.0.0.1:18081", cryptonote::MAINNET, 11, {h0, h1}, false));
+  ASSERT_NE(key, tools::shared_block_cache::make_key("127.0.0.1:18081", cryptonote::MAINNET, 10, {h1, h0}, false));
+  ASSERT_NE(key, tools::shared_block_cache::make_key("127.0.0.1:18081", cryptonote::MAINNET, 10, {h0}, false));
+  ASSERT_NE(key, tools::shared_block_cache::make_key("127.0.0.1:18081", cryptonote::MAINNET, 10, {h0, h1}, true));
+  ASSERT_NE(key, tools::shared_block_cache::make_key("127.0.0.1:18082", cryptonote::MAINNET, 10, {h0, h1}, false));
+  ASSERT_NE(key, tools::shared_block_cache::make_key("127.0.0.1:18081", cryptonote::TESTNET, 10, {h0, h1}, false));
+}
+
+TEST(shared_block_cache, find)
+{
+  tools::shared_block_cache cache;
+  const crypto::hash key = tools::shared_block_cache::make_key("127.0.0.1:18081", cryptonote::MAINNET, 10, {crypto::null_hash}, false);
+  ASSERT_EQ(cache.find(key), nullptr);
+  const auto e = make_entry(10, 100);
+  cache.add(key, e);
+  ASSERT_EQ(cache.find(key), e);
+  ASSERT_EQ(cache.get_hits(), 1);
+  ASSERT_EQ(cache.get_misses(), 1);
+  ASSERT_EQ(cache.size(), tools::shared_block_cache::get_entry_size(*e));
+  cache.clear();
+  ASSERT_EQ(cache.find(key), nullptr);
+  ASSERT_EQ(cache.size(), 0);
+}
+
+TEST(shared_block_cache, size_limit)
+{
+  tools::shared_block_cache cache(1000);
+  std::vector<crypto::hash> keys;
+  for (uint64_t height = 0; height < 4; ++height)
+  {
+    keys.push_back(tools::shared_block_cache::make_key("127.0.0.1:18081", cryptonote::MAINNET, height, {crypto::null_hash}, false));
+    cache.add(keys.back(), make_entry(height, 200));
+  }
+  ASSERT_LE(cache.size(), 1000);
+  ASSERT_EQ(cache.find(keys[0]), nullptr);
+  ASSERT_EQ(cache.find(keys[1]), nullptr);
+  ASSERT_NE(cache.find(keys[2]), nullptr);
+  ASSERT_NE(cache.find(keys[3]), nullptr);
+
+  // too large to ever fit
+  const crypto::hash key = tools::shared_block_cache::make_key("127.0.0.1:18081", cryptonote::MAINNET, 100, {crypto::null_hash}, false);
+  cache.add(key, make_entry(100, 1000));
+  ASSERT_EQ(cache.find(key), nullptr);
+  ASSERT_NE(cache.find(keys[3]), nullptr);
+}
+
+TEST(shared_block_cache, max_age)
+{
+  tools::shared_block_cache cache(1000000, 0);
+  const crypto::hash key = tools::shared_block_cache::make_key("127.0.0.1:18081", cryptonote::MAINNET, 10, {crypto::null_hash}, false);
+  cache.add(key, make_entry(10, 100));
+  sleep(2);
+  ASSERT_EQ(cache.find(key), nullptr);
+  ASSERT_EQ(cache.size(), 0);
+}
@@ -0,0 +1,111 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <thread>
+#include "gtest/gtest.h"
+#include "rapidjson/document.h"
+#include "common/trace.h"
+
+namespace
+{
+  const tools::trace_span_summary *find_summary(const std::vector<tools::trace_span_summary> &summaries, const std::string &name)
+  {
+    auto i = std::find_if(summaries.begin(), summaries.end(), [&name](const tools::trace_span_summary &s) { return s.name == name; });
+    return i == summaries.end() ? nullptr : &*i;
+  }
+}
+
+TEST(trace, wraparound)
+{
+  tools::clear_trace();
+  std::thread t([](){
+    const uint64_t ticks = tools::get_tick_count();
+    for (int i = 0; i < 10; ++i)
+      tools::add_trace_span("old", "test", ticks, ticks + 1);
+    for (int i = 0; i < TRACE_BUFFER_SPANS; ++i)
+      tools::add_trace_span("new", "test", ticks, ticks + 1);
+  });
+  t.join();
+  const std::vector<tools::trace_span_summary> summaries = tools::get_trace_summary();
+  ASSERT_EQ(find_summary(summaries, "old"), nullptr);
+  const tools::trace_span_summary *s = find_summary(summaries, "new");
+  ASSERT_NE(s, nullptr);
+  ASSERT_EQ(s->count, TRACE_BUFFER_SPANS);
+  tools::clear_trace();
+  ASSERT_TRUE(tools::get_trace_summary().empty());
+}
+
+TEST(trace, enable_disable)
+{
+  tools::clear_trace();
+  tools::set_tracing(false);
+  ASSERT_FALSE(tools::is_tracing());
+  { tools::trace_span span("disabled_span", "test"); }
+  tools::set_tracing(true);
+  ASSERT_TRUE(tools::is_tracing());
+  { tools::trace_span span("enabled_span", "test"); }
+  tools::set_tracing(false);
+  { tools::trace_span span("disabled_span", "test"); }
+  const std::vector<tools::trace_span_summary> summaries = tools::get_trace_summary();
+  ASSERT_EQ(summaries.size(), 1);
+  ASSERT_EQ(summaries[0].name, "enabled_span");
+  ASSERT_EQ(summaries[0].count, 1);
+  tools::clear_trace();
+}
+
+TEST(trace, chrome_json)
+{
+  tools::clear_trace();
+  ASSERT_EQ(tools::get_chrome_trace(), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[]}");
+
+  const uint64_t ticks = tools::get_tick_count();
+  tools::add_trace_span("a\"b\\c\nd\x01", "test", ticks, ticks + tools::get_ticks_per_ns() * 5000);
+  tools::add_trace_span("plain", "test", ticks, ticks);
+  const std::string trace = tools::get_chrome_trace();
+  tools::clear_trace();
+  ASSERT_NE(trace.find("\"name\":\"a\\\"b\\\\c\\u000ad\\u0001\""), std::string::npos);
+
+  rapidjson::Document d;
+  ASSERT_FALSE(d.Parse(trace.c_str()).HasParseError());
+  ASSERT_TRUE(d.HasMember("traceEvents"));
+  const rapidjson::Value &events = d["traceEvents"];
+  ASSERT_TRUE(events.IsArray());
+  ASSERT_EQ(events.Size(), 2);
+  ASSERT_EQ(std::string(events[0]["name"].GetString()), "a\"b\\c\nd\x01");
+  ASSERT_EQ(std::string(events[1]["name"].GetString()), "plain");
+  for (rapidjson::SizeType i = 0; i < events.Size(); ++i)
+  {
+    ASSERT_EQ(std::string(events[i]["ph"].GetString()), "X");
+    ASSERT_EQ(std::string(events[i]["cat"].GetString()), "test");
+    ASSERT_EQ(events[i]["tid"].GetUint(), events[0]["tid"].GetUint());
+    ASSERT_TRUE(events[i]["ts"].IsNumber());
+    ASSERT_GE(events[i]["dur"].GetDouble(), 0.0);
+  }
+  ASSERT_EQ(events[1]["dur"].GetDouble(), 0.0);
+}
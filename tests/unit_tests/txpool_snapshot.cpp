@@ -0,0 +1,255 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#define IN_UNIT_TESTS
+
+#include <boost/filesystem.hpp>
+#include "gtest/gtest.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "blockchain_db/testdb.h"
+
+namespace
+{
+
+class TestDB: public cryptonote::BaseTestDB
+{
+public:
+  TestDB() { m_open = true; }
+
+  virtual void add_block( const cryptonote::block& blk
+                        , size_t block_weight
+                        , uint64_t long_term_block_weight
+                        , const cryptonote::difficulty_type& cumulative_difficulty
+                        , const uint64_t& coins_generated
+                        , uint64_t num_rct_outs
+                        , const crypto::hash& blk_hash
+                        ) override {
+    blocks.push_back({block_weight, long_term_block_weight});
+  }
+  virtual uint64_t height() const override { return blocks.size(); }
+  virtual size_t get_block_weight(const uint64_t &h) const override { return blocks[h].first; }
+  virtual uint64_t get_block_long_term_weight(const uint64_t &h) const override { return blocks[h].second; }
+  virtual std::vector<uint64_t> get_block_weights(uint64_t start_height, size_t count) const override {
+    std::vector<uint64_t> ret;
+    while (count-- && start_height < blocks.size()) ret.push_back(blocks[start_height++].first);
+    return ret;
+  }
+  virtual std::vector<uint64_t> get_long_term_block_weights(uint64_t start_height, size_t count) const override {
+    std::vector<uint64_t> ret;
+    while (count-- && start_height < blocks.size()) ret.push_back(blocks[start_height++].second);
+    return ret;
+  }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &height) const override {
+    crypto::hash hash = crypto::null_hash;
+    *(uint64_t*)&hash = height;
+    return hash;
+  }
+  virtual crypto::hash top_block_hash(uint64_t *block_height = NULL) const override {
+    uint64_t h = height();
+    crypto::hash top = crypto::null_hash;
+    if (h)
+      *(uint64_t*)&top = h - 1;
+    if (block_height)
+      *block_height = h - 1;
+    return top;
+  }
+  virtual void pop_block(cryptonote::block &blk, std::vector<cryptonote::transaction> &txs) override { blocks.pop_back(); }
+
+  virtual void add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata_ref &blob, const cryptonote::txpool_tx_meta_t& meta) override {
+    txes[txid] = std::make_pair(std::string(blob.data(), blob.size()), meta);
+  }
+  virtual void update_txpool_tx(const crypto::hash &txid, const cryptonote::txpool_tx_meta_t& meta) override { txes[txid].second = meta; }
+  virtual uint64_t get_txpool_tx_count(cryptonote::relay_category category = cryptonote::relay_category::broadcasted) const override {
+    uint64_t n = 0;
+    for (const auto &e: txes)
+      n += e.second.second.matches(category);
+    return n;
+  }
+  virtual bool txpool_has_tx(const crypto::hash &txid, cryptonote::relay_category category) const override {
+    const auto i = txes.find(txid);
+    return i != txes.end() && i->second.second.matches(category);
+  }
+  virtual void remove_txpool_tx(const crypto::hash& txid) override { txes.erase(txid); }
+  virtual bool get_txpool_tx_meta(const crypto::hash& txid, cryptonote::txpool_tx_meta_t &meta) const override {
+    const auto i = txes.find(txid);
+    if (i == txes.end())
+      return false;
+    meta = i->second.second;
+    return true;
+  }
+  virtual bool get_txpool_tx_blob(const crypto::hash& txid, cryptonote::blobdata &bd, cryptonote::relay_category category) const override {
+    if (!txpool_has_tx(txid, category))
+      return false;
+    bd = txes.find(txid)->second.first;
+    return true;
+  }
+  virtual cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid, cryptonote::relay_category category) const override {
+    cryptonote::blobdata bd;
+    get_txpool_tx_blob(txid, bd, category);
+    return bd;
+  }
+  virtual bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const cryptonote::txpool_tx_meta_t&, const cryptonote::blobdata_ref*)> f, bool include_blob = false, cryptonote::relay_category category = cryptonote::relay_category::broadcasted) const override {
+    for (const auto &e: txes)
+    {
+      if (!e.second.second.matches(category))
+        continue;
+      const cryptonote::blobdata_ref blob(e.second.first);
+      if (!f(e.first, e.second.second, include_blob ? &blob : NULL))
+        return false;
+    }
+    return true;
+  }
+
+  // puts a tx spending key_image in the pool, under txid if given
+  crypto::hash add_tx(const crypto::key_image &key_image, const crypto::hash *txid = NULL)
+  {
+    cryptonote::transaction tx;
+    tx.version = 2;
+    tx.unlock_time = 0;
+    cryptonote::txin_to_key in;
+    in.amount = 0;
+    in.key_offsets.push_back(0);
+    in.k_image = key_image;
+    tx.vin.push_back(in);
+    tx.rct_signatures.type = rct::RCTTypeNull;
+    const cryptonote::blobdata blob = cryptonote::tx_to_blob(tx);
+
+    cryptonote::txpool_tx_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.weight = blob.size();
+    meta.fee = 1000;
+    meta.receive_time = time(NULL);
+    meta.set_relay_method(cryptonote::relay_method::fluff);
+    const crypto::hash id = txid ? *txid : crypto::cn_fast_hash(blob.data(), blob.size());
+    add_txpool_tx(id, blob, meta);
+    return id;
+  }
+
+private:
+  std::vector<std::pair<size_t, uint64_t>> blocks;
+  std::unordered_map<crypto::hash, std::pair<cryptonote::blobdata, cryptonote::txpool_tx_meta_t>> txes;
+};
+
+class txpool_snapshot: public ::testing::Test
+{
+protected:
+  txpool_snapshot():
+    db(new TestDB()),
+    txpool(*bc),
+    filename((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string())
+  {
+    bc.reset(new cryptonote::Blockchain(txpool));
+    for (size_t i = 0; i < 4; ++i)
+      key_images[i] = crypto::rand<crypto::key_image>();
+  }
+
+  virtual void SetUp() override
+  {
+    static const std::pair<uint8_t, uint64_t> hard_forks[2] = {std::make_pair(1, (uint64_t)0), std::make_pair((uint8_t)0, (uint64_t)0)};
+    static const cryptonote::test_options test_options = {hard_forks, 5000};
+    ASSERT_TRUE(bc->init(db, cryptonote::FAKECHAIN, true, &test_options, 0, NULL));
+  }
+
+  virtual void TearDown() override
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove(filename, ec);
+  }
+
+  std::vector<bool> spent()
+  {
+    std::vector<bool> spent;
+    txpool.check_for_key_images({key_images, key_images + 4}, spent);
+    return spent;
+  }
+
+  TestDB *db;
+  std::unique_ptr<cryptonote::Blockchain> bc;
+  cryptonote::tx_memory_pool txpool;
+  const std::string filename;
+  crypto::key_image key_images[4];
+};
+
+}
+
+TEST_F(txpool_snapshot, reload)
+{
+  db->add_tx(key_images[0]);
+  const crypto::hash txid = db->add_tx(key_images[1]);
+  ASSERT_TRUE(txpool.init(0, false, filename));
+  ASSERT_EQ(spent(), std::vector<bool>({true, true, false, false}));
+  const size_t weight = txpool.get_txpool_weight();
+  ASSERT_TRUE(txpool.deinit());
+  ASSERT_TRUE(boost::filesystem::exists(filename));
+
+  // same txids, so the snapshot is used, and the blob change only shows in a rebuild
+  db->add_tx(key_images[2], &txid);
+  ASSERT_TRUE(txpool.init(0, false, filename));
+  ASSERT_EQ(spent(), std::vector<bool>({true, true, false, false}));
+  ASSERT_EQ(txpool.get_txpool_weight(), weight);
+  ASSERT_FALSE(boost::filesystem::exists(filename));
+}
+
+TEST_F(txpool_snapshot, txids_mismatch)
+{
+  db->add_tx(key_images[0]);
+  const crypto::hash txid = db->add_tx(key_images[1]);
+  ASSERT_TRUE(txpool.init(0, false, filename));
+  ASSERT_TRUE(txpool.deinit());
+  ASSERT_TRUE(boost::filesystem::exists(filename));
+
+  // the pool changed while the daemon was down
+  db->add_tx(key_images[2], &txid);
+  db->add_tx(key_images[3]);
+  ASSERT_TRUE(txpool.init(0, false, filename));
+  ASSERT_EQ(spent(), std::vector<bool>({true, false, true, true}));
+  ASSERT_EQ(txpool.get_transactions_count(), 3);
+  ASSERT_FALSE(boost::filesystem::exists(filename));
+}
+
+TEST_F(txpool_snapshot, corrupt)
+{
+  const crypto::hash txid = db->add_tx(key_images[0]);
+  ASSERT_TRUE(txpool.init(0, false, filename));
+  ASSERT_TRUE(txpool.deinit());
+  ASSERT_TRUE(boost::filesystem::exists(filename));
+  std::string data;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(filename, data));
+  ASSERT_TRUE(data.size() > 8);
+  data.resize(data.size() / 2);
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(filename, data));
+
+  db->add_tx(key_images[1], &txid);
+  ASSERT_TRUE(txpool.init(0, false, filename));
+  ASSERT_EQ(spent(), std::vector<bool>({false, true, false, false}));
+  ASSERT_FALSE(boost::filesystem::exists(filename));
+}
@@ -0,0 +1,277 @@
+// Parts are Copyright (c) 2019, The Dinastycoin team
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+#include "file_io_utils.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "device/device.hpp"
+#include "wallet/wallet2.h"
+
+static const std::string output_magic("Dinastycoin output export\005");
+static const std::string key_image_magic("Dinastycoin key image export\004");
+static const size_t n_outputs = 2500; // three chunks, the last one partial
+static const size_t chunk_size = 1024;
+
+static std::vector<tools::wallet2::transfer_details> make_outputs(const cryptonote::account_public_address &address, size_t n)
+{
+  std::vector<tools::wallet2::transfer_details> outs(n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    tools::wallet2::transfer_details &td = outs[i];
+    const cryptonote::keypair tx_key = cryptonote::keypair::generate(hw::get_device("default"));
+    crypto::key_derivation derivation;
+    crypto::public_key out_key;
+    EXPECT_TRUE(crypto::generate_key_derivation(address.m_view_public_key, tx_key.sec, derivation));
+    EXPECT_TRUE(crypto::derive_public_key(derivation, 0, address.m_spend_public_key, out_key));
+    td.m_tx.version = 2;
+    td.m_tx.vout.push_back(cryptonote::tx_out{1, cryptonote::txout_to_key(out_key)});
+    cryptonote::add_tx_pub_key_to_extra(td.m_tx, tx_key.pub);
+    td.m_txid = crypto::rand<crypto::hash>();
+    td.m_internal_output_index = 0;
+    td.m_global_output_index = i;
+    td.m_amount = 1;
+  }
+  return outs;
+}
+
+// splits an export into its magic and length prefixed chunks, and back
+static std::vector<std::string> split_export(const std::string &data, size_t magiclen)
+{
+  std::vector<std::string> parts(1, data.substr(0, magiclen));
+  for (size_t pos = magiclen; pos < data.size(); )
+  {
+    const uint32_t size = (uint8_t)data[pos] | ((uint8_t)data[pos + 1] << 8) | ((uint8_t)data[pos + 2] << 16) | ((uint32_t)(uint8_t)data[pos + 3] << 24);
+    parts.push_back(data.substr(pos, 4 + size));
+    pos += 4 + size;
+  }
+  return parts;
+}
+
+static std::string join_export(const std::vector<std::string> &parts)
+{
+  std::string data;
+  for (const std::string &part: parts)
+    data += part;
+  return data;
+}
+
+class wallet_export: public ::testing::Test
+{
+protected:
+  wallet_export(): hot(cryptonote::TESTNET, 1, true), cold(cryptonote::TESTNET, 1, true) {}
+
+  virtual void SetUp()
+  {
+    dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    ASSERT_TRUE(boost::filesystem::create_directory(dir));
+
+    crypto::public_key spend_pub;
+    crypto::secret_key spendkey;
+    crypto::generate_keys(spend_pub, spendkey);
+    for (tools::wallet2 *w: {&hot, &cold})
+    {
+      w->set_offline();
+      w->set_subaddress_lookahead(1, 1);
+      w->generate("", "", spendkey, true, false);
+    }
+
+    // importing into the hot wallet works out the key images to compare with
+    hot.import_outputs(std::make_pair(0, make_outputs(hot.get_account().get_keys().m_account_address, n_outputs)));
+    ASSERT_EQ(hot.get_num_transfer_details(), n_outputs);
+  }
+
+  virtual void TearDown()
+  {
+    boost::filesystem::remove_all(dir);
+  }
+
+  std::string path(const std::string &name) const
+  {
+    return (dir / name).string();
+  }
+
+  void check_outputs(const tools::wallet2 &w, size_t n) const
+  {
+    ASSERT_EQ(w.get_num_transfer_details(), n);
+    for (size_t i = 0; i < n; ++i)
+    {
+      ASSERT_EQ(w.get_transfer_details(i).m_txid, hot.get_transfer_details(i).m_txid);
+      ASSERT_TRUE(w.get_transfer_details(i).m_key_image_known);
+      ASSERT_EQ(w.get_transfer_details(i).m_key_image, hot.get_transfer_details(i).m_key_image);
+    }
+  }
+
+  void check_key_images(const std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> &ski) const
+  {
+    ASSERT_EQ(ski.first, 0);
+    ASSERT_EQ(ski.second.size(), n_outputs);
+    for (size_t i = 0; i < n_outputs; ++i)
+    {
+      const tools::wallet2::transfer_details &td = hot.get_transfer_details(i);
+      const crypto::key_image &ki = ski.second[i].first;
+      const crypto::public_key pkey = td.get_public_key();
+      ASSERT_EQ(ki, td.m_key_image);
+      ASSERT_TRUE(crypto::check_ring_signature((const crypto::hash&)ki, ki, std::vector<const crypto::public_key*>{&pkey}, &ski.second[i].second));
+    }
+  }
+
+  boost::filesystem::path dir;
+  tools::wallet2 hot;
+  tools::wallet2 cold;
+};
+
+TEST_F(wallet_export, outputs_round_trip)
+{
+  const std::string filename = path("outputs");
+  ASSERT_TRUE(hot.export_outputs_to_file(filename, true));
+  std::string data;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(filename, data));
+  ASSERT_EQ(data.compare(0, output_magic.size(), output_magic), 0);
+  ASSERT_EQ(split_export(data, output_magic.size()).size(), 1 + 1 + (n_outputs + chunk_size - 1) / chunk_size);
+
+  ASSERT_EQ(cold.import_outputs_from_file(filename), n_outputs);
+  check_outputs(cold, n_outputs);
+
+  // the same export again changes nothing
+  ASSERT_EQ(cold.import_outputs_from_str(data), n_outputs);
+  check_outputs(cold, n_outputs);
+}
+
+TEST_F(wallet_export, outputs_legacy_format)
+{
+  const std::string data = hot.export_outputs_to_str(true, true);
+  ASSERT_EQ(data.compare(0, output_magic.size() - 1, output_magic, 0, output_magic.size() - 1), 0);
+  ASSERT_EQ(data[output_magic.size() - 1], '\004');
+  ASSERT_EQ(cold.import_outputs_from_str(data), n_outputs);
+  check_outputs(cold, n_outputs);
+}
+
+TEST_F(wallet_export, key_images_round_trip)
+{
+  cold.import_outputs(hot.export_outputs(true));
+  check_outputs(cold, n_outputs);
+
+  const std::string filename = path("key_images");
+  ASSERT_TRUE(cold.export_key_images(filename, true));
+  std::string data;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(filename, data));
+  ASSERT_EQ(data.compare(0, key_image_magic.size(), key_image_magic), 0);
+  check_key_images(hot.load_key_images(filename));
+
+  const std::string legacy_filename = path("key_images_legacy");
+  ASSERT_TRUE(cold.export_key_images(legacy_filename, true, true));
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(legacy_filename, data));
+  ASSERT_EQ(data[key_image_magic.size() - 1], '\003');
+  check_key_images(hot.load_key_images(legacy_filename));
+}
+
+TEST_F(wallet_export, truncated)
+{
+  cold.import_outputs(hot.export_outputs(true));
+  ASSERT_TRUE(cold.export_key_images(path("key_images"), true));
+  ASSERT_TRUE(hot.export_outputs_to_file(path("outputs"), true));
+
+  tools::wallet2 empty(cryptonote::TESTNET, 1, true);
+  empty.set_offline();
+  empty.set_subaddress_lookahead(1, 1);
+  empty.generate("", "", hot.get_account().get_keys().m_spend_secret_key, true, false);
+
+  std::string key_images, outputs;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(path("key_images"), key_images));
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(path("outputs"), outputs));
+  const std::vector<std::string> output_chunks = split_export(outputs, output_magic.size());
+  for (size_t size: {output_magic.size(), output_magic.size() + 10, outputs.size() / 2, outputs.size() - output_chunks.back().size(), outputs.size() - 1})
+  {
+    ASSERT_TRUE(epee::file_io_utils::save_string_to_file(path("truncated"), outputs.substr(0, size)));
+    tools::wallet2::import_cursor cursor;
+    EXPECT_THROW(empty.import_outputs_from_file(path("truncated"), &cursor), tools::error::wallet_internal_error);
+    ASSERT_EQ(cursor.next_chunk, 0);
+    ASSERT_EQ(empty.get_num_transfer_details(), 0);
+  }
+  for (size_t size: {key_image_magic.size() + 10, key_images.size() / 2, key_images.size() - 1})
+  {
+    ASSERT_TRUE(epee::file_io_utils::save_string_to_file(path("truncated"), key_images.substr(0, size)));
+    EXPECT_THROW(hot.load_key_images(path("truncated")), tools::error::wallet_internal_error);
+  }
+
+  // trailing data is not silently ignored either
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(path("extended"), outputs + output_chunks.back()));
+  EXPECT_THROW(empty.import_outputs_from_file(path("extended")), tools::error::wallet_internal_error);
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(path("extended"), key_images + std::string(4, '\0')));
+  EXPECT_THROW(hot.load_key_images(path("extended")), tools::error::wallet_internal_error);
+}
+
+TEST_F(wallet_export, reordered_chunks)
+{
+  cold.import_outputs(hot.export_outputs(true));
+  ASSERT_TRUE(cold.export_key_images(path("key_images"), true));
+  std::string key_images;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(path("key_images"), key_images));
+  std::vector<std::string> key_image_chunks = split_export(key_images, key_image_magic.size());
+  ASSERT_EQ(key_image_chunks.size(), 5);
+  std::swap(key_image_chunks[2], key_image_chunks[3]);
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(path("reordered"), join_export(key_image_chunks)));
+  EXPECT_THROW(hot.load_key_images(path("reordered")), tools::error::wallet_internal_error);
+
+  tools::wallet2 empty(cryptonote::TESTNET, 1, true);
+  empty.set_offline();
+  empty.set_subaddress_lookahead(1, 1);
+  empty.generate("", "", hot.get_account().get_keys().m_spend_secret_key, true, false);
+
+  // the chunk before the swapped ones is imported, and the cursor left after it
+  ASSERT_TRUE(hot.export_outputs_to_file(path("outputs"), true));
+  std::string outputs;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(path("outputs"), outputs));
+  std::vector<std::string> output_chunks = split_export(outputs, output_magic.size());
+  ASSERT_EQ(output_chunks.size(), 5);
+  std::swap(output_chunks[3], output_chunks[4]);
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(path("reordered"), join_export(output_chunks)));
+  tools::wallet2::import_cursor cursor;
+  EXPECT_THROW(empty.import_outputs_from_file(path("reordered"), &cursor), tools::error::wallet_internal_error);
+  ASSERT_EQ(cursor.next_chunk, 1);
+  ASSERT_EQ(cursor.next_output, chunk_size);
+  check_outputs(empty, chunk_size);
+
+  // resuming does not read the chunk already imported, so it may be damaged
+  std::swap(output_chunks[3], output_chunks[4]);
+  output_chunks[2][10] ^= 1;
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(path("resumed"), join_export(output_chunks)));
+  ASSERT_EQ(empty.import_outputs_from_file(path("resumed"), &cursor), n_outputs);
+  ASSERT_EQ(cursor.next_chunk, 0);
+  check_outputs(empty, n_outputs);
+
+  // a cursor for another export is ignored
+  cursor.file_id = crypto::rand<crypto::hash>();
+  cursor.next_chunk = 2;
+  cursor.next_output = 2 * chunk_size;
+  ASSERT_EQ(empty.import_outputs_from_file(path("outputs"), &cursor), n_outputs);
+  check_outputs(empty, n_outputs);
+}
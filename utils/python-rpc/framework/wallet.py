@@ -405,7 +405,7 @@ class Wallet(object):
         }
         return self.rpc.send_json_rpc_request(incoming_transfers)
 
-    def get_transfers(self, in_ = True, out = True, pending = True, failed = True, pool = True, min_height = None, max_height = None, account_index = 0, subaddr_indices = [], all_accounts = False):
+    def get_transfers(self, in_ = True, out = True, pending = True, failed = True, pool = True, min_height = None, max_height = None, account_index = 0, subaddr_indices = [], all_accounts = False, max_results = 0, cursor = ''):
         get_transfers = {
             'method': 'get_transfers',
             'params' : {
@@ -420,6 +420,8 @@ class Wallet(object):
                 'account_index': account_index,
                 'subaddr_indices': subaddr_indices,
                 'all_accounts': all_accounts,
+                'max_results': max_results,
+                'cursor': cursor,
             },
             'jsonrpc': '2.0', 
             'id': '0'